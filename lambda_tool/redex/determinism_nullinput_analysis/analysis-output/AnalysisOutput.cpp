@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AnalysisOutput.h"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iterator>
+#include <json/reader.h>
+#include <json/writer.h>
+#include <sstream>
+#include <utility>
+
+#include "Debug.h"
+#include "Show.h"
+#include "Trace.h"
+
+namespace analysis_output {
+
+namespace {
+
+// The size of the buffer through which sort_json_lines() copies the lines.
+constexpr size_t kSortBufferSize = 64 * 1024;
+
+// "Lcom/foo/Bar;" -> "Bar"
+std::string short_class_name(const DexMethod* method) {
+  std::string class_name = method->get_class()->c_str();
+  class_name.pop_back();
+  return class_name.substr(class_name.rfind('/') + 1);
+}
+
+bool parse_json(const std::string& text, Json::Value* value) {
+  Json::CharReaderBuilder builder;
+  std::istringstream in(text);
+  std::string errors;
+  return Json::parseFromStream(builder, in, value, &errors);
+}
+
+void add_result(const Json::Value& record,
+                const std::unordered_set<std::string>& methods,
+                Json::Value* records) {
+  if (methods.empty() || methods.count(record["name"].asString())) {
+    records->append(record);
+  }
+}
+
+} // namespace
+
+Format parse_format(const std::string& name) {
+  if (name == "json") {
+    return Format::PER_CLASS_JSON;
+  } else if (name == "jsonl") {
+    return Format::JSON_LINES;
+  }
+  not_reached_log("Unknown output_format %s, expected json or jsonl",
+                  name.c_str());
+}
+
+boost::optional<std::string> result_directory() {
+  const char* output = getenv("ANALYSIS_OUTPUT");
+  if (output == nullptr) {
+    return boost::none;
+  }
+  std::string directory(output);
+  const char* date_time = getenv("current_date_time");
+  if (date_time != nullptr && *date_time != '\0') {
+    directory.append("/").append(date_time);
+  }
+  return directory;
+}
+
+Json::Value read_results(const std::string& directory,
+                         const std::unordered_set<std::string>& methods) {
+  namespace fs = boost::filesystem;
+  Json::Value results(Json::objectValue);
+  boost::system::error_code ec;
+  for (fs::directory_iterator it(directory, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    const auto& path = it->path();
+    auto extension = path.extension().string();
+    auto stem = path.stem().string();
+    std::ifstream in(path.string());
+    if (extension == ".jsonl") {
+      // <suffix>.jsonl
+      auto& records = results[stem];
+      std::string line;
+      while (std::getline(in, line)) {
+        Json::Value record;
+        if (parse_json(line, &record)) {
+          add_result(record, methods, &records);
+        }
+      }
+    } else if (extension == ".json" && stem.find('_') != std::string::npos) {
+      // <Class>_<suffix>.json
+      auto& records = results[stem.substr(stem.rfind('_') + 1)];
+      std::string text((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+      Json::Value class_records;
+      if (parse_json(text, &class_records) && class_records.isArray()) {
+        for (const auto& record : class_records) {
+          add_result(record, methods, &records);
+        }
+      }
+    }
+  }
+  // A pass whose records were all filtered out still gets an empty array.
+  for (const auto& suffix : results.getMemberNames()) {
+    if (results[suffix].isNull()) {
+      results[suffix] = Json::Value(Json::arrayValue);
+    }
+  }
+  return results;
+}
+
+std::unique_ptr<ResultWriter> ResultWriter::open(const std::string& pass_name,
+                                                 const std::string& suffix,
+                                                 Format format) {
+  auto directory = result_directory();
+  if (!directory) {
+    fprintf(stderr,
+            "[%s] ANALYSIS_OUTPUT is not set, the results are not written\n",
+            pass_name.c_str());
+    return nullptr;
+  }
+  std::unique_ptr<ResultWriter> writer(
+      new ResultWriter(pass_name, *directory, suffix, format));
+  if (format == Format::JSON_LINES) {
+    auto path = *directory + "/" + suffix + ".jsonl";
+    writer->m_out.open(path, std::ios_base::out | std::ios_base::trunc);
+    if (!writer->m_out) {
+      fprintf(stderr, "[%s] Cannot create %s, the results are not written\n",
+              pass_name.c_str(), path.c_str());
+      writer->m_finished = true;
+      return nullptr;
+    }
+    TRACE(UDF_OUTPUT, 2, "[%s] Writing the results to %s", pass_name.c_str(),
+          path.c_str());
+    writer->m_writer = std::thread([w = writer.get()] { w->write_json_lines(); });
+  }
+  return writer;
+}
+
+ResultWriter::ResultWriter(std::string pass_name,
+                           std::string directory,
+                           std::string suffix,
+                           Format format)
+    : m_pass_name(std::move(pass_name)),
+      m_directory(std::move(directory)),
+      m_suffix(std::move(suffix)),
+      m_format(format) {}
+
+ResultWriter::~ResultWriter() { finish(); }
+
+void ResultWriter::add(const DexMethod* method, Json::Value record) {
+  always_assert(!m_finished);
+  auto class_name = short_class_name(method);
+  if (m_format == Format::PER_CLASS_JSON) {
+    std::lock_guard<std::mutex> lock(m_classes_lock);
+    auto& records = m_classes[class_name];
+    if (records.isNull()) {
+      records = Json::Value(Json::arrayValue);
+    }
+    records.append(std::move(record));
+    return;
+  }
+  record["class"] = class_name;
+  {
+    std::lock_guard<std::mutex> lock(m_queue_lock);
+    m_queue.push_back(std::move(record));
+  }
+  m_queue_not_empty.notify_one();
+}
+
+void ResultWriter::write_json_lines() {
+  Json::StreamWriterBuilder builder;
+  builder["indentation"] = "";
+  std::deque<Json::Value> batch;
+  size_t offset = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_queue_lock);
+      m_queue_not_empty.wait(lock,
+                             [this] { return m_closed || !m_queue.empty(); });
+      if (m_queue.empty()) {
+        // Closed and drained.
+        return;
+      }
+      batch.swap(m_queue);
+    }
+    for (const auto& record : batch) {
+      auto line = Json::writeString(builder, record);
+      line.push_back('\n');
+      m_out << line;
+      m_lines.push_back(Line{record["name"].asString(), offset, line.size()});
+      offset += line.size();
+    }
+    batch.clear();
+  }
+}
+
+bool ResultWriter::finish() {
+  if (m_finished) {
+    return true;
+  }
+  m_finished = true;
+  if (m_format == Format::JSON_LINES) {
+    {
+      std::lock_guard<std::mutex> lock(m_queue_lock);
+      m_closed = true;
+    }
+    m_queue_not_empty.notify_one();
+    if (m_writer.joinable()) {
+      m_writer.join();
+    }
+    m_out.close();
+    if (!m_out || !sort_json_lines()) {
+      fprintf(stderr, "[%s] Failed to write %s/%s.jsonl\n", m_pass_name.c_str(),
+              m_directory.c_str(), m_suffix.c_str());
+      return false;
+    }
+    return true;
+  }
+  bool ok = true;
+  for (auto& entry : m_classes) {
+    auto& records = entry.second;
+    std::vector<Json::Value> sorted(records.begin(), records.end());
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const Json::Value& a, const Json::Value& b) {
+                       return a["name"].asString() < b["name"].asString();
+                     });
+    records.clear();
+    for (auto& record : sorted) {
+      records.append(std::move(record));
+    }
+    auto path = m_directory + "/" + entry.first + "_" + m_suffix + ".json";
+    TRACE(UDF_OUTPUT, 3, "%s", SHOW(path));
+    std::ofstream o(path, std::ios_base::out | std::ios_base::trunc);
+    o << std::setw(4) << entry.second << std::endl;
+    if (!o) {
+      fprintf(stderr, "[%s] Failed to write %s\n", m_pass_name.c_str(),
+              path.c_str());
+      ok = false;
+    }
+  }
+  m_classes.clear();
+  return ok;
+}
+
+bool ResultWriter::sort_json_lines() {
+  std::stable_sort(
+      m_lines.begin(), m_lines.end(),
+      [](const Line& a, const Line& b) { return a.name < b.name; });
+  auto path = m_directory + "/" + m_suffix + ".jsonl";
+  // The lines are copied one at a time through a bounded buffer, so the memory
+  // used does not grow with the size of the file, which may hold the results
+  // of millions of methods.
+  std::ifstream in(path, std::ios_base::binary);
+  if (!in) {
+    return false;
+  }
+  auto tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios_base::binary | std::ios_base::trunc);
+    std::vector<char> buffer(kSortBufferSize);
+    size_t position = 0;
+    for (const auto& line : m_lines) {
+      if (line.offset != position) {
+        in.seekg(line.offset);
+        position = line.offset;
+      }
+      for (size_t left = line.size; left > 0;) {
+        size_t chunk = std::min(left, buffer.size());
+        if (!in.read(buffer.data(), chunk)) {
+          return false;
+        }
+        out.write(buffer.data(), chunk);
+        position += chunk;
+        left -= chunk;
+      }
+    }
+    if (!out) {
+      return false;
+    }
+  }
+  m_lines.clear();
+  return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+} // namespace analysis_output
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <json/value.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "DexClass.h"
+
+namespace analysis_output {
+
+enum class Format {
+  // One pretty-printed array of records per class, in
+  // <directory>/<Class>_<suffix>.json.
+  PER_CLASS_JSON,
+  // One compact record per line, in <directory>/<suffix>.jsonl. The records
+  // also have the class name in "class".
+  JSON_LINES,
+};
+
+// Parses the value of the output_format option of the UDF analysis passes,
+// "json" or "jsonl".
+Format parse_format(const std::string& name);
+
+// Returns the directory the results are written to: $ANALYSIS_OUTPUT, or
+// $ANALYSIS_OUTPUT/$current_date_time if current_date_time is set and not
+// empty. Returns none if ANALYSIS_OUTPUT is not set.
+boost::optional<std::string> result_directory();
+
+// Reads back the records written to `directory` by the analysis passes, in
+// either format, as an object mapping the suffix of each pass (e.g. "det") to
+// an array of records. Only the records whose "name" is in `methods` are kept,
+// unless `methods` is empty. Files that cannot be parsed are skipped.
+Json::Value read_results(const std::string& directory,
+                         const std::unordered_set<std::string>& methods);
+
+/*
+ * Writes the per-method records of an analysis pass in the given format.
+ *
+ * In the JSON Lines format, the records are serialized and written by a
+ * background thread while the pass keeps adding them, and all the records go
+ * to a single file instead of one file per class.
+ *
+ * add() may be called concurrently, e.g. as the summaries of the methods
+ * become final. finish() sorts the records of each file by "name", so the
+ * output does not depend on the order they were added in.
+ */
+class ResultWriter final {
+ public:
+  // Returns null, after printing why, if ANALYSIS_OUTPUT is not set or the
+  // output file cannot be created.
+  static std::unique_ptr<ResultWriter> open(const std::string& pass_name,
+                                            const std::string& suffix,
+                                            Format format);
+
+  // Waits for the records added so far to be written.
+  ~ResultWriter();
+
+  void add(const DexMethod* method, Json::Value record);
+
+  // Writes the pending records and closes the output. Returns false if a
+  // write failed.
+  bool finish();
+
+ private:
+  ResultWriter(std::string pass_name,
+               std::string directory,
+               std::string suffix,
+               Format format);
+
+  void write_json_lines();
+
+  // Rewrites the JSON Lines file with its lines sorted by name.
+  bool sort_json_lines();
+
+  std::string m_pass_name;
+  std::string m_directory;
+  std::string m_suffix;
+  Format m_format;
+  bool m_finished{false};
+
+  // PER_CLASS_JSON: the records of each class, keyed by the class name.
+  std::mutex m_classes_lock;
+  std::map<std::string, Json::Value> m_classes;
+
+  // JSON_LINES: the records not yet written, and the thread that writes them.
+  std::ofstream m_out;
+  std::mutex m_queue_lock;
+  std::condition_variable m_queue_not_empty;
+  std::deque<Json::Value> m_queue;
+  bool m_closed{false};
+  std::thread m_writer;
+
+  // JSON_LINES: the name, offset and size of each line written, only accessed
+  // by the writer thread until it is joined.
+  struct Line {
+    std::string name;
+    size_t offset;
+    size_t size;
+  };
+  std::vector<Line> m_lines;
+};
+
+} // namespace analysis_output
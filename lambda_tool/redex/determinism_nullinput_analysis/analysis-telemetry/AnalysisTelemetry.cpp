@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AnalysisTelemetry.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <unordered_map>
+
+#include "ScopedMetrics.h"
+#include "Show.h"
+#include "Timer.h"
+
+namespace analysis_telemetry {
+
+void MethodTelemetry::record(const Record& record) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_records.push_back(record);
+}
+
+size_t MethodTelemetry::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_records.size();
+}
+
+bool MethodTelemetry::write_csv(const std::string& path) const {
+  std::ofstream out(path, std::ios::out | std::ios::trunc);
+  if (!out) {
+    return false;
+  }
+  out << "method,iteration,microseconds,blocks,fixpoint_iterations,"
+         "summary_changed\n";
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (const auto& record : m_records) {
+    // Method signatures have no double quotes.
+    out << '"' << show(record.function) << "\"," << record.iteration << ','
+        << record.microseconds << ',' << record.stats.num_nodes << ','
+        << record.stats.num_iterations << ',' << record.summary_changed
+        << '\n';
+  }
+  out.close();
+  return !out.fail();
+}
+
+std::vector<MethodTelemetry::MethodTotals> MethodTelemetry::top_methods(
+    size_t n) const {
+  std::unordered_map<const DexMethod*, MethodTotals> totals;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& record : m_records) {
+      auto& method_totals =
+          totals.emplace(record.function, MethodTotals{record.function})
+              .first->second;
+      ++method_totals.num_analyses;
+      method_totals.microseconds += record.microseconds;
+      method_totals.num_blocks =
+          std::max(method_totals.num_blocks, record.stats.num_nodes);
+      method_totals.num_iterations += record.stats.num_iterations;
+      method_totals.num_summary_changes += record.summary_changed;
+    }
+  }
+  std::vector<MethodTotals> sorted;
+  sorted.reserve(totals.size());
+  for (auto& entry : totals) {
+    sorted.push_back(entry.second);
+  }
+  auto by_time = [](const MethodTotals& a, const MethodTotals& b) {
+    if (a.microseconds != b.microseconds) {
+      return a.microseconds > b.microseconds;
+    }
+    return compare_dexmethods(a.method, b.method);
+  };
+  n = std::min(n, sorted.size());
+  std::partial_sort(sorted.begin(), sorted.begin() + n, sorted.end(), by_time);
+  sorted.resize(n);
+  return sorted;
+}
+
+std::string MethodTelemetry::top_methods_report(size_t n) const {
+  std::string report;
+  char line[128];
+  for (const auto& totals : top_methods(n)) {
+    snprintf(line, sizeof(line),
+             "%10" PRIu64 " us %4zu analyses %6u blocks %6" PRIu64
+             " iterations %4zu changes  ",
+             totals.microseconds, totals.num_analyses, totals.num_blocks,
+             totals.num_iterations, totals.num_summary_changes);
+    report.append(line).append(show(totals.method)).append("\n");
+  }
+  return report;
+}
+
+void MethodTelemetry::write(const std::string& path,
+                            size_t top_n,
+                            TraceModule module) const {
+  if (!write_csv(path)) {
+    fprintf(stderr, "Failed to write the analysis telemetry to %s\n",
+            path.c_str());
+  }
+  TRACE(module, 1, "%zu method analyses, the slowest methods:\n%s", size(),
+        top_methods_report(top_n).c_str());
+}
+
+void MethodTelemetry::report(const std::string& pass_name,
+                             PassManager& mgr) const {
+  uint64_t total_microseconds = 0;
+  uint64_t max_microseconds = 0;
+  size_t num_summary_changes = 0;
+  size_t num_records;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    num_records = m_records.size();
+    for (const auto& record : m_records) {
+      total_microseconds += record.microseconds;
+      max_microseconds = std::max(max_microseconds, record.microseconds);
+      num_summary_changes += record.summary_changed;
+    }
+  }
+  ScopedMetrics sm(mgr);
+  auto sm_scope = sm.scope("telemetry");
+  sm.set_metric("num_analyses", num_records);
+  sm.set_metric("total_us", total_microseconds);
+  sm.set_metric("max_us", max_microseconds);
+  sm.set_metric("num_summary_changes", num_summary_changes);
+  // Summed over the threads, so it can exceed the wall time of the pass.
+  Timer::add_timer(pass_name + " method analyses",
+                   static_cast<double>(total_microseconds) / 1000000);
+}
+
+} // namespace analysis_telemetry
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Analyzer.h"
+#include "DexClass.h"
+#include "Trace.h"
+
+class PassManager;
+
+namespace analysis_telemetry {
+
+/*
+ * Records every analysis of a method by the interprocedural analyzer of a UDF
+ * analysis pass, see sparta::InterproceduralAnalyzer::set_telemetry(), to find
+ * the methods that make a run slow. The records can be written as CSV, and
+ * summarized per method.
+ */
+class MethodTelemetry final
+    : public sparta::AnalysisTelemetry<const DexMethod*> {
+ public:
+  // The records of a method, summed over its analyses.
+  struct MethodTotals {
+    const DexMethod* method;
+    size_t num_analyses = 0;
+    uint64_t microseconds = 0;
+    uint32_t num_blocks = 0;
+    uint64_t num_iterations = 0;
+    size_t num_summary_changes = 0;
+  };
+
+  // Thread-safe.
+  void record(const Record& record) override;
+
+  size_t size() const;
+
+  // Writes one line per record, in the order they were recorded, with the
+  // columns: method, iteration, microseconds, blocks, fixpoint_iterations,
+  // summary_changed. Returns false if the file could not be written.
+  bool write_csv(const std::string& path) const;
+
+  // The `n` methods with the largest total analysis time.
+  std::vector<MethodTotals> top_methods(size_t n) const;
+
+  // One line per method of top_methods(n).
+  std::string top_methods_report(size_t n) const;
+
+  // Writes the CSV to `path`, and traces the report of the `top_n` methods in
+  // `module` at level 1.
+  void write(const std::string& path, size_t top_n, TraceModule module) const;
+
+  // Sets the metrics "telemetry.*" of the running pass, and adds the total
+  // analysis time of the methods to the timers.
+  void report(const std::string& pass_name, PassManager& mgr) const;
+
+ private:
+  mutable std::mutex m_mutex;
+  std::vector<Record> m_records;
+};
+
+} // namespace analysis_telemetry
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/optional.hpp>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ConcurrentContainers.h"
+#include "DexClass.h"
+#include "IRInstruction.h"
+#include "Walkers.h"
+
+/*
+ * The manual labels of the callees, resolved to the method references and
+ * classes they name. The labels file names a method as "<class><name>", e.g.
+ * "Ljava/lang/Math;random", which labels all its overloads, and all the
+ * methods of a class as "<class>*".
+ *
+ * resolve() matches the names against the invoke instructions of the scope
+ * once, so that looking up the label of a callee while analyzing a method is a
+ * pointer-keyed lookup that does not allocate.
+ */
+template <typename Domain>
+class CalleeLabels final {
+ public:
+  void resolve(const Scope& scope,
+               const std::unordered_map<std::string, Domain>& labels) {
+    m_methods.clear();
+    m_classes.clear();
+    std::unordered_map<std::pair<const DexType*, const DexString*>,
+                       Domain,
+                       boost::hash<std::pair<const DexType*, const DexString*>>>
+        named_methods;
+    for (const auto& entry : labels) {
+      const auto& name = entry.first;
+      if (!name.empty() && name.back() == '*') {
+        // Classes that are not referenced by the scope have no type.
+        auto* type = DexType::get_type(name.substr(0, name.size() - 1));
+        if (type != nullptr) {
+          m_classes.emplace(type, entry.second);
+        }
+        continue;
+      }
+      auto class_end = name.find(';');
+      if (class_end == std::string::npos) {
+        continue;
+      }
+      auto* type = DexType::get_type(name.substr(0, class_end + 1));
+      auto* method_name = DexString::get_string(name.substr(class_end + 1));
+      if (type != nullptr && method_name != nullptr) {
+        named_methods.emplace(std::make_pair(type, method_name), entry.second);
+      }
+    }
+    if (named_methods.empty()) {
+      return;
+    }
+    walk::parallel::opcodes(scope, [&](const DexMethod*, IRInstruction* insn) {
+      if (!insn->has_method()) {
+        return;
+      }
+      const auto* callee = insn->get_method();
+      auto it = named_methods.find(
+          std::make_pair(callee->get_class(), callee->get_name()));
+      if (it != named_methods.end()) {
+        m_methods.emplace(callee, it->second);
+      }
+    });
+  }
+
+  // Returns the label of the callee of an invoke instruction, if any. A label
+  // of the method takes precedence over a label of its class.
+  boost::optional<Domain> get(const DexMethodRef* callee) const {
+    auto method_it = m_methods.find(callee);
+    if (method_it != m_methods.end()) {
+      return method_it->second;
+    }
+    auto class_it = m_classes.find(callee->get_class());
+    if (class_it != m_classes.end()) {
+      return class_it->second;
+    }
+    return boost::none;
+  }
+
+  size_t num_methods() const { return m_methods.size(); }
+
+  size_t num_classes() const { return m_classes.size(); }
+
+ private:
+  ConcurrentMap<const DexMethodRef*, Domain> m_methods;
+  std::unordered_map<const DexType*, Domain> m_classes;
+};
+
+/*
+ * The comma-separated words of the lines of a labels file, empty if it cannot
+ * be read. The files are kept in memory, and read again only if their size or
+ * modification time changed, so that the runs forked from a redex-all server
+ * share the files it read, see Pass::preload().
+ */
+inline std::shared_ptr<const std::vector<std::string>> read_label_file(
+    const std::string& path) {
+  struct File {
+    uintmax_t size;
+    std::time_t mtime;
+    std::shared_ptr<const std::vector<std::string>> words;
+  };
+  static std::mutex files_lock;
+  static std::unordered_map<std::string, File> files;
+
+  boost::system::error_code ec;
+  auto size = boost::filesystem::file_size(path, ec);
+  std::time_t mtime = ec ? 0 : boost::filesystem::last_write_time(path, ec);
+  std::lock_guard<std::mutex> lock(files_lock);
+  auto it = files.find(path);
+  if (!ec && it != files.end() && it->second.size == size &&
+      it->second.mtime == mtime) {
+    return it->second.words;
+  }
+  auto words = std::make_shared<std::vector<std::string>>();
+  std::ifstream file(path);
+  std::string line, word;
+  while (std::getline(file, line)) {
+    std::stringstream str(line);
+    while (std::getline(str, word, ',')) {
+      words->push_back(word);
+    }
+  }
+  if (!ec) {
+    files[path] = File{size, mtime, words};
+  }
+  return words;
+}
@@ -25,6 +25,12 @@
 #include "FieldOpTracker.h"
 #include "Show.h"
 #include "SpartaInterprocedural.h"
+#include "UdfAnalysisRunner.h"
+#include "WorkQueue.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -33,11 +39,24 @@
 namespace {
 using namespace determinism;
 
+struct DeterminismTraits {
+  using Summary = DeterminismDomain;
+  static constexpr TraceModule trace_module = UDF_DET;
+  static constexpr const char* pass_name = "DeterminismAnalysisPass";
+  static constexpr const char* suffix = "det";
+  static void add_summary(const Summary& summary, Json::Value* record) {
+    (*record)["lattice"] = summary.element();
+  }
+  static uint32_t encode(const Summary& summary) { return summary.element(); }
+  static Summary decode(uint32_t element) {
+    return Summary(static_cast<DeterminismType>(element));
+  }
+};
+
 using namespace sparta;
 using namespace sparta_interprocedural;
 
 constexpr const IRInstruction* CURRENT_PARTITION_LABEL = nullptr;
-DetFieldPartition instance_fields;
 
 // Description for the analysis
 
@@ -84,26 +103,29 @@ struct Caller {
                       const Domain& exit_state_at_source) {
     // this function sets up the entry_state_at_dest (starting context) for analyzing of functions
     auto ins = edge->invoke_insn();
-    printf("enter analyze_edge in Determinismanalysis.cpp %s\n", SHOW(ins));
+    TRACE(UDF_DET,
+          3,
+          "enter analyze_edge in Determinismanalysis.cpp %s",
+          SHOW(ins));
     auto caller = edge->caller()->method();
     if (edge->caller()->is_entry()) {
-      printf("caller is a ghost entry block\n");
+      TRACE(UDF_DET, 3, "caller is a ghost entry block");
     } else {
-      printf("caller is not a ghost entry block\n");
-      printf("caller method is %s\n", SHOW(caller));
+      TRACE(UDF_DET, 3, "caller is not a ghost entry block");
+      TRACE(UDF_DET, 3, "caller method is %s", SHOW(caller));
     }
     auto callee = edge->callee()->method();
     if (edge->callee()->is_exit()) {
-      printf("callee is a ghost exit block\n");
+      TRACE(UDF_DET, 3, "callee is a ghost exit block");
     } else {
-      printf("callee is not a ghost exit block\n");
-      printf("callee method is %s\n", SHOW(callee));
+      TRACE(UDF_DET, 3, "callee is not a ghost exit block");
+      TRACE(UDF_DET, 3, "callee method is %s", SHOW(callee));
     }
     if (!callee) {
-      printf("callee is nullptr, return a default bottom domain\n");
+      TRACE(UDF_DET, 3, "callee is nullptr, return a default bottom domain");
       return Domain::bottom(); // it means the invoked method is a dead point
     }
-    printf("callee is not nullptr\n");
+    TRACE(UDF_DET, 3, "callee is not nullptr");
 
     Domain arg_domain;
     // the default partition should produce the bottom value.
@@ -121,14 +143,22 @@ struct Caller {
     Domain entry_state_at_dest;
     auto insn = edge->invoke_insn();
     if (insn == nullptr) {
-      printf("invoke instruction is nullptr, get a top argumentdomain\n");
+      TRACE(UDF_DET,
+            3,
+            "invoke instruction is nullptr, get a top argumentdomain");
       entry_state_at_dest.set(CURRENT_PARTITION_LABEL, ArgumentDomain::top());
     } else {
-      printf("invoke instruction is not nullptr, try get domain from exit_state_at_source\n");
+      TRACE(UDF_DET,
+            3,
+            "invoke instruction is not nullptr, try get domain from exit_state_at_source");
       entry_state_at_dest.set(CURRENT_PARTITION_LABEL,
                               exit_state_at_source.get(insn));
     }
-    std::cout << "new entry state is" << CURRENT_PARTITION_LABEL << entry_state_at_dest.get(insn) << std::endl;
+    TRACE(UDF_DET,
+          3,
+          "new entry state is %s %s",
+          SHOW(CURRENT_PARTITION_LABEL),
+          SHOW(entry_state_at_dest.get(insn)));
     return entry_state_at_dest;
   }
 };
@@ -144,31 +174,43 @@ class DeterminismFunctionAnalyzer : public Base {
   const DexMethod* m_method;
   // It store the return value anlaysis result from the intra-analyzer
   DeterminismDomain m_domain;
+  // The size of the CFG and the fixpoint iterations of the last analysis.
+  sparta::FunctionAnalysisStats m_stats;
 
 
  public:
   explicit DeterminismFunctionAnalyzer(const DexMethod* method)
       : m_method(method), m_domain(DeterminismDomain::top()) {}
+
+  sparta::FunctionAnalysisStats analysis_stats() const { return m_stats; }
   // This is the main function for performing intraprocedural analysis
   void debug_boolean_parameters() {
-    printf("track_exception");
-    std::cout << this->get_analysis_parameters()->track_exception << std::endl;
+    TRACE(UDF_DET, 3, "track_exception");
+    TRACE(UDF_DET,
+          3,
+          "%s",
+          SHOW(this->get_analysis_parameters()->track_exception));
   }
   void analyze() override {
     // std::vector<std::string> function_names;
     for (int i = 0; i < this->get_analysis_parameters()->function_names.size();
          i++) {
-      printf("get_analysis_parameters check %s\n",
-             this->get_analysis_parameters()->function_names[i].c_str());
+      TRACE(UDF_DET,
+            3,
+            "get_analysis_parameters check %s",
+            this->get_analysis_parameters()->function_names[i].c_str());
     }
     if (m_method) {
-      printf("Intra anlaysis on a function %s \n",
-             m_method->get_name()->c_str());
+      TRACE(UDF_DET,
+            3,
+            "Intra anlaysis on a function %s",
+            m_method->get_name()->c_str());
 
     } else {
       // ghost exit or ghost entry?
-      printf(
-          "Intra anlaysis on a function that is ghost enetry or exit\n");
+      TRACE(UDF_DET,
+            3,
+            "Intra anlaysis on a function that is ghost enetry or exit");
       return;
     }
     // This very long lambda function queries about the data flow fact after
@@ -176,46 +218,28 @@ class DeterminismFunctionAnalyzer : public Base {
     // Input: instruction that invokes a method, Output: DeterminismDomain
     determinism::SummaryQueryFn query_fn =
         [&](const IRInstruction* insn) -> DeterminismDomain {
+      // Here is how it utilizes previous analysis results of callee functions.
+      // A manual label of the callee takes precedence over its summary. The
+      // labels are resolved once per run, see CalleeLabels, so a labeled
+      // callee costs a single lookup and its callees are not resolved.
+      auto label = this->get_analysis_parameters()->callee_labels.get(
+          insn->get_method());
+      if (label) {
+        TRACE(UDF_DET,
+              3,
+              "find an existing label of callee %s: %s",
+              SHOW(insn->get_method()),
+              SHOW(*label));
+        return *label;
+      }
+      TRACE(UDF_DET, 3, "%s does not find manual label for callee", SHOW(insn));
+      TRACE(UDF_DET, 3, "now try to find summary of the callee");
       auto callees = call_graph::resolve_callees_in_graph(
           *this->get_call_graph(), m_method, insn);
-      auto &map = (*this->get_call_graph()).get_insn_to_callee();
-      std::cout << "size of insn->calee" << map.size()<<std::endl;
       DeterminismDomain ret = DeterminismDomain::bottom();
-      auto func_name = insn->get_method()->c_str();
-      auto class_name = insn->get_method()->get_class()->c_str();
-      std::cout << "callee name is" << class_name << "." << func_name
-                << std::endl;
-      std::string buf(class_name);
-      // buf stores the class_name+func_name
-      buf.append(func_name);
-      // second_buff stores the wildcard for the entire function (for easier
-      // function labeling)
-      std::string second_buff(class_name);
-      second_buff.append("*");
-      // Here is how it utilizes previous analysis results of callee functions
-      if (this->get_analysis_parameters()->func_domain_map.count(buf)) {
-        std::cout << "find and exisitng label from individual function lable"
-                  << (this->get_analysis_parameters()->func_domain_map)[buf]
-                  << std::endl;
-        return (this->get_analysis_parameters()->func_domain_map)[buf];
-      } else if (this->get_analysis_parameters()->func_domain_map.count(
-                     second_buff)) {
-        std::cout
-            << "find and exisitng label from class that has wildcard"
-            << (this->get_analysis_parameters()->func_domain_map)[second_buff]
-            << std::endl;
-        return (this->get_analysis_parameters()->func_domain_map)[second_buff];
-      } else {
-        std::cout << SHOW(insn) << "does not find manual label for callee" << std::endl;
-        // always_assert_log(callees.size() > 0,
-        //                   "%s does not find callee or existing label",
-        //                   SHOW(insn));
-      }
-      printf("now try to find summary of the callee\n");
       for (const DexMethod* method : callees) {
-        auto domain =
-            this->get_summaries()->get(method, DeterminismDomain::top());
-        ret.join_with(domain);
+        ret.join_with(
+            this->get_summaries()->get(method, DeterminismDomain::top()));
       }
       if (ret.is_bottom()) {
         // Two possible reasons on why the return value is bottom: 1. callee is not in the graph. 2. callee returns void.
@@ -228,43 +252,67 @@ class DeterminismFunctionAnalyzer : public Base {
       return ret;
     };
     // CallerContext has the type: Callsite::Domain;
-    printf("try to get calling context\n");
+    TRACE(UDF_DET, 3, "try to get calling context");
     auto context = this->get_caller_context()->get(CURRENT_PARTITION_LABEL);
     if (context.is_bottom()) {
-      printf("in analysis.cpp, encounter a default bottom context\n");
+      TRACE(UDF_DET, 3, "in analysis.cpp, encounter a default bottom context");
     } else {
-      printf("in analysis.cpp, encounter a non-bottom context\n");
+      TRACE(UDF_DET, 3, "in analysis.cpp, encounter a non-bottom context");
+    }
+    auto update_context =
+        [&](const IRInstruction* insn,
+            const determinism::CallingContext& calling_context) {
+          this->get_caller_context()->update(
+              insn, [&](const determinism::CallingContext& original_context) {
+                return calling_context.join(original_context);
+              });
+        };
+    // Methods whose code and inputs did not change since a previous run keep
+    // the analysis of that run.
+    std::vector<uint32_t> context_words;
+    udf_analysis::encode_partition(context, &context_words);
+    udf_analysis::CachedAnalysis<DeterminismTraits> cached_analysis(
+        this->get_analysis_parameters()->summary_cache, m_method, context_words,
+        query_fn);
+    if (auto cached = cached_analysis.reuse<determinism::CallingContext>(
+            update_context)) {
+      m_domain = *cached;
+      return;
     }
-    std::unordered_set<std::string> func_resetdet_set =
-        this->get_analysis_parameters()->func_reset_det_set;
     // Flow-insensitive Intraprocedural anlaysis is performed when the analysis
     // is initialized. I think it should use the registry member varaible in the
     // class of Intraprocedural base
-    printf("enter intra analysis\n");
+    TRACE(UDF_DET, 3, "enter intra analysis");
     debug_boolean_parameters();
     IntraAnalyzerParameters ap;
     ap.track_exception = this->get_analysis_parameters()->track_exception;
     determinism::DeterminismAnalysis analysis(const_cast<DexMethod*>(m_method),ap,
                                               &context, &query_fn,
-                                              &func_resetdet_set, &instance_fields);
-    printf("finish intra analysis\n");                                          
+                                              &this->get_analysis_parameters()->func_reset_det_set,
+                                              &this->get_analysis_parameters()->instance_fields);
+    TRACE(UDF_DET, 3, "finish intra analysis");
+    m_stats.num_nodes = analysis.get_num_blocks();
+    m_stats.num_iterations = analysis.get_num_iterations();
     // After intra analysis is done, we need to update the following things:
     // 1. Use the intraprocedural result to update m_domain, which later (in summarize()) will be
     //    used to update registry (function summary)
     // the initial assumption of the function result is top. So we refine it
     // using the meet operator.
     m_domain.meet_with(analysis.get_return_value());
-    printf("now try to update the calling context\n");
+    TRACE(UDF_DET, 3, "now try to update the calling context");
     // 2. Update the calling context
     auto partition = analysis.get_calling_context_partition();
     // this data structure is propagated in the analyze_node function
     if (!partition.is_top() && !partition.is_bottom()) {
-      printf("now try to update the calling context\n");
+      TRACE(UDF_DET, 3, "now try to update the calling context");
       for (const auto& entry : partition.bindings()) {
         auto insn = entry.first;
         auto calling_context = entry.second;
-        std::cout << "instruction is " << show(insn) << std::endl;
-        std::cout << "new calling context that needs update" << calling_context << std::endl;
+        TRACE(UDF_DET, 3, "instruction is %s", SHOW(insn));
+        TRACE(UDF_DET,
+              3,
+              "new calling context that needs update %s",
+              SHOW(calling_context));
         //  << std::endl;
 
         auto op = insn->opcode();
@@ -273,11 +321,7 @@ class DeterminismFunctionAnalyzer : public Base {
         auto callees = call_graph::resolve_callees_in_graph(
             *this->get_call_graph(), m_method, insn);
         // TODO
-        this->get_caller_context()->update(
-              insn, [&](const determinism::CallingContext& original_context)
-              {
-                return calling_context.join(original_context);
-              });
+        update_context(insn, calling_context);
         // for (const DexMethod* method : callees) {
         //   this->get_caller_context()->update(
         //       insn, [&](const determinism::CallingContext& original_context)
@@ -287,6 +331,7 @@ class DeterminismFunctionAnalyzer : public Base {
         // }        
       }
     }
+    cached_analysis.store(m_domain, partition);
   }
   // this is simple because it only analyzes invoke instruction
   void analyze_insn(IRInstruction* insn) {
@@ -302,7 +347,10 @@ class DeterminismFunctionAnalyzer : public Base {
         resolve_method(callee, opcode_to_search(insn), m_method);
     if (callee_method) {
       // DepthDomain::top() is the default value of the get function
-      printf("method resovled%s\n", callee_method->get_name()->c_str());
+      TRACE(UDF_DET,
+            3,
+            "method resovled %s",
+            callee_method->get_name()->c_str());
       // auto summary =
       //     this->get_summaries()->get(callee_method, DepthDomain::top());
       // if (summary.is_value()) {
@@ -311,21 +359,27 @@ class DeterminismFunctionAnalyzer : public Base {
       //   m_domain.join_with(summary);
       // }
     } else {
-      printf("method didnot resovled%s\n", callee->get_name()->c_str());
+      TRACE(UDF_DET,
+            3,
+            "method didnot resovled %s",
+            callee->get_name()->c_str());
 
       // m_domain.join_with(DepthDomain(1u));
     }
   }
   void summarize() override {
-    printf("m_intraprocedural finish analyze(), now enter summarize()");
+    TRACE(UDF_DET,
+          3,
+          "m_intraprocedural finish analyze(), now enter summarize()");
     if (!m_method) {
-      std::cout << "empty method nullptr, does not update registry\n";
+      TRACE(UDF_DET, 3, "empty method nullptr, does not update registry");
       return;
     }
-    std::cout << m_method->get_name()->c_str()
-              << " finish intra analyzer, now try to update the function "
-                 "summary registry"
-              << m_domain << std::endl;
+    TRACE(UDF_DET,
+          3,
+          "%s finish intra analyzer, now try to update the function summary registry %s",
+          m_method->get_name()->c_str(),
+          SHOW(m_domain));
     this->get_summaries()->maybe_update(m_method, [&](DeterminismDomain& old) {
       if (old == m_domain) {
         // no change will be made
@@ -364,12 +418,24 @@ struct DeterminismAnalysisAdaptor : public BottomUpAnalysisAdaptorBase {
   // which is sparta::HashedAbstractPartition<const IRInstruction*, ArgumentDomain>;
 };
 
-using Analysis =
-    InterproceduralAnalyzer<DeterminismAnalysisAdaptor,
-                            DeterminismAnalysisPass::AnalysisParameters>;
-// declare Analysis as an alias for InterproceduralAnalyzer.
-// InterproceduralAnalyzer will provide the typenames to the FunctionAnalyzer,
-// and implicitly the IntraproceduralBase
+uint64_t summary_cache_fingerprint(
+    const DeterminismAnalysisPass::AnalysisParameters& param) {
+  summary_cache::Fingerprint fingerprint("DeterminismAnalysisPass");
+  fingerprint.add(static_cast<uint64_t>(param.track_exception));
+  std::map<std::string, uint64_t> labels;
+  for (const auto& entry : param.func_domain_map) {
+    labels.emplace(entry.first, entry.second.element());
+  }
+  for (const auto& label : labels) {
+    fingerprint.add(label.first).add(label.second);
+  }
+  std::set<std::string> reset_det(param.func_reset_det_set.begin(),
+                                  param.func_reset_det_set.end());
+  for (const auto& name : reset_det) {
+    fingerprint.add(name);
+  }
+  return fingerprint.get();
+}
 
 } // namespace
 void DeterminismAnalysisPass::run(const Scope& scope,
@@ -377,56 +443,39 @@ void DeterminismAnalysisPass::run(const Scope& scope,
                                   AnalysisParameters param) {
   band_config_func_labels(m_function_labels, param);
   band_config_functionality(param);
+  param.callee_labels.resolve(scope, param.func_domain_map);
+  TRACE(UDF_DET,
+        2,
+        "Resolved the labels of %zu callees and %zu classes",
+        param.callee_labels.num_methods(),
+        param.callee_labels.num_classes());
   // field_op_tracker::FieldStatsMap field_stats = field_op_tracker::analyze(scope);
-  DeterminismDomain is_det(DeterminismType::IS_DET);
-  auto analysis = Analysis(scope, m_max_iteration, &param);
-  analysis.run();
-  std::string analysisOutputPath = getenv ("ANALYSIS_OUTPUT");
-  std::string currentdatetime = getenv("current_date_time");
-  std::unordered_map<std::string, Json::Value> final_result;
-  // Json::Value vec_result(Json::arrayValue);
-  std::cout << "now prepares print out anlaysis result to json\n";
-  for (const auto& entry : analysis.registry.get_map()) {
-    Json::Value method_entry;
-    method_entry["name"] = show(entry.first);
-    method_entry["lattice"] = entry.second.element();
-    std::string class_name = ((entry.first)->get_class())->c_str();
-    class_name.pop_back();
-    std::string delimiter = "/";
-    std::string abb_class_name(class_name.substr(class_name.rfind("/") + 1));
-    // vec_result.append(method_entry);
-    std::cout << "print analysis result" << show(entry.first) << " -> "
-              << entry.second.element() << std::endl;
-    auto got = final_result.find(abb_class_name);
-    if (got == final_result.end()) {
-      // first method of the class encountered
-      Json::Value vec_result(Json::arrayValue);
-      vec_result.append(method_entry);
-      final_result.insert(make_pair(abb_class_name, vec_result));
-
-    } else {
-      got->second.append(method_entry);
-    }
+  auto cache = udf_analysis::load_summary_cache(
+      scope, m_summary_cache, summary_cache_fingerprint(param));
+  param.summary_cache = cache.get();
+  auto program = target_functions::program_of(scope, param.function_names,
+                                              param.target_functions_only);
+  if (param.target_functions_only) {
+    TRACE(UDF_DET, 1, "Analyzing the callees of %zu target functions",
+          program.roots.size());
   }
-  for (auto itr: final_result) {
-    std::string outputJsonFile;
-    if (strcmp(currentdatetime.c_str(), "") == 0) {
-      outputJsonFile = analysisOutputPath + "/" + itr.first + "_" + "det.json";
-    } else {
-      outputJsonFile = analysisOutputPath + "/" + currentdatetime + "/" + itr.first + "_" + "det.json";
-    }
-    std::cout << "current date time is" << ";" << currentdatetime << ";"  << outputJsonFile << std::endl;
-    remove(outputJsonFile.c_str());
-    std::ofstream o(outputJsonFile, std::ios_base::app);
-    std::cout << outputJsonFile << std::endl;
-    o << std::setw(4) << itr.second << std::endl;
-  }
-
+  m_method_telemetry =
+      m_telemetry.empty()
+          ? nullptr
+          : std::make_unique<analysis_telemetry::MethodTelemetry>();
+  udf_analysis::Options options;
+  options.summary_cache = cache.get();
+  options.summary_cache_path = m_summary_cache;
+  options.telemetry = m_method_telemetry.get();
+  options.telemetry_path = m_telemetry;
+  options.telemetry_top_n = m_telemetry_top_n;
+  m_result = udf_analysis::run<DeterminismAnalysisAdaptor, DeterminismTraits>(
+      program, m_max_iteration, &param, options);
 }
 
 void DeterminismAnalysisPass::run_pass(DexStoresVector& stores,
                                        ConfigFiles& /* conf */,
-                                       PassManager& /* pm */) {
+                                       PassManager& pm) {
 
   TRACE(MDA, 1,
         "[return max depth analysis config debug: target function name file] "
@@ -459,19 +508,7 @@ void DeterminismAnalysisPass::run_pass(DexStoresVector& stores,
   //   }
 
   // }
-  std::vector<std::string> content;
-  std::string line, word;
-
-  std::fstream file(m_target_functions, std::ios::in);
-  if (file.is_open()) {
-    while (getline(file, line)) {
-      std::stringstream str(line);
-      while (getline(str, word, ','))
-        content.push_back(word);
-    }
-  } else
-    TRACE(MDA, 1, "[return max depth analysis] could not open file %s",
-          SHOW(m_target_functions));
+  std::vector<std::string> content = target_functions::read(m_target_functions);
   for (int i = 0; i < content.size(); i++) {
     TRACE(MDA, 1, "%s\t", SHOW(content[i]));
   }
@@ -479,10 +516,11 @@ void DeterminismAnalysisPass::run_pass(DexStoresVector& stores,
         "target function read done");
   AnalysisParameters param;
   for (int i = 0; i < content.size(); i++) {
-    printf("add target function name %s\n", content[i].c_str());
+    TRACE(UDF_DET, 3, "add target function name %s", content[i].c_str());
     param.function_names.push_back(content[i]);
     vectors_m_target_functions.push_back(content[i]);
   }
+  param.target_functions_only = m_target_functions_only;
   for (auto it : stores) {
     // printf("%s\n",it.get_name());
     // const std::vector<DexClasses> classes = it.get_dexen();
@@ -501,6 +539,9 @@ void DeterminismAnalysisPass::run_pass(DexStoresVector& stores,
   // using Scope = std::vector<DexClass*>;
   Scope analyze_scope = build_class_scope(stores);
   run(analyze_scope, m_max_iteration, param);
+  if (m_method_telemetry) {
+    m_method_telemetry->report(name(), pm);
+  }
 }
 
 static DeterminismAnalysisPass s_pass;
@@ -13,6 +13,7 @@
 #include <boost/optional.hpp>
 
 #include "BaseIRAnalyzer.h"
+#include "CFGCache.h"
 #include "ControlFlow.h"
 #include "DexMethodHandle.h"
 #include "FiniteAbstractDomain.h"
@@ -54,18 +55,6 @@ namespace determinism {
 // const DeterminismDomain dt_bottom(DeterminismType::DT_BOTTOM);
 // const DeterminismDomain is_det(DeterminismType::IS_DET);
 // const DeterminismDomain not_det(DeterminismType::NOT_DET);
-DetLattice det_lattice({DT_BOTTOM, IS_DET, NOT_DET, DT_TOP},
-                       {{DT_BOTTOM, IS_DET},
-                        {DT_BOTTOM, NOT_DET},
-                        {IS_DET, DT_TOP},
-                        {NOT_DET, DT_TOP}});
-                        
-ExpLattice exp_lattice({EX_BOTTOM, UNVISIT, FROM_EX, NO_EX, EX_TOP},
-                       {{EX_BOTTOM, UNVISIT},
-                        {UNVISIT, FROM_EX},
-                        {UNVISIT, NO_EX},
-                        {NO_EX, EX_TOP},
-                        {FROM_EX, EX_TOP}});
 std::ostream& operator<<(std::ostream& output,
                          const DeterminismDomain& detDomain) {
   switch (detDomain.element()) {
@@ -142,21 +131,26 @@ using namespace ir_analyzer;
 //                                           ReturnValueDomain,
 //                                           CallingContextMap,
 //                                           DetFieldPartition>
-class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
+// The transfer functions of the analysis of a method, run by an Analyzer, or
+// by a fixpoint shared with other analyses of the method.
+class Transfer final {
  public:
-  explicit Analyzer(const DexMethod* dex_method,
+  explicit Transfer(const DexMethod* dex_method,
                     const cfg::ControlFlowGraph& cfg,
                     SummaryQueryFn* summary_query_fn,
                     std::unordered_set<std::string>* reset_det_func,
-                    DetFieldPartition* field_partition, IntraAnalyzerParameters ap)
-      : BaseIRAnalyzer(cfg),
-        m_dex_method(dex_method),
+                    DetFieldPartition* field_partition, IntraAnalyzerParameters ap,
+                    sparta::Arena* arena)
+      : m_dex_method(dex_method),
         m_cfg(cfg),
-        m_summary_query_fn(summary_query_fn),
         m_reset_det_func(reset_det_func),
-        m_field_partition(field_partition), m_ap(ap) {}
+        m_exp_partition(ExpBlockPartition::allocator_type(arena)),
+        m_field_partition(field_partition),
+        m_reg_field_mapping(RegFieldMapping::allocator_type(arena)),
+        m_ap(ap),
+        m_summary_query_fn(summary_query_fn) {}
 
-  void run(CallingContext* context) {
+  AbstractObjectEnvironment initial_state(CallingContext* context) const {
     // We need to compute the initial environment by assigning the parameter
     // registers their correct abstract domain derived from the method's
     // signature.
@@ -169,7 +163,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     // type being String. Also for CLASSes, the exact Java type they refer to is
     // not available here.
     auto track_exception = m_ap.track_exception;
-    std::cout << "track exception is" << track_exception << std::endl;
+    TRACE(UDF_DET, 5, "track exception is %s", SHOW(track_exception));
     DeterminismDomain is_det(DeterminismType::IS_DET);
     auto init_state = AbstractObjectEnvironment::top();
     init_state.set_exp_block_value(ExpBlockDomain(ExceptType::UNVISIT));
@@ -180,7 +174,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
         m_dex_method->get_proto()->get_args()->get_type_list();
     auto sig_it = signature.begin();
 
-    std::cout << "signature size is" << signature.size() << std::endl;
+    TRACE(UDF_DET, 5, "signature size is %s", SHOW(signature.size()));
     // debug_context(context);
     if (sig_it == signature.end()) {
       // return;
@@ -192,7 +186,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
       for (const auto& mie :
            InstructionIterable(m_cfg.get_param_instructions())) {
         IRInstruction* insn = mie.insn;
-        printf("process load param %s\n", SHOW(insn));
+        TRACE(UDF_DET, 5, "process load param %s", SHOW(insn));
         switch (insn->opcode()) {
         case IOPCODE_LOAD_PARAM_OBJECT: {
           if (param_position == 0 && !is_static(m_dex_method)) {
@@ -207,11 +201,11 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
             DexType* type = *sig_it;
             // printf("method not static, parameter is %s\n", type->c_str());
             always_assert(sig_it++ != signature.end());
-            printf("parameter position %d\n", param_position);
+            TRACE(UDF_DET, 5, "parameter position %d", param_position);
             if (context->is_bottom()) {
-              printf(
-                  "encounter a default bottom context, but we set loaded "
-                  "parameter to be det\n");
+              TRACE(UDF_DET,
+                    5,
+                    "encounter a default bottom context, but we set loaded parameter to be det");
               init_state.set_abstract_obj(insn->dest(), is_det);
               // const auto array_object =
               // init_state.get_abstract_obj(insn->dest());
@@ -225,7 +219,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
                 !context->get(param_position).is_top()) {
               // if (context && !context->get(param_position).is_top()) {
               // Parameter domain is provided with the calling context.
-              printf("context is neither top nor bottom\n");
+              TRACE(UDF_DET, 5, "context is neither top nor bottom");
               DeterminismDomain IS_bottom(DeterminismType::DT_BOTTOM);
               DeterminismDomain dt_top(DeterminismType::DT_TOP);
               DeterminismDomain is_det(DeterminismType::IS_DET);
@@ -255,9 +249,9 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
           DexType* type = *sig_it;
           always_assert(sig_it++ != signature.end());
           if (context->is_bottom()) {
-            printf(
-                "encounter a default bottom context, but we set loaded "
-                "parameter to be det\n");
+            TRACE(UDF_DET,
+                  5,
+                  "encounter a default bottom context, but we set loaded parameter to be det");
             if (insn->has_dest()) {
               init_state.set_abstract_obj(insn->dest(), is_det);
               if (insn->dest_is_wide()) {
@@ -291,26 +285,23 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
         }
       }
     }// Now, init_state have mapping between each register to its abstractdomain
-    printf("******done processing parameters\n");
+    TRACE(UDF_DET, 5, "******done processing parameters");
     // std::cout << "Debug arrary_object" << d_ins->dest()
     //           << init_state.get_abstract_obj(d_ins->dest()) << std::endl;
-    printf("******begin fixpoint iterator on cfg run\n");
-    // run is a method inherit from the BaseIRAnalyzer
-    MonotonicFixpointIterator::run(init_state);
-    printf("******done fixpoint iterator run\n");
-    printf("******collect return state starts\n");
-    if (m_ap.track_exception) {
-      for (auto* block : m_cfg.return_blocks()) {
-        auto env = get_exit_state_at(block);
-        std::cout << "return value domain: " << env.get_return_value() << "exp value domain: " << env.get_exp_block_value() << std::endl;
-      }
-    }
+    return init_state;
+  }
 
-    auto env = MonotonicFixpointIterator::get_exit_state_at(m_cfg.exit_block());
+  void finish(const AbstractObjectEnvironment& env) {
+    TRACE(UDF_DET, 5, "******collect return state starts");
+    m_exit_state = env;
     m_return_value = env.get_return_value();
-    std::cout << "exit state return value domain: " << env.get_return_value() << "exp value domain: " << env.get_exp_block_value() << std::endl;
+    TRACE(UDF_DET,
+          5,
+          "exit state return value domain: %s exp value domain: %s",
+          SHOW(env.get_return_value()),
+          SHOW(env.get_exp_block_value()));
 
-    printf("******collect return state finishes\n");
+    TRACE(UDF_DET, 5, "******collect return state finishes");
 
     // auto env = MonotonicFixpointIterator::get_exit_state_at(m_cfg.exit_block());
     // std::cout << env.get_return_value() << std::endl;
@@ -324,28 +315,29 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     //                           FieldType::STATIC,
     //                           m_field_partition);
     // }
-
-    populate_environments(m_cfg);
   }
   void add_except_block(cfg::GraphInterface::NodeId bb) const {
-    std::cout << "add new block that has an exception handling ancestor\n";
-    m_exp_partition->insert(bb);
-    std::cout<<"after add this exception catch block, now size of exp block partition is" << m_exp_partition->size()<<std::endl;
+    TRACE(UDF_DET, 5, "add new block that has an exception handling ancestor");
+    m_exp_partition.insert(bb);
+    TRACE(UDF_DET,
+          5,
+          "after add this exception catch block, now size of exp block partition is %s",
+          SHOW(m_exp_partition.size()));
   }
   void analyze_node(const cfg::GraphInterface::NodeId& node,
-                    AbstractObjectEnvironment* current_state) const override {
-    std::cout<< "analyzing node in self-definied mode" <<std::endl;
+                    AbstractObjectEnvironment* current_state) const {
+    TRACE(UDF_DET, 5, "analyzing node in self-definied mode");
     // if this node is an exception handling block, we add it to the
     // ExpBlockPartition that tracks exception information
-    std::cout << "--- propagate exception information start ---\n";
+    TRACE(UDF_DET, 5, "--- propagate exception information start ---");
     if (node->starts_with_move_exception()) {
       // For a basic block that is the original source of the exception, it
       // always sets the current state to FROM_EX
-      std::cout << "analyze a block that handles exception\n";
+      TRACE(UDF_DET, 5, "analyze a block that handles exception");
       current_state->set_exp_block_value(ExpBlockDomain(ExceptType::FROM_EX));
       current_state->debugExpBlockDomain();
     } else {
-      std::cout << "analyze a block that does not handle exception\n";
+      TRACE(UDF_DET, 5, "analyze a block that does not handle exception");
       // For a basic block that is not the original source of the exception, it
       // either preserves (do nothing) the current state or initialize the current state to
       // NO_EX
@@ -375,14 +367,13 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     //     add_except_block(node);
     //   }
     // }
-    std::cout << "--- propagate exception information end ---\n";
+    TRACE(UDF_DET, 5, "--- propagate exception information end ---");
     for (auto& mie : InstructionIterable(node)) {
       analyze_instruction(mie.insn, current_state);
     }
   }
-  void analyze_instruction(
-      const IRInstruction* insn,
-      AbstractObjectEnvironment* current_state) const override {
+  void analyze_instruction(const IRInstruction* insn,
+                           AbstractObjectEnvironment* current_state) const {
 
     ReturnValueDomain callee_return; // we need this value analysis after the
                                      // invocation instruction
@@ -391,11 +382,11 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     DeterminismDomain dt_bottom(DeterminismType::DT_BOTTOM);
     DeterminismDomain is_det(DeterminismType::IS_DET);
     DeterminismDomain not_det(DeterminismType::NOT_DET);
-    printf("process instructions %s\n", SHOW(insn));
+    TRACE(UDF_DET, 5, "process instructions %s", SHOW(insn));
     if (opcode::is_an_invoke(insn->opcode())) {
       // general preparation for invoke operations (OPRANGE(an_invoke,
       // OPCODE_INVOKE_VIRTUAL, OPCODE_INVOKE_INTERFACE)).
-      printf("process invoke %s, set calling context\n", SHOW(insn));
+      TRACE(UDF_DET, 5, "process invoke %s, set calling context", SHOW(insn));
       CallingContext cc;
       auto srcs = insn->srcs();
       for (param_index_t i = 0; i < srcs.size(); i++) {
@@ -407,26 +398,33 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
         reg_t src = insn->src(i);
         auto aobj = current_state->get_abstract_obj(src);
         cc.set(i, aobj);
-        std::cout << "parameter index " << i <<" set from reg" << src << aobj << std::endl;
+        TRACE(UDF_DET,
+              5,
+              "parameter index %s set from reg %s %s",
+              SHOW(i),
+              SHOW(src),
+              SHOW(aobj));
       }
       if (!cc.is_bottom()) {
         // it stores the calling context. Used for decide state after the invoke
         // instruction
-        std::cout << "calling context is not bottom\n";
+        TRACE(UDF_DET, 5, "calling context is not bottom");
         current_state->set_calling_context(insn, cc);
       } else {
-        std::cout << "calling context is bottom\n";
+        TRACE(UDF_DET, 5, "calling context is bottom");
       }
 
       if (m_summary_query_fn) {
         callee_return = (*m_summary_query_fn)(insn);
-        std::cout << "m_summary_query_fn discovered, reset callee_return to"
-                  << callee_return << std::endl;
+        TRACE(UDF_DET,
+              5,
+              "m_summary_query_fn discovered, reset callee_return to %s",
+              SHOW(callee_return));
       }
     }
 
     switch (insn->opcode()) {
-      printf("process non-invoke %s\n", SHOW(insn));
+      TRACE(UDF_DET, 5, "process non-invoke %s", SHOW(insn));
 
     case IOPCODE_LOAD_PARAM:
     case IOPCODE_LOAD_PARAM_OBJECT:
@@ -434,7 +432,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
       // IOPCODE_LOAD_PARAM_* instructions have been processed before the
       // analysis.
       const auto parameter = current_state->get_abstract_obj(insn->dest());
-      std::cout << "Parameter's fact value: " << parameter << std::endl;
+      TRACE(UDF_DET, 5, "Parameter's fact value: %s", SHOW(parameter));
       break;
     }
     case OPCODE_MOVE:
@@ -446,7 +444,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
       const auto dest = current_state->get_abstract_obj(insn->dest());
 
       const auto aobj = current_state->get_abstract_obj(insn->src(0));
-      std::cout << "set from" << dest << "to" << aobj;
+      TRACE(UDF_DET, 5, "set from %s to %s", SHOW(dest), SHOW(aobj));
       current_state->set_abstract_obj(insn->dest(), aobj);
       break;
 
@@ -468,9 +466,9 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     case IOPCODE_MOVE_RESULT_PSEUDO_WIDE:
     case IOPCODE_MOVE_RESULT_PSEUDO: {
       if (tmp_field_name != nullptr) {
-        std::cout << "add reg to fied mapping for IOPCODE_MOVE_RESULT\n";
+        TRACE(UDF_DET, 5, "add reg to fied mapping for IOPCODE_MOVE_RESULT");
         // DexField *previous_field_name = &std::move(*tmp_field_name);
-        m_reg_field_mapping->insert({insn->dest(), tmp_field_name});
+        m_reg_field_mapping.insert({insn->dest(), tmp_field_name});
         tmp_field_name = nullptr;
       }
 
@@ -499,8 +497,11 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
       //         insn->dest(),
       //         current_state->get_class_source(RESULT_REGISTER));
       //   }
-      std::cout << "result reg" << aobj << "dest reg" << insn->dest()
-                << std::endl;
+      TRACE(UDF_DET,
+            5,
+            "result reg %s dest reg %s",
+            SHOW(aobj),
+            SHOW(insn->dest()));
       break;
     }
     case OPCODE_CMP_LONG:
@@ -595,11 +596,11 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
       // current_state->get_abstract_obj(insn->src(0));
       always_assert(insn->srcs_size() == 2);
       for (reg_t src : insn->srcs()) {
-        printf("%s\n", SHOW(src));
+        TRACE(UDF_DET, 5, "%s", SHOW(src));
       }
       const auto array_object = current_state->get_abstract_obj(insn->src(0));
       const auto offset_object = current_state->get_abstract_obj(insn->src(1));
-      std::cout << "Debug arrary_object" << array_object << std::endl;
+      TRACE(UDF_DET, 5, "Debug arrary_object %s", SHOW(array_object));
 
       if (array_object.is_top()) {
         current_state->set_abstract_obj(RESULT_REGISTER, dt_top);
@@ -613,7 +614,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
         current_state->set_abstract_obj(RESULT_REGISTER, offset_object);
         break;
       }
-      printf("finish aget_object\n");
+      TRACE(UDF_DET, 5, "finish aget_object");
       break;
     }
     case OPCODE_APUT_BYTE:
@@ -644,7 +645,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
           DeterminismDomain result(offset_object.element());
           result.join_with(source_object);
           current_state->set_abstract_obj(insn->src(1), result);
-          std::cout << "update array's value to" << result << std::endl;
+          TRACE(UDF_DET, 5, "update array's value to %s", SHOW(result));
           break;
         }
       } else {
@@ -684,14 +685,18 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
         auto field = resolve_field(insn->get_field());
         const auto f_type = insn->get_field()->get_type();
         const auto f_cls = insn->get_field()->get_class();
-        std::cout << "iput find field" << field->c_str() << f_type->c_str()
-                  << f_cls->c_str() << std::endl;
+        TRACE(UDF_DET,
+              5,
+              "iput find field %s %s %s",
+              field->c_str(),
+              f_type->c_str(),
+              f_cls->c_str());
         DeterminismDomain is_det(DeterminismType::IS_DET);
         current_state->set_field_value(
             field, current_state->get_abstract_obj(insn->src(0)));
         auto result = current_state->get_field_value(field);
         // current_state->set_abstract_obj(RESULT_REGISTER, result);
-        std::cout << "set iget result to" << result << std::endl;
+        TRACE(UDF_DET, 5, "set iget result to %s", SHOW(result));
         break;
       }
     }
@@ -720,11 +725,14 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
           if (result.is_bottom()) {
             not_reached_log("field's value is bottom\n");
           }
-          std::cout << "iget find field" << field->c_str() << std::endl;
+          TRACE(UDF_DET, 5, "iget find field %s", field->c_str());
           current_state->set_abstract_obj(RESULT_REGISTER, result);
-          std::cout << "iget result is " << result  << "set to RESULT_REGISTER"<< std::endl;
+          TRACE(UDF_DET,
+                5,
+                "iget result is %s set to RESULT_REGISTER",
+                SHOW(result));
           tmp_field_name = field;
-          std::cout << tmp_field_name->c_str() << std::endl;
+          TRACE(UDF_DET, 5, "%s", tmp_field_name->c_str());
 
           
           break;
@@ -873,7 +881,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
       break;
     }
     case OPCODE_MOVE_EXCEPTION: {
-      std::cout << "encounter move exception" << std::endl;
+      TRACE(UDF_DET, 5, "encounter move exception");
 
       // always_assert(insn->has_dest());
       // DeterminismDomain is_det(DeterminismType::IS_DET);
@@ -971,7 +979,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
         // the function has at least one argument
         // we use the join operator on these parameters, because we are not sure
         // how they are processed in the function
-        std::cout << "the function has at least 2 arguments\n";
+        TRACE(UDF_DET, 5, "the function has at least 2 arguments");
         DeterminismDomain dt_bottom(DeterminismType::DT_BOTTOM);
 
         DeterminismDomain receiver = dt_bottom;
@@ -988,19 +996,25 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
           receiver.join_with(current_state->get_abstract_obj(insn->src(0)));
         }
         for (unsigned int i = 0; i < insn->srcs_size(); i++) {
-          std::cout << insn->src(i)
-                    << current_state->get_abstract_obj(insn->src(i))
-                    << std::endl;
+          TRACE(UDF_DET,
+                5,
+                "%s %s",
+                SHOW(insn->src(i)),
+                SHOW(current_state->get_abstract_obj(insn->src(i))));
           receiver.join_with(current_state->get_abstract_obj(insn->src(i)));
         }
-        std::cout << "receiver reg is" << receiver << std::endl;
+        TRACE(UDF_DET, 5, "receiver reg is %s", SHOW(receiver));
         process_virtual_call(insn, receiver, current_state, callee_return);
         break;
       } else {
         // the function does not have argument
-        std::cout << "the function has zero argument\n";
+        TRACE(UDF_DET, 5, "the function has zero argument");
         auto receiver = current_state->get_abstract_obj(insn->src(0));
-        std::cout << "receiver reg is" << insn->src(0) << receiver << std::endl;
+        TRACE(UDF_DET,
+              5,
+              "receiver reg is %s %s",
+              SHOW(insn->src(0)),
+              SHOW(receiver));
         process_virtual_call(insn, receiver, current_state, callee_return);
         break;
       }
@@ -1018,9 +1032,11 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
       // default_semantics(insn, current_state);
       // break;
       
-      printf("find return object for %s!!!!!! %s\n",
-             m_dex_method->get_name()->c_str(),
-             SHOW(insn));
+      TRACE(UDF_DET,
+            5,
+            "find return object for %s!!!!!! %s",
+            m_dex_method->get_name()->c_str(),
+            SHOW(insn));
       current_state->debugExpBlockDomain();
       // DeterminismDomain original = this->m_return_value;
       // DeterminismDomain joined_value = current_state->get_abstract_obj(insn->src(0));
@@ -1040,42 +1056,27 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
       break;
     }
     default: {
-      printf("process default semantics %s\n", SHOW(insn));
+      TRACE(UDF_DET, 5, "process default semantics %s", SHOW(insn));
       default_semantics(insn, current_state);
     }
     }
   }
 
-  boost::optional<DeterminismDomain> get_abstract_object(
-      size_t reg, IRInstruction* insn) const {
-    auto it = m_environments.find(insn);
-    if (it == m_environments.end()) {
-      return boost::none;
-    }
-    return it->second.get_abstract_obj(reg);
-  }
+  ReturnValueDomain get_return_value() const { return m_return_value; }
 
-  // boost::optional<ClassObjectSource> get_class_source(
-  //     size_t reg, IRInstruction* insn) const {
-  //   auto it = m_environments.find(insn);
-  //   if (it == m_environments.end()) {
-  //     return boost::none;
-  //   }
-  //   return it->second.get_class_source(reg).get_constant();
-  // }
+  AbstractObjectEnvironment get_exit_state() const { return m_exit_state; }
 
-  ReturnValueDomain get_return_value() const { return m_return_value; }
+  const cfg::ControlFlowGraph& cfg() const { return m_cfg; }
+
+  bool track_exception() const { return m_ap.track_exception; }
 
-  AbstractObjectEnvironment get_exit_state() const {
-    return get_exit_state_at(m_cfg.exit_block());
-  }
   void process_virtual_call(const IRInstruction* insn,
                             const DeterminismDomain& receiver,
                             AbstractObjectEnvironment* current_state,
                             const DeterminismDomain& callee_return) const {
     if (receiver.is_bottom()) {
       if (insn->has_dest()) {
-        std::cout << "has dest" << insn->dest() << std::endl;
+        TRACE(UDF_DET, 5, "has dest %s", SHOW(insn->dest()));
 
         current_state->set_abstract_obj(insn->dest(),
                                         DeterminismDomain::bottom());
@@ -1085,27 +1086,28 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
         }
       }
       if (insn->has_move_result_any()) {
-        std::cout
-            << "has move_result_any(), so set value from previous result reg"
-            << current_state->get_abstract_obj(RESULT_REGISTER) << "to"
-            << DeterminismDomain::bottom() << std::endl;
+        TRACE(UDF_DET,
+              5,
+              "has move_result_any(), so set value from previous result reg %s to %s",
+              SHOW(current_state->get_abstract_obj(RESULT_REGISTER)),
+              SHOW(DeterminismDomain::bottom()));
         current_state->set_abstract_obj(RESULT_REGISTER,
                                         DeterminismDomain::bottom());
       }
       return;
     }
     if (insn->has_dest()) {
-      std::cout << "the instruction has dest\n";
+      TRACE(UDF_DET, 5, "the instruction has dest");
     }
     DeterminismDomain result =
         operation_with_two_domains(receiver, callee_return, current_state);
-    std::cout << "result of callee and args are" << result << std::endl;
+    TRACE(UDF_DET, 5, "result of callee and args are %s", SHOW(result));
     std::string method_name(insn->get_method()->get_name()->c_str());
     std::string class_name(insn->get_method()->get_class()->c_str());
     if (method_name.find("init") != std::string::npos) {
       if (insn->srcs_size() == 0) {
         // we don't analyze static field for now.
-        std::cout << "encounter static function;" << method_name << std::endl;
+        TRACE(UDF_DET, 5, "encounter static function;%s", SHOW(method_name));
         return;
       }
       current_state->set_abstract_obj(insn->src(0), result);
@@ -1113,18 +1115,24 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     }
     if (method_name.find("set") != std::string::npos && class_name.find("Calendar") == std::string::npos) {
       // class constructor does not have dest reg or remove any
-      std::cout << "find function set() that set this instance field or dest reg" << insn->src(0) << "to"
-                << callee_return << std::endl;
+      TRACE(UDF_DET,
+            5,
+            "find function set() that set this instance field or dest reg %s to %s",
+            SHOW(insn->src(0)),
+            SHOW(callee_return));
       if (insn->srcs_size() == 0) {
         // we don't analyze static field for now.
-        std::cout << "encounter static function;" << method_name << std::endl;
+        TRACE(UDF_DET, 5, "encounter static function;%s", SHOW(method_name));
         return;
       }
-      if (m_reg_field_mapping->count(insn->src(0)) > 0) {
-        std::cout << "find reg" << insn->src(0) << "in field mapping\n";
-        auto field = m_reg_field_mapping->at(insn->src(0));
+      if (m_reg_field_mapping.count(insn->src(0)) > 0) {
+        TRACE(UDF_DET, 5, "find reg %s in field mapping", SHOW(insn->src(0)));
+        auto field = m_reg_field_mapping.at(insn->src(0));
         current_state->set_field_value(field, callee_return);
-        std::cout << "updated field value is" << current_state->get_field_value(field) << std::endl;
+        TRACE(UDF_DET,
+              5,
+              "updated field value is %s",
+              SHOW(current_state->get_field_value(field)));
       } else {
         current_state->set_abstract_obj(insn->src(0), callee_return);
 
@@ -1135,18 +1143,21 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     if (method_name.find("append") != std::string::npos) {
       // class constructor does not have dest reg or remove any
       // this branch is to deal with string.append
-      std::cout << "find function append set this instance" << insn->src(0) << "to"
-                << result << std::endl;
+      TRACE(UDF_DET,
+            5,
+            "find function append set this instance %s to %s",
+            SHOW(insn->src(0)),
+            SHOW(result));
       if (insn->srcs_size() == 0) {
         // we don't analyze static field for now.
-        std::cout << "encounter static function;" << method_name << std::endl;
+        TRACE(UDF_DET, 5, "encounter static function;%s", SHOW(method_name));
         return;
       }
       current_state->set_abstract_obj(insn->src(0), result);
       return;
     }
     if (insn->has_dest()) {
-      std::cout << "has dest" << insn->dest() << std::endl;
+      TRACE(UDF_DET, 5, "has dest %s", SHOW(insn->dest()));
 
       current_state->set_abstract_obj(insn->dest(), result);
       if (insn->dest_is_wide()) {
@@ -1154,10 +1165,11 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
       }
     }
     if (insn->has_move_result_any()) {
-      std::cout
-          << "has move_result_any(), so set value from previous result reg"
-          << current_state->get_abstract_obj(RESULT_REGISTER) << "to" << result
-          << std::endl;
+      TRACE(UDF_DET,
+            5,
+            "has move_result_any(), so set value from previous result reg %s to %s",
+            SHOW(current_state->get_abstract_obj(RESULT_REGISTER)),
+            SHOW(result));
       current_state->set_abstract_obj(RESULT_REGISTER, result);
     }
   }
@@ -1187,7 +1199,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     whole_name.append(func_name);
     // std::cout << "whole name" << whole_name;
     if (this->m_reset_det_func->count(whole_name)) {
-      std::cout << "find reset func!\n";
+      TRACE(UDF_DET, 5, "find reset func!");
       // For now, the reset function changes the dest reg
       DeterminismDomain is_det(DeterminismType::IS_DET);
       // iterate its function argument
@@ -1195,13 +1207,18 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
 
       DeterminismDomain receiver = dt_bottom;
       for (unsigned int i = 1; i < insn->srcs_size(); i++) {
-        std::cout << insn->src(i)
-                  << current_state->get_abstract_obj(insn->src(i)) << std::endl;
+        TRACE(UDF_DET,
+              5,
+              "%s %s",
+              SHOW(insn->src(i)),
+              SHOW(current_state->get_abstract_obj(insn->src(i))));
         receiver.join_with(current_state->get_abstract_obj(insn->src(i)));
       }
       if (receiver.equals(is_det)) {
-        std::cout << "func args are all det. so set class reg back to be det register number is:"
-                  << insn->src(0) << std::endl;
+        TRACE(UDF_DET,
+              5,
+              "func args are all det. so set class reg back to be det register number is: %s",
+              SHOW(insn->src(0)));
         current_state->set_abstract_obj(insn->src(0), is_det);
         return true;
       } else {
@@ -1217,13 +1234,13 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
  private:
   const DexMethod* m_dex_method;
   const cfg::ControlFlowGraph& m_cfg;
-  std::unordered_map<IRInstruction*, AbstractObjectEnvironment> m_environments;
   mutable ReturnValueDomain m_return_value;
+  AbstractObjectEnvironment m_exit_state{AbstractObjectEnvironment::bottom()};
   std::unordered_set<std::string>* m_reset_det_func;
-  ExpBlockPartition* m_exp_partition = new ExpBlockPartition();
+  mutable ExpBlockPartition m_exp_partition;
   DetFieldPartition* m_field_partition;
   mutable DexField* tmp_field_name;
-  mutable RegFieldMapping * m_reg_field_mapping = new RegFieldMapping();
+  mutable RegFieldMapping m_reg_field_mapping;
   IntraAnalyzerParameters m_ap;
 
   // a function that summarizes the callees' analysis result
@@ -1240,22 +1257,21 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     // }
     always_assert(insn->srcs_size() == 1);
 
-    printf("three operands instruction %s\n", SHOW(insn));
+    TRACE(UDF_DET, 5, "three operands instruction %s", SHOW(insn));
 
     // const auto a_object = current_state->get_abstract_obj(insn->src(0));
     const auto b_object = current_state->get_abstract_obj(insn->src(0));
 
-    std::cout << "propagate value" << b_object << std::endl;
+    TRACE(UDF_DET, 5, "propagate value %s", SHOW(b_object));
     if (insn->has_dest()) {
-      std::cout << "has dest" << insn->dest() << std::endl;
+      TRACE(UDF_DET, 5, "has dest %s", SHOW(insn->dest()));
 
       current_state->set_abstract_obj(insn->dest(), b_object);
       if (insn->dest_is_wide()) {
         current_state->set_abstract_obj(insn->dest() + 1, b_object);
       }
     } else {
-      std::cout << "Carefule!!! no dest found but set the RESULT reg"
-                << std::endl;
+      TRACE(UDF_DET, 5, "Carefule!!! no dest found but set the RESULT reg");
       current_state->set_abstract_obj(RESULT_REGISTER, b_object);
     }
     // current_state->set_abstract_obj(insn->dest(), b_object);
@@ -1268,7 +1284,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     // the result is determined by B and C
     always_assert(insn->srcs_size() == 2);
 
-    printf("three operands instruction %s\n", SHOW(insn));
+    TRACE(UDF_DET, 5, "three operands instruction %s", SHOW(insn));
 
     // const auto a_object = current_state->get_abstract_obj(insn->src(0));
     const auto b_object = current_state->get_abstract_obj(insn->src(0));
@@ -1277,7 +1293,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     DeterminismDomain result =
         operation_with_two_domains(b_object, c_object, current_state);
     if (insn->has_dest()) {
-      std::cout << "has dest" << insn->dest() << std::endl;
+      TRACE(UDF_DET, 5, "has dest %s", SHOW(insn->dest()));
 
       current_state->set_abstract_obj(insn->dest(), result);
       if (insn->dest_is_wide()) {
@@ -1293,20 +1309,24 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     DeterminismDomain dt_bottom(DeterminismType::DT_BOTTOM);
     DeterminismDomain is_det(DeterminismType::IS_DET);
     DeterminismDomain not_det(DeterminismType::NOT_DET);
-    std::cout << "two operands:" << a_object << b_object << "result is";
+    TRACE(UDF_DET,
+          5,
+          "two operands: %s %s result is",
+          SHOW(a_object),
+          SHOW(b_object));
     if (a_object.is_top()) {
-      std::cout << dt_top << std::endl;
+      TRACE(UDF_DET, 5, "%s", SHOW(dt_top));
       return DeterminismDomain::top();
       // current_state->set_abstract_obj(RESULT_REGISTER,
       //                                 DeterminismDomain::top());
     }
     if (a_object.equals(not_det)) {
-      std::cout << not_det << std::endl;
+      TRACE(UDF_DET, 5, "%s", SHOW(not_det));
       return not_det;
       // current_state->set_abstract_obj(RESULT_REGISTER, not_det);
     }
     if (a_object.equals(is_det)) {
-      std::cout << b_object << std::endl;
+      TRACE(UDF_DET, 5, "%s", SHOW(b_object));
       return b_object;
       // current_state->set_abstract_obj(RESULT_REGISTER, b_object);
     }
@@ -1317,10 +1337,12 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     // For instructions that involve operation only on one reg, such as
     // array-length, add_int: The result is determined by the abstract value of
     // the reg
-    printf("single operand instruction %s\n", SHOW(insn));
+    TRACE(UDF_DET, 5, "single operand instruction %s", SHOW(insn));
     always_assert(insn->srcs_size() == 1);
-    std::cout << "propagate value "
-              << current_state->get_abstract_obj(insn->src(0)) << std::endl;
+    TRACE(UDF_DET,
+          5,
+          "propagate value %s",
+          SHOW(current_state->get_abstract_obj(insn->src(0))));
     current_state->set_abstract_obj(
         RESULT_REGISTER, current_state->get_abstract_obj(insn->src(0)));
   }
@@ -1334,11 +1356,11 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     // like the reflectionanalysis only cares about object involving
     // operations). Hence, the effect of those operations is correctly
     // abstracted away regardless of the size of the destination register.
-    std::cout << "default semantics" << std::endl;
+    TRACE(UDF_DET, 5, "default semantics");
     bool do_anything = false;
     if (insn->has_dest()) {
       do_anything = true;
-      std::cout << "has dest" << insn->dest() << std::endl;
+      TRACE(UDF_DET, 5, "has dest %s", SHOW(insn->dest()));
 
       current_state->set_abstract_obj(insn->dest(), DeterminismDomain(DeterminismType::DT_TOP));
       if (insn->dest_is_wide()) {
@@ -1349,45 +1371,64 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     // this register.
     if (insn->has_move_result_any()) {
       do_anything = true;
-      std::cout << "set value from previous result reg"
-                << current_state->get_abstract_obj(RESULT_REGISTER)
-                << std::endl;
+      TRACE(UDF_DET,
+            5,
+            "set value from previous result reg %s",
+            SHOW(current_state->get_abstract_obj(RESULT_REGISTER)));
       current_state->set_abstract_obj(RESULT_REGISTER, DeterminismDomain(DeterminismType::DT_TOP));
     }
     if (do_anything) {
-      std::cout << "be careful with what has been done\n";
+      TRACE(UDF_DET, 5, "be careful with what has been done");
     }
   }
 
-  // After the fixpoint iteration completes, we replay the analysis on all
-  // blocks and we cache the abstract state at each instruction. This cache is
-  // used by get_abstract_object() to query the state of a register at a given
-  // instruction. Since we use an abstract domain based on Patricia trees, the
-  // memory footprint of storing the abstract state at each program point is
-  // small.
-  void populate_environments(const cfg::ControlFlowGraph& cfg) {
-    // We reserve enough space for the map in order to avoid repeated
-    // rehashing during the computation.
-    printf("enter populate_env\n");
-    m_environments.reserve(cfg.blocks().size() * 16);
-    for (cfg::Block* block : cfg.blocks()) {
-      AbstractObjectEnvironment current_state = get_entry_state_at(block);
-      for (auto& mie : InstructionIterable(block)) {
-        IRInstruction* insn = mie.insn;
-        m_environments.emplace(insn, current_state);
-        analyze_instruction(insn, &current_state);
-      }
-    }
-  }
   void debug_context(CallingContext* context) {
     // printf("debug calling context size %d\n", context->size());
     for (int idx = 0; idx < 5; idx++) {
-      std::cout << idx << context->get(idx) << std::endl;
+      TRACE(UDF_DET, 5, "%s %s", SHOW(idx), SHOW(context->get(idx)));
     }
     // printf("finish debug calling context\n");
   }
 };
 
+// Runs the fixpoint of a Transfer over the CFG of its method.
+class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
+ public:
+  Analyzer(Transfer* transfer, sparta::Arena* arena)
+      : BaseIRAnalyzer(transfer->cfg(), arena), m_transfer(transfer) {}
+
+  void run(CallingContext* context) {
+    TRACE(UDF_DET, 5, "******begin fixpoint iterator on cfg run");
+    MonotonicFixpointIterator::run(m_transfer->initial_state(context));
+    TRACE(UDF_DET, 5, "******done fixpoint iterator run");
+    if (m_transfer->track_exception()) {
+      for (auto* block : m_transfer->cfg().return_blocks()) {
+        auto env = get_exit_state_at(block);
+        TRACE(UDF_DET,
+              5,
+              "return value domain: %s exp value domain: %s",
+              SHOW(env.get_return_value()),
+              SHOW(env.get_exp_block_value()));
+      }
+    }
+    m_transfer->finish(get_exit_state_at(m_transfer->cfg().exit_block()));
+  }
+
+  void analyze_node(const cfg::GraphInterface::NodeId& node,
+                    AbstractObjectEnvironment* current_state) const override {
+    m_transfer->analyze_node(node, current_state);
+  }
+
+  void analyze_instruction(
+      const IRInstruction* insn,
+      AbstractObjectEnvironment* current_state) const override {
+    m_transfer->analyze_instruction(insn, current_state);
+  }
+
+ private:
+  Transfer* m_transfer;
+};
+
 } // namespace impl
 
 DeterminismAnalysis::~DeterminismAnalysis() {
@@ -1401,6 +1442,28 @@ DeterminismAnalysis::DeterminismAnalysis(
     SummaryQueryFn* summary_query_fn,
     std::unordered_set<std::string>* reset_det_func,
     DetFieldPartition* fields)
+    : DeterminismAnalysis(Deferred(),
+                          dex_method,
+                          ap,
+                          summary_query_fn,
+                          reset_det_func,
+                          fields) {
+  if (m_transfer == nullptr) {
+    return;
+  }
+  m_analyzer = std::make_unique<impl::Analyzer>(m_transfer.get(), &m_arena);
+  TRACE(UDF_DET, 5, "enter m_analyzer->run(context)");
+  m_analyzer->run(context);
+  // m_analyzer->get_analysis_result();
+}
+
+DeterminismAnalysis::DeterminismAnalysis(
+    Deferred,
+    DexMethod* dex_method,
+    IntraAnalyzerParameters ap,
+    SummaryQueryFn* summary_query_fn,
+    std::unordered_set<std::string>* reset_det_func,
+    DetFieldPartition* fields)
     : m_dex_method(dex_method), m_ap(ap) {
   always_assert(dex_method != nullptr);
   IRCode* code = dex_method->get_code();
@@ -1410,119 +1473,54 @@ DeterminismAnalysis::DeterminismAnalysis(
   if (fields == nullptr) {
     not_reached();
   }
-  code->build_cfg(/* editable */ false);
-  cfg::ControlFlowGraph& cfg = code->cfg();
-  cfg.calculate_exit_block();
-  m_analyzer = std::make_unique<impl::Analyzer>(
-      dex_method, cfg, summary_query_fn, reset_det_func, fields, m_ap);
-  printf("enter m_analyzer->run(context)\n");
-  m_analyzer->run(context);
-  // m_analyzer->get_analysis_result();
+  const cfg::ControlFlowGraph& cfg = cfg::CFGCache::instance().borrow(code);
+  m_transfer = std::make_unique<impl::Transfer>(
+      dex_method, cfg, summary_query_fn, reset_det_func, fields, m_ap,
+      &m_arena);
 }
 
-// void ReflectionAnalysis::get_reflection_site(
-//     const reg_t reg,
-//     IRInstruction* insn,
-//     std::map<reg_t, ReflectionAbstractObject>* abstract_objects) const {
-//   auto aobj = m_analyzer->get_abstract_object(reg, insn);
-//   if (!aobj) {
-//     return;
-//   }
-//   if (is_not_reflection_output(*aobj)) {
-//     return;
-//   }
-//   boost::optional<ClassObjectSource> cls_src =
-//       aobj->obj_kind == AbstractObjectKind::CLASS
-//           ? m_analyzer->get_class_source(reg, insn)
-//           : boost::none;
-//   if (aobj->obj_kind == AbstractObjectKind::CLASS &&
-//       cls_src == ClassObjectSource::NON_REFLECTION) {
-//     return;
-//   }
-//   if (traceEnabled(REFL, 5)) {
-//     std::ostringstream out;
-//     out << "reg " << reg << " " << *aobj << " ";
-//     if (cls_src) {
-//       out << *cls_src;
-//     }
-//     out << std::endl;
-//     TRACE(REFL, 5, " reflection site: %s", out.str().c_str());
-//   }
-//   (*abstract_objects)[reg] = ReflectionAbstractObject(*aobj, cls_src);
-// }
+AbstractObjectEnvironment DeterminismAnalysis::initial_state(
+    CallingContext* context) const {
+  return m_transfer->initial_state(context);
+}
 
-// ReflectionSites ReflectionAnalysis::get_reflection_sites() const {
-//   ReflectionSites reflection_sites;
-//   auto code = m_dex_method->get_code();
-//   if (code == nullptr) {
-//     return reflection_sites;
-//   }
-//   auto reg_size = code->get_registers_size();
-//   for (auto& mie : InstructionIterable(code)) {
-//     IRInstruction* insn = mie.insn;
-//     std::map<reg_t, ReflectionAbstractObject> abstract_objects;
-//     for (size_t i = 0; i < reg_size; i++) {
-//       get_reflection_site(i, insn, &abstract_objects);
-//     }
-//     get_reflection_site(RESULT_REGISTER, insn, &abstract_objects);
-
-//     if (!abstract_objects.empty()) {
-//       reflection_sites.push_back(std::make_pair(insn, abstract_objects));
-//     }
-//   }
-//   return reflection_sites;
-// }
+void DeterminismAnalysis::analyze_node(
+    cfg::Block* block, AbstractObjectEnvironment* current_state) const {
+  m_transfer->analyze_node(block, current_state);
+}
 
-DeterminismDomain DeterminismAnalysis::get_return_value() const {
+void DeterminismAnalysis::finish(const AbstractObjectEnvironment& exit_state) {
+  m_transfer->finish(exit_state);
+}
+
+size_t DeterminismAnalysis::get_num_blocks() const {
+  if (!m_transfer) {
+    return 0;
+  }
+  return m_dex_method->get_code()->cfg().num_blocks();
+}
+
+uint32_t DeterminismAnalysis::get_num_iterations() const {
   if (!m_analyzer) {
+    return 0;
+  }
+  return m_analyzer->get_num_iterations();
+}
+
+DeterminismDomain DeterminismAnalysis::get_return_value() const {
+  if (!m_transfer) {
     // Method has no code, or is a native method.
     return DeterminismDomain::top();
   }
-  return m_analyzer->get_return_value();
+  return m_transfer->get_return_value();
 }
 
-// boost::optional<std::vector<DexType*>> ReflectionAnalysis::get_method_params(
-//     IRInstruction* invoke_insn) const {
-//   auto code = m_dex_method->get_code();
-//   IRInstruction* move_result_insn = nullptr;
-//   auto ii = InstructionIterable(code);
-//   for (auto it = ii.begin(); it != ii.end(); ++it) {
-//     auto* insn = it->insn;
-//     if (insn == invoke_insn) {
-//       move_result_insn = std::next(it)->insn;
-//       break;
-//     }
-//   }
-//   if (!move_result_insn ||
-//       !opcode::is_a_move_result(move_result_insn->opcode())) {
-//     return boost::none;
-//   }
-//   auto arg_param = get_abstract_object(RESULT_REGISTER, move_result_insn);
-//   if (!arg_param ||
-//       arg_param->obj_kind != reflection::AbstractObjectKind::METHOD) {
-//     return boost::none;
-//   }
-//   return arg_param->dex_type_array;
-// }
-
-// bool ReflectionAnalysis::has_found_reflection() const {
-//   return !get_reflection_sites().empty();
-// }
-
-// boost::optional<AbstractObject> ReflectionAnalysis::get_abstract_object(
-//     size_t reg, IRInstruction* insn) const {
-//   if (m_analyzer == nullptr) {
-//     return boost::none;
-//   }
-//   return m_analyzer->get_abstract_object(reg, insn);
-// }
-
 CallingContextMap DeterminismAnalysis::get_calling_context_partition() const {
-  if (m_analyzer == nullptr) {
+  if (m_transfer == nullptr) {
     return CallingContextMap::top();
   }
-  printf("return a non top calling contextmap\n");
-  return this->m_analyzer->get_exit_state().get_calling_context_partition();
+  TRACE(UDF_DET, 5, "return a non top calling contextmap");
+  return this->m_transfer->get_exit_state().get_calling_context_partition();
 }
 
 } // namespace determinism
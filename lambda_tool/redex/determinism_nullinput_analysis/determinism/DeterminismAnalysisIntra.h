@@ -26,38 +26,38 @@
 #include "PatriciaTreeMapAbstractPartition.h"
 #include "DexClass.h"
 #include "ReducedProductAbstractDomain.h"
+#include "Show.h"
+#include "Trace.h"
+#include "UdfAnalysisTypes.h"
 #include <iostream>
 
 using namespace sparta;
 
-struct IntraAnalyzerParameters {
-    bool track_exception = false;
-};  
-enum DeterminismType { DT_BOTTOM, IS_DET, NOT_DET, DT_TOP };
-// label whether a basic block comes from an exception block
-enum ExceptType { EX_BOTTOM, UNVISIT, FROM_EX, NO_EX, EX_TOP };
-
-std::ostream& operator<<(std::ostream& output, const DeterminismType& det);
-std::ostream& operator<<(std::ostream& output, const ExceptType& det);
-
-
 namespace determinism {
 enum class FieldType { INSTANCE, STATIC };
 
 using std::placeholders::_1;
 
-using DetLattice = sparta::BitVectorLattice<DeterminismType, 4, std::hash<int>>;
-extern DetLattice det_lattice;
-using ExpLattice = sparta::BitVectorLattice<ExceptType, 5, std::hash<int>>;
-extern ExpLattice exp_lattice;
-using DeterminismDomain = sparta::FiniteAbstractDomain<DeterminismType,
-                                                       DetLattice,
-                                                       DetLattice::Encoding,
-                                                       &det_lattice>;
-using ExpDomain = sparta::FiniteAbstractDomain<ExceptType,
-                                            ExpLattice,
-                                            ExpLattice::Encoding,
-                                            &exp_lattice>;
+using DetLattice = sparta::ConstexprLattice<DeterminismType, 4>;
+inline constexpr DetLattice det_lattice({DT_BOTTOM, IS_DET, NOT_DET, DT_TOP},
+                                        {{DT_BOTTOM, IS_DET},
+                                         {DT_BOTTOM, NOT_DET},
+                                         {IS_DET, DT_TOP},
+                                         {NOT_DET, DT_TOP}});
+using ExpLattice = sparta::ConstexprLattice<ExceptType, 5>;
+inline constexpr ExpLattice exp_lattice(
+    {EX_BOTTOM, UNVISIT, FROM_EX, NO_EX, EX_TOP},
+    {{EX_BOTTOM, UNVISIT},
+     {UNVISIT, FROM_EX},
+     {UNVISIT, NO_EX},
+     {NO_EX, EX_TOP},
+     {FROM_EX, EX_TOP}});
+using DeterminismDomain =
+    sparta::ConstexprFiniteAbstractDomain<DeterminismType,
+                                          DetLattice,
+                                          &det_lattice>;
+using ExpDomain =
+    sparta::ConstexprFiniteAbstractDomain<ExceptType, ExpLattice, &exp_lattice>;
 
 std::ostream& operator<<(std::ostream& output,
                          const DeterminismDomain& detDomain);
@@ -81,11 +81,20 @@ using SummaryQueryFn =
 
 using DetFieldPartition =
     sparta::PatriciaTreeMapAbstractEnvironment<DexField*, DeterminismDomain>;
-using RegFieldMapping = std::unordered_map<reg_t, DexField*>;
+using RegFieldMapping =
+    std::unordered_map<reg_t,
+                       DexField*,
+                       std::hash<reg_t>,
+                       std::equal_to<reg_t>,
+                       sparta::ArenaAllocator<std::pair<const reg_t, DexField*>>>;
 // This program state is block-wise, and tracks a set of block that has an
 // exception handling block as its ancestor.
 // NodeId = Block*;
-using ExpBlockPartition = std::unordered_set<cfg::GraphInterface::NodeId>;
+using ExpBlockPartition =
+    std::unordered_set<cfg::GraphInterface::NodeId,
+                       std::hash<cfg::GraphInterface::NodeId>,
+                       std::equal_to<cfg::GraphInterface::NodeId>,
+                       sparta::ArenaAllocator<cfg::GraphInterface::NodeId>>;
 
 
 // using ClassObjectSourceDomain =
@@ -142,7 +151,7 @@ class AbstractObjectEnvironment final
   }
 
   void set_field_value(DexField* field, const DeterminismDomain value) {
-    std::cout << "set field value to" << value;
+    TRACE(UDF_DET, 5, "set field value to %s", SHOW(value));
     apply<3>([=](auto env) { env->set(field, value); }, true);
   }
   const DetFieldPartition& get_field_environment() const {
@@ -155,9 +164,9 @@ class AbstractObjectEnvironment final
 
   ReturnValueDomain get_return_value() const { return get<1>(); }
   void debugExpBlockDomain() const {
-    std::cout<< "debugExpBlockDomain() start\n";
-    std::cout << get_exp_block_value() << std::endl;
-    std::cout<< "debugExpBlockDomain() end\n";
+    TRACE(UDF_DET, 5, "debugExpBlockDomain() start");
+    TRACE(UDF_DET, 5, "%s", SHOW(get_exp_block_value()));
+    TRACE(UDF_DET, 5, "debugExpBlockDomain() end");
   }
   ExpBlockDomain get_exp_block_value() const { return get<4>(); }
 
@@ -169,16 +178,16 @@ class AbstractObjectEnvironment final
   }
   
   void set_exp_block_value(const ExpBlockDomain& domain) {
-    std::cout << "set exp block value to" << domain << std::endl;
+    TRACE(UDF_DET, 5, "set exp block value to %s", SHOW(domain));
     apply<4>([=](auto original) { original->set_to_top(); original->meet_with(domain);}, true);
   }
   void join_exp_block_value(const ExpBlockDomain& domain) {
-    std::cout << "join with exp block value" << domain << std::endl;
+    TRACE(UDF_DET, 5, "join with exp block value %s", SHOW(domain));
     debugExpBlockDomain();
     apply<4>([=](auto original) { original->join_with(domain); }, true);
   }
   void meet_exp_block_value(const ExpBlockDomain& domain) {
-    std::cout << "meet with exp block value\n";
+    TRACE(UDF_DET, 5, "meet with exp block value");
     apply<4>([=](auto original) { original->meet_with(domain); }, true);
   }
 
@@ -196,6 +205,7 @@ namespace impl {
 
 // Forward declarations.
 class Analyzer;
+class Transfer;
 
 } // namespace impl
 
@@ -215,34 +225,42 @@ class DeterminismAnalysis final {
   explicit DeterminismAnalysis(DexMethod* dex_method, IntraAnalyzerParameters ap, CallingContext* context = nullptr, SummaryQueryFn* summary_query_fn = nullptr,
                               std::unordered_set<std::string>* reset_det_func = nullptr, DetFieldPartition* filed_partition = nullptr);
 
+  // Prepares the analysis without running it, for a fixpoint over the CFG of
+  // the method shared with other analyses: the caller iterates analyze_node()
+  // from initial_state(), and passes the state at the exit block to finish()
+  // before reading the results. Only for methods with code.
+  struct Deferred {};
+  DeterminismAnalysis(Deferred,
+                      DexMethod* dex_method,
+                      IntraAnalyzerParameters ap,
+                      SummaryQueryFn* summary_query_fn,
+                      std::unordered_set<std::string>* reset_det_func,
+                      DetFieldPartition* filed_partition);
+
+  AbstractObjectEnvironment initial_state(CallingContext* context) const;
+  void analyze_node(cfg::Block* block,
+                    AbstractObjectEnvironment* current_state) const;
+  void finish(const AbstractObjectEnvironment& exit_state);
 
   DeterminismDomain get_return_value() const;
 
-  /**
-   * Return a parameter type array for this invoke method instruction.
-   */
-  boost::optional<std::vector<DexType*>> get_method_params(
-      IRInstruction* invoke_insn) const;
-  /*
-   * Returns the abstract object (if any) referenced by the register at the
-   * given instruction. Note that if the instruction overwrites the register,
-   * the abstract object returned is the value held by the register *before*
-   * that instruction is executed.
-   */
-//   boost::optional<DeterminismDomain> get_abstract_object(
-//       size_t reg, IRInstruction* insn) const;
-
-//   boost::optional<ClassObjectSource> get_class_source(
-//       size_t reg, IRInstruction* insn) const;
-
   CallingContextMap get_calling_context_partition() const;
 
+  // The number of blocks of the CFG, and of iterations of the fixpoint over
+  // its loops, see MonotonicFixpointIteratorBase::get_num_iterations(). Both
+  // are 0 if the method has no code.
+  size_t get_num_blocks() const;
+  uint32_t get_num_iterations() const;
+
  private:
   const DexMethod* m_dex_method;
   // This is the actual class that performs the analysis over the CFG
   // class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> 
   // class BaseIRAnalyzer : public sparta::MonotonicFixpointIterator<cfg::GraphInterface, Domain> {
-  std::unique_ptr<impl::Analyzer> m_analyzer; 
+  // The state of the analysis of the method, released at once with it.
+  sparta::Arena m_arena;
+  std::unique_ptr<impl::Transfer> m_transfer;
+  std::unique_ptr<impl::Analyzer> m_analyzer;
   std::unordered_set<std::string>* reset_det_func = nullptr;
   DetFieldPartition* filed_partition = new DetFieldPartition();
   IntraAnalyzerParameters m_ap;
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "Debug.h"
+#include "DexClass.h"
+#include "Show.h"
+#include "SpartaInterprocedural.h"
+#include "Walkers.h"
+
+/*
+ * The target functions of the UDF analyses, e.g. the public static entry
+ * methods of a UDF jar. With the target_functions_only option, the call graph
+ * is rooted at these methods, so only they and their transitive callees are
+ * analyzed.
+ */
+namespace target_functions {
+
+// Reads the comma separated names of a target functions file. Returns no
+// names if the file cannot be opened.
+inline std::vector<std::string> read(const std::string& filename) {
+  std::vector<std::string> names;
+  std::string line, word;
+  std::fstream file(filename, std::ios::in);
+  if (!file.is_open()) {
+    return names;
+  }
+  while (getline(file, line)) {
+    std::stringstream str(line);
+    while (getline(str, word, ',')) {
+      names.push_back(word);
+    }
+  }
+  return names;
+}
+
+// Returns the methods with code of the scope named by `names`, in the order of
+// the scope. A name is either a method, "Lcom/Foo;.bar:(I)I", or
+// "<class><name>", "Lcom/Foo;bar", for all the overloads of a method, as in the
+// labels files.
+inline std::vector<const DexMethod*> resolve(
+    const Scope& scope, const std::vector<std::string>& names) {
+  std::unordered_set<std::string> name_set(names.begin(), names.end());
+  std::vector<const DexMethod*> methods;
+  if (name_set.empty()) {
+    return methods;
+  }
+  walk::methods(scope, [&](DexMethod* method) {
+    if (method->get_code() == nullptr) {
+      return;
+    }
+    if (name_set.count(show(method)) ||
+        name_set.count(std::string(method->get_class()->c_str()) +
+                       method->get_name()->c_str())) {
+      methods.push_back(method);
+    }
+  });
+  return methods;
+}
+
+// Returns the program analyzed by a UDF analysis pass: the scope, rooted at the
+// target functions named by `names` if `target_functions_only` is set.
+inline sparta_interprocedural::RootedScope program_of(
+    const Scope& scope,
+    const std::vector<std::string>& names,
+    bool target_functions_only) {
+  if (!target_functions_only) {
+    return sparta_interprocedural::RootedScope(scope);
+  }
+  auto roots = resolve(scope, names);
+  always_assert_log(!roots.empty(),
+                    "None of the %zu target functions is in the scope",
+                    names.size());
+  return sparta_interprocedural::RootedScope(scope, std::move(roots));
+}
+
+} // namespace target_functions
@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <boost/optional.hpp>
+#include <json/value.h>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "AnalysisOutput.h"
+#include "AnalysisTelemetry.h"
+#include "DexClass.h"
+#include "EditableCfgAdapter.h"
+#include "IRInstruction.h"
+#include "Show.h"
+#include "SpartaInterprocedural.h"
+#include "SummaryCache.h"
+#include "Trace.h"
+#include "WorkQueue.h"
+
+/*
+ * The interprocedural plumbing shared by the UDF analysis passes: choosing the
+ * analyzer of the global fixpoint from the parameters, streaming the summaries
+ * to analysis_output::ResultWriter, and reusing and saving the analyses of
+ * the methods with summary_cache::SummaryCache.
+ *
+ * A pass describes its summaries with a Traits class:
+ *
+ *   struct Traits {
+ *     using Summary = ...;  // The FunctionSummary of the Adaptor.
+ *     static constexpr TraceModule trace_module = ...;
+ *     // The name and suffix of the result files, see ResultWriter::open.
+ *     static constexpr const char* pass_name = ...;
+ *     static constexpr const char* suffix = ...;
+ *     // Adds the summary of a method to its record.
+ *     static void add_summary(const Summary&, Json::Value* record);
+ *     // The summary as stored in a summary_cache::SummaryCache, and back.
+ *     static uint32_t encode(const Summary&);
+ *     static Summary decode(uint32_t);
+ *   };
+ *
+ * The AnalysisParameters of the pass have the members parallel_fixpoint,
+ * num_threads, incremental_fixpoint, scc_fixpoint, scc_budget and
+ * output_format.
+ */
+namespace udf_analysis {
+
+template <typename Summary>
+using Result = std::unordered_map<const DexMethod*, Summary>;
+
+struct Options {
+  // The cache the analyses of a run that reached the global fixpoint are
+  // committed to, and the file it is then saved to. Disabled if nullptr.
+  summary_cache::SummaryCache* summary_cache = nullptr;
+  std::string summary_cache_path;
+  // The records of the analyses of every method, written to telemetry_path.
+  // Disabled if nullptr.
+  analysis_telemetry::MethodTelemetry* telemetry = nullptr;
+  std::string telemetry_path;
+  size_t telemetry_top_n = 0;
+};
+
+// Creates the summary cache of a pass and loads `path` into it. Returns
+// nullptr if `path` is empty.
+inline std::unique_ptr<summary_cache::SummaryCache> load_summary_cache(
+    const Scope& scope, const std::string& path, uint64_t fingerprint) {
+  if (path.empty()) {
+    return nullptr;
+  }
+  auto cache =
+      std::make_unique<summary_cache::SummaryCache>(scope, fingerprint);
+  cache->load(path);
+  return cache;
+}
+
+constexpr uint32_t TOP_PARTITION = std::numeric_limits<uint32_t>::max();
+
+// Appends a partition of the parameters of a method, e.g. a
+// determinism::CallingContext, to `words`.
+template <typename Partition>
+void encode_partition(const Partition& partition,
+                      std::vector<uint32_t>* words) {
+  if (partition.is_top()) {
+    words->push_back(TOP_PARTITION);
+    return;
+  }
+  std::vector<std::pair<uint32_t, uint32_t>> bindings;
+  for (const auto& binding : partition.bindings()) {
+    bindings.emplace_back(binding.first, binding.second.element());
+  }
+  std::sort(bindings.begin(), bindings.end());
+  words->push_back(bindings.size());
+  for (const auto& binding : bindings) {
+    words->push_back(binding.first);
+    words->push_back(binding.second);
+  }
+}
+
+// Reads the partition written by encode_partition at `*pos` of `words`, and
+// moves `*pos` past it.
+template <typename Partition>
+Partition decode_partition(const std::vector<uint32_t>& words, size_t* pos) {
+  uint32_t size = words.at((*pos)++);
+  if (size == TOP_PARTITION) {
+    return Partition::top();
+  }
+  Partition partition;
+  for (uint32_t i = 0; i < size; ++i) {
+    auto label = words.at((*pos)++);
+    auto element = words.at((*pos)++);
+    using Domain = std::decay_t<decltype(partition.get(label))>;
+    using Element = decltype(std::declval<Domain>().element());
+    partition.set(label, Domain(static_cast<Element>(element)));
+  }
+  return partition;
+}
+
+/*
+ * The summary cache lookup and update of the analysis of a method by a
+ * function analyzer. An analysis is cached under the calling context of the
+ * method and the summaries of the callees of all its invoke instructions, as
+ * returned by the SummaryQueryFn of each analysis, see
+ * summary_cache::SummaryCache. The value of an analysis is the summary, then
+ * each map of the calling contexts the method passes to its callees, so that
+ * reusing it leaves the rest of the fixpoint as if the method had been
+ * analyzed. A fused pass passes one SummaryQueryFn and one calling context map
+ * per analysis.
+ */
+template <typename Traits>
+class CachedAnalysis final {
+ public:
+  using Summary = typename Traits::Summary;
+
+  // `context` is the calling context of the method, see encode_partition.
+  template <typename... QueryFns>
+  CachedAnalysis(summary_cache::SummaryCache* cache,
+                 const DexMethod* method,
+                 const std::vector<uint32_t>& context,
+                 const QueryFns&... query_fns)
+      : m_cache(cache), m_method(method) {
+    if (m_cache == nullptr) {
+      return;
+    }
+    auto* code = const_cast<DexMethod*>(method)->get_code();
+    if (code != nullptr) {
+      editable_cfg_adapter::iterate(code, [&](MethodItemEntry& mie) {
+        if (opcode::is_an_invoke(mie.insn->opcode())) {
+          m_invokes.push_back(mie.insn);
+        }
+        return editable_cfg_adapter::LOOP_CONTINUE;
+      });
+    }
+    m_inputs = context;
+    m_inputs.reserve(context.size() + m_invokes.size() * sizeof...(query_fns));
+    for (const auto* insn : m_invokes) {
+      (m_inputs.push_back(static_cast<uint32_t>(query_fns(insn).element())),
+       ...);
+    }
+  }
+
+  // The summary of the cached analysis, if any, after passing each calling
+  // context of the i-th map it computed to `update_contexts[i](insn,
+  // context)`. Without maps, for the analyses that pass no calling contexts to
+  // the callees.
+  template <typename... CallingContexts, typename... UpdateFns>
+  boost::optional<Summary> reuse(const UpdateFns&... update_contexts) {
+    static_assert(sizeof...(CallingContexts) == sizeof...(UpdateFns),
+                  "One update function per calling context map");
+    auto value = lookup();
+    if (!value) {
+      return boost::none;
+    }
+    size_t pos = 0;
+    auto summary = Traits::decode(value->at(pos++));
+    (decode_contexts<CallingContexts>(*value, &pos, update_contexts), ...);
+    m_cache->stage(m_method, m_inputs, std::move(*value));
+    return summary;
+  }
+
+  // Records the analysis of the method, with each map of the calling contexts
+  // it passes to the callees, in the order reuse() takes them.
+  template <typename... CallingContextMaps>
+  void store(const Summary& summary, const CallingContextMaps&... contexts) {
+    if (m_cache == nullptr) {
+      return;
+    }
+    std::vector<uint32_t> value{Traits::encode(summary)};
+    if (sizeof...(CallingContextMaps) == 0) {
+      value.push_back(0);
+    }
+    (encode_contexts(contexts, &value), ...);
+    m_cache->stage(m_method, m_inputs, std::move(value));
+  }
+
+ private:
+  template <typename CallingContextMap>
+  void encode_contexts(const CallingContextMap& contexts,
+                       std::vector<uint32_t>* value) const {
+    auto size_pos = value->size();
+    value->push_back(0);
+    if (contexts.is_top() || contexts.is_bottom()) {
+      return;
+    }
+    std::unordered_map<const IRInstruction*, uint32_t> indices;
+    for (uint32_t i = 0; i < m_invokes.size(); ++i) {
+      indices.emplace(m_invokes[i], i);
+    }
+    std::vector<std::pair<uint32_t, const IRInstruction*>> invokes;
+    for (const auto& entry : contexts.bindings()) {
+      invokes.emplace_back(indices.at(entry.first), entry.first);
+    }
+    std::sort(invokes.begin(), invokes.end());
+    (*value)[size_pos] = invokes.size();
+    for (const auto& invoke : invokes) {
+      value->push_back(invoke.first);
+      encode_partition(contexts.get(invoke.second), value);
+    }
+  }
+
+  template <typename CallingContext, typename UpdateFn>
+  void decode_contexts(const summary_cache::SummaryCache::Value& value,
+                       size_t* pos,
+                       const UpdateFn& update_context) const {
+    uint32_t num_contexts = value.at((*pos)++);
+    for (uint32_t i = 0; i < num_contexts; ++i) {
+      const auto* insn = m_invokes.at(value.at((*pos)++));
+      update_context(insn, decode_partition<CallingContext>(value, pos));
+    }
+  }
+
+  boost::optional<summary_cache::SummaryCache::Value> lookup() const {
+    if (m_cache == nullptr) {
+      return boost::none;
+    }
+    auto value = m_cache->get(m_method, m_inputs);
+    if (value) {
+      TRACE(Traits::trace_module, 3, "Reusing the analysis of %s",
+            SHOW(m_method));
+    }
+    return value;
+  }
+
+  summary_cache::SummaryCache* m_cache;
+  const DexMethod* m_method;
+  std::vector<const IRInstruction*> m_invokes;
+  summary_cache::SummaryCache::Inputs m_inputs;
+};
+
+/*
+ * Writes the records of the summaries with analysis_output::ResultWriter as
+ * they become final, see stream_results(). add() is thread-safe, and the
+ * writer sorts the records when it finishes, so the output does not depend on
+ * the order of the (possibly parallel) fixpoint.
+ */
+template <typename Traits>
+class ResultStream final {
+ public:
+  explicit ResultStream(analysis_output::Format format)
+      : m_writer(analysis_output::ResultWriter::open(Traits::pass_name,
+                                                     Traits::suffix,
+                                                     format)) {}
+
+  void add(const DexMethod* method,
+           const typename Traits::Summary& summary,
+           bool budget_exhausted) {
+    TRACE(Traits::trace_module, 3, "Summary of %s: %s", SHOW(method),
+          SHOW(summary));
+    if (!m_writer) {
+      return;
+    }
+    Json::Value record;
+    record["name"] = show(method);
+    Traits::add_summary(summary, &record);
+    if (budget_exhausted) {
+      record["budget_exhausted"] = true;
+    }
+    m_writer->add(method, std::move(record));
+  }
+
+  void finish() {
+    if (m_writer) {
+      m_writer->finish();
+    }
+  }
+
+ private:
+  std::unique_ptr<analysis_output::ResultWriter> m_writer;
+};
+
+// The summaries of the global fixpoints are only final at the end of the run.
+// Returns false, the caller adds them after the run.
+template <typename Traits, typename Analyzer>
+bool stream_results(Analyzer&, ResultStream<Traits>*) {
+  return false;
+}
+
+// The summaries of a component of a SccInterproceduralAnalyzer are final once
+// it is analyzed, so they are written while the other components are.
+template <typename Traits, typename Adaptor, typename AnalysisParameters>
+bool stream_results(
+    sparta::SccInterproceduralAnalyzer<Adaptor, AnalysisParameters>& analysis,
+    ResultStream<Traits>* results) {
+  using Function = typename sparta::
+      SccInterproceduralAnalyzer<Adaptor, AnalysisParameters>::Function;
+  analysis.set_component_callback(
+      [&analysis, results](const std::vector<Function>& functions,
+                           bool widened) {
+        const auto& summaries = analysis.registry.get_map();
+        for (const auto& method : functions) {
+          if (summaries.count(method)) {
+            results->add(method,
+                         summaries.get(method, Traits::Summary::top()),
+                         widened);
+          }
+        }
+      });
+  return true;
+}
+
+// Adds the analyses of a run that reached the global fixpoint to the cache and
+// saves it.
+template <typename Traits, typename Analyzer>
+void update_summary_cache(const Analyzer& analysis, const Options& options) {
+  if (options.summary_cache == nullptr) {
+    return;
+  }
+  if (!analysis.reached_fixpoint()) {
+    TRACE(Traits::trace_module, 1,
+          "No global fixpoint, the summary cache is not updated");
+    return;
+  }
+  options.summary_cache->commit();
+  options.summary_cache->save(options.summary_cache_path);
+}
+
+template <typename Traits, typename Analyzer>
+void trace_reuse(const Analyzer&) {}
+
+template <typename Traits, typename BaseAnalyzer>
+void trace_reuse(
+    const sparta::IncrementalInterproceduralAnalyzer<BaseAnalyzer>& analysis) {
+  TRACE(Traits::trace_module, 1,
+        "Analyzed %zu methods, reused %zu previous analyses",
+        analysis.num_analyzed(), analysis.num_reused());
+}
+
+template <typename Traits, typename Analyzer, typename AnalysisParameters>
+std::shared_ptr<Result<typename Traits::Summary>> run_analysis(
+    Analyzer& analysis,
+    const AnalysisParameters& param,
+    const Options& options) {
+  analysis.set_telemetry(options.telemetry);
+  // Open the output before the run, so that the records are written as the
+  // summaries become final.
+  ResultStream<Traits> results(param.output_format);
+  bool streamed = stream_results(analysis, &results);
+  analysis.run();
+  trace_reuse<Traits>(analysis);
+  const auto& summaries = analysis.registry.get_map();
+  if (!streamed) {
+    for (const auto& entry : summaries) {
+      results.add(entry.first, entry.second, /* budget_exhausted */ false);
+    }
+  }
+  if (!analysis.budget_exhausted_functions().empty()) {
+    TRACE(Traits::trace_module, 1,
+          "%zu methods exhausted their iteration budget",
+          analysis.budget_exhausted_functions().size());
+  }
+  results.finish();
+  update_summary_cache<Traits>(analysis, options);
+  return std::make_shared<Result<typename Traits::Summary>>(summaries.begin(),
+                                                            summaries.end());
+}
+
+// Runs the global fixpoint of `Adaptor` on `program` with the analyzer chosen
+// by `param`, writes the summaries and updates the summary cache. Returns the
+// summaries.
+template <typename Adaptor, typename Traits, typename AnalysisParameters>
+std::shared_ptr<Result<typename Traits::Summary>> run(
+    const typename Adaptor::Program& program,
+    unsigned max_iteration,
+    AnalysisParameters* param,
+    const Options& options) {
+  using Analysis = sparta::InterproceduralAnalyzer<Adaptor, AnalysisParameters>;
+  // The analyses only read the summaries of the callees returned by
+  // call_graph::resolve_callees_in_graph(), the successors of the method in
+  // the call graph, so the parallel analyzers give the summaries of the serial
+  // ones, see sparta::ParallelAnalysisAdaptor.
+  using ParallelAnalysis =
+      sparta::ParallelInterproceduralAnalyzer<Adaptor, AnalysisParameters>;
+  using IncrementalAnalysis =
+      sparta::IncrementalInterproceduralAnalyzer<Analysis>;
+  using IncrementalParallelAnalysis =
+      sparta::IncrementalInterproceduralAnalyzer<ParallelAnalysis>;
+  using SccAnalysis =
+      sparta::SccInterproceduralAnalyzer<Adaptor, AnalysisParameters>;
+
+  size_t num_threads = param->num_threads
+                           ? param->num_threads
+                           : redex_parallel::default_num_threads();
+  std::shared_ptr<Result<typename Traits::Summary>> result;
+  if (param->scc_fixpoint) {
+    SccAnalysis analysis(program, max_iteration, param,
+                         param->parallel_fixpoint ? num_threads : 1);
+    analysis.set_component_budget(param->scc_budget);
+    result = run_analysis<Traits>(analysis, *param, options);
+  } else if (param->parallel_fixpoint && param->incremental_fixpoint) {
+    IncrementalParallelAnalysis analysis(program, max_iteration, param,
+                                         num_threads);
+    result = run_analysis<Traits>(analysis, *param, options);
+  } else if (param->parallel_fixpoint) {
+    ParallelAnalysis analysis(program, max_iteration, param, num_threads);
+    result = run_analysis<Traits>(analysis, *param, options);
+  } else if (param->incremental_fixpoint) {
+    IncrementalAnalysis analysis(program, max_iteration, param);
+    result = run_analysis<Traits>(analysis, *param, options);
+  } else {
+    Analysis analysis(program, max_iteration, param);
+    result = run_analysis<Traits>(analysis, *param, options);
+  }
+  if (options.telemetry != nullptr) {
+    options.telemetry->write(options.telemetry_path, options.telemetry_top_n,
+                             Traits::trace_module);
+  }
+  return result;
+}
+
+} // namespace udf_analysis
@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <ostream>
+
+// Types shared by the intraprocedural determinism, null-input and
+// parallel-safety analyses, so that their headers can be included together.
+
+struct IntraAnalyzerParameters {
+  bool track_exception = false;
+};
+
+enum DeterminismType { DT_BOTTOM, IS_DET, NOT_DET, DT_TOP };
+// label whether a basic block comes from an exception block
+enum ExceptType { EX_BOTTOM, UNVISIT, FROM_EX, NO_EX, EX_TOP };
+
+std::ostream& operator<<(std::ostream& output, const DeterminismType& det);
+std::ostream& operator<<(std::ostream& output, const ExceptType& det);
@@ -0,0 +1,449 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "FusedUdfAnalysis.h"
+
+#include <json/writer.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "BaseIRAnalyzer.h"
+#include "CFGCache.h"
+#include "ControlFlow.h"
+#include "Debug.h"
+#include "DexClass.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "PatriciaTreeMapAbstractEnvironment.h"
+#include "PatriciaTreeMapAbstractPartition.h"
+#include "Show.h"
+#include "SpartaInterprocedural.h"
+#include "UdfAnalysisRunner.h"
+#include "Walkers.h"
+#include "WorkQueue.h"
+
+namespace {
+using namespace fused_udf;
+
+struct UdfTraits {
+  using Summary = UdfSummary;
+  static constexpr TraceModule trace_module = UDF_FUSED;
+  static constexpr const char* pass_name = "FusedUdfAnalysisPass";
+  static constexpr const char* suffix = "udf";
+  static void add_summary(const Summary& summary, Json::Value* record) {
+    (*record)["det"] = summary.determinism().element();
+    (*record)["nullinput"] = summary.null_input().element();
+    (*record)["psafe"] = summary.parallel_safety().element();
+  }
+  // One byte per component.
+  static uint32_t encode(const Summary& summary) {
+    return static_cast<uint32_t>(summary.determinism().element()) |
+           static_cast<uint32_t>(summary.null_input().element()) << 8 |
+           static_cast<uint32_t>(summary.parallel_safety().element()) << 16;
+  }
+  static Summary decode(uint32_t element) {
+    return Summary(std::make_tuple(
+        determinism::DeterminismDomain(
+            static_cast<DeterminismType>(element & 0xff)),
+        nullinput::NullInputDomain(
+            static_cast<NullInputType>(element >> 8 & 0xff)),
+        parallelsafe::DeterminismDomain(
+            static_cast<DeterminismType>(element >> 16 & 0xff))));
+  }
+};
+
+using namespace sparta;
+using namespace sparta_interprocedural;
+
+constexpr const IRInstruction* CURRENT_PARTITION_LABEL = nullptr;
+
+// The calling contexts of the determinism and parallel-safety analyses map the
+// invoke instructions of a method to the arguments they pass. The null-input
+// analysis does not propagate calling contexts.
+using DeterminismContext =
+    PatriciaTreeMapAbstractEnvironment<const IRInstruction*,
+                                       determinism::CallingContext>;
+using NullInputContext =
+    PatriciaTreeMapAbstractPartition<const DexMethod*,
+                                     nullinput::CallingContext>;
+using ParallelSafetyContext =
+    PatriciaTreeMapAbstractEnvironment<const IRInstruction*,
+                                       parallelsafe::CallingContext>;
+
+class UdfCallingContext final
+    : public DirectProductAbstractDomain<UdfCallingContext,
+                                         DeterminismContext,
+                                         NullInputContext,
+                                         ParallelSafetyContext> {
+ public:
+  using DirectProductAbstractDomain::DirectProductAbstractDomain;
+};
+
+// Propagates each component along a call edge like the Caller of the
+// corresponding pass.
+struct Caller {
+  using Domain = UdfCallingContext;
+
+  Domain analyze_edge(const std::shared_ptr<call_graph::Edge>& edge,
+                      const Domain& exit_state_at_source) {
+    if (!edge->callee()->method()) {
+      TRACE(UDF_FUSED, 3, "callee is nullptr, return a default bottom domain");
+      return Domain::bottom();
+    }
+    DeterminismContext determinism_context;
+    ParallelSafetyContext parallel_safety_context;
+    auto insn = edge->invoke_insn();
+    if (insn == nullptr) {
+      determinism_context.set(CURRENT_PARTITION_LABEL,
+                              determinism::CallingContext::top());
+      parallel_safety_context.set(CURRENT_PARTITION_LABEL,
+                                  parallelsafe::CallingContext::top());
+    } else {
+      determinism_context.set(CURRENT_PARTITION_LABEL,
+                              exit_state_at_source.get<0>().get(insn));
+      parallel_safety_context.set(CURRENT_PARTITION_LABEL,
+                                  exit_state_at_source.get<2>().get(insn));
+    }
+    return Domain(std::make_tuple(std::move(determinism_context),
+                                  NullInputContext::bottom(),
+                                  std::move(parallel_safety_context)));
+  }
+};
+
+// The states of the three intraprocedural analyses at a program point.
+class UdfEnvironment final
+    : public DirectProductAbstractDomain<
+          UdfEnvironment,
+          determinism::AbstractObjectEnvironment,
+          nullinput::RegisterSetDomain,
+          parallelsafe::AbstractObjectEnvironment> {
+ public:
+  using DirectProductAbstractDomain::DirectProductAbstractDomain;
+};
+
+// One fixpoint over the CFG of a method for the three analyses: each block is
+// analyzed by the transfer functions of every analysis on its component of
+// the state. The components never interact, and a bottom component is
+// analyzed like in the fixpoint of its own analysis, so the results are those
+// of the three separate fixpoints.
+class UdfIntraAnalyzer final
+    : public ir_analyzer::BaseIRAnalyzer<UdfEnvironment> {
+ public:
+  UdfIntraAnalyzer(const cfg::ControlFlowGraph& cfg,
+                   const determinism::DeterminismAnalysis* determinism,
+                   const nullinput::NullInputAnalysis* null_input,
+                   const parallelsafe::ParallelSafetyAnalysis* parallel_safety,
+                   sparta::Arena* arena)
+      : BaseIRAnalyzer(cfg, arena),
+        m_determinism(determinism),
+        m_null_input(null_input),
+        m_parallel_safety(parallel_safety) {}
+
+  void analyze_node(const NodeId& block,
+                    UdfEnvironment* current_state) const override {
+    // The components are copied rather than updated with apply(), which skips
+    // the state when all of them are bottom.
+    auto determinism = current_state->get<0>();
+    auto null_input = current_state->get<1>();
+    auto parallel_safety = current_state->get<2>();
+    m_determinism->analyze_node(block, &determinism);
+    m_null_input->analyze_node(block, &null_input);
+    m_parallel_safety->analyze_node(block, &parallel_safety);
+    *current_state = UdfEnvironment(std::make_tuple(
+        std::move(determinism), std::move(null_input),
+        std::move(parallel_safety)));
+  }
+
+  void analyze_instruction(const IRInstruction*,
+                           UdfEnvironment*) const override {
+    // The analyses have their own transfer functions of whole blocks.
+    not_reached();
+  }
+
+ private:
+  const determinism::DeterminismAnalysis* m_determinism;
+  const nullinput::NullInputAnalysis* m_null_input;
+  const parallelsafe::ParallelSafetyAnalysis* m_parallel_safety;
+};
+
+template <typename Base>
+class UdfFunctionAnalyzer : public Base {
+ private:
+  const DexMethod* m_method;
+  UdfSummary m_domain;
+  // The size of the CFG and the iterations of the fixpoint of the analyses.
+  sparta::FunctionAnalysisStats m_stats;
+
+  // The summary of the callees of `insn` for the analysis of component
+  // `Index`. A label of the callee, if any, overrides its summary.
+  template <size_t Index, typename Domain>
+  Domain query_summary(const IRInstruction* insn,
+                       const CalleeLabels<Domain>* labels) const {
+    if (labels != nullptr) {
+      if (auto label = labels->get(insn->get_method())) {
+        return *label;
+      }
+    }
+    auto callees = call_graph::resolve_callees_in_graph(
+        *this->get_call_graph(), m_method, insn);
+    Domain ret = Domain::bottom();
+    for (const DexMethod* method : callees) {
+      ret.join_with(this->get_summaries()
+                        ->get(method, UdfSummary::top())
+                        .template get<Index>());
+    }
+    if (ret.is_bottom()) {
+      // The callee is not in the graph, or returns void.
+      return Domain::top();
+    }
+    return ret;
+  }
+
+  // Joins the calling context passed by `insn` into component `Index` of the
+  // caller context.
+  template <size_t Index, typename CallingContext>
+  void update_calling_context(const IRInstruction* insn,
+                              const CallingContext& calling_context) {
+    always_assert(opcode::is_an_invoke(insn->opcode()));
+    this->get_caller_context()->template apply<Index>([&](auto* context) {
+      context->update(insn, [&](const auto& original_context) {
+        return calling_context.join(original_context);
+      });
+    });
+  }
+
+  // Joins the calling contexts computed by an intraprocedural analysis into
+  // component `Index` of the caller context.
+  template <size_t Index, typename CallingContextMap>
+  void update_calling_contexts(const CallingContextMap& partition) {
+    if (partition.is_top() || partition.is_bottom()) {
+      return;
+    }
+    for (const auto& entry : partition.bindings()) {
+      update_calling_context<Index>(entry.first, entry.second);
+    }
+  }
+
+ public:
+  explicit UdfFunctionAnalyzer(const DexMethod* method)
+      : m_method(method), m_domain(UdfSummary::top()) {}
+
+  sparta::FunctionAnalysisStats analysis_stats() const { return m_stats; }
+
+  void analyze() override {
+    if (!m_method) {
+      // ghost entry or exit
+      return;
+    }
+    TRACE(UDF_FUSED, 3, "Intra analysis on a function %s", SHOW(m_method));
+    auto* param = this->get_analysis_parameters();
+    auto* caller_context = this->get_caller_context();
+    auto* method = const_cast<DexMethod*>(m_method);
+
+    determinism::SummaryQueryFn determinism_query_fn =
+        [&](const IRInstruction* insn) {
+          return query_summary<0>(insn, &param->determinism.callee_labels);
+        };
+    nullinput::SummaryQueryFn null_input_query_fn =
+        [&](const IRInstruction* insn) {
+          return query_summary<1, nullinput::NullInputDomain>(insn, nullptr);
+        };
+    parallelsafe::SummaryQueryFn parallel_safety_query_fn =
+        [&](const IRInstruction* insn) {
+          return query_summary<2>(insn,
+                                  &param->parallel_safety.callee_labels);
+        };
+
+    auto determinism_context =
+        caller_context->template get<0>().get(CURRENT_PARTITION_LABEL);
+    auto null_input_context = caller_context->template get<1>().get(m_method);
+    auto parallel_safety_context =
+        caller_context->template get<2>().get(CURRENT_PARTITION_LABEL);
+
+    // Methods whose code and inputs did not change since a previous run keep
+    // the analyses of that run. The null-input calling context is always
+    // bottom, see Caller, so it is not part of the inputs.
+    std::vector<uint32_t> context_words;
+    udf_analysis::encode_partition(determinism_context, &context_words);
+    udf_analysis::encode_partition(parallel_safety_context, &context_words);
+    udf_analysis::CachedAnalysis<UdfTraits> cached_analysis(
+        param->summary_cache, m_method, context_words, determinism_query_fn,
+        null_input_query_fn, parallel_safety_query_fn);
+    if (auto cached = cached_analysis.reuse<determinism::CallingContext,
+                                            parallelsafe::CallingContext>(
+            [&](const IRInstruction* insn,
+                const determinism::CallingContext& context) {
+              update_calling_context<0>(insn, context);
+            },
+            [&](const IRInstruction* insn,
+                const parallelsafe::CallingContext& context) {
+              update_calling_context<2>(insn, context);
+            })) {
+      m_domain = *cached;
+      return;
+    }
+
+    IntraAnalyzerParameters ap;
+    ap.track_exception = param->determinism.track_exception;
+    determinism::DeterminismAnalysis determinism_analysis(
+        determinism::DeterminismAnalysis::Deferred(), method, ap,
+        &determinism_query_fn, &param->determinism.func_reset_det_set,
+        &param->determinism.instance_fields);
+
+    ap.track_exception = false;
+    nullinput::NullInputAnalysis null_input_analysis(
+        nullinput::NullInputAnalysis::Deferred(), method, ap,
+        &null_input_query_fn);
+
+    ap.track_exception = param->parallel_safety.track_exception;
+    parallelsafe::ParallelSafetyAnalysis parallel_safety_analysis(
+        parallelsafe::ParallelSafetyAnalysis::Deferred(), method, ap,
+        &parallel_safety_query_fn, &param->parallel_safety.func_reset_det_set);
+
+    if (method->get_code() != nullptr) {
+      const auto& cfg = cfg::CFGCache::instance().borrow(method->get_code());
+      sparta::Arena arena;
+      UdfIntraAnalyzer analyzer(cfg, &determinism_analysis,
+                                &null_input_analysis,
+                                &parallel_safety_analysis, &arena);
+      analyzer.run(UdfEnvironment(std::make_tuple(
+          determinism_analysis.initial_state(&determinism_context),
+          null_input_analysis.initial_state(&null_input_context),
+          parallel_safety_analysis.initial_state(&parallel_safety_context))));
+      auto exit_state = analyzer.get_exit_state_at(cfg.exit_block());
+      determinism_analysis.finish(exit_state.get<0>());
+      null_input_analysis.finish(exit_state.get<1>());
+      parallel_safety_analysis.finish(exit_state.get<2>());
+      m_stats.num_nodes = cfg.num_blocks();
+      m_stats.num_iterations = analyzer.get_num_iterations();
+    }
+
+    m_domain = UdfSummary(
+        std::make_tuple(determinism_analysis.get_return_value(),
+                        null_input_analysis.get_nullinput_result(),
+                        parallel_safety_analysis.get_return_value()));
+    TRACE(UDF_FUSED, 3, "summary of %s is %s", SHOW(m_method), SHOW(m_domain));
+
+    auto determinism_partition =
+        determinism_analysis.get_calling_context_partition();
+    auto parallel_safety_partition =
+        parallel_safety_analysis.get_calling_context_partition();
+    update_calling_contexts<0>(determinism_partition);
+    update_calling_contexts<2>(parallel_safety_partition);
+    cached_analysis.store(m_domain, determinism_partition,
+                          parallel_safety_partition);
+  }
+
+  void summarize() override {
+    if (!m_method) {
+      return;
+    }
+    this->get_summaries()->maybe_update(m_method, [&](UdfSummary& old) {
+      if (old == m_domain) {
+        return false;
+      }
+      old = m_domain;
+      return true;
+    });
+  }
+};
+
+struct UdfAnalysisAdaptor : public BottomUpAnalysisAdaptorBase {
+  using Registry = MethodSummaryRegistry<UdfSummary>;
+  using FunctionSummary = UdfSummary;
+  template <typename IntraproceduralBase>
+  using FunctionAnalyzer = UdfFunctionAnalyzer<IntraproceduralBase>;
+  using Callsite = Caller;
+};
+
+// The labels and flags of the determinism and parallel-safety analyses, the
+// null-input analysis has no configuration.
+uint64_t summary_cache_fingerprint(
+    const FusedUdfAnalysisPass::AnalysisParameters& param) {
+  summary_cache::Fingerprint fingerprint("FusedUdfAnalysisPass");
+  auto add_analysis = [&](const auto& analysis_param) {
+    fingerprint.add(static_cast<uint64_t>(analysis_param.track_exception));
+    std::map<std::string, uint64_t> labels;
+    for (const auto& entry : analysis_param.func_domain_map) {
+      labels.emplace(entry.first, entry.second.element());
+    }
+    for (const auto& label : labels) {
+      fingerprint.add(label.first).add(label.second);
+    }
+    std::set<std::string> reset_det(analysis_param.func_reset_det_set.begin(),
+                                    analysis_param.func_reset_det_set.end());
+    for (const auto& name : reset_det) {
+      fingerprint.add(name);
+    }
+  };
+  add_analysis(param.determinism);
+  add_analysis(param.parallel_safety);
+  return fingerprint.get();
+}
+
+} // namespace
+
+void FusedUdfAnalysisPass::run(const Scope& scope,
+                               unsigned m_max_iteration,
+                               AnalysisParameters param) {
+  band_config_func_labels(param);
+  band_config_functionality(param);
+  param.determinism.callee_labels.resolve(scope,
+                                         param.determinism.func_domain_map);
+  param.parallel_safety.callee_labels.resolve(
+      scope, param.parallel_safety.func_domain_map);
+  auto cache = udf_analysis::load_summary_cache(
+      scope, m_summary_cache, summary_cache_fingerprint(param));
+  param.summary_cache = cache.get();
+  auto program = target_functions::program_of(scope, param.function_names,
+                                              param.target_functions_only);
+  if (param.target_functions_only) {
+    TRACE(UDF_FUSED, 1, "Analyzing the callees of %zu target functions",
+          program.roots.size());
+  } else {
+    // The CFGs are built in parallel before the fixpoint, and then borrowed
+    // by the intraprocedural analyses, see cfg::CFGCache. Only the methods in
+    // the call graph are analyzed when it is rooted at the target functions,
+    // so their CFGs are built on demand instead.
+    walk::parallel::code(scope, [](DexMethod*, IRCode& code) {
+      cfg::CFGCache::instance().borrow(&code);
+    });
+  }
+  m_method_telemetry =
+      m_telemetry.empty()
+          ? nullptr
+          : std::make_unique<analysis_telemetry::MethodTelemetry>();
+  udf_analysis::Options options;
+  options.summary_cache = cache.get();
+  options.summary_cache_path = m_summary_cache;
+  options.telemetry = m_method_telemetry.get();
+  options.telemetry_path = m_telemetry;
+  options.telemetry_top_n = m_telemetry_top_n;
+  m_result = udf_analysis::run<UdfAnalysisAdaptor, UdfTraits>(
+      program, m_max_iteration, &param, options);
+}
+
+void FusedUdfAnalysisPass::run_pass(DexStoresVector& stores,
+                                    ConfigFiles& /* conf */,
+                                    PassManager& pm) {
+  AnalysisParameters param;
+  param.function_names = target_functions::read(m_target_functions);
+  param.target_functions_only = m_target_functions_only;
+  Scope analyze_scope = build_class_scope(stores);
+  run(analyze_scope, m_max_iteration, param);
+  if (m_method_telemetry) {
+    m_method_telemetry->report(name(), pm);
+  }
+}
+
+static FusedUdfAnalysisPass s_pass;
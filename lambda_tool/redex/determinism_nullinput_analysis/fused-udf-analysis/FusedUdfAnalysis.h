@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <unordered_map>
+
+#include "AnalysisOutput.h"
+#include "AnalysisTelemetry.h"
+#include "DeterminismAnalysis.h"
+#include "DexClass.h"
+#include "DirectProductAbstractDomain.h"
+#include "NullInputAnalysisIntra.h"
+#include "ParallelSafetyAnalysis.h"
+#include "Pass.h"
+#include "SummaryCache.h"
+#include "TargetFunctions.h"
+#include "Trace.h"
+
+namespace fused_udf {
+
+/*
+ * The summary of a method for the three UDF analyses. The components are
+ * computed independently of each other, so that they are the same as the
+ * summaries of the separate passes; no reduction is applied and a bottom
+ * component does not make the others bottom.
+ */
+class UdfSummary final
+    : public sparta::DirectProductAbstractDomain<UdfSummary,
+                                                 determinism::DeterminismDomain,
+                                                 nullinput::NullInputDomain,
+                                                 parallelsafe::DeterminismDomain> {
+ public:
+  using DirectProductAbstractDomain::DirectProductAbstractDomain;
+
+  const determinism::DeterminismDomain& determinism() const { return get<0>(); }
+  const nullinput::NullInputDomain& null_input() const { return get<1>(); }
+  const parallelsafe::DeterminismDomain& parallel_safety() const {
+    return get<2>();
+  }
+};
+
+} // namespace fused_udf
+
+/*
+ * Runs the determinism, null-input and parallel-safety analyses together: the
+ * call graph, the method override graph and the CFGs are built once, one
+ * global fixpoint computes the summaries of the three analyses, and one
+ * fixpoint over the CFG of each method runs their transfer functions. Writes
+ * one record per method with the three results.
+ */
+class FusedUdfAnalysisPass : public Pass {
+ public:
+  struct AnalysisParameters {
+    // The labels, reset-determinism functions and exception tracking of the
+    // determinism and parallel-safety analyses.
+    DeterminismAnalysisPass::AnalysisParameters determinism;
+    ParallelSafetyAnalysisPass::AnalysisParameters parallel_safety;
+    // For analyzing a subset of functions
+    std::vector<std::string> function_names;
+    // Only analyze function_names and their transitive callees, see
+    // target_functions::program_of.
+    bool target_functions_only = false;
+    // Run the call graph fixpoint on a ParallelMonotonicFixpointIterator.
+    bool parallel_fixpoint = false;
+    // Number of worker threads, 0 means the default for this machine.
+    unsigned num_threads = 0;
+    // Only re-analyze the methods whose calling context or callee summaries
+    // changed since their previous analysis.
+    bool incremental_fixpoint = false;
+    // Analyze the strongly connected components of the call graph callees
+    // first, iterating only the recursive ones, see
+    // sparta::SccInterproceduralAnalyzer. Takes precedence over
+    // incremental_fixpoint, and uses num_threads if parallel_fixpoint is set.
+    bool scc_fixpoint = false;
+    // With scc_fixpoint, the iterations of each recursive component of the
+    // call graph. The summaries of a component that did not stabilize within
+    // them are widened to top and marked "budget_exhausted" in the results. 0
+    // means max_iteration, without widening.
+    unsigned scc_budget = 0;
+    // How the results are written, see analysis_output::Format.
+    analysis_output::Format output_format =
+        analysis_output::Format::PER_CLASS_JSON;
+    // Summaries computed by previous runs, null if the cache is disabled.
+    summary_cache::SummaryCache* summary_cache = nullptr;
+  };
+  FusedUdfAnalysisPass() : Pass("FusedUdfAnalysisPass", Pass::ANALYSIS) {}
+  void bind_config() override {
+    bind("max_iteration", 10U, m_max_iteration);
+    bind("det_func_labels", "", m_det_function_labels);
+    bind("psafe_func_labels", "", m_psafe_function_labels);
+    bind("track_exception", false, m_track_exception);
+    bind("parallel_fixpoint", false, m_parallel_fixpoint);
+    bind("num_threads", 0U, m_num_threads);
+    bind("incremental_fixpoint", false, m_incremental_fixpoint);
+    bind("scc_fixpoint", false, m_scc_fixpoint);
+    bind("scc_budget", 0U, m_scc_budget);
+    bind("target_functions", "", m_target_functions);
+    bind("target_functions_only", false, m_target_functions_only);
+    bind("output_format", "json", m_output_format);
+    bind("summary_cache", "", m_summary_cache);
+    bind("telemetry", "", m_telemetry);
+    bind("telemetry_top_n", 20U, m_telemetry_top_n);
+  }
+  void band_config_functionality(AnalysisParameters& param) {
+    if (m_track_exception) {
+      TRACE(UDF_FUSED, 2, "track exception flag is on");
+      param.determinism.track_exception = true;
+      param.parallel_safety.track_exception = true;
+    }
+    param.parallel_fixpoint = m_parallel_fixpoint;
+    param.num_threads = m_num_threads;
+    param.incremental_fixpoint = m_incremental_fixpoint;
+    param.scc_fixpoint = m_scc_fixpoint;
+    param.scc_budget = m_scc_budget;
+    param.output_format = analysis_output::parse_format(m_output_format);
+  }
+  void band_config_func_labels(AnalysisParameters& param) {
+    DeterminismAnalysisPass::read_func_labels(
+        m_det_function_labels, &param.determinism.func_domain_map,
+        &param.determinism.func_reset_det_set);
+    ParallelSafetyAnalysisPass::read_func_labels(
+        m_psafe_function_labels, &param.parallel_safety.func_domain_map,
+        &param.parallel_safety.func_reset_det_set);
+  }
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+  void preload() override {
+    read_label_file(m_det_function_labels);
+    read_label_file(m_psafe_function_labels);
+    if (!m_summary_cache.empty()) {
+      summary_cache::SummaryCache::preload(m_summary_cache);
+    }
+  }
+  void run(const Scope& scope,
+           unsigned m_max_iteration,
+           AnalysisParameters param);
+  using Result = std::unordered_map<const DexMethod*, fused_udf::UdfSummary>;
+
+  std::shared_ptr<Result> get_result() { return m_result; }
+
+  void destroy_analysis_result() override { m_result = nullptr; }
+
+ private:
+  unsigned m_max_iteration;
+  std::string m_det_function_labels;
+  std::string m_psafe_function_labels;
+  bool m_track_exception = false;
+  bool m_parallel_fixpoint = false;
+  unsigned m_num_threads = 0;
+  bool m_incremental_fixpoint = false;
+  bool m_scc_fixpoint = false;
+  unsigned m_scc_budget = 0;
+  std::string m_target_functions;
+  bool m_target_functions_only = false;
+  std::string m_output_format{"json"};
+  std::string m_summary_cache;
+  // CSV file of the analyses of every method, see
+  // analysis_telemetry::MethodTelemetry. Disabled if empty.
+  std::string m_telemetry;
+  unsigned m_telemetry_top_n = 20;
+  std::unique_ptr<analysis_telemetry::MethodTelemetry> m_method_telemetry;
+
+  std::shared_ptr<Result> m_result = nullptr;
+};
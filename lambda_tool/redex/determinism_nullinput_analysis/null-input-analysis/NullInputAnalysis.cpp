@@ -24,6 +24,12 @@
 #include "FieldOpTracker.h"
 #include "Show.h"
 #include "SpartaInterprocedural.h"
+#include "UdfAnalysisRunner.h"
+#include "WorkQueue.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -32,10 +38,30 @@
 namespace {
 using namespace nullinput;
 
+struct NullInputTraits {
+  using Summary = NullInputDomain;
+  static constexpr TraceModule trace_module = UDF_NULL;
+  static constexpr const char* pass_name = "NullInputAnalysisPass";
+  static constexpr const char* suffix = "nullinput";
+  static void add_summary(const Summary& summary, Json::Value* record) {
+    (*record)["lattice"] = summary.element();
+  }
+  static uint32_t encode(const Summary& summary) { return summary.element(); }
+  static Summary decode(uint32_t element) {
+    return Summary(static_cast<NullInputType>(element));
+  }
+};
+
 using namespace sparta;
 using namespace sparta_interprocedural;
 
 constexpr const IRInstruction* CURRENT_PARTITION_LABEL = nullptr;
+
+// The parameters of the intraprocedural analysis of every method.
+IntraAnalyzerParameters intra_parameters(
+    const NullInputAnalysisPass::AnalysisParameters& /* param */) {
+  return IntraAnalyzerParameters();
+}
 // DetFieldPartition instance_fields;
 
 // Description for the analysis
@@ -59,7 +85,7 @@ struct Caller {
    */
   using Domain = PatriciaTreeMapAbstractPartition<const DexMethod*,
                                                   nullinput::CallingContext>;
-  // using Domain = nullinput::StringSetDomain;
+  // using Domain = nullinput::RegisterSetDomain;
   //     its usage is when analyze_edge during interprocedural analysis, because
   //     it needs to get entry_state_at_callee.
   // entry_state_at_dest.set(CURRENT_PARTITION_LABEL,
@@ -71,7 +97,7 @@ struct Caller {
   Domain analyze_edge(const std::shared_ptr<call_graph::Edge>& edge,
                       const Domain& exit_state_at_source) {
     
-    printf("return a default bottom domain\n");
+    TRACE(UDF_NULL, 3, "return a default bottom domain");
     return Domain::bottom(); 
   }
 };
@@ -87,28 +113,37 @@ class DeterminismFunctionAnalyzer : public Base {
   const DexMethod* m_method;
   // It store the return value anlaysis result from the intra-analyzer
   NullInputDomain m_domain;
+  // The size of the CFG and the fixpoint iterations of the last analysis.
+  sparta::FunctionAnalysisStats m_stats;
 
 
  public:
   explicit DeterminismFunctionAnalyzer(const DexMethod* method)
       : m_method(method), m_domain(NullInputDomain::top()) {}
+
+  sparta::FunctionAnalysisStats analysis_stats() const { return m_stats; }
   // This is the main function for performing intraprocedural analysis
 
   void analyze() override {
     // std::vector<std::string> function_names;
     for (int i = 0; i < this->get_analysis_parameters()->function_names.size();
          i++) {
-      printf("get_analysis_parameters check %s\n",
-             this->get_analysis_parameters()->function_names[i].c_str());
+      TRACE(UDF_NULL,
+            3,
+            "get_analysis_parameters check %s",
+            this->get_analysis_parameters()->function_names[i].c_str());
     }
     if (m_method) {
-      printf("Intra anlaysis on a function %s \n",
-             m_method->get_name()->c_str());
+      TRACE(UDF_NULL,
+            3,
+            "Intra anlaysis on a function %s",
+            m_method->get_name()->c_str());
 
     } else {
       // ghost exit or ghost entry?
-      printf(
-          "Intra anlaysis on a function that is ghost enetry or exit\n");
+      TRACE(UDF_NULL,
+            3,
+            "Intra anlaysis on a function that is ghost enetry or exit");
       return;
     }
     // This very long lambda function queries about the data flow fact after
@@ -118,15 +153,12 @@ class DeterminismFunctionAnalyzer : public Base {
         [&](const IRInstruction* insn) -> NullInputDomain {
       auto callees = call_graph::resolve_callees_in_graph(
           *this->get_call_graph(), m_method, insn);
-      auto &map = (*this->get_call_graph()).get_insn_to_callee();
-      std::cout << "size of insn->calee" << map.size()<<std::endl;
       NullInputDomain ret = NullInputDomain::bottom();
 
-      printf("now try to find summary of the callee\n");
+      TRACE(UDF_NULL, 3, "now try to find summary of the callee");
       for (const DexMethod* method : callees) {
-        auto domain =
-            this->get_summaries()->get(method, NullInputDomain::top());
-        ret.join_with(domain);
+        ret.join_with(
+            this->get_summaries()->get(method, NullInputDomain::top()));
       }
       if (ret.is_bottom()) {
         // Two possible reasons on why the return value is bottom: 1. callee is not in the graph. 2. callee returns void.
@@ -139,8 +171,17 @@ class DeterminismFunctionAnalyzer : public Base {
       return ret;
     };
     // CallerContext has the type: Callsite::Domain;
-    printf("try to get calling context\n");
+    TRACE(UDF_NULL, 3, "try to get calling context");
     auto context = this->get_caller_context()->get(m_method);
+    // Methods whose code and callee summaries did not change since a previous
+    // run keep the analysis of that run. The calling context is always bottom,
+    // see Caller, so it is not part of the inputs.
+    udf_analysis::CachedAnalysis<NullInputTraits> cached_analysis(
+        this->get_analysis_parameters()->summary_cache, m_method, {}, query_fn);
+    if (auto cached = cached_analysis.reuse()) {
+      m_domain = *cached;
+      return;
+    }
     // if (context.is_bottom()) {
     //   printf("in analysis.cpp, encounter a default bottom context\n");
     // } else {
@@ -150,19 +191,22 @@ class DeterminismFunctionAnalyzer : public Base {
     // Flow-insensitive Intraprocedural anlaysis is performed when the analysis
     // is initialized. I think it should use the registry member varaible in the
     // class of Intraprocedural base
-    printf("enter intra analysis\n");
-    IntraAnalyzerParameters ap;
+    TRACE(UDF_NULL, 3, "enter intra analysis");
+    auto ap = intra_parameters(*this->get_analysis_parameters());
     nullinput::NullInputAnalysis analysis(const_cast<DexMethod*>(m_method),ap, &context, &query_fn);
-    printf("finish intra analysis\n");                                          
+    TRACE(UDF_NULL, 3, "finish intra analysis");
+    m_stats.num_nodes = analysis.get_num_blocks();
+    m_stats.num_iterations = analysis.get_num_iterations();
     // After intra analysis is done, we need to update the following things:
     // 1. Use the intraprocedural result to update m_domain, which later (in summarize()) will be
     //    used to update registry (function summary)
     // the initial assumption of the function result is top. So we refine it
     // using the meet operator.
     m_domain.meet_with(analysis.get_nullinput_result());
+    cached_analysis.store(m_domain);
 
     // std::cout << "get the return value is" << m_domain << std::endl;
-    printf("now try to update the calling context\n");
+    TRACE(UDF_NULL, 3, "now try to update the calling context");
     // 2. Update the calling context
     // auto partition = analysis.get_calling_context_partition();
     // // this data structure is propagated in the analyze_node function
@@ -193,15 +237,18 @@ class DeterminismFunctionAnalyzer : public Base {
   }
   
   void summarize() override {
-    printf("m_intraprocedural finish analyze(), now enter summarize()");
+    TRACE(UDF_NULL,
+          3,
+          "m_intraprocedural finish analyze(), now enter summarize()");
     if (!m_method) {
-      std::cout << "empty method nullptr, does not update registry\n";
+      TRACE(UDF_NULL, 3, "empty method nullptr, does not update registry");
       return;
     }
-    std::cout << m_method->get_name()->c_str()
-              << " finish intra analyzer, now try to update the function "
-                 "summary registry"
-              << m_domain << std::endl;
+    TRACE(UDF_NULL,
+          3,
+          "%s finish intra analyzer, now try to update the function summary registry %s",
+          m_method->get_name()->c_str(),
+          SHOW(m_domain));
     this->get_summaries()->maybe_update(m_method, [&](NullInputDomain& old) {
       if (old == m_domain) {
         // no change will be made
@@ -236,12 +283,16 @@ struct NullInputAnalysisAdaptor : public BottomUpAnalysisAdaptorBase {
   // which is sparta::HashedAbstractPartition<const IRInstruction*, ArgumentDomain>;
 };
 
-using Analysis =
-    InterproceduralAnalyzer<NullInputAnalysisAdaptor,
-                            NullInputAnalysisPass::AnalysisParameters>;
-// declare Analysis as an alias for InterproceduralAnalyzer.
-// InterproceduralAnalyzer will provide the typenames to the FunctionAnalyzer,
-// and implicitly the IntraproceduralBase
+// The callee summaries are part of the key of a cached analysis, see
+// udf_analysis::CachedAnalysis, so the configuration that remains is the one
+// of the intraprocedural analysis.
+uint64_t summary_cache_fingerprint(
+    const NullInputAnalysisPass::AnalysisParameters& param) {
+  auto ap = intra_parameters(param);
+  return summary_cache::Fingerprint("NullInputAnalysisPass")
+      .add(static_cast<uint64_t>(ap.track_exception))
+      .get();
+}
 
 } // namespace
 void NullInputAnalysisPass::run(const Scope& scope,
@@ -249,57 +300,32 @@ void NullInputAnalysisPass::run(const Scope& scope,
                                   AnalysisParameters param) {
   band_config_functionality(param);
   // field_op_tracker::FieldStatsMap field_stats = field_op_tracker::analyze(scope);
-  auto analysis = Analysis(scope, m_max_iteration, &param);
-  analysis.run();
-  m_result = std::make_shared<std::unordered_map<const DexMethod*, NullInputDomain>>();
-  std::string analysisOutputPath = getenv ("ANALYSIS_OUTPUT");
-  std::string currentdatetime = getenv("current_date_time");
-  std::unordered_map<std::string, Json::Value> final_result;
-  // Json::Value vec_result(Json::arrayValue);
-  std::cout << "now prepares print out anlaysis result to json\n";
-  for (const auto& entry : analysis.registry.get_map()) {
-    Json::Value method_entry;
-    method_entry["name"] = show(entry.first);
-    method_entry["lattice"] = entry.second.element();
-    std::string class_name = ((entry.first)->get_class())->c_str();
-    class_name.pop_back();
-    std::string delimiter = "/";
-    std::string abb_class_name(class_name.substr(class_name.rfind("/") + 1));
-    // vec_result.append(method_entry);
-    std::cout << "print analysis result" << show(entry.first) << " -> "
-              << entry.second.element() << std::endl;
-    auto got = final_result.find(abb_class_name);
-    if (got == final_result.end()) {
-      // first method of the class encountered
-      Json::Value vec_result(Json::arrayValue);
-      vec_result.append(method_entry);
-      final_result.insert(make_pair(abb_class_name, vec_result));
-
-    } else {
-      got->second.append(method_entry);
-    }
-  }
-  for (auto itr: final_result) {
-    std::string outputJsonFile;
-    if (strcmp(currentdatetime.c_str(), "") == 0) {
-      outputJsonFile = analysisOutputPath + "/" + itr.first + "_" + "nullinput.json";
-    } else {
-      outputJsonFile = analysisOutputPath + "/" + currentdatetime + "/" + itr.first + "_" + "nullinput.json";
-    }
-    std::cout << "current date time is" << ";" << currentdatetime << ";"  << outputJsonFile << std::endl;
-    remove(outputJsonFile.c_str());
-    std::ofstream o(outputJsonFile, std::ios_base::app);
-    std::cout << outputJsonFile << std::endl;
-    o << std::setw(4) << itr.second << std::endl;
+  auto cache = udf_analysis::load_summary_cache(
+      scope, m_summary_cache, summary_cache_fingerprint(param));
+  param.summary_cache = cache.get();
+  auto program = target_functions::program_of(scope, param.function_names,
+                                              param.target_functions_only);
+  if (param.target_functions_only) {
+    TRACE(UDF_NULL, 1, "Analyzing the callees of %zu target functions",
+          program.roots.size());
   }
-
-
-
+  m_method_telemetry =
+      m_telemetry.empty()
+          ? nullptr
+          : std::make_unique<analysis_telemetry::MethodTelemetry>();
+  udf_analysis::Options options;
+  options.summary_cache = cache.get();
+  options.summary_cache_path = m_summary_cache;
+  options.telemetry = m_method_telemetry.get();
+  options.telemetry_path = m_telemetry;
+  options.telemetry_top_n = m_telemetry_top_n;
+  m_result = udf_analysis::run<NullInputAnalysisAdaptor, NullInputTraits>(
+      program, m_max_iteration, &param, options);
 }
 
 void NullInputAnalysisPass::run_pass(DexStoresVector& stores,
                                        ConfigFiles& /* conf */,
-                                       PassManager& /* pm */) {
+                                       PassManager& pm) {
 
   // read m_target_functions file
   // std::vector<std::vector<std::string>> content;
@@ -346,6 +372,8 @@ void NullInputAnalysisPass::run_pass(DexStoresVector& stores,
 //   TRACE(MDA, 1, "[return max depth analysis]  %s\n",
 //         "target function read done");
   AnalysisParameters param;
+  param.function_names = target_functions::read(m_target_functions);
+  param.target_functions_only = m_target_functions_only;
 //   for (int i = 0; i < content.size(); i++) {
 //     printf("add target function name %s\n", content[i].c_str());
 //     param.function_names.push_back(content[i]);
@@ -369,6 +397,9 @@ void NullInputAnalysisPass::run_pass(DexStoresVector& stores,
 //   // using Scope = std::vector<DexClass*>;
   Scope analyze_scope = build_class_scope(stores);
   run(analyze_scope, m_max_iteration, param);
+  if (m_method_telemetry) {
+    m_method_telemetry->report(name(), pm);
+  }
 }
 
 static NullInputAnalysisPass s_pass;
@@ -8,10 +8,14 @@
 #pragma once
 
 #include <unordered_map>
+#include "AnalysisOutput.h"
+#include "AnalysisTelemetry.h"
 #include "NullInputAnalysisIntra.h"
 #include "NullInputAnalysis.h"
 #include "DexClass.h"
 #include "Pass.h"
+#include "SummaryCache.h"
+#include "TargetFunctions.h"
 #include <fstream>
 #include <iostream>
 class NullInputAnalysisPass : public Pass {
@@ -19,10 +23,46 @@ class NullInputAnalysisPass : public Pass {
   struct AnalysisParameters {
     // For analyzing a subset of functions
     std::vector<std::string> function_names;
+    // Only analyze function_names and their transitive callees, see
+    // target_functions::program_of.
+    bool target_functions_only = false;
+    // Run the call graph fixpoint on a ParallelMonotonicFixpointIterator.
+    bool parallel_fixpoint = false;
+    // Number of worker threads, 0 means the default for this machine.
+    unsigned num_threads = 0;
+    // Only re-analyze the methods whose calling context or callee summaries
+    // changed since their previous analysis.
+    bool incremental_fixpoint = false;
+    // Analyze the strongly connected components of the call graph callees
+    // first, iterating only the recursive ones, see
+    // sparta::SccInterproceduralAnalyzer. Takes precedence over
+    // incremental_fixpoint, and uses num_threads if parallel_fixpoint is set.
+    bool scc_fixpoint = false;
+    // With scc_fixpoint, the iterations of each recursive component of the
+    // call graph. The summaries of a component that did not stabilize within
+    // them are widened to top and marked "budget_exhausted" in the results. 0
+    // means max_iteration, without widening.
+    unsigned scc_budget = 0;
+    // How the results are written, see analysis_output::Format.
+    analysis_output::Format output_format =
+        analysis_output::Format::PER_CLASS_JSON;
+    // Summaries computed by previous runs, null if the cache is disabled.
+    summary_cache::SummaryCache* summary_cache = nullptr;
   };
   NullInputAnalysisPass() : Pass("NullInputAnalysisPass", Pass::ANALYSIS) {}
   void bind_config() override {
     bind("max_iteration", 10U, m_max_iteration);
+    bind("parallel_fixpoint", false, m_parallel_fixpoint);
+    bind("num_threads", 0U, m_num_threads);
+    bind("incremental_fixpoint", false, m_incremental_fixpoint);
+    bind("scc_fixpoint", false, m_scc_fixpoint);
+    bind("scc_budget", 0U, m_scc_budget);
+    bind("target_functions", "", m_target_functions);
+    bind("target_functions_only", false, m_target_functions_only);
+    bind("output_format", "json", m_output_format);
+    bind("summary_cache", "", m_summary_cache);
+    bind("telemetry", "", m_telemetry);
+    bind("telemetry_top_n", 20U, m_telemetry_top_n);
     // bind("track_exception", false, m_track_exception);
 
     // printf("print banding %s", m_func_name.c_str());
@@ -32,9 +72,20 @@ class NullInputAnalysisPass : public Pass {
     //   std::cout << "track exception flag is on\n";
     //   param.track_exception = true;
     // }
+    param.parallel_fixpoint = m_parallel_fixpoint;
+    param.num_threads = m_num_threads;
+    param.incremental_fixpoint = m_incremental_fixpoint;
+    param.scc_fixpoint = m_scc_fixpoint;
+    param.scc_budget = m_scc_budget;
+    param.output_format = analysis_output::parse_format(m_output_format);
   }
   
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+  void preload() override {
+    if (!m_summary_cache.empty()) {
+      summary_cache::SummaryCache::preload(m_summary_cache);
+    }
+  }
   // this ise useful for writing unit tests
   void run(DexMethod* method, XStoreRefs* xstores);
   void run(const Scope& scope,
@@ -49,6 +100,20 @@ class NullInputAnalysisPass : public Pass {
 
  private:
   unsigned m_max_iteration;
+  bool m_parallel_fixpoint = false;
+  unsigned m_num_threads = 0;
+  bool m_incremental_fixpoint = false;
+  bool m_scc_fixpoint = false;
+  unsigned m_scc_budget = 0;
+  std::string m_output_format{"json"};
+  std::string m_summary_cache;
+  // CSV file of the analyses of every method, see
+  // analysis_telemetry::MethodTelemetry. Disabled if empty.
+  std::string m_telemetry;
+  unsigned m_telemetry_top_n = 20;
+  std::unique_ptr<analysis_telemetry::MethodTelemetry> m_method_telemetry;
+  std::string m_target_functions;
+  bool m_target_functions_only = false;
 
   std::vector<std::string> vectors_m_target_functions;
 
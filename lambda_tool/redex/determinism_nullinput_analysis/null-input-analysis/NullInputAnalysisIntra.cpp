@@ -5,6 +5,7 @@
 #include <boost/optional.hpp>
 
 #include "BaseIRAnalyzer.h"
+#include "CFGCache.h"
 #include "ControlFlow.h"
 #include "DexMethodHandle.h"
 #include "FiniteAbstractDomain.h"
@@ -17,11 +18,6 @@
 #include "Show.h"
 #include "Trace.h"
 namespace nullinput {
-NullInputLattice nullinput_lattice({BOTTOM, SAT, UNSAT, TOP},
-                       {{BOTTOM, SAT},
-                        {BOTTOM, UNSAT},
-                        {SAT, TOP},
-                        {UNSAT, TOP}});
 std::ostream& operator<<(std::ostream& output,
                          const NullInputDomain& detDomain) {
   switch (detDomain.element()) {
@@ -54,19 +50,20 @@ using namespace ir_analyzer;
 //                                           ReturnValueDomain,
 //                                           CallingContextMap,
 //                                           DetFieldPartition>
-class Analyzer final : public BaseIRAnalyzer<StringSetDomain> {
+// The transfer functions of the analysis of a method, run by an Analyzer, or
+// by a fixpoint shared with other analyses of the method.
+class Transfer final {
  public:
-  explicit Analyzer(const DexMethod* dex_method,
+  explicit Transfer(const DexMethod* dex_method,
                     const cfg::ControlFlowGraph& cfg,
                     SummaryQueryFn* summary_query_fn,
                     IntraAnalyzerParameters ap)
-      : BaseIRAnalyzer(cfg),
-        m_dex_method(dex_method),
+      : m_dex_method(dex_method),
         m_cfg(cfg),
         m_summary_query_fn(summary_query_fn),
         m_ap(ap) {}
 
-  void run(CallingContext* context) {
+  RegisterSetDomain initial_state(CallingContext* context) const {
     // We need to compute the initial environment by assigning the parameter
     // registers their correct abstract domain derived from the method's
     // signature.
@@ -79,9 +76,9 @@ class Analyzer final : public BaseIRAnalyzer<StringSetDomain> {
     // type being String. Also for CLASSes, the exact Java type they refer to is
     // not available here.
     
-    auto init_state = StringSetDomain::bottom();
+    auto init_state = RegisterSetDomain::bottom();
     
-    std::cout << "init state is bottom:" << init_state.is_bottom() << std::endl;
+    TRACE(UDF_NULL, 5, "init state is bottom: %s", SHOW(init_state.is_bottom()));
 
 
     // Get function signature
@@ -89,23 +86,24 @@ class Analyzer final : public BaseIRAnalyzer<StringSetDomain> {
         m_dex_method->get_proto()->get_args()->get_type_list();
     auto sig_it = signature.begin();
 
-    std::cout << "testsignature size is" << signature.size() << std::endl;
+    TRACE(UDF_NULL, 5, "testsignature size is %s", SHOW(signature.size()));
     // debug_context(context);
-    printf("******done processing parameters\n");
+    TRACE(UDF_NULL, 5, "******done processing parameters");
     // std::cout << "Debug arrary_object" << d_ins->dest()
     //           << init_state.get_abstract_obj(d_ins->dest()) << std::endl;
-    printf("******begin fixpoint iterator on cfg run\n");
-    // run is a method inherit from the BaseIRAnalyzer
-    MonotonicFixpointIterator::run(init_state);
-    printf("******done fixpoint iterator run\n");
-    printf("******collect return state starts\n");
+    return init_state;
+  }
+
+  void finish(const RegisterSetDomain& exit_state) {
+    TRACE(UDF_NULL, 5, "******collect return state starts");
+    m_exit_state = exit_state;
     
 
     // auto env = MonotonicFixpointIterator::get_exit_state_at(m_cfg.exit_block());
     // m_return_value = env.get_return_value();
     // std::cout << "exit state return value domain: " << env.get_return_value() << std::endl;
 
-    printf("******collect return state finishes\n");
+    TRACE(UDF_NULL, 5, "******collect return state finishes");
 
     // auto env = MonotonicFixpointIterator::get_exit_state_at(m_cfg.exit_block());
     // std::cout << env.get_return_value() << std::endl;
@@ -124,8 +122,8 @@ class Analyzer final : public BaseIRAnalyzer<StringSetDomain> {
   }
  
   void analyze_node(const cfg::GraphInterface::NodeId& node,
-                    StringSetDomain* current_state) const override {
-    std::cout<< "analyzing node in self-definied mode" <<std::endl;
+                    RegisterSetDomain* current_state) const {
+    TRACE(UDF_NULL, 5, "analyzing node in self-definied mode");
     // if this node is an exception handling block, we add it to the
     // ExpBlockPartition that tracks exception information
     // IRInstruction* insn = node->get_last_insn();
@@ -141,14 +139,20 @@ class Analyzer final : public BaseIRAnalyzer<StringSetDomain> {
     auto last_insn = last_it->insn;
     auto first_op = first_insn->opcode();
     auto last_op = last_insn->opcode();
-    std::cout << "debug first and last insn" << show(first_insn) << show(last_insn) << std::endl; 
+    TRACE(UDF_NULL,
+          5,
+          "debug first and last insn %s %s",
+          SHOW(first_insn),
+          SHOW(last_insn)); 
     if (first_op != OPCODE_GOTO && first_op != OPCODE_IF_EQZ && first_op != OPCODE_IF_NEZ) {
       if (last_op != OPCODE_RETURN_OBJECT) {
         if ((last_op == OPCODE_IF_EQZ || last_op == OPCODE_IF_NEZ) && (first_op == IOPCODE_LOAD_PARAM || first_op == IOPCODE_LOAD_PARAM_OBJECT)) {
           // this is the first null check block
           first_node = true;
         } else {
-          std::cout << "this block is not pure null check, so erase previous state\n";
+          TRACE(UDF_NULL,
+                5,
+                "this block is not pure null check, so erase previous state");
           if (!current_state->is_bottom()) {
             current_state->set_to_bottom();
           }
@@ -156,18 +160,22 @@ class Analyzer final : public BaseIRAnalyzer<StringSetDomain> {
         }
 
       } else {
-        std::cout << "encounter a return reg block\n";
+        TRACE(UDF_NULL, 5, "encounter a return reg block");
         // if (!first_insn->has_literal()) {
         //   not_reached_log("the instruction does not have a literal\n");
         // }
         if (first_op == OPCODE_CONST && first_insn->has_literal()&& first_insn->get_literal() == 0) {
-          std::cout << "encounter a return null block\n";
-          std::cout << show(first_insn) << std::endl;
+          TRACE(UDF_NULL, 5, "encounter a return null block");
+          TRACE(UDF_NULL, 5, "%s", SHOW(first_insn));
         } else if (first_op == OPCODE_RETURN_OBJECT) {
-          std::cout << "encounter a return null block that only has 1 instruction\n";
+          TRACE(UDF_NULL,
+                5,
+                "encounter a return null block that only has 1 instruction");
         } else {
-            std::cout << "does not encounter a return null block, print first instruction for debugging\n";
-            std::cout << show(first_insn) << std::endl;
+            TRACE(UDF_NULL,
+                  5,
+                  "does not encounter a return null block, print first instruction for debugging");
+            TRACE(UDF_NULL, 5, "%s", SHOW(first_insn));
             current_state->set_to_bottom();
         }
         
@@ -180,21 +188,26 @@ class Analyzer final : public BaseIRAnalyzer<StringSetDomain> {
       // reg==null
       // for each predecessor, we verify if its edge correspond to the true path
       // for reg == null
-    std::cout << "encounter a possible null check block\n";
+    TRACE(UDF_NULL, 5, "encounter a possible null check block");
     
     if (!current_state->is_bottom()) {
-      std::cout << "null check on predecessor's\n";
-      auto anchors = current_state->elements();
+      TRACE(UDF_NULL, 5, "null check on predecessor's");
       for (auto p: node->preds()) {
         auto src_node = p->src();
         auto src_last_insn = src_node->get_last_insn()->insn;
         auto src_last_insn_op = src_last_insn->opcode();
-        auto last_reg_name = DexString::make_string(std::to_string(src_last_insn->src(0)));
+        reg_t last_reg = src_last_insn->src(0);
         auto edge = p;
         if (src_last_insn_op != OPCODE_IF_EQZ && src_last_insn_op != OPCODE_IF_NEZ) {
-          std::cout << "predecessor's last insn is" << show(src_last_insn) << std::endl;
-          std::cout << "the predecessor's branch is not from null check, remove the reg from the current state" << last_reg_name << std::endl;
-          current_state->remove(last_reg_name);
+          TRACE(UDF_NULL,
+                5,
+                "predecessor's last insn is %s",
+                SHOW(src_last_insn));
+          TRACE(UDF_NULL,
+                5,
+                "the predecessor's branch is not from null check, remove the reg from the current state %u",
+                last_reg);
+          current_state->remove(last_reg);
         }
         switch (src_last_insn_op) {
           // check if the edge takes the reg == null branch. if not, remove
@@ -208,40 +221,44 @@ class Analyzer final : public BaseIRAnalyzer<StringSetDomain> {
               break;
             }
           default: 
-            std::cout << "the edge is false for reg == null branch, remove the reg from the current state\n";
-            current_state->remove(last_reg_name);
+            TRACE(UDF_NULL,
+                  5,
+                  "the edge is false for reg == null branch, remove the reg from the current state");
+            current_state->remove(last_reg);
         }
-        std::cout << "finish examine predecessors, now debug current state\n";
+        TRACE(UDF_NULL,
+              5,
+              "finish examine predecessors, now debug current state");
       }
     }
     if (first_node) {
-      std::cout << "process first node of the cfg\n";
+      TRACE(UDF_NULL, 5, "process first node of the cfg");
 
       // for first node, do 2 things:
       // 1. create a vector to store function parameters
       // done in populate_environment
       // 2. add reg to current_state 
-      auto reg_name = DexString::make_string(std::to_string(last_insn->src(0)));
-      std::cout << "add reg" << show(reg_name) << "\n";
+      reg_t reg = last_insn->src(0);
+      TRACE(UDF_NULL, 5, "add reg %u", reg);
       if (current_state->is_bottom()) {
-        current_state->join_with(StringSetDomain());
+        current_state->join_with(RegisterSetDomain());
       }
-      current_state->add(reg_name);
-      debug_stringset(*current_state);
+      current_state->add(reg);
+      debug_register_set(*current_state);
     } else {
       // now, we add possible reg to the current_state
       if (first_op == OPCODE_GOTO) {
         // do nothing, goto just preserve the state
-        std::cout << "go to just preserve the state\n";
+        TRACE(UDF_NULL, 5, "go to just preserve the state");
       } else {
         // add the register that is being compared to the current state
-        auto reg_name = DexString::make_string(std::to_string(first_insn->src(0)));
-        std::cout << "add reg" << show(reg_name) << "\n";
+        reg_t reg = first_insn->src(0);
+        TRACE(UDF_NULL, 5, "add reg %u", reg);
         if (current_state->is_bottom()) {
-          current_state->join_with(StringSetDomain());
+          current_state->join_with(RegisterSetDomain());
         }
-        current_state->add(reg_name);
-        debug_stringset(*current_state);
+        current_state->add(reg);
+        debug_register_set(*current_state);
       }
     }
     
@@ -274,35 +291,34 @@ class Analyzer final : public BaseIRAnalyzer<StringSetDomain> {
     }
     
   }
-  void analyze_instruction(
-      const IRInstruction* insn,
-      StringSetDomain* current_state) const override {
-    printf("process instructions %s\n", SHOW(insn));
-    std::cout << "--- instruction analysis end ---\n";
+  void analyze_instruction(const IRInstruction* insn,
+                           RegisterSetDomain* current_state) const {
+    TRACE(UDF_NULL, 5, "process instructions %s", SHOW(insn));
+    TRACE(UDF_NULL, 5, "--- instruction analysis end ---");
   }
 
-  StringSetDomain get_return_value() {
-    std::cout << "get return value\n";
+  RegisterSetDomain get_return_value() {
+    TRACE(UDF_NULL, 5, "get return value");
     auto result = get_exit_state();
-    debug_stringset(result);
+    debug_register_set(result);
 
     return result;
     // return m_return_value; 
   }
-  std::vector<DexString*> get_parametersset() {
+  const std::vector<reg_t>& get_parametersset() const {
     return m_parameters;
   }
 
-  StringSetDomain get_exit_state() const {
-    return get_exit_state_at(m_cfg.exit_block());
-  }
-  
+  RegisterSetDomain get_exit_state() const { return m_exit_state; }
+
+  const cfg::ControlFlowGraph& cfg() const { return m_cfg; }
+
  private:
   const DexMethod* m_dex_method;
   const cfg::ControlFlowGraph& m_cfg;
-  std::unordered_map<IRInstruction*, StringSetDomain> m_environments;
-  std::vector<DexString*> m_parameters;
-  mutable StringSetDomain m_return_value;
+  RegisterSetDomain m_exit_state{RegisterSetDomain::bottom()};
+  std::vector<reg_t> m_parameters;
+  mutable RegisterSetDomain m_return_value;
   std::unordered_set<std::string>* m_reset_det_func;
   IntraAnalyzerParameters m_ap;
 
@@ -310,7 +326,7 @@ class Analyzer final : public BaseIRAnalyzer<StringSetDomain> {
   SummaryQueryFn* m_summary_query_fn;
 
   void default_semantics(const IRInstruction* insn,
-                         StringSetDomain* current_state) const {
+                         RegisterSetDomain* current_state) const {
     // For instructions that are transparent for this analysis, we just need to
     // clobber the destination registers in the abstract environment. Note that
     // this also covers the MOVE_RESULT_* and MOVE_RESULT_PSEUDO_* instructions
@@ -344,71 +360,84 @@ class Analyzer final : public BaseIRAnalyzer<StringSetDomain> {
     // }
   }
 
-  // After the fixpoint iteration completes, we replay the analysis on all
-  // blocks and we cache the abstract state at each instruction. This cache is
-  // used by get_abstract_object() to query the state of a register at a given
-  // instruction. Since we use an abstract domain based on Patricia trees, the
-  // memory footprint of storing the abstract state at each program point is
-  // small.
+  // After the fixpoint iteration completes, we collect the registers of the
+  // parameters of the method, i.e., all but `this`.
   void populate_environments(const cfg::ControlFlowGraph& cfg) {
-    // We reserve enough space for the map in order to avoid repeated
-    // rehashing during the computation.
-    printf("enter populate_env, populate parameter set\n");
+    TRACE(UDF_NULL, 5, "enter populate_env, populate parameter set");
     param_index_t param_position = 0;
     for (const auto& mie :
            InstructionIterable(cfg.get_param_instructions())) {
       IRInstruction* insn = mie.insn;
-      printf("process load param %s\n", SHOW(insn));
+      TRACE(UDF_NULL, 5, "process load param %s", SHOW(insn));
       if (insn->opcode() == IOPCODE_LOAD_PARAM || insn->opcode() == IOPCODE_LOAD_PARAM_OBJECT || insn->opcode() == IOPCODE_LOAD_PARAM_WIDE) {
         // if (insn->srcs_size() > 0) {
         if (param_position == 0 && !is_static(m_dex_method)) {
           // the first parameter correspond to 'this', not parameter
         } else {
-          auto parameter_register_name = DexString::make_string(std::to_string(insn->dest()));
-          m_parameters.push_back(parameter_register_name);
+          m_parameters.push_back(insn->dest());
         }
         param_position++;
       }
     }
 
   }
-    // m_environments.reserve(cfg.blocks().size() * 16);
-    // for (cfg::Block* block : cfg.blocks()) {
-    //   StringSetDomain current_state = get_entry_state_at(block);
-    //   for (auto& mie : InstructionIterable(block)) {
-    //     IRInstruction* insn = mie.insn;
-    //     m_environments.emplace(insn, current_state);
-    //     analyze_instruction(insn, &current_state);
-    //   }
-    // }
 
-  void debug_stringset(StringSetDomain s) const{
+  void debug_register_set(const RegisterSetDomain& s) const {
     // By design, the analysis can't generate the Top value.
     always_assert(!s.is_top());
     if (s.is_bottom()) {
       // This means that some code in the method is unreachable.
-      std::cout << "string set is bottom\n";
+      TRACE(UDF_NULL, 5, "register set is bottom");
+      return;
+    }
+    if (!traceEnabled(UDF_NULL, 5)) {
       return;
     }
     auto anchors = s.elements();
     if (anchors.empty()) {
       // The denotation of the anchor set is just the `null` reference. This is
       // represented by a special points-to variable.
-      std::cout << "string set is empty\n";
+      TRACE(UDF_NULL, 5, "register set is empty");
       return;
     } else {
-        std::cout << "string set is not empty\n";
+        TRACE(UDF_NULL, 5, "register set is not empty");
 
-        for (const DexString* e: anchors) {
-            std::cout << e->c_str() << ";";
+        for (reg_t e : anchors) {
+            TRACE(UDF_NULL, 5, "%u;", e);
         }
-        std::cout << std::endl;
 
     }
   }
 
 };
 
+// Runs the fixpoint of a Transfer over the CFG of its method.
+class Analyzer final : public BaseIRAnalyzer<RegisterSetDomain> {
+ public:
+  Analyzer(Transfer* transfer, sparta::Arena* arena)
+      : BaseIRAnalyzer(transfer->cfg(), arena), m_transfer(transfer) {}
+
+  void run(CallingContext* context) {
+    TRACE(UDF_NULL, 5, "******begin fixpoint iterator on cfg run");
+    MonotonicFixpointIterator::run(m_transfer->initial_state(context));
+    TRACE(UDF_NULL, 5, "******done fixpoint iterator run");
+    m_transfer->finish(get_exit_state_at(m_transfer->cfg().exit_block()));
+  }
+
+  void analyze_node(const cfg::GraphInterface::NodeId& node,
+                    RegisterSetDomain* current_state) const override {
+    m_transfer->analyze_node(node, current_state);
+  }
+
+  void analyze_instruction(const IRInstruction* insn,
+                           RegisterSetDomain* current_state) const override {
+    m_transfer->analyze_instruction(insn, current_state);
+  }
+
+ private:
+  Transfer* m_transfer;
+};
+
 } // namespace impl
 
 NullInputAnalysis::~NullInputAnalysis() {
@@ -420,67 +449,73 @@ NullInputAnalysis::NullInputAnalysis(
     IntraAnalyzerParameters ap,
     CallingContext* context,
     SummaryQueryFn* summary_query_fn)
+    : NullInputAnalysis(Deferred(), dex_method, ap, summary_query_fn) {
+  if (m_transfer == nullptr) {
+    return;
+  }
+  m_analyzer = std::make_unique<impl::Analyzer>(m_transfer.get(), &m_arena);
+  TRACE(UDF_NULL, 5, "enter m_analyzer->run(context)");
+  m_analyzer->run(context);
+  // m_analyzer->get_analysis_result();
+}
+
+NullInputAnalysis::NullInputAnalysis(Deferred,
+                                     DexMethod* dex_method,
+                                     IntraAnalyzerParameters ap,
+                                     SummaryQueryFn* summary_query_fn)
     : m_dex_method(dex_method), m_ap(ap) {
   always_assert(dex_method != nullptr);
   IRCode* code = dex_method->get_code();
   if (code == nullptr) {
     return;
   }
-  code->build_cfg(/* editable */ false);
-  cfg::ControlFlowGraph& cfg = code->cfg();
-  cfg.calculate_exit_block();
-  m_analyzer = std::make_unique<impl::Analyzer>(
-      dex_method, cfg, summary_query_fn, m_ap);
-  printf("enter m_analyzer->run(context)\n");
-  m_analyzer->run(context);
-  // m_analyzer->get_analysis_result();
+  const cfg::ControlFlowGraph& cfg = cfg::CFGCache::instance().borrow(code);
+  m_transfer =
+      std::make_unique<impl::Transfer>(dex_method, cfg, summary_query_fn, m_ap);
+}
+
+RegisterSetDomain NullInputAnalysis::initial_state(
+    CallingContext* context) const {
+  return m_transfer->initial_state(context);
+}
+
+void NullInputAnalysis::analyze_node(cfg::Block* block,
+                                     RegisterSetDomain* current_state) const {
+  m_transfer->analyze_node(block, current_state);
+}
+
+void NullInputAnalysis::finish(const RegisterSetDomain& exit_state) {
+  m_transfer->finish(exit_state);
 }
 
-// void ReflectionAnalysis::get_reflection_site(
-//     const reg_t reg,
-//     IRInstruction* insn,
-//     std::map<reg_t, ReflectionAbstractObject>* abstract_objects) const {
-//   auto aobj = m_analyzer->get_abstract_object(reg, insn);
-//   if (!aobj) {
-//     return;
-//   }
-//   if (is_not_reflection_output(*aobj)) {
-//     return;
-//   }
-//   boost::optional<ClassObjectSource> cls_src =
-//       aobj->obj_kind == AbstractObjectKind::CLASS
-//           ? m_analyzer->get_class_source(reg, insn)
-//           : boost::none;
-//   if (aobj->obj_kind == AbstractObjectKind::CLASS &&
-//       cls_src == ClassObjectSource::NON_REFLECTION) {
-//     return;
-//   }
-//   if (traceEnabled(REFL, 5)) {
-//     std::ostringstream out;
-//     out << "reg " << reg << " " << *aobj << " ";
-//     if (cls_src) {
-//       out << *cls_src;
-//     }
-//     out << std::endl;
-//     TRACE(REFL, 5, " reflection site: %s", out.str().c_str());
-//   }
-//   (*abstract_objects)[reg] = ReflectionAbstractObject(*aobj, cls_src);
-// }
+size_t NullInputAnalysis::get_num_blocks() const {
+  if (!m_transfer) {
+    return 0;
+  }
+  return m_dex_method->get_code()->cfg().num_blocks();
+}
+
+uint32_t NullInputAnalysis::get_num_iterations() const {
+  if (!m_analyzer) {
+    return 0;
+  }
+  return m_analyzer->get_num_iterations();
+}
 
 NullInputDomain NullInputAnalysis::get_nullinput_result() const {
-  std::cout << "invoke get_nullinput_result\n";
+  TRACE(UDF_NULL, 5, "invoke get_nullinput_result");
   NullInputDomain result = NullInputDomain::bottom();
-  StringSetDomain parameterset = StringSetDomain();
+  RegisterSetDomain parameterset = RegisterSetDomain();
   auto code = m_dex_method->get_code();
   if (code == nullptr) {
     return result;
   }
-  auto nullinput_regs = m_analyzer->get_return_value();
-  auto parameters = m_analyzer->get_parametersset();
+  auto nullinput_regs = m_transfer->get_return_value();
+  const auto& parameters = m_transfer->get_parametersset();
   parameterset.add(parameters.begin(), parameters.end());
-  std::cout << "debug parameters set\n";
+  TRACE(UDF_NULL, 5, "debug parameters set");
   for (auto item: parameters) {
-    std::cout << show(*item);
+    TRACE(UDF_NULL, 5, "%u", item);
   }
   if (nullinput_regs.equals(parameterset)) {
     result.join_with(NullInputDomain(NullInputType::SAT));
@@ -490,55 +525,23 @@ NullInputDomain NullInputAnalysis::get_nullinput_result() const {
   } else {
     result.join_with(NullInputDomain(NullInputType::UNSAT));
   }
-  std::cout <<m_dex_method->c_str()<< "get nullinput result is" << result << std::endl;
+  TRACE(UDF_NULL,
+        5,
+        "%s get nullinput result is %s",
+        m_dex_method->c_str(),
+        SHOW(result));
   return result;
 }
 
-StringSetDomain NullInputAnalysis::get_null_check_result_null() const {
-  std::cout << "get return value from the m_analyzer()\n";
-  if (!m_analyzer) {
+RegisterSetDomain NullInputAnalysis::get_null_check_result_null() const {
+  TRACE(UDF_NULL, 5, "get return value from the m_transfer()");
+  if (!m_transfer) {
     // Method has no code, or is a native method.
-    return StringSetDomain::top();
+    return RegisterSetDomain::top();
   }
-  return m_analyzer->get_return_value();
+  return m_transfer->get_return_value();
 }
 
-// boost::optional<std::vector<DexType*>> ReflectionAnalysis::get_method_params(
-//     IRInstruction* invoke_insn) const {
-//   auto code = m_dex_method->get_code();
-//   IRInstruction* move_result_insn = nullptr;
-//   auto ii = InstructionIterable(code);
-//   for (auto it = ii.begin(); it != ii.end(); ++it) {
-//     auto* insn = it->insn;
-//     if (insn == invoke_insn) {
-//       move_result_insn = std::next(it)->insn;
-//       break;
-//     }
-//   }
-//   if (!move_result_insn ||
-//       !opcode::is_a_move_result(move_result_insn->opcode())) {
-//     return boost::none;
-//   }
-//   auto arg_param = get_abstract_object(RESULT_REGISTER, move_result_insn);
-//   if (!arg_param ||
-//       arg_param->obj_kind != reflection::AbstractObjectKind::METHOD) {
-//     return boost::none;
-//   }
-//   return arg_param->dex_type_array;
-// }
-
-// bool ReflectionAnalysis::has_found_reflection() const {
-//   return !get_reflection_sites().empty();
-// }
-
-// boost::optional<AbstractObject> ReflectionAnalysis::get_abstract_object(
-//     size_t reg, IRInstruction* insn) const {
-//   if (m_analyzer == nullptr) {
-//     return boost::none;
-//   }
-//   return m_analyzer->get_abstract_object(reg, insn);
-// }
-
 CallingContextMap NullInputAnalysis::get_calling_context_partition() const {
   return CallingContextMap::top();
 
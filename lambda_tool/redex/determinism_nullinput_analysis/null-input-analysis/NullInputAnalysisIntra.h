@@ -26,16 +26,13 @@
 #include "PatriciaTreeMapAbstractPartition.h"
 #include "DexClass.h"
 #include "ReducedProductAbstractDomain.h"
+#include "UdfAnalysisTypes.h"
 #include <iostream>
 #include "ConstantAbstractDomain.h"
-#include "PatriciaTreeSetAbstractDomain.h"
+#include "BitSetAbstractDomain.h"
 
 using namespace sparta;
 
-struct IntraAnalyzerParameters {
-    bool track_exception = false;
-};  
-
 enum NullInputType { BOTTOM, SAT, UNSAT, TOP };
 
 
@@ -45,15 +42,16 @@ enum class FieldType { INSTANCE, STATIC };
 
 using std::placeholders::_1;
 
-using StringDomain = sparta::ConstantAbstractDomain<const DexString*>;
-using StringSetDomain = sparta::PatriciaTreeSetAbstractDomain<const DexString*>;
-using NullInputLattice = sparta::BitVectorLattice<NullInputType, 4, std::hash<int>>;
-extern NullInputLattice nullinput_lattice;
-using NullInputDomain = sparta::FiniteAbstractDomain<NullInputType,
-                                                       NullInputLattice,
-                                                       NullInputLattice::Encoding,
-                                                       &nullinput_lattice>;
-using CallingContext = StringSetDomain;
+// The registers compared against null along the paths to a program point.
+using RegisterSetDomain = sparta::BitSetAbstractDomain<reg_t>;
+using NullInputLattice = sparta::ConstexprLattice<NullInputType, 4>;
+inline constexpr NullInputLattice nullinput_lattice(
+    {BOTTOM, SAT, UNSAT, TOP},
+    {{BOTTOM, SAT}, {BOTTOM, UNSAT}, {SAT, TOP}, {UNSAT, TOP}});
+using NullInputDomain = sparta::ConstexprFiniteAbstractDomain<NullInputType,
+                                                              NullInputLattice,
+                                                              &nullinput_lattice>;
+using CallingContext = RegisterSetDomain;
 using CallingContextMap =
     sparta::PatriciaTreeMapAbstractEnvironment<const IRInstruction*,
                                                CallingContext>;
@@ -67,6 +65,7 @@ namespace impl {
 
 // Forward declarations.
 class Analyzer;
+class Transfer;
 
 } // namespace impl
 
@@ -85,36 +84,42 @@ class NullInputAnalysis final {
 
 explicit NullInputAnalysis(DexMethod* dex_method, IntraAnalyzerParameters ap, CallingContext* context,SummaryQueryFn* summary_query_fn = nullptr);
 
+  // Prepares the analysis without running it, for a fixpoint over the CFG of
+  // the method shared with other analyses: the caller iterates analyze_node()
+  // from initial_state(), and passes the state at the exit block to finish()
+  // before reading the results. Only for methods with code.
+  struct Deferred {};
+  NullInputAnalysis(Deferred,
+                    DexMethod* dex_method,
+                    IntraAnalyzerParameters ap,
+                    SummaryQueryFn* summary_query_fn);
 
-  StringSetDomain get_null_check_result_null() const;
+  RegisterSetDomain initial_state(CallingContext* context) const;
+  void analyze_node(cfg::Block* block, RegisterSetDomain* current_state) const;
+  void finish(const RegisterSetDomain& exit_state);
 
-  /**
-   * Return a parameter type array for this invoke method instruction.
-   */
-  boost::optional<std::vector<DexType*>> get_method_params(
-      IRInstruction* invoke_insn) const;
-  /*
-   * Returns the abstract object (if any) referenced by the register at the
-   * given instruction. Note that if the instruction overwrites the register,
-   * the abstract object returned is the value held by the register *before*
-   * that instruction is executed.
-   */
-//   boost::optional<DeterminismDomain> get_abstract_object(
-//       size_t reg, IRInstruction* insn) const;
 
-//   boost::optional<ClassObjectSource> get_class_source(
-//       size_t reg, IRInstruction* insn) const;
+  RegisterSetDomain get_null_check_result_null() const;
 
   CallingContextMap get_calling_context_partition() const;
   NullInputDomain get_nullinput_result() const;
 
+  // The number of blocks of the CFG, and of iterations of the fixpoint over
+  // its loops, see MonotonicFixpointIteratorBase::get_num_iterations(). Both
+  // are 0 if the method has no code.
+  size_t get_num_blocks() const;
+  uint32_t get_num_iterations() const;
+
 
  private:
   const DexMethod* m_dex_method;
   // This is the actual class that performs the analysis over the CFG
   // class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> 
   // class BaseIRAnalyzer : public sparta::MonotonicFixpointIterator<cfg::GraphInterface, Domain> {
-  std::unique_ptr<impl::Analyzer> m_analyzer; 
+  // The state of the analysis of the method, released at once with it.
+  sparta::Arena m_arena;
+  std::unique_ptr<impl::Transfer> m_transfer;
+  std::unique_ptr<impl::Analyzer> m_analyzer;
   IntraAnalyzerParameters m_ap;
 };
 
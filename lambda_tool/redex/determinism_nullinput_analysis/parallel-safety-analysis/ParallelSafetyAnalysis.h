@@ -9,9 +9,16 @@
 
 #include <unordered_map>
 
+#include "AnalysisOutput.h"
+#include "AnalysisTelemetry.h"
+#include "CalleeLabels.h"
 #include "ParallelSafetyAnalysisIntra.h"
 #include "DexClass.h"
 #include "Pass.h"
+#include "SummaryCache.h"
+#include "TargetFunctions.h"
+#include "Show.h"
+#include "Trace.h"
 #include <fstream>
 #include <iostream>
 class ParallelSafetyAnalysisPass : public Pass {
@@ -19,39 +26,84 @@ class ParallelSafetyAnalysisPass : public Pass {
   struct AnalysisParameters {
     // For analyzing a subset of functions
     std::vector<std::string> function_names;
+    // Only analyze function_names and their transitive callees, see
+    // target_functions::program_of.
+    bool target_functions_only = false;
     std::unordered_map<std::string, parallelsafe::DeterminismDomain>
         func_domain_map;
     std::unordered_set<std::string> func_reset_det_set;
+    // func_domain_map resolved against the scope by run().
+    CalleeLabels<parallelsafe::DeterminismDomain> callee_labels;
     bool track_exception = false;
+    // Run the call graph fixpoint on a ParallelMonotonicFixpointIterator.
+    bool parallel_fixpoint = false;
+    // Number of worker threads, 0 means the default for this machine.
+    unsigned num_threads = 0;
+    // Only re-analyze the methods whose calling context or callee summaries
+    // changed since their previous analysis.
+    bool incremental_fixpoint = false;
+    // Analyze the strongly connected components of the call graph callees
+    // first, iterating only the recursive ones, see
+    // sparta::SccInterproceduralAnalyzer. Takes precedence over
+    // incremental_fixpoint, and uses num_threads if parallel_fixpoint is set.
+    bool scc_fixpoint = false;
+    // With scc_fixpoint, the iterations of each recursive component of the
+    // call graph. The summaries of a component that did not stabilize within
+    // them are widened to top and marked "budget_exhausted" in the results. 0
+    // means max_iteration, without widening.
+    unsigned scc_budget = 0;
+    // How the results are written, see analysis_output::Format.
+    analysis_output::Format output_format =
+        analysis_output::Format::PER_CLASS_JSON;
+    // Summaries computed by previous runs, null if the cache is disabled.
+    summary_cache::SummaryCache* summary_cache = nullptr;
   };
   ParallelSafetyAnalysisPass() : Pass("ParallelSafetyAnalysisPass", Pass::ANALYSIS) {}
   void bind_config() override {
     bind("max_iteration", 10U, m_max_iteration);
     bind("m_func_lables", "", m_function_labels);
     bind("track_exception", false, m_track_exception);
+    bind("parallel_fixpoint", false, m_parallel_fixpoint);
+    bind("num_threads", 0U, m_num_threads);
+    bind("incremental_fixpoint", false, m_incremental_fixpoint);
+    bind("scc_fixpoint", false, m_scc_fixpoint);
+    bind("scc_budget", 0U, m_scc_budget);
+    bind("target_functions", "", m_target_functions);
+    bind("target_functions_only", false, m_target_functions_only);
+    bind("output_format", "json", m_output_format);
+    bind("summary_cache", "", m_summary_cache);
+    bind("telemetry", "", m_telemetry);
+    bind("telemetry_top_n", 20U, m_telemetry_top_n);
 
     // printf("print banding %s", m_func_name.c_str());
   }
   void band_config_functionality(AnalysisParameters& param) {
     if (m_track_exception) {
-      std::cout << "track exception flag is on\n";
+      TRACE(UDF_PSAFE, 2, "track exception flag is on");
       param.track_exception = true;
     }
+    param.parallel_fixpoint = m_parallel_fixpoint;
+    param.num_threads = m_num_threads;
+    param.incremental_fixpoint = m_incremental_fixpoint;
+    param.scc_fixpoint = m_scc_fixpoint;
+    param.scc_budget = m_scc_budget;
+    param.output_format = analysis_output::parse_format(m_output_format);
   }
   void band_config_func_labels(std::string filename,
                                AnalysisParameters& param) {
     // m_function_labels = filename;
-    std::vector<std::string> content;
-    std::string line, word;
-
-    std::fstream file(filename, std::ios::in);
-    if (file.is_open()) {
-      while (getline(file, line)) {
-        std::stringstream str(line);
-        while (getline(str, word, ','))
-          content.push_back(word);
-      }
-    }
+    read_func_labels(filename, &m_func_domain_map, &m_func_reset_det_set);
+    param.func_domain_map = m_func_domain_map;
+    param.func_reset_det_set = m_func_reset_det_set;
+  }
+  // Reads the name,label pairs of a function labels file. Also used by the
+  // fused UDF analysis pass.
+  static void read_func_labels(
+      const std::string& filename,
+      std::unordered_map<std::string, parallelsafe::DeterminismDomain>*
+          func_domain_map,
+      std::unordered_set<std::string>* func_reset_det_set) {
+    const auto& content = *read_label_file(filename);
     always_assert_log(content.size() % 2 == 0,
                       "the format of m_function_labels is not correct\n");
     for (int i = 0; i < content.size(); i = i + 2) {
@@ -59,26 +111,32 @@ class ParallelSafetyAnalysisPass : public Pass {
       std::string label = content[i + 1];
       if (!check_valid_label(label)) {
         if (!label.compare("FORCEDET")) {
-          m_func_reset_det_set.insert(name);
+          func_reset_det_set->insert(name);
         } else {
           not_reached_log("check the invalid label %s\n", label);
         }
       }
-      if (m_func_domain_map.count(name) == 0) {
-        printf("add funcname to m_func_domain_map");
-        m_func_domain_map[name] = return_det_domain(label);
-        std::cout << name << "\t" << label << std::endl;
+      if (func_domain_map->count(name) == 0) {
+        TRACE(UDF_PSAFE, 2, "add funcname to m_func_domain_map");
+        (*func_domain_map)[name] = return_det_domain(label);
+        TRACE(UDF_PSAFE, 2, "%s\t %s", SHOW(name), SHOW(label));
 
       } else {
         not_reached_log("duplicate function name %s\n", name);
       }
     }
-    printf("finish populating m_func_domain_map size %d",
-           m_func_domain_map.size());
-    param.func_domain_map = m_func_domain_map;
-    param.func_reset_det_set = m_func_reset_det_set;
+    TRACE(UDF_PSAFE,
+          2,
+          "finish populating m_func_domain_map size %zu",
+          func_domain_map->size());
   }
   void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+  void preload() override {
+    read_label_file(m_function_labels);
+    if (!m_summary_cache.empty()) {
+      summary_cache::SummaryCache::preload(m_summary_cache);
+    }
+  }
   // this ise useful for writing unit tests
   void run(DexMethod* method, XStoreRefs* xstores);
   void run(const Scope& scope,
@@ -94,7 +152,20 @@ class ParallelSafetyAnalysisPass : public Pass {
  private:
   unsigned m_max_iteration;
   std::string m_target_functions;
+  bool m_target_functions_only = false;
   bool m_track_exception;
+  bool m_parallel_fixpoint = false;
+  unsigned m_num_threads = 0;
+  bool m_incremental_fixpoint = false;
+  bool m_scc_fixpoint = false;
+  unsigned m_scc_budget = 0;
+  std::string m_output_format{"json"};
+  std::string m_summary_cache;
+  // CSV file of the analyses of every method, see
+  // analysis_telemetry::MethodTelemetry. Disabled if empty.
+  std::string m_telemetry;
+  unsigned m_telemetry_top_n = 20;
+  std::unique_ptr<analysis_telemetry::MethodTelemetry> m_method_telemetry;
   std::string m_function_labels;
   std::unordered_set<std::string> m_func_reset_det_set;
 
@@ -103,7 +174,7 @@ class ParallelSafetyAnalysisPass : public Pass {
   std::shared_ptr<Result> m_result = nullptr;
   std::unordered_map<std::string, parallelsafe::DeterminismDomain>
       m_func_domain_map;
-  bool check_valid_label(std::string label) {
+  static bool check_valid_label(std::string label) {
     std::set<std::string> valid_labels = {"SAFE", "TOP", "UNSAFE"};
     if (valid_labels.count(label) == 1) {
       return true;
@@ -111,7 +182,7 @@ class ParallelSafetyAnalysisPass : public Pass {
       return false;
     }
   }
-  parallelsafe::DeterminismDomain return_det_domain(std::string label) {
+  static parallelsafe::DeterminismDomain return_det_domain(std::string label) {
     if (!label.compare("SAFE")) {
       parallelsafe::DeterminismDomain obj(DeterminismType::IS_DET);
       return obj;
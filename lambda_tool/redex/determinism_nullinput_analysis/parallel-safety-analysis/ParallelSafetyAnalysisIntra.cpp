@@ -13,6 +13,7 @@
 #include <boost/optional.hpp>
 
 #include "BaseIRAnalyzer.h"
+#include "CFGCache.h"
 #include "ControlFlow.h"
 #include "DexMethodHandle.h"
 #include "FiniteAbstractDomain.h"
@@ -54,18 +55,6 @@ namespace parallelsafe {
 // const DeterminismDomain dt_bottom(DeterminismType::DT_BOTTOM);
 // const DeterminismDomain is_det(DeterminismType::IS_DET);
 // const DeterminismDomain not_det(DeterminismType::NOT_DET);
-DetLattice det_lattice({DT_BOTTOM, IS_DET, NOT_DET, DT_TOP},
-                       {{DT_BOTTOM, IS_DET},
-                        {DT_BOTTOM, NOT_DET},
-                        {IS_DET, DT_TOP},
-                        {NOT_DET, DT_TOP}});
-                        
-ExpLattice exp_lattice({EX_BOTTOM, UNVISIT, FROM_EX, NO_EX, EX_TOP},
-                       {{EX_BOTTOM, UNVISIT},
-                        {UNVISIT, FROM_EX},
-                        {UNVISIT, NO_EX},
-                        {NO_EX, EX_TOP},
-                        {FROM_EX, EX_TOP}});
 std::ostream& operator<<(std::ostream& output,
                          const DeterminismDomain& detDomain) {
   switch (detDomain.element()) {
@@ -142,21 +131,22 @@ using namespace ir_analyzer;
 //                                           ReturnValueDomain,
 //                                           CallingContextMap,
 //                                           DetFieldPartition>
-class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
+// The transfer functions of the analysis of a method, run by an Analyzer, or
+// by a fixpoint shared with other analyses of the method.
+class Transfer final {
  public:
-  explicit Analyzer(const DexMethod* dex_method,
+  explicit Transfer(const DexMethod* dex_method,
                     const cfg::ControlFlowGraph& cfg,
                     SummaryQueryFn* summary_query_fn,
                     std::unordered_set<std::string>* reset_det_func,
                     IntraAnalyzerParameters ap)
-      : BaseIRAnalyzer(cfg),
-        m_dex_method(dex_method),
+      : m_dex_method(dex_method),
         m_cfg(cfg),
         m_summary_query_fn(summary_query_fn),
         m_reset_det_func(reset_det_func),
         m_ap(ap) {}
 
-  void run(CallingContext* context) {
+  AbstractObjectEnvironment initial_state(CallingContext* context) const {
     // We need to compute the initial environment by assigning the parameter
     // registers their correct abstract domain derived from the method's
     // signature.
@@ -169,11 +159,11 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     // type being String. Also for CLASSes, the exact Java type they refer to is
     // not available here.
     auto track_exception = m_ap.track_exception;
-    std::cout << "track exception is" << track_exception << std::endl;
+    TRACE(UDF_PSAFE, 5, "track exception is %s", SHOW(track_exception));
     auto init_state = AbstractObjectEnvironment::top();
     init_state.set_abstract_obj(DeterminismDomain(DeterminismType::IS_DET));
     init_state.set_return_value(DeterminismDomain(DeterminismType::IS_DET));
-    std::cout << "init state is" << init_state.get_abstract_obj() << std::endl;
+    TRACE(UDF_PSAFE, 5, "init state is %s", SHOW(init_state.get_abstract_obj()));
 
 
     m_return_value.set_to_bottom();
@@ -182,23 +172,24 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
         m_dex_method->get_proto()->get_args()->get_type_list();
     auto sig_it = signature.begin();
 
-    std::cout << "testsignature size is" << signature.size() << std::endl;
+    TRACE(UDF_PSAFE, 5, "testsignature size is %s", SHOW(signature.size()));
     // debug_context(context);
-    printf("******done processing parameters\n");
+    TRACE(UDF_PSAFE, 5, "******done processing parameters");
     // std::cout << "Debug arrary_object" << d_ins->dest()
     //           << init_state.get_abstract_obj(d_ins->dest()) << std::endl;
-    printf("******begin fixpoint iterator on cfg run\n");
-    // run is a method inherit from the BaseIRAnalyzer
-    MonotonicFixpointIterator::run(init_state);
-    printf("******done fixpoint iterator run\n");
-    printf("******collect return state starts\n");
-    
+    return init_state;
+  }
 
-    auto env = MonotonicFixpointIterator::get_exit_state_at(m_cfg.exit_block());
+  void finish(const AbstractObjectEnvironment& env) {
+    TRACE(UDF_PSAFE, 5, "******collect return state starts");
+    m_exit_state = env;
     m_return_value = env.get_return_value();
-    std::cout << "exit state return value domain: " << env.get_return_value() << std::endl;
+    TRACE(UDF_PSAFE,
+          5,
+          "exit state return value domain: %s",
+          SHOW(env.get_return_value()));
 
-    printf("******collect return state finishes\n");
+    TRACE(UDF_PSAFE, 5, "******collect return state finishes");
 
     // auto env = MonotonicFixpointIterator::get_exit_state_at(m_cfg.exit_block());
     // std::cout << env.get_return_value() << std::endl;
@@ -212,40 +203,39 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     //                           FieldType::STATIC,
     //                           m_field_partition);
     // }
-
-    populate_environments(m_cfg);
   }
  
   void analyze_node(const cfg::GraphInterface::NodeId& node,
-                    AbstractObjectEnvironment* current_state) const override {
-    std::cout<< "analyzing node in self-definied mode" <<std::endl;
+                    AbstractObjectEnvironment* current_state) const {
+    TRACE(UDF_PSAFE, 5, "analyzing node in self-definied mode");
     // if this node is an exception handling block, we add it to the
     // ExpBlockPartition that tracks exception information
-    std::cout << "--- propagate exception information start ---\n";
+    TRACE(UDF_PSAFE, 5, "--- propagate exception information start ---");
     if (node->starts_with_move_exception()) {
       // For a basic block that is the original source of the exception, it
       // always sets the current state to FROM_EX
-      std::cout << "analyze a block that handles exception, that makes the UDF not parallel safe\n";
+      TRACE(UDF_PSAFE,
+            5,
+            "analyze a block that handles exception, that makes the UDF not parallel safe");
       current_state->set_abstract_obj(DeterminismDomain(DeterminismType::NOT_DET));
     } else {
-      std::cout << "--- propagate exception information end ---\n";
+      TRACE(UDF_PSAFE, 5, "--- propagate exception information end ---");
       for (auto& mie : InstructionIterable(node)) {
         analyze_instruction(mie.insn, current_state);
       }
     }
   }
-  void analyze_instruction(
-      const IRInstruction* insn,
-      AbstractObjectEnvironment* current_state) const override {
-    printf("process instructions %s\n", SHOW(insn));
-    std::cout << "--- instruction analysis start ---\n";
+  void analyze_instruction(const IRInstruction* insn,
+                           AbstractObjectEnvironment* current_state) const {
+    TRACE(UDF_PSAFE, 5, "process instructions %s", SHOW(insn));
+    TRACE(UDF_PSAFE, 5, "--- instruction analysis start ---");
     ReturnValueDomain callee_return; // we need this value analysis after the
                                      // invocation instruction
     callee_return.set_to_bottom();
     if (opcode::is_an_invoke(insn->opcode())) {
       if (m_summary_query_fn) {
         callee_return = (*m_summary_query_fn)(insn);
-        std::cout << "find callee return" << callee_return;
+        TRACE(UDF_PSAFE, 5, "find callee return %s", SHOW(callee_return));
         current_state->join_abstract_obj(callee_return);
       } else {
         current_state->join_abstract_obj(DeterminismDomain(DeterminismType::NOT_DET));
@@ -254,7 +244,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     }
     switch (insn->opcode()) {
     case OPCODE_CONST_STRING: {
-      printf("process constant string %s\n", SHOW(insn), insn->get_string());
+      TRACE(UDF_PSAFE, 5, "process constant string %s", SHOW(insn));
       std::string query_string = insn->get_string()->str();
       if (query_string.find("update") != std::string::npos) {
         // The update query makes the UDF parallel unsafe
@@ -268,7 +258,7 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     case OPCODE_RETURN_OBJECT: {
     }
     default: {
-      printf("process default semantics %s\n", SHOW(insn));
+      TRACE(UDF_PSAFE, 5, "process default semantics %s", SHOW(insn));
       default_semantics(insn, current_state);
       }
     }
@@ -280,17 +270,16 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     // return m_return_value; 
   }
 
-  AbstractObjectEnvironment get_exit_state() const {
-    return get_exit_state_at(m_cfg.exit_block());
-  }
-  
+  AbstractObjectEnvironment get_exit_state() const { return m_exit_state; }
+
+  const cfg::ControlFlowGraph& cfg() const { return m_cfg; }
+
  private:
   const DexMethod* m_dex_method;
   const cfg::ControlFlowGraph& m_cfg;
-  std::unordered_map<IRInstruction*, AbstractObjectEnvironment> m_environments;
   mutable ReturnValueDomain m_return_value;
+  AbstractObjectEnvironment m_exit_state{AbstractObjectEnvironment::bottom()};
   std::unordered_set<std::string>* m_reset_det_func;
-  ExpBlockPartition* m_exp_partition = new ExpBlockPartition();
   DetFieldPartition* m_field_partition;
   IntraAnalyzerParameters m_ap;
 
@@ -306,7 +295,10 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     // like the reflectionanalysis only cares about object involving
     // operations). Hence, the effect of those operations is correctly
     // abstracted away regardless of the size of the destination register.
-    std::cout << "default semantics: just preserve" << current_state->get_abstract_obj()<< std::endl;
+    TRACE(UDF_PSAFE,
+          5,
+          "default semantics: just preserve %s",
+          SHOW(current_state->get_abstract_obj()));
     
     // bool do_anything = false;
     // if (insn->has_dest()) {
@@ -332,35 +324,43 @@ class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
     // }
   }
 
-  // After the fixpoint iteration completes, we replay the analysis on all
-  // blocks and we cache the abstract state at each instruction. This cache is
-  // used by get_abstract_object() to query the state of a register at a given
-  // instruction. Since we use an abstract domain based on Patricia trees, the
-  // memory footprint of storing the abstract state at each program point is
-  // small.
-  void populate_environments(const cfg::ControlFlowGraph& cfg) {
-    // We reserve enough space for the map in order to avoid repeated
-    // rehashing during the computation.
-    printf("enter populate_env\n");
-    m_environments.reserve(cfg.blocks().size() * 16);
-    for (cfg::Block* block : cfg.blocks()) {
-      AbstractObjectEnvironment current_state = get_entry_state_at(block);
-      for (auto& mie : InstructionIterable(block)) {
-        IRInstruction* insn = mie.insn;
-        m_environments.emplace(insn, current_state);
-        analyze_instruction(insn, &current_state);
-      }
-    }
-  }
   void debug_context(CallingContext* context) {
     // printf("debug calling context size %d\n", context->size());
     for (int idx = 0; idx < 5; idx++) {
-      std::cout << idx << context->get(idx) << std::endl;
+      TRACE(UDF_PSAFE, 5, "%s %s", SHOW(idx), SHOW(context->get(idx)));
     }
     // printf("finish debug calling context\n");
   }
 };
 
+// Runs the fixpoint of a Transfer over the CFG of its method.
+class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> {
+ public:
+  Analyzer(Transfer* transfer, sparta::Arena* arena)
+      : BaseIRAnalyzer(transfer->cfg(), arena), m_transfer(transfer) {}
+
+  void run(CallingContext* context) {
+    TRACE(UDF_PSAFE, 5, "******begin fixpoint iterator on cfg run");
+    MonotonicFixpointIterator::run(m_transfer->initial_state(context));
+    TRACE(UDF_PSAFE, 5, "******done fixpoint iterator run");
+    m_transfer->finish(get_exit_state_at(m_transfer->cfg().exit_block()));
+  }
+
+  void analyze_node(const cfg::GraphInterface::NodeId& node,
+                    AbstractObjectEnvironment* current_state) const override {
+    m_transfer->analyze_node(node, current_state);
+  }
+
+  void analyze_instruction(
+      const IRInstruction* insn,
+      AbstractObjectEnvironment* current_state) const override {
+    m_transfer->analyze_instruction(insn, current_state);
+  }
+
+ private:
+  Transfer* m_transfer;
+};
+
 } // namespace impl
 
 ParallelSafetyAnalysis::~ParallelSafetyAnalysis() {
@@ -373,120 +373,72 @@ ParallelSafetyAnalysis::ParallelSafetyAnalysis(
     CallingContext* context,
     SummaryQueryFn* summary_query_fn,
     std::unordered_set<std::string>* reset_det_func)
+    : ParallelSafetyAnalysis(
+          Deferred(), dex_method, ap, summary_query_fn, reset_det_func) {
+  if (m_transfer == nullptr) {
+    return;
+  }
+  m_analyzer = std::make_unique<impl::Analyzer>(m_transfer.get(), &m_arena);
+  TRACE(UDF_PSAFE, 5, "enter m_analyzer->run(context)");
+  m_analyzer->run(context);
+  // m_analyzer->get_analysis_result();
+}
+
+ParallelSafetyAnalysis::ParallelSafetyAnalysis(
+    Deferred,
+    DexMethod* dex_method,
+    IntraAnalyzerParameters ap,
+    SummaryQueryFn* summary_query_fn,
+    std::unordered_set<std::string>* reset_det_func)
     : m_dex_method(dex_method), m_ap(ap) {
   always_assert(dex_method != nullptr);
   IRCode* code = dex_method->get_code();
   if (code == nullptr) {
     return;
   }
-  code->build_cfg(/* editable */ false);
-  cfg::ControlFlowGraph& cfg = code->cfg();
-  cfg.calculate_exit_block();
-  m_analyzer = std::make_unique<impl::Analyzer>(
+  const cfg::ControlFlowGraph& cfg = cfg::CFGCache::instance().borrow(code);
+  m_transfer = std::make_unique<impl::Transfer>(
       dex_method, cfg, summary_query_fn, reset_det_func, m_ap);
-  printf("enter m_analyzer->run(context)\n");
-  m_analyzer->run(context);
-  // m_analyzer->get_analysis_result();
 }
 
-// void ReflectionAnalysis::get_reflection_site(
-//     const reg_t reg,
-//     IRInstruction* insn,
-//     std::map<reg_t, ReflectionAbstractObject>* abstract_objects) const {
-//   auto aobj = m_analyzer->get_abstract_object(reg, insn);
-//   if (!aobj) {
-//     return;
-//   }
-//   if (is_not_reflection_output(*aobj)) {
-//     return;
-//   }
-//   boost::optional<ClassObjectSource> cls_src =
-//       aobj->obj_kind == AbstractObjectKind::CLASS
-//           ? m_analyzer->get_class_source(reg, insn)
-//           : boost::none;
-//   if (aobj->obj_kind == AbstractObjectKind::CLASS &&
-//       cls_src == ClassObjectSource::NON_REFLECTION) {
-//     return;
-//   }
-//   if (traceEnabled(REFL, 5)) {
-//     std::ostringstream out;
-//     out << "reg " << reg << " " << *aobj << " ";
-//     if (cls_src) {
-//       out << *cls_src;
-//     }
-//     out << std::endl;
-//     TRACE(REFL, 5, " reflection site: %s", out.str().c_str());
-//   }
-//   (*abstract_objects)[reg] = ReflectionAbstractObject(*aobj, cls_src);
-// }
+AbstractObjectEnvironment ParallelSafetyAnalysis::initial_state(
+    CallingContext* context) const {
+  return m_transfer->initial_state(context);
+}
 
-// ReflectionSites ReflectionAnalysis::get_reflection_sites() const {
-//   ReflectionSites reflection_sites;
-//   auto code = m_dex_method->get_code();
-//   if (code == nullptr) {
-//     return reflection_sites;
-//   }
-//   auto reg_size = code->get_registers_size();
-//   for (auto& mie : InstructionIterable(code)) {
-//     IRInstruction* insn = mie.insn;
-//     std::map<reg_t, ReflectionAbstractObject> abstract_objects;
-//     for (size_t i = 0; i < reg_size; i++) {
-//       get_reflection_site(i, insn, &abstract_objects);
-//     }
-//     get_reflection_site(RESULT_REGISTER, insn, &abstract_objects);
-
-//     if (!abstract_objects.empty()) {
-//       reflection_sites.push_back(std::make_pair(insn, abstract_objects));
-//     }
-//   }
-//   return reflection_sites;
-// }
+void ParallelSafetyAnalysis::analyze_node(
+    cfg::Block* block, AbstractObjectEnvironment* current_state) const {
+  m_transfer->analyze_node(block, current_state);
+}
 
-DeterminismDomain ParallelSafetyAnalysis::get_return_value() const {
-  std::cout << "get return value from the m_analyzer()\n";
+void ParallelSafetyAnalysis::finish(
+    const AbstractObjectEnvironment& exit_state) {
+  m_transfer->finish(exit_state);
+}
+
+size_t ParallelSafetyAnalysis::get_num_blocks() const {
+  if (!m_transfer) {
+    return 0;
+  }
+  return m_dex_method->get_code()->cfg().num_blocks();
+}
+
+uint32_t ParallelSafetyAnalysis::get_num_iterations() const {
   if (!m_analyzer) {
+    return 0;
+  }
+  return m_analyzer->get_num_iterations();
+}
+
+DeterminismDomain ParallelSafetyAnalysis::get_return_value() const {
+  TRACE(UDF_PSAFE, 5, "get return value from the m_transfer()");
+  if (!m_transfer) {
     // Method has no code, or is a native method.
     return DeterminismDomain::top();
   }
-  return m_analyzer->get_return_value();
+  return m_transfer->get_return_value();
 }
 
-// boost::optional<std::vector<DexType*>> ReflectionAnalysis::get_method_params(
-//     IRInstruction* invoke_insn) const {
-//   auto code = m_dex_method->get_code();
-//   IRInstruction* move_result_insn = nullptr;
-//   auto ii = InstructionIterable(code);
-//   for (auto it = ii.begin(); it != ii.end(); ++it) {
-//     auto* insn = it->insn;
-//     if (insn == invoke_insn) {
-//       move_result_insn = std::next(it)->insn;
-//       break;
-//     }
-//   }
-//   if (!move_result_insn ||
-//       !opcode::is_a_move_result(move_result_insn->opcode())) {
-//     return boost::none;
-//   }
-//   auto arg_param = get_abstract_object(RESULT_REGISTER, move_result_insn);
-//   if (!arg_param ||
-//       arg_param->obj_kind != reflection::AbstractObjectKind::METHOD) {
-//     return boost::none;
-//   }
-//   return arg_param->dex_type_array;
-// }
-
-// bool ReflectionAnalysis::has_found_reflection() const {
-//   return !get_reflection_sites().empty();
-// }
-
-// boost::optional<AbstractObject> ReflectionAnalysis::get_abstract_object(
-//     size_t reg, IRInstruction* insn) const {
-//   if (m_analyzer == nullptr) {
-//     return boost::none;
-//   }
-//   return m_analyzer->get_abstract_object(reg, insn);
-// }
-
 CallingContextMap ParallelSafetyAnalysis::get_calling_context_partition() const {
   return CallingContextMap::top();
 
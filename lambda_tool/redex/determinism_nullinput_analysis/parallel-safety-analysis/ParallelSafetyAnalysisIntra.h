@@ -26,38 +26,36 @@
 #include "PatriciaTreeMapAbstractPartition.h"
 #include "DexClass.h"
 #include "ReducedProductAbstractDomain.h"
+#include "UdfAnalysisTypes.h"
 #include <iostream>
 
 using namespace sparta;
 
-struct IntraAnalyzerParameters {
-    bool track_exception = false;
-};  
-enum DeterminismType { DT_BOTTOM, IS_DET, NOT_DET, DT_TOP };
-// label whether a basic block comes from an exception block
-enum ExceptType { EX_BOTTOM, UNVISIT, FROM_EX, NO_EX, EX_TOP };
-
-std::ostream& operator<<(std::ostream& output, const DeterminismType& det);
-std::ostream& operator<<(std::ostream& output, const ExceptType& det);
-
-
 namespace parallelsafe {
 enum class FieldType { INSTANCE, STATIC };
 
 using std::placeholders::_1;
 
-using DetLattice = sparta::BitVectorLattice<DeterminismType, 4, std::hash<int>>;
-extern DetLattice det_lattice;
-using ExpLattice = sparta::BitVectorLattice<ExceptType, 5, std::hash<int>>;
-extern ExpLattice exp_lattice;
-using DeterminismDomain = sparta::FiniteAbstractDomain<DeterminismType,
-                                                       DetLattice,
-                                                       DetLattice::Encoding,
-                                                       &det_lattice>;
-using ExpDomain = sparta::FiniteAbstractDomain<ExceptType,
-                                            ExpLattice,
-                                            ExpLattice::Encoding,
-                                            &exp_lattice>;
+using DetLattice = sparta::ConstexprLattice<DeterminismType, 4>;
+inline constexpr DetLattice det_lattice({DT_BOTTOM, IS_DET, NOT_DET, DT_TOP},
+                                        {{DT_BOTTOM, IS_DET},
+                                         {DT_BOTTOM, NOT_DET},
+                                         {IS_DET, DT_TOP},
+                                         {NOT_DET, DT_TOP}});
+using ExpLattice = sparta::ConstexprLattice<ExceptType, 5>;
+inline constexpr ExpLattice exp_lattice(
+    {EX_BOTTOM, UNVISIT, FROM_EX, NO_EX, EX_TOP},
+    {{EX_BOTTOM, UNVISIT},
+     {UNVISIT, FROM_EX},
+     {UNVISIT, NO_EX},
+     {NO_EX, EX_TOP},
+     {FROM_EX, EX_TOP}});
+using DeterminismDomain =
+    sparta::ConstexprFiniteAbstractDomain<DeterminismType,
+                                          DetLattice,
+                                          &det_lattice>;
+using ExpDomain =
+    sparta::ConstexprFiniteAbstractDomain<ExceptType, ExpLattice, &exp_lattice>;
 
 std::ostream& operator<<(std::ostream& output,
                          const DeterminismDomain& detDomain);
@@ -140,6 +138,7 @@ namespace impl {
 
 // Forward declarations.
 class Analyzer;
+class Transfer;
 
 } // namespace impl
 
@@ -159,34 +158,41 @@ class ParallelSafetyAnalysis final {
   explicit ParallelSafetyAnalysis(DexMethod* dex_method, IntraAnalyzerParameters ap, CallingContext* context = nullptr, SummaryQueryFn* summary_query_fn = nullptr,
                               std::unordered_set<std::string>* reset_det_func = nullptr);
 
+  // Prepares the analysis without running it, for a fixpoint over the CFG of
+  // the method shared with other analyses: the caller iterates analyze_node()
+  // from initial_state(), and passes the state at the exit block to finish()
+  // before reading the results. Only for methods with code.
+  struct Deferred {};
+  ParallelSafetyAnalysis(Deferred,
+                         DexMethod* dex_method,
+                         IntraAnalyzerParameters ap,
+                         SummaryQueryFn* summary_query_fn,
+                         std::unordered_set<std::string>* reset_det_func);
+
+  AbstractObjectEnvironment initial_state(CallingContext* context) const;
+  void analyze_node(cfg::Block* block,
+                    AbstractObjectEnvironment* current_state) const;
+  void finish(const AbstractObjectEnvironment& exit_state);
 
   DeterminismDomain get_return_value() const;
 
-  /**
-   * Return a parameter type array for this invoke method instruction.
-   */
-  boost::optional<std::vector<DexType*>> get_method_params(
-      IRInstruction* invoke_insn) const;
-  /*
-   * Returns the abstract object (if any) referenced by the register at the
-   * given instruction. Note that if the instruction overwrites the register,
-   * the abstract object returned is the value held by the register *before*
-   * that instruction is executed.
-   */
-//   boost::optional<DeterminismDomain> get_abstract_object(
-//       size_t reg, IRInstruction* insn) const;
-
-//   boost::optional<ClassObjectSource> get_class_source(
-//       size_t reg, IRInstruction* insn) const;
-
   CallingContextMap get_calling_context_partition() const;
 
+  // The number of blocks of the CFG, and of iterations of the fixpoint over
+  // its loops, see MonotonicFixpointIteratorBase::get_num_iterations(). Both
+  // are 0 if the method has no code.
+  size_t get_num_blocks() const;
+  uint32_t get_num_iterations() const;
+
  private:
   const DexMethod* m_dex_method;
   // This is the actual class that performs the analysis over the CFG
   // class Analyzer final : public BaseIRAnalyzer<AbstractObjectEnvironment> 
   // class BaseIRAnalyzer : public sparta::MonotonicFixpointIterator<cfg::GraphInterface, Domain> {
-  std::unique_ptr<impl::Analyzer> m_analyzer; 
+  // The state of the analysis of the method, released at once with it.
+  sparta::Arena m_arena;
+  std::unique_ptr<impl::Transfer> m_transfer;
+  std::unique_ptr<impl::Analyzer> m_analyzer;
   std::unordered_set<std::string>* reset_det_func = nullptr;
   IntraAnalyzerParameters m_ap;
   void debug_context(CallingContext* context); 
@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SummaryCache.h"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <mutex>
+#include <sys/file.h>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+#include "CppUtil.h"
+#include "DexHasher.h"
+#include "ReadMaybeMapped.h"
+#include "Show.h"
+#include "Trace.h"
+#include "Walkers.h"
+
+namespace summary_cache {
+
+namespace {
+
+constexpr char MAGIC[8] = {'U', 'D', 'F', 'S', 'U', 'M', 'S', '\0'};
+constexpr uint32_t VERSION = 3;
+
+// The file is a Header followed by `num_entries` Entries, each followed by the
+// `num_input_words` words of its inputs and the `num_words` words of its
+// value, in the byte order of the machine that wrote it.
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t fingerprint;
+  uint64_t num_entries;
+};
+
+struct Entry {
+  uint64_t signature_hash;
+  uint64_t class_hash;
+  uint64_t inputs_hash;
+  uint64_t num_input_words;
+  uint64_t num_words;
+};
+
+uint64_t class_hash(DexClass* cls) {
+  auto hash = hashing::DexClassHasher(cls).run();
+  size_t seed = 0;
+  boost::hash_combine(seed, hash.signature_hash);
+  boost::hash_combine(seed, hash.code_hash);
+  return seed;
+}
+
+} // namespace
+
+size_t SummaryCache::KeyHash::operator()(const Key& key) const {
+  size_t seed = 0;
+  boost::hash_combine(seed, key.signature_hash);
+  boost::hash_combine(seed, key.class_hash);
+  boost::hash_combine(seed, key.inputs_hash);
+  return seed;
+}
+
+SummaryCache::SummaryCache(const Scope& scope, uint64_t fingerprint)
+    : m_fingerprint(fingerprint) {
+  const size_t n = scope.size();
+  std::unordered_map<const DexClass*, size_t> indices;
+  for (size_t i = 0; i < n; ++i) {
+    indices.emplace(scope[i], i);
+  }
+  std::vector<uint64_t> hashes(n);
+  walk::parallel::classes(scope, [&](DexClass* cls) {
+    hashes[indices.at(cls)] = class_hash(cls);
+  });
+  for (size_t i = 0; i < n; ++i) {
+    m_class_hashes.emplace(scope[i], hashes[i]);
+  }
+}
+
+boost::optional<SummaryCache::Key> SummaryCache::key_of(
+    const DexMethod* method, const Inputs& inputs) const {
+  auto it = m_class_hashes.find(type_class(method->get_class()));
+  if (it == m_class_hashes.end()) {
+    return boost::none;
+  }
+  return Key{boost::hash<std::string>()(show(method)), it->second,
+             boost::hash_range(inputs.begin(), inputs.end())};
+}
+
+boost::optional<SummaryCache::Value> SummaryCache::get(
+    const DexMethod* method, const Inputs& inputs) const {
+  auto key = key_of(method, inputs);
+  if (!key) {
+    return boost::none;
+  }
+  auto it = m_entries.find(*key);
+  if (it == m_entries.end()) {
+    return boost::none;
+  }
+  if (it->second.inputs != inputs) {
+    TRACE(UDF_CACHE, 2, "Collision of the inputs of %s", SHOW(method));
+    return boost::none;
+  }
+  return it->second.value;
+}
+
+void SummaryCache::stage(const DexMethod* method, Inputs inputs, Value value) {
+  auto key = key_of(method, inputs);
+  if (key) {
+    m_staged.insert_or_assign(std::make_pair(
+        method,
+        std::make_pair(*key, Analysis{std::move(inputs), std::move(value)})));
+  }
+}
+
+void SummaryCache::commit() {
+  for (const auto& pair : m_staged) {
+    m_entries.insert_or_assign(pair.second);
+  }
+  m_staged.clear();
+}
+
+size_t SummaryCache::load(const std::string& path) {
+  if (!boost::filesystem::exists(path)) {
+    TRACE(UDF_CACHE, 1, "No summary cache at %s", path.c_str());
+    return 0;
+  }
+  auto file = read_resident_file(path, /* preload */ false);
+  if (!file) {
+    return 0;
+  }
+  if (file->fingerprint != m_fingerprint) {
+    TRACE(UDF_CACHE, 1,
+          "Ignoring summary cache %s of another analysis configuration",
+          path.c_str());
+    return 0;
+  }
+  for (const auto& entry : file->entries) {
+    m_entries.insert_or_assign(entry);
+  }
+  TRACE(UDF_CACHE, 1, "Loaded %zu summaries from %s", file->entries.size(),
+        path.c_str());
+  return file->entries.size();
+}
+
+void SummaryCache::preload(const std::string& path) {
+  read_resident_file(path, /* preload */ true);
+}
+
+std::shared_ptr<const SummaryCache::File> SummaryCache::read_resident_file(
+    const std::string& path, bool preload) {
+  struct Resident {
+    uintmax_t size;
+    std::time_t mtime;
+    std::shared_ptr<const File> file;
+  };
+  static std::mutex resident_lock;
+  static std::unordered_map<std::string, Resident> resident;
+
+  boost::system::error_code ec;
+  auto size = boost::filesystem::file_size(path, ec);
+  std::time_t mtime = ec ? 0 : boost::filesystem::last_write_time(path, ec);
+  std::lock_guard<std::mutex> lock(resident_lock);
+  auto it = resident.find(path);
+  if (it == resident.end() && !preload) {
+    return read_file(path);
+  }
+  if (!ec && it != resident.end() && it->second.size == size &&
+      it->second.mtime == mtime) {
+    return it->second.file;
+  }
+  auto file = ec ? nullptr : read_file(path);
+  if (file) {
+    resident[path] = Resident{size, mtime, file};
+  } else {
+    resident.erase(path);
+  }
+  return file;
+}
+
+std::shared_ptr<const SummaryCache::File> SummaryCache::read_file(
+    const std::string& path) {
+  auto file = std::make_shared<File>();
+  auto* entries = &file->entries;
+  bool ok = false;
+  redex::read_file_with_contents(path, [&](const char* data, size_t size) {
+    Header header;
+    if (size < sizeof(Header)) {
+      TRACE(UDF_CACHE, 1, "Ignoring truncated summary cache %s", path.c_str());
+      return;
+    }
+    memcpy(&header, data, sizeof(Header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION) {
+      TRACE(UDF_CACHE, 1, "Ignoring summary cache %s of another format",
+            path.c_str());
+      return;
+    }
+    file->fingerprint = header.fingerprint;
+    const char* end = data + size;
+    const char* cursor = data + sizeof(Header);
+    for (uint64_t i = 0; i < header.num_entries; ++i) {
+      Entry entry;
+      if (static_cast<size_t>(end - cursor) < sizeof(Entry)) {
+        break;
+      }
+      memcpy(&entry, cursor, sizeof(Entry));
+      cursor += sizeof(Entry);
+      size_t num_words = static_cast<size_t>(end - cursor) / sizeof(uint32_t);
+      if (num_words < entry.num_input_words ||
+          num_words - entry.num_input_words < entry.num_words) {
+        break;
+      }
+      Analysis analysis;
+      analysis.inputs.resize(entry.num_input_words);
+      memcpy(analysis.inputs.data(), cursor,
+             entry.num_input_words * sizeof(uint32_t));
+      cursor += entry.num_input_words * sizeof(uint32_t);
+      analysis.value.resize(entry.num_words);
+      memcpy(analysis.value.data(), cursor, entry.num_words * sizeof(uint32_t));
+      cursor += entry.num_words * sizeof(uint32_t);
+      entries->emplace_back(
+          Key{entry.signature_hash, entry.class_hash, entry.inputs_hash},
+          std::move(analysis));
+    }
+    if (entries->size() != header.num_entries || cursor != end) {
+      TRACE(UDF_CACHE, 1, "Ignoring truncated summary cache %s", path.c_str());
+      return;
+    }
+    ok = true;
+  });
+  return ok ? file : nullptr;
+}
+
+bool SummaryCache::save(const std::string& path) const {
+  // The analysis already succeeded, so a cache that cannot be written, e.g. on
+  // a read-only path, only costs the next run its reuse.
+  auto warn = [&path](const char* what, const std::string& file) {
+    fprintf(stderr, "[summary cache] Cannot %s %s: %s, %s is not updated\n",
+            what, file.c_str(), strerror(errno), path.c_str());
+    return false;
+  };
+
+  // Runs sharing the cache, e.g. the requests of a redex-all server, may save
+  // it concurrently. The file is locked while it is replaced, and the entries
+  // other runs saved since this one loaded it are kept.
+  auto lock_path = path + ".lock";
+  int lock_fd = open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (lock_fd < 0) {
+    return warn("create", lock_path);
+  }
+  auto unlock = at_scope_exit([lock_fd] { close(lock_fd); });
+  while (flock(lock_fd, LOCK_EX) != 0) {
+    if (errno != EINTR) {
+      return warn("lock", lock_path);
+    }
+  }
+
+  // Read from the file rather than from memory, which may be stale if the
+  // file was replaced within the resolution of its modification time.
+  std::shared_ptr<const File> saved;
+  if (boost::filesystem::exists(path)) {
+    saved = read_file(path);
+  }
+  std::vector<std::pair<Key, const Analysis*>> entries;
+  entries.reserve(m_entries.size());
+  for (const auto& pair : m_entries) {
+    entries.emplace_back(pair.first, &pair.second);
+  }
+  size_t num_merged = 0;
+  if (saved && saved->fingerprint == m_fingerprint) {
+    for (const auto& pair : saved->entries) {
+      if (m_entries.count(pair.first) == 0) {
+        entries.emplace_back(pair.first, &pair.second);
+        ++num_merged;
+      }
+    }
+  }
+  // Sort the entries so that the file does not depend on the iteration order
+  // of the map.
+  std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+    return std::tie(a.first.signature_hash, a.first.class_hash,
+                    a.first.inputs_hash) < std::tie(b.first.signature_hash,
+                                                    b.first.class_hash,
+                                                    b.first.inputs_hash);
+  });
+  Header header;
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.reserved = 0;
+  header.fingerprint = m_fingerprint;
+  header.num_entries = entries.size();
+
+  // Write to a temporary file first, so that concurrent runs sharing the
+  // cache never read a partially written file.
+  std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.good()) {
+      return warn("create", tmp_path);
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    for (const auto& pair : entries) {
+      const auto& analysis = *pair.second;
+      Entry entry{pair.first.signature_hash, pair.first.class_hash,
+                  pair.first.inputs_hash, analysis.inputs.size(),
+                  analysis.value.size()};
+      out.write(reinterpret_cast<const char*>(&entry), sizeof(Entry));
+      out.write(reinterpret_cast<const char*>(analysis.inputs.data()),
+                analysis.inputs.size() * sizeof(uint32_t));
+      out.write(reinterpret_cast<const char*>(analysis.value.data()),
+                analysis.value.size() * sizeof(uint32_t));
+    }
+    out.close();
+    if (out.fail()) {
+      warn("write", tmp_path);
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    warn("replace", path);
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  TRACE(UDF_CACHE, 1, "Saved %zu summaries to %s, %zu of them from other runs",
+        entries.size(), path.c_str(), num_merged);
+  return true;
+}
+
+Fingerprint::Fingerprint(const std::string& analysis_name) {
+  add(static_cast<uint64_t>(VERSION));
+  add(analysis_name);
+}
+
+Fingerprint& Fingerprint::add(const std::string& value) {
+  boost::hash_combine(m_hash, value);
+  return *this;
+}
+
+Fingerprint& Fingerprint::add(uint64_t value) {
+  boost::hash_combine(m_hash, value);
+  return *this;
+}
+
+} // namespace summary_cache
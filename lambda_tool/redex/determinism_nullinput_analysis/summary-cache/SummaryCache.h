@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ConcurrentContainers.h"
+#include "DexClass.h"
+
+namespace summary_cache {
+
+/*
+ * A persistent store of the analyses of methods by the UDF analyses, so that a
+ * run only analyzes the methods whose code or inputs changed.
+ *
+ * An analysis is keyed by the signature of its method, the DexClassHasher hash
+ * of the method's class, and a hash of the inputs of the analysis besides the
+ * code: the calling context of the method and the summaries of the callees of
+ * its invoke instructions, as resolved in the call graph, i.e. with all the
+ * overrides of a virtual callee. The inputs themselves are stored with the
+ * analysis and compared on a lookup, so that a collision of their hashes is a
+ * miss. An analysis is thus reused only if it would compute the same result,
+ * whatever changed elsewhere in the program.
+ *
+ * The value of an analysis is a sequence of words written by the analysis,
+ * e.g. the summary of the method and the calling contexts it passes to its
+ * callees, see udf_analysis::CachedAnalysis. The file also records a
+ * fingerprint of the analysis configuration (e.g. the function labels); the
+ * entries of a file with a different fingerprint or format version are
+ * ignored. Entries of methods that are not in the current scope are kept, so
+ * that one file can be shared by the runs on many jars.
+ */
+class SummaryCache final {
+ public:
+  using Inputs = std::vector<uint32_t>;
+  using Value = std::vector<uint32_t>;
+
+  // Computes the class hashes of `scope`.
+  SummaryCache(const Scope& scope, uint64_t fingerprint);
+
+  // Loads the entries of `path`, which may not exist. Returns the number of
+  // entries loaded.
+  size_t load(const std::string& path);
+
+  // Writes all entries to `path`, replacing it atomically. The entries that
+  // other processes saved to `path` in the meantime are kept. Returns false,
+  // after printing a warning, if `path` cannot be written; it is then left
+  // as it was.
+  bool save(const std::string& path) const;
+
+  // Keeps the entries of `path` in memory, so that load() only reads it again
+  // if it changed since. A redex-all server preloads the caches of its passes
+  // before forking the runs of its requests, which then share them, see
+  // Pass::preload().
+  static void preload(const std::string& path);
+
+  // The analysis of `method` with the inputs `inputs`, if any. Thread-safe as
+  // long as commit() is not running.
+  boost::optional<Value> get(const DexMethod* method,
+                             const Inputs& inputs) const;
+
+  // Records the latest analysis of `method`. Thread-safe.
+  void stage(const DexMethod* method, Inputs inputs, Value value);
+
+  // Adds the latest analysis of every method to the entries, once the global
+  // fixpoint is reached.
+  void commit();
+
+  size_t size() const { return m_entries.size(); }
+
+ private:
+  struct Key {
+    uint64_t signature_hash;
+    uint64_t class_hash;
+    uint64_t inputs_hash;
+
+    bool operator==(const Key& other) const {
+      return signature_hash == other.signature_hash &&
+             class_hash == other.class_hash &&
+             inputs_hash == other.inputs_hash;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  struct Analysis {
+    Inputs inputs;
+    Value value;
+  };
+
+  boost::optional<Key> key_of(const DexMethod* method,
+                              const Inputs& inputs) const;
+
+  // The entries of a file, and the fingerprint of the configuration they were
+  // computed with.
+  struct File {
+    uint64_t fingerprint;
+    std::vector<std::pair<Key, Analysis>> entries;
+  };
+
+  // Reads the file at `path`. Returns null if it has another format or is
+  // truncated.
+  static std::shared_ptr<const File> read_file(const std::string& path);
+
+  // read_file(), from memory if `path` was preloaded and its size and
+  // modification time did not change since. Preloads `path` if `preload` is
+  // set.
+  static std::shared_ptr<const File> read_resident_file(const std::string& path,
+                                                        bool preload);
+
+  uint64_t m_fingerprint;
+  std::unordered_map<const DexClass*, uint64_t> m_class_hashes;
+  ConcurrentMap<Key, Analysis, KeyHash> m_entries;
+  ConcurrentMap<const DexMethod*, std::pair<Key, Analysis>> m_staged;
+};
+
+// Combines the parts of an analysis configuration into a fingerprint.
+class Fingerprint final {
+ public:
+  explicit Fingerprint(const std::string& analysis_name);
+
+  Fingerprint& add(const std::string& value);
+  Fingerprint& add(uint64_t value);
+
+  uint64_t get() const { return m_hash; }
+
+ private:
+  size_t m_hash{0};
+};
+
+} // namespace summary_cache
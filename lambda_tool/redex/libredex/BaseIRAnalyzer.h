@@ -19,9 +19,12 @@ class BaseIRAnalyzer
  public:
   using NodeId = cfg::Block*;
 
-  explicit BaseIRAnalyzer(const cfg::ControlFlowGraph& cfg)
+  // The states of the fixpoint are allocated from `arena` if not null, see
+  // sparta::MonotonicFixpointIteratorBase.
+  explicit BaseIRAnalyzer(const cfg::ControlFlowGraph& cfg,
+                          sparta::Arena* arena = nullptr)
       : sparta::MonotonicFixpointIterator<cfg::GraphInterface, Domain>(
-            cfg, cfg.blocks().size()) {}
+            cfg, cfg.blocks().size(), arena) {}
 
   void analyze_node(const NodeId& node, Domain* current_state) const override {
     for (auto& mie : ir_list::InstructionIterable(node)) {
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CFGCache.h"
+
+#include "ControlFlow.h"
+#include "IRCode.h"
+
+namespace cfg {
+
+CFGCache& CFGCache::instance() {
+  static CFGCache cache;
+  return cache;
+}
+
+const ControlFlowGraph& CFGCache::borrow(IRCode* code) {
+  if (code->cfg_built() && !code->editable_cfg_built() &&
+      m_cfgs.get(code, nullptr) == &code->cfg()) {
+    ++m_hits;
+    auto& cfg = code->cfg();
+    // The address comparison cannot tell the cached CFG from one that was
+    // cleared and rebuilt elsewhere since, and happens to reuse its address.
+    // Such a CFG is still non-editable and built from the current code, so it
+    // can be shared, but it may lack the exit block that borrow() promises.
+    // Computing it is a no-op on the CFG that borrow() built.
+    cfg.calculate_exit_block();
+    return cfg;
+  }
+  ++m_misses;
+  code->build_cfg(/* editable */ false);
+  auto& cfg = code->cfg();
+  cfg.calculate_exit_block();
+  m_cfgs.update(code,
+                [&](const IRCode*, const ControlFlowGraph*& cached,
+                    bool /* exists */) { cached = &cfg; });
+  return cfg;
+}
+
+void CFGCache::invalidate() { m_cfgs.clear(); }
+
+CFGCache::Stats CFGCache::stats() const {
+  Stats stats;
+  stats.hits = m_hits;
+  stats.misses = m_misses;
+  return stats;
+}
+
+} // namespace cfg
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "ConcurrentContainers.h"
+
+class IRCode;
+
+namespace cfg {
+
+class ControlFlowGraph;
+
+/*
+ * Shares the non-editable CFGs of the methods between the analyses of a pass,
+ * and between consecutive ANALYSIS passes, instead of rebuilding them for
+ * every analysis of a method.
+ *
+ * A CFG is kept in its IRCode, as if built by IRCode::build_cfg(false). It is
+ * rebuilt when its IRCode no longer has it, i.e., after the CFG was cleared or
+ * rebuilt, e.g., as an editable CFG to change the code. Since the code can
+ * also change without touching its CFG, the PassManager invalidates the whole
+ * cache after every pass that is not an ANALYSIS pass.
+ */
+class CFGCache final {
+ public:
+  struct Stats {
+    size_t hits{0};
+    size_t misses{0};
+  };
+
+  // The cache shared by the passes.
+  static CFGCache& instance();
+
+  // Returns the non-editable CFG of `code`, with its exit block computed.
+  // Thread-safe, but the CFG of a given IRCode must not be borrowed by two
+  // threads at once.
+  const ControlFlowGraph& borrow(IRCode* code);
+
+  // Makes the next borrow() of every IRCode rebuild its CFG.
+  void invalidate();
+
+  // The borrows since the cache was created.
+  Stats stats() const;
+
+ private:
+  // The CFG built by borrow() for each IRCode, compared by address with the
+  // current CFG of the code.
+  ConcurrentMap<const IRCode*, const ControlFlowGraph*> m_cfgs;
+  std::atomic<size_t> m_hits{0};
+  std::atomic<size_t> m_misses{0};
+};
+
+} // namespace cfg
@@ -36,6 +36,15 @@ Graph multiple_callee_graph(const mog::Graph& method_override_graph,
                                       big_override_threshold));
 }
 
+Graph multiple_callee_graph(const mog::Graph& method_override_graph,
+                            const Scope& scope,
+                            uint32_t big_override_threshold,
+                            const std::vector<const DexMethod*>& roots) {
+  MultipleCalleeStrategy strategy(method_override_graph, scope,
+                                  big_override_threshold);
+  return Graph(RootedStrategy(strategy, roots));
+}
+
 SingleCalleeStrategy::SingleCalleeStrategy(
     const mog::Graph& method_override_graph, const Scope& scope)
     : m_scope(scope) {
@@ -56,14 +65,9 @@ CallSites SingleCalleeStrategy::get_callsites(const DexMethod* method) const {
         if (opcode::is_an_invoke(insn->opcode())) {
           auto callee = this->resolve_callee(method, insn);
           if (callee == nullptr || is_definitely_virtual(callee)) {
-            printf("debug: editable_cfg_adapter::iterate_with_iterator\n");
-            if (!callee) {
-              printf("does not resolve_callee:%s\n",
-                     insn->get_string()->c_str());
-            } else {
-              printf("callee definitely virtual:%s\n",
-                     insn->get_string()->c_str());
-            }
+            TRACE(CALLGRAPH, 5, "%s callee of %s",
+                  callee == nullptr ? "unresolved" : "true virtual",
+                  SHOW(insn));
             return editable_cfg_adapter::LOOP_CONTINUE;
             ;
           }
@@ -109,7 +113,6 @@ RootAndDynamic MultipleCalleeBaseStrategy::get_roots() const {
   MethodSet emplaced_methods;
   auto& roots = root_and_dynamic.roots;
   auto& dynamic_methods = root_and_dynamic.dynamic_methods;
-  printf("begin debug get roots in multiplecallee's get_roots()\n");
   // Gather clinits and root methods, and the methods that override or
   // overriden by the root methods.
   auto add_root_method_overrides = [&](const DexMethod* method) {
@@ -123,9 +126,8 @@ RootAndDynamic MultipleCalleeBaseStrategy::get_roots() const {
     }
   };
   walk::methods(m_scope, [&](DexMethod* method) {
-    printf("walk::method%s\n", method->get_name()->c_str());
     if (method::is_clinit(method)) {
-      printf("add %s because it is clinit\n", method->get_name()->c_str());
+      TRACE(CALLGRAPH, 5, "root (clinit): %s", SHOW(method));
       roots.emplace_back(method);
       emplaced_methods.emplace(method);
       return;
@@ -136,22 +138,19 @@ RootAndDynamic MultipleCalleeBaseStrategy::get_roots() const {
       // For root methods and dynamically added classes, created via
       // Proxy.newProxyInstance, we need to add them and their overrides and
       // overriden to roots.
-      printf("%s satisfy constraints: not root, not virtual or interface\n",
-             method->get_name()->c_str());
       if (!method->is_external() && method->get_code()) {
-        printf("satisfy not external and has code\n");
+        TRACE(CALLGRAPH, 5, "root (non-root method): %s", SHOW(method));
         roots.emplace(roots.begin(),method);
       }
       return;
     }
     if (method->is_virtual() && is_interface(type_class(method->get_class())) &&
         !can_rename(method)) {
-      printf("%s satisfy constraints: virtual and interface",
-             method->get_name()->c_str());
+      TRACE(CALLGRAPH, 5, "dynamic: %s", SHOW(method));
       dynamic_methods.emplace(method);
     }
     if (!emplaced_methods.count(method) && method->get_code()) {
-      printf("add root %s\n", method->get_name()->c_str());
+      TRACE(CALLGRAPH, 5, "root: %s", SHOW(method));
       roots.emplace_back(method);
       emplaced_methods.emplace(method);
     }
@@ -209,9 +208,8 @@ RootAndDynamic MultipleCalleeBaseStrategy::get_roots() const {
   // Add additional roots if needed.
   auto additional_roots = get_additional_roots(emplaced_methods);
   roots.insert(roots.end(), additional_roots.begin(), additional_roots.end());
-  for (auto const& r : roots) {
-    printf("added root: %s\n", r->get_name()->c_str());
-  }
+  TRACE(CALLGRAPH, 2, "%zu roots, %zu dynamic methods", roots.size(),
+        dynamic_methods.size());
   return root_and_dynamic;
 }
 
@@ -353,9 +351,7 @@ MultipleCalleeStrategy::MultipleCalleeStrategy(
         callee = resolve_interface_virtual_callee(insn, method, m_resolved_refs,
                                                   /* use_cache */ false);
         if (callee == nullptr) {
-          printf(
-              "fail resolve callee constructor for MultipleCalleeStrategy%s\n",
-              insn->get_method()->get_name()->c_str());
+          TRACE(CALLGRAPH, 5, "unresolved callee: %s", SHOW(insn));
           return;
         }
       }
@@ -389,9 +385,6 @@ CallSites MultipleCalleeStrategy::get_callsites(const DexMethod* method) const {
   if (code == nullptr) {
     return callsites;
   }
-  printf(
-      "debug:  MultipleCalleeStrategy::get_callsites(const DexMethod* method) "
-      "\n");
   // iterate instructions within code
   editable_cfg_adapter::iterate_with_iterator(
       code, [&](const IRList::iterator& it) {
@@ -405,11 +398,8 @@ CallSites MultipleCalleeStrategy::get_callsites(const DexMethod* method) const {
                 resolve_interface_virtual_callee(insn, method, m_resolved_refs,
                                                  /* use_cache */ true);
             if (callee == nullptr) {
-              printf(
-                  "fail resolve callee in: "
-                  "MultipleCalleeStrategy::get_callsites%s\n",
-                  insn->get_method()->get_name()->c_str());
-
+              TRACE(CALLGRAPH, 5, "unresolved callee in %s: %s",
+                    SHOW(method), SHOW(insn));
               return editable_cfg_adapter::LOOP_CONTINUE;
               ;
             }
@@ -456,6 +446,20 @@ std::vector<const DexMethod*> MultipleCalleeStrategy::get_additional_roots(
   return additional_roots;
 }
 
+RootedStrategy::RootedStrategy(const BuildStrategy& strategy,
+                               std::vector<const DexMethod*> roots)
+    : m_strategy(strategy), m_roots(std::move(roots)) {}
+
+CallSites RootedStrategy::get_callsites(const DexMethod* method) const {
+  return m_strategy.get_callsites(method);
+}
+
+RootAndDynamic RootedStrategy::get_roots() const {
+  RootAndDynamic root_and_dynamic;
+  root_and_dynamic.roots = m_roots;
+  return root_and_dynamic;
+}
+
 Edge::Edge(NodeId caller, NodeId callee, IRInstruction* invoke_insn)
     : m_caller(std::move(caller)),
       m_callee(std::move(callee)),
@@ -466,7 +470,6 @@ Graph::Graph(const BuildStrategy& strat)
       m_exit(std::make_shared<Node>(Node::GHOST_EXIT)) {
   // Add edges from the single "ghost" entry node to all the "real" entry
   // nodes in the graph.
-  printf("begin debugging call graph building\n");
   auto root_and_dynamic = strat.get_roots();
   const auto& roots = root_and_dynamic.roots;
   m_dynamic_methods = std::move(root_and_dynamic.dynamic_methods);
@@ -8,11 +8,14 @@
 #pragma once
 
 #include <unordered_map>
+#include <vector>
 
 #include "DexClass.h"
 #include "IRCode.h"
 #include "MonotonicFixpointIterator.h"
 #include "Resolver.h"
+#include "Show.h"
+#include "Trace.h"
 
 namespace method_override_graph {
 class Graph;
@@ -48,6 +51,17 @@ Graph multiple_callee_graph(
 Graph complete_call_graph(
     const method_override_graph::Graph& method_override_graph, const Scope&);
 
+/*
+ * The multiple_callee_graph of the methods reachable from `roots` only, e.g.
+ * to analyze a few entry points of a large scope. The other methods of the
+ * scope are not visited.
+ */
+Graph multiple_callee_graph(
+    const method_override_graph::Graph& method_override_graph,
+    const Scope&,
+    uint32_t big_override_threshold,
+    const std::vector<const DexMethod*>& roots);
+
 struct CallSite {
   const DexMethod* callee;
   IRInstruction* invoke_insn;
@@ -154,13 +168,12 @@ class Graph final {
   const std::unordered_set<const DexMethod*>& get_dynamic_methods() const {
     return m_dynamic_methods;
   }
-  void debug_methods_in_graph () {
-    for (const auto &m: m_nodes) {
-      printf("debug_methods_in_graph: %s\n",m.first->get_name()->c_str());
+  void debug_methods_in_graph() const {
+    for (const auto& m : m_nodes) {
+      TRACE(CALLGRAPH, 5, "method in graph: %s", SHOW(m.first));
     }
-    for (const auto &vm: m_dynamic_methods) {
-        printf("debug_dynamic_methods_in_graph: %s\n",vm->get_name()->c_str());
-
+    for (const auto& vm : m_dynamic_methods) {
+      TRACE(CALLGRAPH, 5, "dynamic method in graph: %s", SHOW(vm));
     }
   }
 
@@ -243,6 +256,21 @@ class MultipleCalleeStrategy : public MultipleCalleeBaseStrategy {
   MethodSet m_big_override;
 };
 
+// Restricts another strategy to the methods reachable from the given roots.
+// Unlike the strategies above, it does not walk the scope for roots, and
+// reports no dynamic methods.
+class RootedStrategy : public BuildStrategy {
+ public:
+  RootedStrategy(const BuildStrategy& strategy,
+                 std::vector<const DexMethod*> roots);
+  CallSites get_callsites(const DexMethod* method) const override;
+  RootAndDynamic get_roots() const override;
+
+ private:
+  const BuildStrategy& m_strategy;
+  std::vector<const DexMethod*> m_roots;
+};
+
 // A static-method-only API for use with the monotonic fixpoint iterator.
 class GraphInterface {
  public:
@@ -13,18 +13,132 @@
 #include "DexMethodHandle.h"
 #include "DexUtil.h"
 #include "Show.h"
+#include "SlabAllocator.h"
 
+#include <algorithm>
 #include <boost/range/any_range.hpp>
 #include <cstring>
 #include <iterator>
 
+/*
+ * The out-of-line source registers of an instruction: a header followed by
+ * `capacity` registers. The small capacities, which cover the invokes of
+ * almost all methods, have their own slabs; the others come from the heap.
+ */
+struct IRInstruction::SrcArray {
+  uint32_t size;
+  uint32_t capacity;
+
+  static constexpr uint32_t MIN_CAPACITY = 4;
+
+  // The size of the header is checked in make().
+  template <uint32_t capacity>
+  using Allocator = sparta::SlabAllocator<8 + sizeof(reg_t) * capacity,
+                                         alignof(reg_t)>;
+
+  reg_t* data() { return reinterpret_cast<reg_t*>(this + 1); }
+  const reg_t* data() const {
+    return reinterpret_cast<const reg_t*>(this + 1);
+  }
+
+  // The registers are zeroed, as in a new vector.
+  static SrcArray* make(size_t size) {
+    static_assert(sizeof(SrcArray) == 8 && alignof(SrcArray) == alignof(reg_t),
+                  "Allocator doesn't fit the header");
+    uint32_t capacity = MIN_CAPACITY;
+    while (capacity < size) {
+      capacity *= 2;
+    }
+    void* p;
+    switch (capacity) {
+    case 4:
+      p = Allocator<4>::allocate();
+      break;
+    case 8:
+      p = Allocator<8>::allocate();
+      break;
+    case 16:
+      p = Allocator<16>::allocate();
+      break;
+    case 32:
+      p = Allocator<32>::allocate();
+      break;
+    case 64:
+      p = Allocator<64>::allocate();
+      break;
+    default:
+      p = ::operator new(sizeof(SrcArray) + sizeof(reg_t) * capacity);
+      break;
+    }
+    auto* srcs = new (p) SrcArray{static_cast<uint32_t>(size), capacity};
+    std::fill_n(srcs->data(), size, 0);
+    return srcs;
+  }
+
+  static SrcArray* make(const reg_t* regs, size_t size) {
+    auto* srcs = make(size);
+    std::copy_n(regs, size, srcs->data());
+    return srcs;
+  }
+
+  static void destroy(SrcArray* srcs) {
+    switch (srcs->capacity) {
+    case 4:
+      Allocator<4>::deallocate(srcs);
+      break;
+    case 8:
+      Allocator<8>::deallocate(srcs);
+      break;
+    case 16:
+      Allocator<16>::deallocate(srcs);
+      break;
+    case 32:
+      Allocator<32>::deallocate(srcs);
+      break;
+    case 64:
+      Allocator<64>::deallocate(srcs);
+      break;
+    default:
+      ::operator delete(srcs);
+      break;
+    }
+  }
+
+  // Returns the array to use from now on, which is `srcs` if it is large
+  // enough. The new registers are zeroed.
+  static SrcArray* resize(SrcArray* srcs, size_t size) {
+    if (size > srcs->capacity) {
+      auto* grown = make(size);
+      std::copy_n(srcs->data(), srcs->size, grown->data());
+      destroy(srcs);
+      return grown;
+    }
+    if (size > srcs->size) {
+      std::fill(srcs->data() + srcs->size, srcs->data() + size, 0);
+    }
+    srcs->size = size;
+    return srcs;
+  }
+};
+
+void* IRInstruction::operator new(size_t size) {
+  always_assert(size == sizeof(IRInstruction));
+  return sparta::SlabAllocator<sizeof(IRInstruction),
+                               alignof(IRInstruction)>::allocate();
+}
+
+void IRInstruction::operator delete(void* p) {
+  sparta::SlabAllocator<sizeof(IRInstruction),
+                        alignof(IRInstruction)>::deallocate(p);
+}
+
 IRInstruction::IRInstruction(IROpcode op) : m_opcode(op) {
   auto count = opcode_impl::min_srcs_size(op);
   if (count <= MAX_NUM_INLINE_SRCS) {
     m_num_inline_srcs = count;
   } else {
     m_num_inline_srcs = MAX_NUM_INLINE_SRCS + 1;
-    m_srcs = new std::vector<reg_t>(count);
+    m_srcs = SrcArray::make(count);
   }
 }
 
@@ -38,13 +152,13 @@ IRInstruction::IRInstruction(const IRInstruction& other)
       m_inline_srcs[i] = other.m_inline_srcs[i];
     }
   } else {
-    m_srcs = new std::vector<reg_t>(*other.m_srcs);
+    m_srcs = SrcArray::make(other.m_srcs->data(), other.m_srcs->size);
   }
 }
 
 IRInstruction::~IRInstruction() {
   if (m_num_inline_srcs > MAX_NUM_INLINE_SRCS) {
-    delete m_srcs;
+    SrcArray::destroy(m_srcs);
   }
 }
 
@@ -67,7 +181,9 @@ bool IRInstruction::operator==(const IRInstruction& that) const {
     }
     return true;
   } else {
-    return *m_srcs == *that.m_srcs;
+    return m_srcs->size == that.m_srcs->size &&
+           std::equal(m_srcs->data(), m_srcs->data() + m_srcs->size,
+                      that.m_srcs->data());
   }
 }
 
@@ -77,7 +193,8 @@ reg_t IRInstruction::src(src_index_t i) const {
     always_assert(i < m_num_inline_srcs);
     return m_inline_srcs[i];
   }
-  return m_srcs->at(i);
+  always_assert(i < m_srcs->size);
+  return m_srcs->data()[i];
 }
 
 IRInstruction::reg_range IRInstruction::srcs() const {
@@ -89,7 +206,7 @@ IRInstruction::reg_range IRInstruction::srcs() const {
     return reg_range(begin, end);
   }
   const reg_t* begin = m_srcs->data();
-  const reg_t* end = begin + m_srcs->size();
+  const reg_t* end = begin + m_srcs->size;
   return reg_range(begin, end);
 }
 
@@ -107,7 +224,8 @@ IRInstruction* IRInstruction::set_src(src_index_t i, reg_t reg) {
     always_assert(i < m_num_inline_srcs);
     m_inline_srcs[i] = reg;
   } else {
-    m_srcs->at(i) = reg;
+    always_assert(i < m_srcs->size);
+    m_srcs->data()[i] = reg;
   }
   return this;
 }
@@ -116,7 +234,7 @@ size_t IRInstruction::srcs_size() const {
   if (m_num_inline_srcs <= MAX_NUM_INLINE_SRCS) {
     return m_num_inline_srcs;
   }
-  return m_srcs->size();
+  return m_srcs->size;
 }
 
 IRInstruction* IRInstruction::set_srcs_size(size_t count) {
@@ -125,27 +243,23 @@ IRInstruction* IRInstruction::set_srcs_size(size_t count) {
       // staying in the inline state
       m_num_inline_srcs = count;
     } else {
-      // inline regs -> vector
-      auto srcs = new std::vector<reg_t>();
-      srcs->reserve(count);
-      for (auto i = 0; i < m_num_inline_srcs; ++i) {
-        srcs->push_back(m_inline_srcs[i]);
-      }
-      srcs->resize(count);
+      // inline regs -> array
+      auto srcs = SrcArray::make(count);
+      std::copy_n(m_inline_srcs, m_num_inline_srcs, srcs->data());
       m_num_inline_srcs = MAX_NUM_INLINE_SRCS + 1;
       m_srcs = srcs;
     }
   } else {
     if (count <= MAX_NUM_INLINE_SRCS) {
-      // vector -> inline regs
+      // array -> inline regs
       auto old_srcs_ptr = m_srcs;
       m_num_inline_srcs = count;
-      always_assert(count <= old_srcs_ptr->size());
+      always_assert(count <= old_srcs_ptr->size);
       std::memcpy(m_inline_srcs, old_srcs_ptr->data(), count * sizeof(reg_t));
-      delete old_srcs_ptr;
+      SrcArray::destroy(old_srcs_ptr);
     } else {
-      // staying in the vector state
-      m_srcs->resize(count);
+      // staying in the array state
+      m_srcs = SrcArray::resize(m_srcs, count);
     }
   }
   return this;
@@ -335,7 +449,7 @@ void IRInstruction::denormalize_registers() {
 
     // update m_inline_srcs or m_srcs
     if (m_num_inline_srcs > MAX_NUM_INLINE_SRCS) {
-      delete m_srcs;
+      SrcArray::destroy(m_srcs);
     }
     if (srcs.size() <= MAX_NUM_INLINE_SRCS) {
       m_num_inline_srcs = srcs.size();
@@ -344,7 +458,7 @@ void IRInstruction::denormalize_registers() {
       }
     } else {
       m_num_inline_srcs = MAX_NUM_INLINE_SRCS + 1;
-      m_srcs = new std::vector<reg_t>(std::move(srcs));
+      m_srcs = SrcArray::make(srcs.data(), srcs.size());
     }
   }
 }
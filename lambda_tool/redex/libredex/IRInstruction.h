@@ -139,6 +139,11 @@ class IRInstruction final {
   IRInstruction(const IRInstruction&);
   ~IRInstruction();
 
+  // Instructions are allocated from thread-local slabs: passes like inlining
+  // and outlining create and destroy millions of them.
+  static void* operator new(size_t size);
+  static void operator delete(void* p);
+
   /*
    * Ensures that wide registers only have their first register referenced
    * in the srcs list. This only affects invoke-* instructions.
@@ -389,9 +394,13 @@ class IRInstruction final {
   // 2 is chosen because it's the maximum number of registers (32 bits each) we
   // can fit in the size of a pointer (on a 64bit system).
   // In practice, most IRInstructions have 2 or fewer source registers, so we
-  // can avoid a vector allocation most of the time.
+  // can avoid an out-of-line allocation most of the time.
   static constexpr uint8_t MAX_NUM_INLINE_SRCS = 2;
 
+  // The out-of-line source registers, allocated from thread-local slabs by
+  // power-of-two capacity. See IRInstruction.cpp.
+  struct SrcArray;
+
   // The fields of IRInstruction are carefully selected and ordered to avoid
   // empty packing bytes and minimize total size. This is optimized for 8 byte
   // alignment on a 64bit system.
@@ -423,8 +432,8 @@ class IRInstruction final {
     // m_num_inline_srcs indicates how to interpret the union. See comment above
     reg_t m_inline_srcs[MAX_NUM_INLINE_SRCS] = {0};
     // Use a pointer here because it's 8 bytes instead of ~24.
-    // Be careful to new and delete it correctly!
-    std::vector<reg_t>* m_srcs;
+    // Be careful to make and destroy it correctly!
+    SrcArray* m_srcs;
   };
   // 24 bytes total
 };
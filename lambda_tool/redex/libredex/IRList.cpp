@@ -17,6 +17,7 @@
 #include "DexUtil.h"
 #include "IRInstruction.h"
 #include "Show.h"
+#include "SlabAllocator.h"
 
 bool TryEntry::operator==(const TryEntry& other) const {
   return type == other.type && *catch_start == *other.catch_start;
@@ -112,6 +113,24 @@ MethodItemEntry::MethodItemEntry(const MethodItemEntry& that)
   }
 }
 
+using MethodItemEntryAllocator =
+    sparta::SlabAllocator<sizeof(MethodItemEntry), alignof(MethodItemEntry)>;
+
+void* MethodItemEntry::operator new(size_t size) {
+  if (size != sizeof(MethodItemEntry)) {
+    return ::operator new(size);
+  }
+  return MethodItemEntryAllocator::allocate();
+}
+
+void MethodItemEntry::operator delete(void* p, size_t size) {
+  if (size != sizeof(MethodItemEntry)) {
+    ::operator delete(p);
+    return;
+  }
+  MethodItemEntryAllocator::deallocate(p);
+}
+
 MethodItemEntry::~MethodItemEntry() {
   switch (type) {
   case MFLOW_TRY:
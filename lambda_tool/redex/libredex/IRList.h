@@ -299,6 +299,10 @@ struct MethodItemEntry {
   MethodItemEntry() : type(MFLOW_FALLTHROUGH) {}
   ~MethodItemEntry();
 
+  // Entries are allocated from thread-local slabs, like IRInstructions.
+  static void* operator new(size_t size);
+  static void operator delete(void* p, size_t size);
+
   /*
    * This should only ever be used by the instruction lowering step. Do NOT use
    * it in passes!
@@ -38,7 +38,8 @@ class IRMetaIO {
            !obj->rstate.inner_struct.m_set_allowshrinking &&
            !obj->rstate.inner_struct.m_unset_allowshrinking &&
            !obj->rstate.inner_struct.m_set_allowobfuscation &&
-           !obj->rstate.inner_struct.m_unset_allowobfuscation;
+           !obj->rstate.inner_struct.m_unset_allowobfuscation &&
+           !obj->rstate.inner_struct.m_no_optimizations;
   }
 };
 } // namespace ir_meta_io
@@ -7,12 +7,20 @@
 
 #include <boost/iostreams/device/mapped_file.hpp>
 
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <zlib.h>
 
 #include "Macros.h"
+#include "RedexContext.h"
 
 #if IS_WINDOWS
 #include <Winsock2.h>
@@ -22,12 +30,18 @@
 #endif
 
 #include "Creators.h"
+#include "DexCallSite.h"
 #include "DexClass.h"
+#include "DexMethodHandle.h"
 #include "DuplicateClasses.h"
+#include "IRCode.h"
 #include "JarLoader.h"
+#include "JvmBytecodeTranslator.h"
 #include "Show.h"
 #include "Trace.h"
+#include "TypeUtil.h"
 #include "Util.h"
+#include "WorkQueue.h"
 
 /******************
  * Begin Class Loading code.
@@ -105,6 +119,9 @@ struct cp_method_info {
 #define CP_CONST_METHTYPE    (16)
 #define CP_CONST_INVOKEDYN   (18)
 
+// Since Java 11
+#define CP_CONST_DYNAMIC     (17)
+
 // Since Java 9
 #define CP_CONST_MODULE      (19)
 #define CP_CONST_PACKAGE     (20)
@@ -125,10 +142,16 @@ static bool parse_cp_entry(uint8_t*& buffer, cp_entry& cpe) {
   case CP_CONST_METHOD:
   case CP_CONST_INTERFACE:
   case CP_CONST_NAMEANDTYPE:
-  case CP_CONST_METHHANDLE:
+  case CP_CONST_DYNAMIC:
+  case CP_CONST_INVOKEDYN:
     cpe.s0 = read16(buffer);
     cpe.s1 = read16(buffer);
     return true;
+  case CP_CONST_METHHANDLE:
+    // The reference kind, then the index of the reference.
+    cpe.s0 = *buffer++;
+    cpe.s1 = read16(buffer);
+    return true;
   case CP_CONST_INT:
   case CP_CONST_FLOAT:
     cpe.i0 = read32(buffer);
@@ -143,9 +166,6 @@ static bool parse_cp_entry(uint8_t*& buffer, cp_entry& cpe) {
     cpe.data = buffer;
     buffer += cpe.len;
     return true;
-  case CP_CONST_INVOKEDYN:
-    fprintf(stderr, "INVOKEDYN constant unsupported, Bailing\n");
-    return false;
   }
   fprintf(stderr, "Unrecognized constant pool tag 0x%02x, Bailing\n", cpe.tag);
   return false;
@@ -207,9 +227,33 @@ static bool extract_utf8(std::vector<cp_entry>& cpool,
   return true;
 }
 
+// The content of the attribute named `name` among the attributes at `buffer`,
+// or null if there is none.
+static uint8_t* find_attribute(std::vector<cp_entry>& cpool,
+                               uint8_t* buffer,
+                               const char* name,
+                               uint32_t* length = nullptr) {
+  char attribute_name[MAX_CLASS_NAMELEN];
+  uint16_t acount = read16(buffer);
+  for (int i = 0; i < acount; i++) {
+    uint16_t name_index = read16(buffer);
+    uint32_t attribute_length = read32(buffer);
+    if (extract_utf8(cpool, name_index, attribute_name, MAX_CLASS_NAMELEN) &&
+        strcmp(attribute_name, name) == 0) {
+      if (length != nullptr) {
+        *length = attribute_length;
+      }
+      return buffer;
+    }
+    buffer += attribute_length;
+  }
+  return nullptr;
+}
+
 static DexField* make_dexfield(std::vector<cp_entry>& cpool,
                                DexType* self,
-                               cp_field_info& finfo) {
+                               cp_field_info& finfo,
+                               bool program_class) {
   char dbuffer[MAX_CLASS_NAMELEN];
   char nbuffer[MAX_CLASS_NAMELEN];
   if (!extract_utf8(cpool, finfo.nameNdx, nbuffer, MAX_CLASS_NAMELEN) ||
@@ -221,7 +265,9 @@ static DexField* make_dexfield(std::vector<cp_entry>& cpool,
   DexField* field =
       static_cast<DexField*>(DexField::make_field(self, name, desc));
   field->set_access((DexAccessFlags)finfo.aflags);
-  field->set_external();
+  if (!program_class) {
+    field->set_external();
+  }
   return field;
 }
 
@@ -324,7 +370,8 @@ static DexTypeList* extract_arguments(const char*& buf) {
 
 static DexMethod* make_dexmethod(std::vector<cp_entry>& cpool,
                                  DexType* self,
-                                 cp_method_info& finfo) {
+                                 cp_method_info& finfo,
+                                 bool program_class) {
   char dbuffer[MAX_CLASS_NAMELEN];
   char nbuffer[MAX_CLASS_NAMELEN];
   if (!extract_utf8(cpool, finfo.nameNdx, nbuffer, MAX_CLASS_NAMELEN) ||
@@ -354,16 +401,344 @@ static DexMethod* make_dexmethod(std::vector<cp_entry>& cpool,
     }
   } else if (access & (ACC_PRIVATE | ACC_STATIC))
     is_virt = false;
+  if (program_class) {
+    // As in dex files, static initializers are constructors too, and only
+    // native methods keep the synchronized flag.
+    if (nbuffer[0] == '<') {
+      access |= ACC_CONSTRUCTOR;
+    }
+    if ((access & ACC_SYNCHRONIZED) && !(access & ACC_NATIVE)) {
+      access = (access & ~ACC_SYNCHRONIZED) | ACC_DECLARED_SYNCHRONIZED;
+    }
+    // The code is translated once the attributes of the class are parsed.
+    return method->make_concrete((DexAccessFlags)access, is_virt);
+  }
   method->set_access((DexAccessFlags)access);
   method->set_virtual(is_virt);
   method->set_external();
   return method;
 }
 
+static DexProto* make_proto(const std::string& descriptor) {
+  const char* ptr = descriptor.c_str();
+  if (*ptr != '(') {
+    fprintf(stderr, "Invalid method descriptor '%s', bailing\n", ptr);
+    return nullptr;
+  }
+  DexTypeList* tlist = extract_arguments(ptr);
+  if (tlist == nullptr) return nullptr;
+  DexType* rtype = parse_type(ptr);
+  if (rtype == nullptr) return nullptr;
+  return DexProto::make_proto(rtype, tlist);
+}
+
+namespace {
+
+// The constant pool of a program class, as needed to translate the code of its
+// methods.
+class ClassConstantPool final : public jvm_bytecode::ConstantPool {
+ public:
+  explicit ClassConstantPool(const std::vector<cp_entry>& cpool)
+      : m_cpool(cpool) {}
+
+  void set_bootstrap_methods(uint8_t* attribute) {
+    m_bootstrap_methods = attribute;
+  }
+
+  bool get_utf8(uint16_t index, std::string* utf8) const override {
+    const cp_entry* cpe = entry(index, CP_CONST_UTF8);
+    if (cpe == nullptr) {
+      return false;
+    }
+    utf8->assign(reinterpret_cast<const char*>(cpe->data), cpe->len);
+    return true;
+  }
+
+  bool get_constant(uint16_t index,
+                    jvm_bytecode::Constant* constant) const override {
+    using Kind = jvm_bytecode::Constant::Kind;
+    const cp_entry* cpe = entry(index);
+    if (cpe == nullptr) {
+      return false;
+    }
+    switch (cpe->tag) {
+    case CP_CONST_INT:
+    case CP_CONST_FLOAT:
+      constant->kind = cpe->tag == CP_CONST_INT ? Kind::INT : Kind::FLOAT;
+      constant->bits = static_cast<int32_t>(cpe->i0);
+      return true;
+    case CP_CONST_LONG:
+    case CP_CONST_DOUBLE:
+      constant->kind = cpe->tag == CP_CONST_LONG ? Kind::LONG : Kind::DOUBLE;
+      constant->bits = (static_cast<uint64_t>(cpe->i0) << 32) | cpe->i1;
+      return true;
+    case CP_CONST_STRING: {
+      std::string utf8;
+      if (!get_utf8(cpe->s0, &utf8)) {
+        return false;
+      }
+      constant->kind = Kind::STRING;
+      constant->string = DexString::make_string(utf8);
+      return true;
+    }
+    case CP_CONST_CLASS:
+      constant->kind = Kind::CLASS;
+      constant->type = get_type(index);
+      return constant->type != nullptr;
+    }
+    fprintf(stderr, "Unsupported constant with tag %d, bailing\n", cpe->tag);
+    return false;
+  }
+
+  DexType* get_type(uint16_t index) const override {
+    const cp_entry* cpe = entry(index, CP_CONST_CLASS);
+    std::string name;
+    if (cpe == nullptr || !get_utf8(cpe->s0, &name) || name.empty()) {
+      return nullptr;
+    }
+    return DexType::make_type(
+        (name[0] == '[' ? name : "L" + name + ";").c_str());
+  }
+
+  DexFieldRef* get_field(uint16_t index) const override {
+    const cp_entry* cpe = entry(index, CP_CONST_FIELD);
+    std::string name;
+    std::string descriptor;
+    if (cpe == nullptr || !get_name_and_type(cpe->s1, &name, &descriptor)) {
+      return nullptr;
+    }
+    DexType* container = get_type(cpe->s0);
+    const char* ptr = descriptor.c_str();
+    DexType* type = parse_type(ptr);
+    if (container == nullptr || type == nullptr) {
+      return nullptr;
+    }
+    return DexField::make_field(container, DexString::make_string(name), type);
+  }
+
+  DexMethodRef* get_method(uint16_t index) const override {
+    const cp_entry* cpe = entry(index);
+    if (cpe == nullptr) {
+      return nullptr;
+    }
+    if (cpe->tag != CP_CONST_METHOD && cpe->tag != CP_CONST_INTERFACE) {
+      fprintf(stderr, "Non-method ref %d, bailing\n", index);
+      return nullptr;
+    }
+    std::string name;
+    std::string descriptor;
+    if (!get_name_and_type(cpe->s1, &name, &descriptor)) {
+      return nullptr;
+    }
+    DexType* container = get_type(cpe->s0);
+    DexProto* proto = make_proto(descriptor);
+    if (container == nullptr || proto == nullptr) {
+      return nullptr;
+    }
+    return DexMethod::make_method(container, DexString::make_string(name),
+                                  proto);
+  }
+
+  DexCallSite* get_call_site(uint16_t index) const override {
+    auto it = m_call_sites.find(index);
+    if (it != m_call_sites.end()) {
+      return it->second;
+    }
+    const cp_entry* cpe = entry(index, CP_CONST_INVOKEDYN);
+    if (cpe == nullptr) {
+      return nullptr;
+    }
+    if (m_bootstrap_methods == nullptr) {
+      fprintf(stderr, "Missing BootstrapMethods attribute, bailing\n");
+      return nullptr;
+    }
+    uint8_t* ptr = m_bootstrap_methods;
+    uint16_t methods_count = read16(ptr);
+    if (cpe->s0 >= methods_count) {
+      fprintf(stderr, "Invalid bootstrap method %d, bailing\n", cpe->s0);
+      return nullptr;
+    }
+    for (uint16_t i = 0; i < cpe->s0; i++) {
+      ptr += 2; // Skip bootstrap_method_ref
+      uint16_t args_count = read16(ptr);
+      ptr += 2 * args_count;
+    }
+    DexMethodHandle* handle = get_method_handle(read16(ptr));
+    if (handle == nullptr) {
+      return nullptr;
+    }
+    uint16_t args_count = read16(ptr);
+    std::vector<DexEncodedValue*> args;
+    for (uint16_t i = 0; i < args_count; i++) {
+      DexEncodedValue* arg = get_encoded_value(read16(ptr));
+      if (arg == nullptr) {
+        return nullptr;
+      }
+      args.push_back(arg);
+    }
+    std::string name;
+    std::string descriptor;
+    if (!get_name_and_type(cpe->s1, &name, &descriptor)) {
+      return nullptr;
+    }
+    DexProto* proto = make_proto(descriptor);
+    if (proto == nullptr) {
+      return nullptr;
+    }
+    // Never freed, as the call sites of the dex files.
+    auto* call_site =
+        new DexCallSite(handle, DexString::make_string(name), proto, args);
+    m_call_sites.emplace(index, call_site);
+    return call_site;
+  }
+
+  // The value of the ConstantValue attribute of a static field of `type`.
+  DexEncodedValue* get_field_value(uint16_t index, DexType* type) const {
+    jvm_bytecode::Constant constant;
+    if (!get_constant(index, &constant)) {
+      return nullptr;
+    }
+    if (constant.kind == jvm_bytecode::Constant::Kind::STRING) {
+      return new DexEncodedValueString(constant.string);
+    }
+    if (!type::is_primitive(type) ||
+        constant.kind == jvm_bytecode::Constant::Kind::CLASS) {
+      fprintf(stderr, "Invalid ConstantValue %d, bailing\n", index);
+      return nullptr;
+    }
+    auto* value = DexEncodedValue::zero_for_type(type);
+    value->value(type == type::_char() ? constant.bits & 0xffff
+                                       : constant.bits);
+    return value;
+  }
+
+ private:
+  const cp_entry* entry(uint16_t index) const {
+    if (index == 0 || index >= m_cpool.size()) {
+      fprintf(stderr, "Invalid constant pool index %d, bailing\n", index);
+      return nullptr;
+    }
+    return &m_cpool[index];
+  }
+
+  const cp_entry* entry(uint16_t index, uint8_t tag) const {
+    const cp_entry* cpe = entry(index);
+    if (cpe != nullptr && cpe->tag != tag) {
+      fprintf(stderr, "Unexpected tag %d of constant %d, bailing\n", cpe->tag,
+              index);
+      return nullptr;
+    }
+    return cpe;
+  }
+
+  bool get_name_and_type(uint16_t index,
+                         std::string* name,
+                         std::string* descriptor) const {
+    const cp_entry* cpe = entry(index, CP_CONST_NAMEANDTYPE);
+    return cpe != nullptr && get_utf8(cpe->s0, name) &&
+           get_utf8(cpe->s1, descriptor);
+  }
+
+  DexMethodHandle* get_method_handle(uint16_t index) const {
+    const cp_entry* cpe = entry(index, CP_CONST_METHHANDLE);
+    if (cpe == nullptr) {
+      return nullptr;
+    }
+    // Java Virtual Machine Specification Chapter 5, Section 5.4.3.5
+    switch (cpe->s0) {
+    case 1: // REF_getField
+    case 2: // REF_getStatic
+    case 3: // REF_putField
+    case 4: { // REF_putStatic
+      static const MethodHandleType kFieldTypes[] = {
+          METHOD_HANDLE_TYPE_INSTANCE_GET, METHOD_HANDLE_TYPE_STATIC_GET,
+          METHOD_HANDLE_TYPE_INSTANCE_PUT, METHOD_HANDLE_TYPE_STATIC_PUT};
+      DexFieldRef* field = get_field(cpe->s1);
+      if (field == nullptr) {
+        return nullptr;
+      }
+      return new DexMethodHandle(kFieldTypes[cpe->s0 - 1], field);
+    }
+    case 5: // REF_invokeVirtual
+    case 6: // REF_invokeStatic
+    case 7: // REF_invokeSpecial
+    case 8: // REF_newInvokeSpecial
+    case 9: { // REF_invokeInterface
+      static const MethodHandleType kMethodTypes[] = {
+          METHOD_HANDLE_TYPE_INVOKE_INSTANCE, METHOD_HANDLE_TYPE_INVOKE_STATIC,
+          METHOD_HANDLE_TYPE_INVOKE_DIRECT,
+          METHOD_HANDLE_TYPE_INVOKE_CONSTRUCTOR,
+          METHOD_HANDLE_TYPE_INVOKE_INTERFACE};
+      DexMethodRef* method = get_method(cpe->s1);
+      if (method == nullptr) {
+        return nullptr;
+      }
+      return new DexMethodHandle(kMethodTypes[cpe->s0 - 5], method);
+    }
+    }
+    fprintf(stderr, "Invalid method handle kind %d, bailing\n", cpe->s0);
+    return nullptr;
+  }
+
+  // A static argument of a bootstrap method.
+  DexEncodedValue* get_encoded_value(uint16_t index) const {
+    const cp_entry* cpe = entry(index);
+    if (cpe == nullptr) {
+      return nullptr;
+    }
+    switch (cpe->tag) {
+    case CP_CONST_METHTYPE: {
+      std::string descriptor;
+      DexProto* proto =
+          get_utf8(cpe->s0, &descriptor) ? make_proto(descriptor) : nullptr;
+      return proto == nullptr ? nullptr : new DexEncodedValueMethodType(proto);
+    }
+    case CP_CONST_METHHANDLE: {
+      DexMethodHandle* handle = get_method_handle(index);
+      return handle == nullptr ? nullptr
+                               : new DexEncodedValueMethodHandle(handle);
+    }
+    }
+    jvm_bytecode::Constant constant;
+    if (!get_constant(index, &constant)) {
+      return nullptr;
+    }
+    switch (constant.kind) {
+    case jvm_bytecode::Constant::Kind::STRING:
+      return new DexEncodedValueString(constant.string);
+    case jvm_bytecode::Constant::Kind::CLASS:
+      return new DexEncodedValueType(constant.type);
+    default:
+      break;
+    }
+    static const std::unordered_map<uint8_t, DexType* (*)()> kTypes = {
+        {CP_CONST_INT, type::_int},
+        {CP_CONST_FLOAT, type::_float},
+        {CP_CONST_LONG, type::_long},
+        {CP_CONST_DOUBLE, type::_double}};
+    auto* value = DexEncodedValue::zero_for_type(kTypes.at(cpe->tag)());
+    value->value(constant.bits);
+    return value;
+  }
+
+  const std::vector<cp_entry>& m_cpool;
+  uint8_t* m_bootstrap_methods{nullptr};
+  mutable std::unordered_map<uint16_t, DexCallSite*> m_call_sites;
+};
+
+} // namespace
+
+// Serializes the parsing of the class files that define the same type.
+static std::mutex& class_lock(const DexType* type) {
+  static std::array<std::mutex, 64> locks;
+  return locks[std::hash<const DexType*>()(type) % locks.size()];
+}
+
 bool parse_class(uint8_t* buffer,
                  Scope* classes,
                  attribute_hook_t attr_hook,
-                 const std::string& jar_location) {
+                 const std::string& jar_location,
+                 bool program_class) {
   uint32_t magic = read32(buffer);
   uint16_t vminor DEBUG_ONLY = read16(buffer);
   uint16_t vmajor DEBUG_ONLY = read16(buffer);
@@ -397,7 +772,11 @@ bool parse_class(uint8_t* buffer,
   }
 
   DexType* self = make_dextype_from_cref(cpool, clazz);
-  DexClass* cls = type_class(self);
+  // Jar entries are parsed in parallel: the class must not be published by
+  // another thread between the lookup and create(), and the lookup must not
+  // race with the classes of other types being published.
+  std::lock_guard<std::mutex> lock(class_lock(self));
+  DexClass* cls = g_redex->published_type_class(self);
   if (cls) {
     // We are seeing duplicate classes when parsing jar file
     if (cls->is_external()) {
@@ -431,7 +810,12 @@ bool parse_class(uint8_t* buffer,
   }
 
   ClassCreator cc(self, jar_location);
-  cc.set_external();
+  if (program_class) {
+    // ACC_SUPER, which dex files do not have, is ACC_SYNCHRONIZED there.
+    aflags &= ~ACC_SYNCHRONIZED;
+  } else {
+    cc.set_external();
+  }
   if (super != 0) {
     DexType* sclazz = make_dextype_from_cref(cpool, super);
     cc.set_super(sclazz);
@@ -445,6 +829,7 @@ bool parse_class(uint8_t* buffer,
     }
   }
   uint16_t fcount = read16(buffer);
+  ClassConstantPool class_cpool(cpool);
 
   auto invoke_attr_hook =
       [&](const boost::variant<DexField*, DexMethod*>& field_or_method,
@@ -475,13 +860,28 @@ bool parse_class(uint8_t* buffer,
     cpfield.descNdx = read16(buffer);
     uint8_t* attrPtr = buffer;
     skip_attributes(buffer);
-    DexField* field = make_dexfield(cpool, self, cpfield);
+    DexField* field = make_dexfield(cpool, self, cpfield, program_class);
     if (field == nullptr) return false;
+    if (program_class) {
+      DexEncodedValue* value = nullptr;
+      if (is_static(field)) {
+        uint8_t* constant_value =
+            find_attribute(cpool, attrPtr, "ConstantValue");
+        if (constant_value != nullptr) {
+          value = class_cpool.get_field_value(read16(constant_value),
+                                              field->get_type());
+          if (value == nullptr) return false;
+        }
+      }
+      field->make_concrete(field->get_access(), value);
+    }
     cc.add_field(field);
     invoke_attr_hook({field}, attrPtr);
   }
 
   uint16_t mcount = read16(buffer);
+  // The methods of a program class, with their attributes.
+  std::vector<std::pair<DexMethod*, uint8_t*>> method_attributes;
   if (mcount) {
     for (int i = 0; i < mcount; i++) {
       cp_method_info cpmethod;
@@ -491,13 +891,54 @@ bool parse_class(uint8_t* buffer,
 
       uint8_t* attrPtr = buffer;
       skip_attributes(buffer);
-      DexMethod* method = make_dexmethod(cpool, self, cpmethod);
+      DexMethod* method = make_dexmethod(cpool, self, cpmethod, program_class);
       if (method == nullptr) return false;
       cc.add_method(method);
       invoke_attr_hook({method}, attrPtr);
+      if (program_class) {
+        method_attributes.emplace_back(method, attrPtr);
+      }
+    }
+  }
+
+  DexString* source_file = nullptr;
+  if (program_class) {
+    // The code refers to the bootstrap methods, which are in the attributes of
+    // the class, after the methods.
+    uint8_t* source_file_attr = find_attribute(cpool, buffer, "SourceFile");
+    if (source_file_attr != nullptr) {
+      char nbuffer[MAX_CLASS_NAMELEN];
+      if (!extract_utf8(cpool, read16(source_file_attr), nbuffer,
+                        MAX_CLASS_NAMELEN)) {
+        return false;
+      }
+      source_file = DexString::make_string(nbuffer);
+    }
+    class_cpool.set_bootstrap_methods(
+        find_attribute(cpool, buffer, "BootstrapMethods"));
+    for (const auto& pair : method_attributes) {
+      DexMethod* method = pair.first;
+      uint32_t code_length;
+      uint8_t* code_attr =
+          find_attribute(cpool, pair.second, "Code", &code_length);
+      if (code_attr == nullptr) {
+        continue;
+      }
+      std::string error;
+      auto code = jvm_bytecode::translate(method, code_attr, code_length,
+                                          class_cpool, source_file, &error);
+      if (code == nullptr) {
+        fprintf(stderr, "Warning: cannot translate the code of %s: %s\n",
+                SHOW(method), error.c_str());
+        continue;
+      }
+      method->set_code(std::move(code));
     }
   }
   DexClass* dc = cc.create();
+  if (source_file != nullptr) {
+    dc->set_source_file(source_file);
+  }
   if (classes != nullptr) {
     classes->emplace_back(dc);
   }
@@ -533,7 +974,9 @@ bool parse_class(uint8_t* buffer,
   return true;
 }
 
-bool load_class_file(const std::string& filename, Scope* classes) {
+static bool load_class_file(const std::string& filename,
+                            Scope* classes,
+                            bool program_class) {
   // It's not exactly efficient to call init_basic_types repeatedly for each
   // class file that we load, but load_class_file should typically only be used
   // in tests to load a small number of files.
@@ -546,7 +989,15 @@ bool load_class_file(const std::string& filename, Scope* classes) {
   auto buffer = std::make_unique<char[]>(size);
   buf->sgetn(buffer.get(), size);
   return parse_class(reinterpret_cast<uint8_t*>(buffer.get()), classes,
-                     /* attr_hook */ nullptr);
+                     /* attr_hook */ nullptr, filename, program_class);
+}
+
+bool load_class_file(const std::string& filename, Scope* classes) {
+  return load_class_file(filename, classes, /* program_class */ false);
+}
+
+bool load_program_class_file(const std::string& filename, Scope* classes) {
+  return load_class_file(filename, classes, /* program_class */ true);
 }
 
 /******************
@@ -775,16 +1226,34 @@ static bool decompress_class(jar_entry& file,
 
 static const int kStartBufferSize = 128 * 1024;
 
+// The name of the class a jar entry is expected to define, e.g.
+// "java/lang/Object" for "java/lang/Object.class" and for the entries of a
+// multi-release jar "META-INF/versions/9/java/lang/Object.class".
+static std::string expected_class_name(const jar_entry& file,
+                                       size_t class_end_len) {
+  std::string name(reinterpret_cast<const char*>(file.filename),
+                   file.cd_entry.fname_len - class_end_len);
+  static const std::string versions_prefix = "META-INF/versions/";
+  if (name.compare(0, versions_prefix.size(), versions_prefix) == 0) {
+    auto version_end = name.find('/', versions_prefix.size());
+    if (version_end != std::string::npos) {
+      name.erase(0, version_end + 1);
+    }
+  }
+  return name;
+}
+
 static bool process_jar_entries(const char* location,
                                 std::vector<jar_entry>& files,
                                 const uint8_t* mapping,
                                 Scope* classes,
-                                const attribute_hook_t& attr_hook) {
-  ssize_t bufsize = kStartBufferSize;
-  uint8_t* outbuffer = (uint8_t*)malloc(bufsize);
+                                const attribute_hook_t& attr_hook,
+                                bool program_classes) {
   static char classEndString[] = ".class";
   static size_t classEndStringLen = strlen(classEndString);
   init_basic_types();
+
+  std::vector<jar_entry*> class_files;
   for (auto& file : files) {
     if (file.cd_entry.ucomp_size == 0) continue;
     if (file.cd_entry.fname_len < (classEndStringLen + 1)) continue;
@@ -793,26 +1262,116 @@ static bool process_jar_entries(const char* location,
     uint8_t* endcomp =
         file.filename + (file.cd_entry.fname_len - classEndStringLen);
     if (memcmp(endcomp, classEndString, classEndStringLen) != 0) continue;
+    class_files.push_back(&file);
+  }
 
+  // The inflate buffer of every worker, grown as needed.
+  struct Buffer {
+    std::unique_ptr<uint8_t[]> data;
+    ssize_t size{0};
+  };
+  auto decompress_and_parse = [&](jar_entry& file, Buffer& buffer,
+                                  Scope* parsed) {
     // Resize output if necessary.
-    if (bufsize < file.cd_entry.ucomp_size) {
-      while (bufsize < file.cd_entry.ucomp_size)
-        bufsize *= 2;
-      free(outbuffer);
-      outbuffer = (uint8_t*)malloc(bufsize);
+    if (buffer.size < file.cd_entry.ucomp_size) {
+      ssize_t size = std::max<ssize_t>(buffer.size, kStartBufferSize);
+      while (size < file.cd_entry.ucomp_size) {
+        size *= 2;
+      }
+      buffer.data = std::make_unique<uint8_t[]>(size);
+      buffer.size = size;
     }
+    return decompress_class(file, mapping, buffer.data.get(), buffer.size) &&
+           parse_class(buffer.data.get(), parsed, attr_hook, location,
+                       program_classes);
+  };
 
-    if (!decompress_class(file, mapping, outbuffer, bufsize)) {
-      free(outbuffer);
-      return false;
+  // The class loaded from every entry, if any, so that the classes are added
+  // to `classes` in the order of the entries whatever the order they are
+  // parsed in.
+  std::vector<DexClass*> loaded(class_files.size(), nullptr);
+
+  // The attribute hooks are not required to be thread-safe.
+  if (attr_hook != nullptr || class_files.size() < 2) {
+    Buffer buffer;
+    for (size_t i = 0; i < class_files.size(); ++i) {
+      Scope parsed;
+      if (!decompress_and_parse(*class_files[i], buffer, &parsed)) {
+        return false;
+      }
+      if (!parsed.empty()) {
+        loaded[i] = parsed.front();
+      }
+    }
+  } else {
+    // When entries define the same class, the first one wins, as when they are
+    // loaded in order: later entries that are expected to define an already
+    // seen class are only parsed once the others are loaded.
+    std::vector<size_t> unique_entries;
+    std::vector<size_t> duplicate_entries;
+    std::unordered_set<std::string> seen;
+    for (size_t i = 0; i < class_files.size(); ++i) {
+      auto name = expected_class_name(*class_files[i], classEndStringLen);
+      (seen.insert(std::move(name)).second ? unique_entries
+                                           : duplicate_entries)
+          .push_back(i);
     }
 
-    if (!parse_class(outbuffer, classes, attr_hook, location)) {
-      free(outbuffer);
+    auto num_threads = redex_parallel::default_num_threads();
+    std::vector<Buffer> buffers(num_threads);
+    std::atomic<bool> failed{false};
+    // Rethrown in the order of the entries, as if they were loaded in order.
+    std::vector<std::exception_ptr> exceptions(class_files.size());
+    workqueue_run<size_t>(
+        [&](sparta::SpartaWorkerState<size_t>* state, size_t i) {
+          if (failed.load(std::memory_order_relaxed)) {
+            return;
+          }
+          Scope parsed;
+          try {
+            if (!decompress_and_parse(*class_files[i],
+                                      buffers[state->worker_id()], &parsed)) {
+              failed = true;
+              return;
+            }
+          } catch (...) {
+            exceptions[i] = std::current_exception();
+            failed = true;
+            return;
+          }
+          if (!parsed.empty()) {
+            loaded[i] = parsed.front();
+          }
+        },
+        unique_entries, num_threads);
+    for (const auto& exception : exceptions) {
+      if (exception) {
+        std::rethrow_exception(exception);
+      }
+    }
+    if (failed) {
       return false;
     }
+
+    Buffer& buffer = buffers.front();
+    for (size_t i : duplicate_entries) {
+      Scope parsed;
+      if (!decompress_and_parse(*class_files[i], buffer, &parsed)) {
+        return false;
+      }
+      if (!parsed.empty()) {
+        loaded[i] = parsed.front();
+      }
+    }
+  }
+
+  if (classes != nullptr) {
+    for (auto* cls : loaded) {
+      if (cls != nullptr) {
+        classes->push_back(cls);
+      }
+    }
   }
-  free(outbuffer);
   return true;
 }
 
@@ -820,21 +1379,24 @@ bool process_jar(const char* location,
                  const uint8_t* mapping,
                  ssize_t size,
                  Scope* classes,
-                 const attribute_hook_t& attr_hook) {
+                 const attribute_hook_t& attr_hook,
+                 bool program_classes) {
   pk_cdir_end pce;
   std::vector<jar_entry> files;
   if (!find_central_directory(mapping, size, pce)) return false;
   if (!validate_pce(pce, size)) return false;
   if (!get_jar_entries(mapping, pce, files)) return false;
-  if (!process_jar_entries(location, files, mapping, classes, attr_hook)) {
+  if (!process_jar_entries(location, files, mapping, classes, attr_hook,
+                           program_classes)) {
     return false;
   }
   return true;
 }
 
-bool load_jar_file(const char* location,
-                   Scope* classes,
-                   const attribute_hook_t& attr_hook) {
+static bool load_jar_file(const char* location,
+                          Scope* classes,
+                          const attribute_hook_t& attr_hook,
+                          bool program_classes) {
   boost::iostreams::mapped_file file;
   try {
     file.open(location, boost::iostreams::mapped_file::readonly);
@@ -844,13 +1406,160 @@ bool load_jar_file(const char* location,
   }
 
   auto mapping = reinterpret_cast<const uint8_t*>(file.const_data());
-  if (!process_jar(location, mapping, file.size(), classes, attr_hook)) {
+  if (!process_jar(location, mapping, file.size(), classes, attr_hook,
+                   program_classes)) {
     fprintf(stderr, "error: cannot process jar: %s\n", location);
     return false;
   }
   return true;
 }
 
+bool load_jar_file(const char* location,
+                   Scope* classes,
+                   const attribute_hook_t& attr_hook) {
+  return load_jar_file(location, classes, attr_hook,
+                       /* program_classes */ false);
+}
+
+bool load_program_jar_file(const char* location, Scope* classes) {
+  return load_jar_file(location, classes, /* attr_hook */ nullptr,
+                       /* program_classes */ true);
+}
+
+namespace {
+
+/*
+ * The classes of the jars loaded with load_jar_file_lazily(): the class
+ * entries are indexed by the name of the class they are expected to define,
+ * and an entry is only decompressed and parsed when its class is first looked
+ * up.
+ */
+class LazyJarClasses final : public LazyClassSource {
+ public:
+  ~LazyJarClasses() override {
+    for (auto& entry : m_entries) {
+      delete entry.second->cls;
+    }
+  }
+
+  // Not thread-safe.
+  bool add_jar(const char* location) {
+    auto jar = std::make_unique<Jar>();
+    jar->location = location;
+    try {
+      jar->file.open(location, boost::iostreams::mapped_file::readonly);
+    } catch (const std::exception& e) {
+      fprintf(stderr, "error: cannot open jar file: %s\n", location);
+      return false;
+    }
+    auto mapping = reinterpret_cast<const uint8_t*>(jar->file.const_data());
+    auto size = static_cast<ssize_t>(jar->file.size());
+    pk_cdir_end pce;
+    if (!find_central_directory(mapping, size, pce) ||
+        !validate_pce(pce, size) ||
+        !get_jar_entries(mapping, pce, jar->entries)) {
+      fprintf(stderr, "error: cannot process jar: %s\n", location);
+      return false;
+    }
+    static const std::string class_end = ".class";
+    for (auto& file : jar->entries) {
+      if (file.cd_entry.ucomp_size == 0 ||
+          file.cd_entry.fname_len < class_end.size() + 1 ||
+          memcmp(file.filename + file.cd_entry.fname_len - class_end.size(),
+                 class_end.c_str(), class_end.size()) != 0) {
+        continue;
+      }
+      auto entry = std::make_unique<Entry>();
+      entry->jar = jar.get();
+      entry->file = &file;
+      // The first entry of a class wins, as when the jars are loaded eagerly.
+      m_entries.emplace("L" + expected_class_name(file, class_end.size()) + ";",
+                        std::move(entry));
+    }
+    m_jars.push_back(std::move(jar));
+    return true;
+  }
+
+  DexClass* type_class(const DexType* type) override {
+    if (type == s_creating) {
+      // parse_class() checks that the class does not exist yet.
+      return nullptr;
+    }
+    auto it = m_entries.find(type->str());
+    if (it == m_entries.end()) {
+      return nullptr;
+    }
+    auto& entry = *it->second;
+    std::call_once(entry.created, [&] { entry.cls = create(type, entry); });
+    return entry.cls;
+  }
+
+  bool publish_class(DexClass* /* cls */) override {
+    return s_creating != nullptr;
+  }
+
+ private:
+  struct Jar {
+    std::string location;
+    boost::iostreams::mapped_file file;
+    std::vector<jar_entry> entries;
+  };
+
+  struct Entry {
+    Jar* jar;
+    jar_entry* file;
+    std::once_flag created;
+    DexClass* cls{nullptr};
+  };
+
+  static DexClass* create(const DexType* type, Entry& entry) {
+    auto mapping =
+        reinterpret_cast<const uint8_t*>(entry.jar->file.const_data());
+    std::vector<uint8_t> buffer(entry.file->cd_entry.ucomp_size);
+    Scope created;
+    s_creating = type;
+    bool parsed =
+        decompress_class(*entry.file, mapping, buffer.data(), buffer.size()) &&
+        parse_class(buffer.data(), &created, /* attr_hook */ nullptr,
+                    entry.jar->location);
+    s_creating = nullptr;
+    if (!parsed || created.size() != 1 || created[0]->get_type() != type) {
+      fprintf(stderr, "error: cannot load %s from jar: %s\n",
+              type->c_str(), entry.jar->location.c_str());
+      for (auto* cls : created) {
+        delete cls;
+      }
+      return nullptr;
+    }
+    TRACE(MAIN, 5, "Loaded %s lazily from %s", type->c_str(),
+          entry.jar->location.c_str());
+    return created[0];
+  }
+
+  // The type whose class is being created by the calling thread, if any.
+  static thread_local const DexType* s_creating;
+
+  std::vector<std::unique_ptr<Jar>> m_jars;
+  // Not modified once the passes run, so it is read without locks.
+  std::unordered_map<std::string, std::unique_ptr<Entry>> m_entries;
+};
+
+thread_local const DexType* LazyJarClasses::s_creating = nullptr;
+
+} // namespace
+
+bool load_jar_file_lazily(const char* location) {
+  init_basic_types();
+  auto* source = dynamic_cast<LazyJarClasses*>(g_redex->lazy_class_source());
+  if (source == nullptr) {
+    always_assert_log(g_redex->lazy_class_source() == nullptr,
+                      "Another lazy class source is installed");
+    g_redex->set_lazy_class_source(std::make_unique<LazyJarClasses>());
+    source = static_cast<LazyJarClasses*>(g_redex->lazy_class_source());
+  }
+  return source->add_jar(location);
+}
+
 //#define LOCAL_MAIN
 #ifdef LOCAL_MAIN
 int main(int argc, char* argv[]) {
@@ -26,20 +26,41 @@ using attribute_hook_t =
                        const char* attribute_name,
                        uint8_t* attribute_pointer)>;
 
+// Loads the classes of a jar as external classes, and appends them to
+// `classes` in the order of the jar entries. The entries are decompressed and
+// parsed in parallel, unless there is an attribute hook, which is then called
+// on the calling thread.
 bool load_jar_file(const char* location,
                    Scope* classes = nullptr,
                    const attribute_hook_t& = nullptr);
 
+// Indexes the class entries of a jar, and only creates the class of an entry,
+// as an external class, when type_class() is first called on its type. The
+// classes are not returned in a Scope, and are neither in
+// RedexContext::external_classes() nor walked by walk_type_class(), see
+// LazyClassSource. The jar stays mapped until g_redex is deleted.
+bool load_jar_file_lazily(const char* location);
+
 bool load_class_file(const std::string& filename, Scope* classes = nullptr);
 
+// Loads the classes of a jar, or of a class file, as program classes: the code
+// of their methods is translated from JVM bytecode, see
+// JvmBytecodeTranslator.h. The methods whose code cannot be translated are
+// left without code, with a warning.
+bool load_program_jar_file(const char* location, Scope* classes);
+
+bool load_program_class_file(const std::string& filename, Scope* classes);
+
 void init_basic_types();
 bool process_jar(const char* location,
                  const uint8_t* mapping,
                  ssize_t size,
                  Scope* classes,
-                 const attribute_hook_t& attr_hook);
+                 const attribute_hook_t& attr_hook,
+                 bool program_classes = false);
 
 bool parse_class(uint8_t* buffer,
                  Scope* classes,
                  attribute_hook_t attr_hook,
-                 const std::string& jar_location = "");
+                 const std::string& jar_location = "",
+                 bool program_class = false);
@@ -0,0 +1,1819 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "JvmBytecodeTranslator.h"
+
+#include <array>
+#include <boost/optional.hpp>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "DexCallSite.h"
+#include "DexClass.h"
+#include "DexPosition.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "Show.h"
+#include "TypeUtil.h"
+
+namespace jvm_bytecode {
+
+namespace {
+
+/* clang-format off */
+
+// Java Virtual Machine Specification Chapter 6, Section 6.5
+enum JvmOpcode : uint8_t {
+  JVM_NOP             = 0x00,
+  JVM_ACONST_NULL     = 0x01,
+  JVM_ICONST_M1       = 0x02,
+  JVM_ICONST_5        = 0x08,
+  JVM_LCONST_0        = 0x09,
+  JVM_LCONST_1        = 0x0a,
+  JVM_FCONST_0        = 0x0b,
+  JVM_FCONST_1        = 0x0c,
+  JVM_FCONST_2        = 0x0d,
+  JVM_DCONST_0        = 0x0e,
+  JVM_DCONST_1        = 0x0f,
+  JVM_BIPUSH          = 0x10,
+  JVM_SIPUSH          = 0x11,
+  JVM_LDC             = 0x12,
+  JVM_LDC_W           = 0x13,
+  JVM_LDC2_W          = 0x14,
+  JVM_ILOAD           = 0x15,
+  JVM_LLOAD           = 0x16,
+  JVM_FLOAD           = 0x17,
+  JVM_DLOAD           = 0x18,
+  JVM_ALOAD           = 0x19,
+  JVM_ILOAD_0         = 0x1a,
+  JVM_ALOAD_3         = 0x2d,
+  JVM_IALOAD          = 0x2e,
+  JVM_LALOAD          = 0x2f,
+  JVM_FALOAD          = 0x30,
+  JVM_DALOAD          = 0x31,
+  JVM_AALOAD          = 0x32,
+  JVM_BALOAD          = 0x33,
+  JVM_CALOAD          = 0x34,
+  JVM_SALOAD          = 0x35,
+  JVM_ISTORE          = 0x36,
+  JVM_LSTORE          = 0x37,
+  JVM_FSTORE          = 0x38,
+  JVM_DSTORE          = 0x39,
+  JVM_ASTORE          = 0x3a,
+  JVM_ISTORE_0        = 0x3b,
+  JVM_ASTORE_3        = 0x4e,
+  JVM_IASTORE         = 0x4f,
+  JVM_LASTORE         = 0x50,
+  JVM_FASTORE         = 0x51,
+  JVM_DASTORE         = 0x52,
+  JVM_AASTORE         = 0x53,
+  JVM_BASTORE         = 0x54,
+  JVM_CASTORE         = 0x55,
+  JVM_SASTORE         = 0x56,
+  JVM_POP             = 0x57,
+  JVM_POP2            = 0x58,
+  JVM_DUP             = 0x59,
+  JVM_DUP_X1          = 0x5a,
+  JVM_DUP_X2          = 0x5b,
+  JVM_DUP2            = 0x5c,
+  JVM_DUP2_X1         = 0x5d,
+  JVM_DUP2_X2         = 0x5e,
+  JVM_SWAP            = 0x5f,
+  JVM_IADD            = 0x60,
+  JVM_LADD            = 0x61,
+  JVM_FADD            = 0x62,
+  JVM_DADD            = 0x63,
+  JVM_ISUB            = 0x64,
+  JVM_LSUB            = 0x65,
+  JVM_FSUB            = 0x66,
+  JVM_DSUB            = 0x67,
+  JVM_IMUL            = 0x68,
+  JVM_LMUL            = 0x69,
+  JVM_FMUL            = 0x6a,
+  JVM_DMUL            = 0x6b,
+  JVM_IDIV            = 0x6c,
+  JVM_LDIV            = 0x6d,
+  JVM_FDIV            = 0x6e,
+  JVM_DDIV            = 0x6f,
+  JVM_IREM            = 0x70,
+  JVM_LREM            = 0x71,
+  JVM_FREM            = 0x72,
+  JVM_DREM            = 0x73,
+  JVM_INEG            = 0x74,
+  JVM_LNEG            = 0x75,
+  JVM_FNEG            = 0x76,
+  JVM_DNEG            = 0x77,
+  JVM_ISHL            = 0x78,
+  JVM_LSHL            = 0x79,
+  JVM_ISHR            = 0x7a,
+  JVM_LSHR            = 0x7b,
+  JVM_IUSHR           = 0x7c,
+  JVM_LUSHR           = 0x7d,
+  JVM_IAND            = 0x7e,
+  JVM_LAND            = 0x7f,
+  JVM_IOR             = 0x80,
+  JVM_LOR             = 0x81,
+  JVM_IXOR            = 0x82,
+  JVM_LXOR            = 0x83,
+  JVM_IINC            = 0x84,
+  JVM_I2L             = 0x85,
+  JVM_I2F             = 0x86,
+  JVM_I2D             = 0x87,
+  JVM_L2I             = 0x88,
+  JVM_L2F             = 0x89,
+  JVM_L2D             = 0x8a,
+  JVM_F2I             = 0x8b,
+  JVM_F2L             = 0x8c,
+  JVM_F2D             = 0x8d,
+  JVM_D2I             = 0x8e,
+  JVM_D2L             = 0x8f,
+  JVM_D2F             = 0x90,
+  JVM_I2B             = 0x91,
+  JVM_I2C             = 0x92,
+  JVM_I2S             = 0x93,
+  JVM_LCMP            = 0x94,
+  JVM_FCMPL           = 0x95,
+  JVM_FCMPG           = 0x96,
+  JVM_DCMPL           = 0x97,
+  JVM_DCMPG           = 0x98,
+  JVM_IFEQ            = 0x99,
+  JVM_IFNE            = 0x9a,
+  JVM_IFLT            = 0x9b,
+  JVM_IFGE            = 0x9c,
+  JVM_IFGT            = 0x9d,
+  JVM_IFLE            = 0x9e,
+  JVM_IF_ICMPEQ       = 0x9f,
+  JVM_IF_ICMPNE       = 0xa0,
+  JVM_IF_ICMPLT       = 0xa1,
+  JVM_IF_ICMPGE       = 0xa2,
+  JVM_IF_ICMPGT       = 0xa3,
+  JVM_IF_ICMPLE       = 0xa4,
+  JVM_IF_ACMPEQ       = 0xa5,
+  JVM_IF_ACMPNE       = 0xa6,
+  JVM_GOTO            = 0xa7,
+  JVM_JSR             = 0xa8,
+  JVM_RET             = 0xa9,
+  JVM_TABLESWITCH     = 0xaa,
+  JVM_LOOKUPSWITCH    = 0xab,
+  JVM_IRETURN         = 0xac,
+  JVM_LRETURN         = 0xad,
+  JVM_FRETURN         = 0xae,
+  JVM_DRETURN         = 0xaf,
+  JVM_ARETURN         = 0xb0,
+  JVM_RETURN          = 0xb1,
+  JVM_GETSTATIC       = 0xb2,
+  JVM_PUTSTATIC       = 0xb3,
+  JVM_GETFIELD        = 0xb4,
+  JVM_PUTFIELD        = 0xb5,
+  JVM_INVOKEVIRTUAL   = 0xb6,
+  JVM_INVOKESPECIAL   = 0xb7,
+  JVM_INVOKESTATIC    = 0xb8,
+  JVM_INVOKEINTERFACE = 0xb9,
+  JVM_INVOKEDYNAMIC   = 0xba,
+  JVM_NEW             = 0xbb,
+  JVM_NEWARRAY        = 0xbc,
+  JVM_ANEWARRAY       = 0xbd,
+  JVM_ARRAYLENGTH     = 0xbe,
+  JVM_ATHROW          = 0xbf,
+  JVM_CHECKCAST       = 0xc0,
+  JVM_INSTANCEOF      = 0xc1,
+  JVM_MONITORENTER    = 0xc2,
+  JVM_MONITOREXIT     = 0xc3,
+  JVM_WIDE            = 0xc4,
+  JVM_MULTIANEWARRAY  = 0xc5,
+  JVM_IFNULL          = 0xc6,
+  JVM_IFNONNULL       = 0xc7,
+  JVM_GOTO_W          = 0xc8,
+  JVM_JSR_W           = 0xc9,
+};
+
+/* clang-format on */
+
+// Registers after the operand stack, for the values that are shuffled by the
+// dup and swap instructions, and for the operands of multianewarray.
+constexpr reg_t kScratchRegisters = 4;
+
+uint16_t read_u2(const uint8_t* p) { return (p[0] << 8) | p[1]; }
+
+uint32_t read_u4(const uint8_t* p) {
+  return (uint32_t(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// The kinds of the values on the operand stack, as far as the IR is concerned:
+// ints and floats are both moved with move.
+enum class Kind : uint8_t { NARROW, WIDE, OBJECT };
+
+using Stack = std::vector<Kind>;
+
+uint32_t width(Kind kind) { return kind == Kind::WIDE ? 2 : 1; }
+
+uint32_t width(const Stack& stack) {
+  uint32_t slots = 0;
+  for (auto kind : stack) {
+    slots += width(kind);
+  }
+  return slots;
+}
+
+Kind kind_of(const DexType* type) {
+  return type::is_wide_type(type) ? Kind::WIDE
+         : type::is_object(type)  ? Kind::OBJECT
+                                  : Kind::NARROW;
+}
+
+IROpcode move_opcode(Kind kind) {
+  switch (kind) {
+  case Kind::NARROW:
+    return OPCODE_MOVE;
+  case Kind::WIDE:
+    return OPCODE_MOVE_WIDE;
+  case Kind::OBJECT:
+    return OPCODE_MOVE_OBJECT;
+  }
+  not_reached();
+}
+
+IROpcode move_result_opcode(Kind kind) {
+  switch (kind) {
+  case Kind::NARROW:
+    return OPCODE_MOVE_RESULT;
+  case Kind::WIDE:
+    return OPCODE_MOVE_RESULT_WIDE;
+  case Kind::OBJECT:
+    return OPCODE_MOVE_RESULT_OBJECT;
+  }
+  not_reached();
+}
+
+IROpcode move_result_pseudo_opcode(Kind kind) {
+  switch (kind) {
+  case Kind::NARROW:
+    return IOPCODE_MOVE_RESULT_PSEUDO;
+  case Kind::WIDE:
+    return IOPCODE_MOVE_RESULT_PSEUDO_WIDE;
+  case Kind::OBJECT:
+    return IOPCODE_MOVE_RESULT_PSEUDO_OBJECT;
+  }
+  not_reached();
+}
+
+// The variants of a field instruction, in the order of the IR opcodes.
+using FieldOpcodes = std::array<IROpcode, 7>;
+
+const FieldOpcodes kIget = {OPCODE_IGET,         OPCODE_IGET_WIDE,
+                            OPCODE_IGET_OBJECT,  OPCODE_IGET_BOOLEAN,
+                            OPCODE_IGET_BYTE,    OPCODE_IGET_CHAR,
+                            OPCODE_IGET_SHORT};
+const FieldOpcodes kIput = {OPCODE_IPUT,         OPCODE_IPUT_WIDE,
+                            OPCODE_IPUT_OBJECT,  OPCODE_IPUT_BOOLEAN,
+                            OPCODE_IPUT_BYTE,    OPCODE_IPUT_CHAR,
+                            OPCODE_IPUT_SHORT};
+const FieldOpcodes kSget = {OPCODE_SGET,         OPCODE_SGET_WIDE,
+                            OPCODE_SGET_OBJECT,  OPCODE_SGET_BOOLEAN,
+                            OPCODE_SGET_BYTE,    OPCODE_SGET_CHAR,
+                            OPCODE_SGET_SHORT};
+const FieldOpcodes kSput = {OPCODE_SPUT,         OPCODE_SPUT_WIDE,
+                            OPCODE_SPUT_OBJECT,  OPCODE_SPUT_BOOLEAN,
+                            OPCODE_SPUT_BYTE,    OPCODE_SPUT_CHAR,
+                            OPCODE_SPUT_SHORT};
+
+IROpcode field_opcode(const FieldOpcodes& opcodes, const DexType* type) {
+  switch (type::to_datatype(type)) {
+  case DataType::Int:
+  case DataType::Float:
+    return opcodes[0];
+  case DataType::Long:
+  case DataType::Double:
+    return opcodes[1];
+  case DataType::Object:
+  case DataType::Array:
+    return opcodes[2];
+  case DataType::Boolean:
+    return opcodes[3];
+  case DataType::Byte:
+    return opcodes[4];
+  case DataType::Char:
+    return opcodes[5];
+  case DataType::Short:
+    return opcodes[6];
+  case DataType::Void:
+    break;
+  }
+  not_reached();
+}
+
+struct Handler {
+  uint32_t start_pc;
+  uint32_t end_pc;
+  uint32_t handler_pc;
+  // Null for the handlers of finally blocks.
+  DexType* catch_type;
+};
+
+// The handlers that are tried, in order, when an instruction throws.
+using CatchChain = std::vector<std::pair<DexType*, uint32_t>>;
+
+// The IR of a reachable JVM instruction.
+struct Translation {
+  // The operand stack before the instruction.
+  Stack stack;
+  uint32_t length{0};
+  std::vector<std::unique_ptr<IRInstruction>> insns;
+};
+
+struct Branch {
+  IRInstruction* insn;
+  uint32_t target;
+  boost::optional<int32_t> case_key;
+};
+
+class Translator {
+ public:
+  Translator(DexMethod* method, const ConstantPool& cpool)
+      : m_method(method), m_cpool(cpool) {}
+
+  std::unique_ptr<IRCode> run(const uint8_t* code_attribute,
+                              uint32_t length,
+                              DexString* source_file) {
+    if (!parse(code_attribute, length) || !visit_all()) {
+      return nullptr;
+    }
+    return layout(source_file);
+  }
+
+  const std::string& error() const { return m_error; }
+
+ private:
+  bool fail(const std::string& what) {
+    if (m_error.empty()) {
+      m_error = what;
+      if (m_offset) {
+        m_error += " at offset " + std::to_string(*m_offset);
+      }
+    }
+    return false;
+  }
+
+  bool parse(const uint8_t* attribute, uint32_t length) {
+    if (length < 8) {
+      return fail("truncated Code attribute");
+    }
+    m_max_stack = read_u2(attribute);
+    m_max_locals = read_u2(attribute + 2);
+    m_code_length = read_u4(attribute + 4);
+    const uint8_t* end = attribute + length;
+    const uint8_t* ptr = attribute + 8;
+    if (m_code_length == 0 || m_code_length > uint32_t(end - ptr)) {
+      return fail("invalid code length");
+    }
+    m_code = ptr;
+    ptr += m_code_length;
+
+    if (end - ptr < 2) {
+      return fail("truncated exception table");
+    }
+    uint16_t handlers_count = read_u2(ptr);
+    ptr += 2;
+    if (end - ptr < handlers_count * 8) {
+      return fail("truncated exception table");
+    }
+    for (uint16_t i = 0; i < handlers_count; ++i, ptr += 8) {
+      Handler handler{read_u2(ptr), read_u2(ptr + 2), read_u2(ptr + 4),
+                      nullptr};
+      uint16_t catch_type = read_u2(ptr + 6);
+      if (handler.start_pc >= handler.end_pc ||
+          handler.end_pc > m_code_length ||
+          handler.handler_pc >= m_code_length) {
+        return fail("invalid exception table entry");
+      }
+      if (catch_type != 0) {
+        handler.catch_type = m_cpool.get_type(catch_type);
+        if (handler.catch_type == nullptr) {
+          return fail("invalid catch type");
+        }
+      }
+      m_handlers.push_back(handler);
+    }
+
+    if (end - ptr < 2) {
+      return fail("truncated Code attribute");
+    }
+    uint16_t attributes_count = read_u2(ptr);
+    ptr += 2;
+    for (uint16_t i = 0; i < attributes_count; ++i) {
+      if (end - ptr < 6) {
+        return fail("truncated Code attribute");
+      }
+      uint16_t name_index = read_u2(ptr);
+      uint32_t attribute_length = read_u4(ptr + 2);
+      ptr += 6;
+      if (attribute_length > uint32_t(end - ptr)) {
+        return fail("truncated Code attribute");
+      }
+      std::string name;
+      if (!m_cpool.get_utf8(name_index, &name)) {
+        return fail("invalid attribute name");
+      }
+      if (name == "LineNumberTable" && attribute_length >= 2) {
+        uint16_t lines_count = read_u2(ptr);
+        if (attribute_length < 2 + lines_count * 4u) {
+          return fail("truncated LineNumberTable");
+        }
+        for (uint16_t j = 0; j < lines_count; ++j) {
+          const uint8_t* entry = ptr + 2 + j * 4;
+          m_lines.emplace(read_u2(entry), read_u2(entry + 2));
+        }
+      }
+      ptr += attribute_length;
+    }
+    m_scratch = m_max_locals + m_max_stack;
+    return true;
+  }
+
+  // The length of the instruction at `offset`, checked to fit in the code.
+  bool instruction_length(uint32_t offset, uint32_t* length) {
+    uint8_t op = m_code[offset];
+    switch (op) {
+    case JVM_BIPUSH:
+    case JVM_LDC:
+    case JVM_ILOAD:
+    case JVM_LLOAD:
+    case JVM_FLOAD:
+    case JVM_DLOAD:
+    case JVM_ALOAD:
+    case JVM_ISTORE:
+    case JVM_LSTORE:
+    case JVM_FSTORE:
+    case JVM_DSTORE:
+    case JVM_ASTORE:
+    case JVM_RET:
+    case JVM_NEWARRAY:
+      *length = 2;
+      break;
+    case JVM_SIPUSH:
+    case JVM_LDC_W:
+    case JVM_LDC2_W:
+    case JVM_IINC:
+    case JVM_GOTO:
+    case JVM_JSR:
+    case JVM_GETSTATIC:
+    case JVM_PUTSTATIC:
+    case JVM_GETFIELD:
+    case JVM_PUTFIELD:
+    case JVM_INVOKEVIRTUAL:
+    case JVM_INVOKESPECIAL:
+    case JVM_INVOKESTATIC:
+    case JVM_NEW:
+    case JVM_ANEWARRAY:
+    case JVM_CHECKCAST:
+    case JVM_INSTANCEOF:
+    case JVM_IFNULL:
+    case JVM_IFNONNULL:
+      *length = 3;
+      break;
+    case JVM_MULTIANEWARRAY:
+      *length = 4;
+      break;
+    case JVM_INVOKEINTERFACE:
+    case JVM_INVOKEDYNAMIC:
+    case JVM_GOTO_W:
+    case JVM_JSR_W:
+      *length = 5;
+      break;
+    case JVM_WIDE:
+      if (offset + 1 >= m_code_length) {
+        return fail("truncated instruction");
+      }
+      *length = m_code[offset + 1] == JVM_IINC ? 6 : 4;
+      break;
+    case JVM_TABLESWITCH:
+    case JVM_LOOKUPSWITCH: {
+      // The operands are 4-byte aligned from the start of the code.
+      uint32_t operands = (offset + 4) & ~3u;
+      if (operands + 12 > m_code_length) {
+        return fail("truncated instruction");
+      }
+      uint64_t cases;
+      if (op == JVM_TABLESWITCH) {
+        int32_t low = read_u4(m_code + operands + 4);
+        int32_t high = read_u4(m_code + operands + 8);
+        if (low > high) {
+          return fail("invalid tableswitch");
+        }
+        cases = int64_t(high) - low + 1;
+        *length = operands + 12 + cases * 4 - offset;
+        if (operands + 12 + cases * 4 > m_code_length) {
+          return fail("truncated instruction");
+        }
+      } else {
+        cases = read_u4(m_code + operands + 4);
+        if (operands + 8 + cases * 8 > m_code_length) {
+          return fail("truncated instruction");
+        }
+        *length = operands + 8 + cases * 8 - offset;
+      }
+      return true;
+    }
+    default:
+      if (op > JVM_JSR_W) {
+        return fail("invalid opcode " + std::to_string(op));
+      }
+      if (op >= JVM_IFEQ && op <= JVM_IF_ACMPNE) {
+        *length = 3;
+      } else {
+        *length = 1;
+      }
+      break;
+    }
+    if (offset + *length > m_code_length) {
+      return fail("truncated instruction");
+    }
+    return true;
+  }
+
+  void enqueue(uint32_t offset, const Stack& stack) {
+    if (offset >= m_code_length) {
+      fail("control flow falls off the end of the code");
+      return;
+    }
+    auto inserted = m_translations.emplace(offset, Translation());
+    auto& translation = inserted.first->second;
+    if (inserted.second) {
+      translation.stack = stack;
+      m_worklist.push_back(offset);
+    } else if (translation.stack != stack) {
+      fail("inconsistent stacks at offset " + std::to_string(offset));
+    }
+  }
+
+  bool visit_all() {
+    m_worklist.push_back(0);
+    m_translations.emplace(0, Translation());
+    while (!m_worklist.empty()) {
+      uint32_t offset = m_worklist.back();
+      m_worklist.pop_back();
+      m_offset = offset;
+      if (!visit(offset, m_translations.at(offset))) {
+        return false;
+      }
+    }
+    m_offset = boost::none;
+    // The verifier rejects the code that jumps inside an instruction.
+    uint32_t end = 0;
+    for (const auto& entry : m_translations) {
+      if (entry.first < end) {
+        return fail("overlapping instructions at offset " +
+                    std::to_string(entry.first));
+      }
+      end = entry.first + entry.second.length;
+    }
+    return true;
+  }
+
+  // Registers and stack.
+
+  reg_t local(uint32_t index, Kind kind) {
+    if (index + width(kind) > m_max_locals) {
+      fail("invalid local " + std::to_string(index));
+    }
+    return index;
+  }
+
+  reg_t push(Kind kind) {
+    reg_t reg = m_max_locals + m_slots;
+    m_stack.push_back(kind);
+    m_slots += width(kind);
+    if (m_slots > m_max_stack) {
+      fail("stack overflow");
+    }
+    return reg;
+  }
+
+  reg_t pop(Kind kind) {
+    if (m_stack.empty()) {
+      fail("stack underflow");
+      return 0;
+    }
+    if (m_stack.back() != kind) {
+      fail("unexpected kind of value on the stack");
+    }
+    m_slots -= width(m_stack.back());
+    m_stack.pop_back();
+    return m_max_locals + m_slots;
+  }
+
+  // The kind of the value `depth` values below the top of the stack.
+  boost::optional<Kind> peek(size_t depth) const {
+    if (depth >= m_stack.size()) {
+      return boost::none;
+    }
+    return m_stack[m_stack.size() - 1 - depth];
+  }
+
+  // Instructions.
+
+  IRInstruction* emit(IROpcode op) {
+    m_insns->push_back(std::make_unique<IRInstruction>(op));
+    return m_insns->back().get();
+  }
+
+  // Pushes the result of `insn`, through a move-result-pseudo if it has one.
+  void push_result(IRInstruction* insn, Kind kind) {
+    reg_t dest = push(kind);
+    if (insn->has_move_result_pseudo()) {
+      emit(move_result_pseudo_opcode(kind))->set_dest(dest);
+    } else {
+      insn->set_dest(dest);
+    }
+  }
+
+  void branch(IRInstruction* insn,
+              int64_t target,
+              boost::optional<int32_t> case_key = boost::none) {
+    if (target < 0 || target >= m_code_length) {
+      fail("invalid branch target");
+      return;
+    }
+    m_branches.push_back(Branch{insn, uint32_t(target), case_key});
+    enqueue(target, m_stack);
+  }
+
+  void constant(int32_t value) {
+    emit(OPCODE_CONST)->set_literal(value)->set_dest(push(Kind::NARROW));
+  }
+
+  void wide_constant(int64_t value) {
+    emit(OPCODE_CONST_WIDE)->set_literal(value)->set_dest(push(Kind::WIDE));
+  }
+
+  void load(Kind kind, uint32_t index) {
+    reg_t src = local(index, kind);
+    emit(move_opcode(kind))->set_src(0, src)->set_dest(push(kind));
+  }
+
+  void store(Kind kind, uint32_t index) {
+    reg_t src = pop(kind);
+    emit(move_opcode(kind))->set_src(0, src)->set_dest(local(index, kind));
+  }
+
+  void unop(IROpcode op, Kind from, Kind to) {
+    reg_t src = pop(from);
+    emit(op)->set_src(0, src)->set_dest(push(to));
+  }
+
+  void binop(IROpcode op, Kind kind, Kind rhs_kind, Kind result_kind) {
+    reg_t rhs = pop(rhs_kind);
+    reg_t lhs = pop(kind);
+    emit(op)->set_src(0, lhs)->set_src(1, rhs)->set_dest(push(result_kind));
+  }
+
+  void binop(IROpcode op, Kind kind) { binop(op, kind, kind, kind); }
+
+  void array_load(IROpcode op, Kind kind) {
+    reg_t index = pop(Kind::NARROW);
+    reg_t array = pop(Kind::OBJECT);
+    auto* insn = emit(op)->set_src(0, array)->set_src(1, index);
+    push_result(insn, kind);
+  }
+
+  void array_store(IROpcode op, Kind kind) {
+    reg_t value = pop(kind);
+    reg_t index = pop(Kind::NARROW);
+    reg_t array = pop(Kind::OBJECT);
+    emit(op)->set_src(0, value)->set_src(1, array)->set_src(2, index);
+  }
+
+  void if_zero(IROpcode op, Kind kind, uint32_t offset) {
+    reg_t src = pop(kind);
+    auto* insn = emit(op)->set_src(0, src);
+    branch(insn, offset + int16_t(read_u2(m_code + offset + 1)));
+  }
+
+  void if_compare(IROpcode op, Kind kind, uint32_t offset) {
+    reg_t rhs = pop(kind);
+    reg_t lhs = pop(kind);
+    auto* insn = emit(op)->set_src(0, lhs)->set_src(1, rhs);
+    branch(insn, offset + int16_t(read_u2(m_code + offset + 1)));
+  }
+
+  void return_value(IROpcode op, Kind kind) {
+    reg_t src = pop(kind);
+    emit(op)->set_src(0, src);
+  }
+
+  // Replaces the `count` values on top of the stack with the values at the
+  // `order` indices among them, from the bottom, moving them around with the
+  // scratch registers as needed.
+  void permute(size_t count, const std::vector<size_t>& order) {
+    if (count > m_stack.size()) {
+      fail("stack underflow");
+      return;
+    }
+    Stack old_kinds(m_stack.end() - count, m_stack.end());
+    for (size_t i = 0; i < count; ++i) {
+      pop(old_kinds[count - 1 - i]);
+    }
+    std::vector<reg_t> old_regs;
+    reg_t reg = m_max_locals + m_slots;
+    for (auto kind : old_kinds) {
+      old_regs.push_back(reg);
+      reg += width(kind);
+    }
+    std::vector<reg_t> new_regs;
+    for (auto index : order) {
+      new_regs.push_back(push(old_kinds[index]));
+    }
+    // Only the values that change register are moved, and the ones whose
+    // register is overwritten before are read from the scratch registers.
+    std::vector<bool> overwritten(count, false);
+    for (size_t j = 0; j < order.size(); ++j) {
+      if (new_regs[j] == old_regs[order[j]]) {
+        continue;
+      }
+      reg_t begin = new_regs[j];
+      reg_t end = begin + width(old_kinds[order[j]]);
+      for (size_t i = 0; i < count; ++i) {
+        if (old_regs[i] < end && begin < old_regs[i] + width(old_kinds[i])) {
+          overwritten[i] = true;
+        }
+      }
+    }
+    std::vector<reg_t> srcs(old_regs);
+    reg_t scratch = m_scratch;
+    for (size_t i = 0; i < count; ++i) {
+      if (!overwritten[i]) {
+        continue;
+      }
+      emit(move_opcode(old_kinds[i]))
+          ->set_src(0, old_regs[i])
+          ->set_dest(scratch);
+      srcs[i] = scratch;
+      scratch += width(old_kinds[i]);
+    }
+    always_assert(scratch <= m_scratch + kScratchRegisters);
+    for (size_t j = 0; j < order.size(); ++j) {
+      if (new_regs[j] != old_regs[order[j]]) {
+        emit(move_opcode(old_kinds[order[j]]))
+            ->set_src(0, srcs[order[j]])
+            ->set_dest(new_regs[j]);
+      }
+    }
+  }
+
+  bool is_narrow(size_t depth) const {
+    auto kind = peek(depth);
+    return kind && *kind != Kind::WIDE;
+  }
+
+  bool is_wide(size_t depth) const {
+    auto kind = peek(depth);
+    return kind && *kind == Kind::WIDE;
+  }
+
+  void stack_op(uint8_t op) {
+    switch (op) {
+    case JVM_POP:
+      if (!is_narrow(0)) {
+        fail("invalid pop");
+        return;
+      }
+      m_slots -= 1;
+      m_stack.pop_back();
+      return;
+    case JVM_POP2:
+      if (is_wide(0)) {
+        m_slots -= 2;
+        m_stack.pop_back();
+      } else if (is_narrow(0) && is_narrow(1)) {
+        m_slots -= 2;
+        m_stack.resize(m_stack.size() - 2);
+      } else {
+        fail("invalid pop2");
+      }
+      return;
+    case JVM_DUP:
+      if (!is_narrow(0)) {
+        break;
+      }
+      permute(1, {0, 0});
+      return;
+    case JVM_DUP_X1:
+      if (!is_narrow(0) || !is_narrow(1)) {
+        break;
+      }
+      permute(2, {1, 0, 1});
+      return;
+    case JVM_DUP_X2:
+      if (!is_narrow(0)) {
+        break;
+      }
+      if (is_wide(1)) {
+        permute(2, {1, 0, 1});
+      } else if (is_narrow(1) && is_narrow(2)) {
+        permute(3, {2, 0, 1, 2});
+      } else {
+        break;
+      }
+      return;
+    case JVM_DUP2:
+      if (is_wide(0)) {
+        permute(1, {0, 0});
+      } else if (is_narrow(0) && is_narrow(1)) {
+        permute(2, {0, 1, 0, 1});
+      } else {
+        break;
+      }
+      return;
+    case JVM_DUP2_X1:
+      if (is_wide(0) && is_narrow(1)) {
+        permute(2, {1, 0, 1});
+      } else if (is_narrow(0) && is_narrow(1) && is_narrow(2)) {
+        permute(3, {1, 2, 0, 1, 2});
+      } else {
+        break;
+      }
+      return;
+    case JVM_DUP2_X2:
+      if (is_wide(0) && is_wide(1)) {
+        permute(2, {1, 0, 1});
+      } else if (is_wide(0) && is_narrow(1) && is_narrow(2)) {
+        permute(3, {2, 0, 1, 2});
+      } else if (is_narrow(0) && is_narrow(1) && is_wide(2)) {
+        permute(3, {1, 2, 0, 1, 2});
+      } else if (is_narrow(0) && is_narrow(1) && is_narrow(2) &&
+                 is_narrow(3)) {
+        permute(4, {2, 3, 0, 1, 2, 3});
+      } else {
+        break;
+      }
+      return;
+    case JVM_SWAP:
+      if (!is_narrow(0) || !is_narrow(1)) {
+        break;
+      }
+      permute(2, {1, 0});
+      return;
+    default:
+      not_reached();
+    }
+    fail("invalid operands of " + std::to_string(op));
+  }
+
+  void ldc(uint16_t index, bool wide) {
+    Constant value;
+    if (!m_cpool.get_constant(index, &value)) {
+      fail("invalid constant " + std::to_string(index));
+      return;
+    }
+    bool is_wide = value.kind == Constant::Kind::LONG ||
+                   value.kind == Constant::Kind::DOUBLE;
+    if (is_wide != wide) {
+      fail("unexpected kind of constant " + std::to_string(index));
+      return;
+    }
+    switch (value.kind) {
+    case Constant::Kind::INT:
+    case Constant::Kind::FLOAT:
+      constant(int32_t(value.bits));
+      return;
+    case Constant::Kind::LONG:
+    case Constant::Kind::DOUBLE:
+      wide_constant(value.bits);
+      return;
+    case Constant::Kind::STRING:
+      push_result(emit(OPCODE_CONST_STRING)->set_string(value.string),
+                  Kind::OBJECT);
+      return;
+    case Constant::Kind::CLASS:
+      push_result(emit(OPCODE_CONST_CLASS)->set_type(value.type),
+                  Kind::OBJECT);
+      return;
+    }
+  }
+
+  void field_op(uint8_t op, uint16_t index) {
+    auto* field = m_cpool.get_field(index);
+    if (field == nullptr) {
+      fail("invalid field " + std::to_string(index));
+      return;
+    }
+    auto* type = field->get_type();
+    Kind kind = kind_of(type);
+    switch (op) {
+    case JVM_GETSTATIC:
+      push_result(emit(field_opcode(kSget, type))->set_field(field), kind);
+      return;
+    case JVM_PUTSTATIC: {
+      reg_t value = pop(kind);
+      emit(field_opcode(kSput, type))->set_field(field)->set_src(0, value);
+      return;
+    }
+    case JVM_GETFIELD: {
+      reg_t object = pop(Kind::OBJECT);
+      auto* insn =
+          emit(field_opcode(kIget, type))->set_field(field)->set_src(0, object);
+      push_result(insn, kind);
+      return;
+    }
+    case JVM_PUTFIELD: {
+      reg_t value = pop(kind);
+      reg_t object = pop(Kind::OBJECT);
+      emit(field_opcode(kIput, type))
+          ->set_field(field)
+          ->set_src(0, value)
+          ->set_src(1, object);
+      return;
+    }
+    default:
+      not_reached();
+    }
+  }
+
+  void invoke(uint8_t op, uint16_t index) {
+    auto* callee = m_cpool.get_method(index);
+    if (callee == nullptr) {
+      fail("invalid method " + std::to_string(index));
+      return;
+    }
+    IROpcode opcode;
+    switch (op) {
+    case JVM_INVOKEVIRTUAL:
+      opcode = OPCODE_INVOKE_VIRTUAL;
+      break;
+    case JVM_INVOKESTATIC:
+      opcode = OPCODE_INVOKE_STATIC;
+      break;
+    case JVM_INVOKEINTERFACE:
+      opcode = OPCODE_INVOKE_INTERFACE;
+      break;
+    case JVM_INVOKESPECIAL:
+      // Constructors and the private methods of the class are direct, the
+      // other methods are those of a superclass or superinterface.
+      opcode = callee->get_name()->str() == "<init>" ||
+                       callee->get_class() == m_method->get_class()
+                   ? OPCODE_INVOKE_DIRECT
+                   : OPCODE_INVOKE_SUPER;
+      break;
+    default:
+      not_reached();
+    }
+    const auto& args = callee->get_proto()->get_args()->get_type_list();
+    bool has_receiver = opcode != OPCODE_INVOKE_STATIC;
+    std::vector<reg_t> srcs(args.size() + has_receiver);
+    for (size_t i = args.size(); i > 0; --i) {
+      srcs[i - 1 + has_receiver] = pop(kind_of(args[i - 1]));
+    }
+    if (has_receiver) {
+      srcs[0] = pop(Kind::OBJECT);
+    }
+    auto* insn = emit(opcode)->set_method(callee);
+    insn->set_srcs_size(srcs.size());
+    for (size_t i = 0; i < srcs.size(); ++i) {
+      insn->set_src(i, srcs[i]);
+    }
+    auto* rtype = callee->get_proto()->get_rtype();
+    if (rtype != type::_void()) {
+      Kind kind = kind_of(rtype);
+      emit(move_result_opcode(kind))->set_dest(push(kind));
+    }
+  }
+
+  void invoke_dynamic(uint16_t index) {
+    auto* call_site = m_cpool.get_call_site(index);
+    if (call_site == nullptr) {
+      fail("invalid call site " + std::to_string(index));
+      return;
+    }
+    // As in the IR loaded from dex files, the wide arguments of invoke-custom
+    // take two registers.
+    const auto& args = call_site->method_type()->get_args()->get_type_list();
+    std::vector<reg_t> srcs;
+    for (auto it = args.rbegin(); it != args.rend(); ++it) {
+      Kind kind = kind_of(*it);
+      reg_t src = pop(kind);
+      if (kind == Kind::WIDE) {
+        srcs.push_back(src + 1);
+      }
+      srcs.push_back(src);
+    }
+    auto* insn = emit(OPCODE_INVOKE_CUSTOM)->set_callsite(call_site);
+    insn->set_srcs_size(srcs.size());
+    for (size_t i = 0; i < srcs.size(); ++i) {
+      insn->set_src(i, srcs[srcs.size() - 1 - i]);
+    }
+    auto* rtype = call_site->method_type()->get_rtype();
+    if (rtype != type::_void()) {
+      Kind kind = kind_of(rtype);
+      emit(move_result_opcode(kind))->set_dest(push(kind));
+    }
+  }
+
+  void new_array(DexType* array_type) {
+    reg_t count = pop(Kind::NARROW);
+    auto* insn =
+        emit(OPCODE_NEW_ARRAY)->set_type(array_type)->set_src(0, count);
+    push_result(insn, Kind::OBJECT);
+  }
+
+  // As dx does, an array of several dimensions is created with
+  // Array.newInstance(Class, int[]).
+  void multi_new_array(uint16_t index, uint8_t dimensions) {
+    auto* array_type = m_cpool.get_type(index);
+    if (array_type == nullptr) {
+      fail("invalid type " + std::to_string(index));
+      return;
+    }
+    DexType* component = array_type;
+    for (uint8_t i = 0; i < dimensions && component != nullptr; ++i) {
+      component = type::get_array_component_type(component);
+    }
+    if (dimensions == 0 || component == nullptr) {
+      fail("invalid multianewarray of " + show(array_type));
+      return;
+    }
+    if (dimensions == 1) {
+      new_array(array_type);
+      return;
+    }
+    std::vector<reg_t> counts(dimensions);
+    for (size_t i = dimensions; i > 0; --i) {
+      counts[i - 1] = pop(Kind::NARROW);
+    }
+    reg_t counts_array = m_scratch;
+    reg_t component_class = m_scratch + 1;
+    auto* fill = emit(OPCODE_FILLED_NEW_ARRAY)
+                     ->set_type(type::make_array_type(type::_int()));
+    fill->set_srcs_size(dimensions);
+    for (size_t i = 0; i < dimensions; ++i) {
+      fill->set_src(i, counts[i]);
+    }
+    emit(fill->has_move_result_pseudo() ? IOPCODE_MOVE_RESULT_PSEUDO_OBJECT
+                                        : OPCODE_MOVE_RESULT_OBJECT)
+        ->set_dest(counts_array);
+    if (type::is_primitive(component)) {
+      emit(OPCODE_SGET_OBJECT)
+          ->set_field(DexField::make_field(
+              type::get_boxed_reference_type(component),
+              DexString::make_string("TYPE"), type::java_lang_Class()));
+    } else {
+      emit(OPCODE_CONST_CLASS)->set_type(component);
+    }
+    emit(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT)->set_dest(component_class);
+    emit(OPCODE_INVOKE_STATIC)
+        ->set_method(DexMethod::make_method(
+            "Ljava/lang/reflect/Array;.newInstance:"
+            "(Ljava/lang/Class;[I)Ljava/lang/Object;"))
+        ->set_srcs_size(2)
+        ->set_src(0, component_class)
+        ->set_src(1, counts_array);
+    reg_t array = push(Kind::OBJECT);
+    emit(OPCODE_MOVE_RESULT_OBJECT)->set_dest(array);
+    emit(OPCODE_CHECK_CAST)->set_type(array_type)->set_src(0, array);
+    emit(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT)->set_dest(array);
+  }
+
+  void type_op(uint8_t op, uint16_t index) {
+    auto* type = m_cpool.get_type(index);
+    if (type == nullptr) {
+      fail("invalid type " + std::to_string(index));
+      return;
+    }
+    switch (op) {
+    case JVM_NEW:
+      push_result(emit(OPCODE_NEW_INSTANCE)->set_type(type), Kind::OBJECT);
+      return;
+    case JVM_ANEWARRAY:
+      new_array(type::make_array_type(type));
+      return;
+    case JVM_CHECKCAST: {
+      reg_t object = pop(Kind::OBJECT);
+      push_result(emit(OPCODE_CHECK_CAST)->set_type(type)->set_src(0, object),
+                  Kind::OBJECT);
+      return;
+    }
+    case JVM_INSTANCEOF: {
+      reg_t object = pop(Kind::OBJECT);
+      push_result(emit(OPCODE_INSTANCE_OF)->set_type(type)->set_src(0, object),
+                  Kind::NARROW);
+      return;
+    }
+    default:
+      not_reached();
+    }
+  }
+
+  void switch_op(uint8_t op, uint32_t offset) {
+    uint32_t operands = (offset + 4) & ~3u;
+    int32_t default_offset = read_u4(m_code + operands);
+    std::vector<std::pair<int32_t, int32_t>> cases;
+    if (op == JVM_TABLESWITCH) {
+      int32_t low = read_u4(m_code + operands + 4);
+      int32_t high = read_u4(m_code + operands + 8);
+      for (int64_t key = low; key <= high; ++key) {
+        cases.emplace_back(
+            key, read_u4(m_code + operands + 12 + (key - low) * 4));
+      }
+    } else {
+      uint32_t pairs = read_u4(m_code + operands + 4);
+      for (uint32_t i = 0; i < pairs; ++i) {
+        const uint8_t* pair = m_code + operands + 8 + i * 8;
+        cases.emplace_back(read_u4(pair), read_u4(pair + 4));
+      }
+    }
+    reg_t key = pop(Kind::NARROW);
+    if (!cases.empty()) {
+      auto* insn = emit(OPCODE_SWITCH)->set_src(0, key);
+      for (const auto& c : cases) {
+        branch(insn, int64_t(offset) + c.second, c.first);
+      }
+    }
+    // The switch falls through to the default case.
+    branch(emit(OPCODE_GOTO), int64_t(offset) + default_offset);
+  }
+
+  // Translates the instruction at `offset`, and enqueues its successors.
+  bool visit(uint32_t offset, Translation& translation) {
+    m_stack = translation.stack;
+    m_slots = width(m_stack);
+    m_insns = &translation.insns;
+    if (!instruction_length(offset, &translation.length)) {
+      return false;
+    }
+    const uint8_t* operands = m_code + offset + 1;
+    bool falls_through = true;
+    uint8_t op = m_code[offset];
+    switch (op) {
+    case JVM_NOP:
+      break;
+    case JVM_ACONST_NULL:
+      emit(OPCODE_CONST)->set_literal(0)->set_dest(push(Kind::OBJECT));
+      break;
+    case JVM_LCONST_0:
+    case JVM_LCONST_1:
+      wide_constant(op - JVM_LCONST_0);
+      break;
+    case JVM_FCONST_0:
+    case JVM_FCONST_1:
+    case JVM_FCONST_2: {
+      float value = op - JVM_FCONST_0;
+      int32_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      constant(bits);
+      break;
+    }
+    case JVM_DCONST_0:
+    case JVM_DCONST_1: {
+      double value = op - JVM_DCONST_0;
+      int64_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      wide_constant(bits);
+      break;
+    }
+    case JVM_BIPUSH:
+      constant(int8_t(operands[0]));
+      break;
+    case JVM_SIPUSH:
+      constant(int16_t(read_u2(operands)));
+      break;
+    case JVM_LDC:
+      ldc(operands[0], /* wide */ false);
+      break;
+    case JVM_LDC_W:
+      ldc(read_u2(operands), /* wide */ false);
+      break;
+    case JVM_LDC2_W:
+      ldc(read_u2(operands), /* wide */ true);
+      break;
+    case JVM_ILOAD:
+    case JVM_FLOAD:
+      load(Kind::NARROW, operands[0]);
+      break;
+    case JVM_LLOAD:
+    case JVM_DLOAD:
+      load(Kind::WIDE, operands[0]);
+      break;
+    case JVM_ALOAD:
+      load(Kind::OBJECT, operands[0]);
+      break;
+    case JVM_IALOAD:
+    case JVM_FALOAD:
+      array_load(OPCODE_AGET, Kind::NARROW);
+      break;
+    case JVM_LALOAD:
+    case JVM_DALOAD:
+      array_load(OPCODE_AGET_WIDE, Kind::WIDE);
+      break;
+    case JVM_AALOAD:
+      array_load(OPCODE_AGET_OBJECT, Kind::OBJECT);
+      break;
+    case JVM_BALOAD:
+      // Also used for the boolean arrays, whose elements are one byte too.
+      array_load(OPCODE_AGET_BYTE, Kind::NARROW);
+      break;
+    case JVM_CALOAD:
+      array_load(OPCODE_AGET_CHAR, Kind::NARROW);
+      break;
+    case JVM_SALOAD:
+      array_load(OPCODE_AGET_SHORT, Kind::NARROW);
+      break;
+    case JVM_ISTORE:
+    case JVM_FSTORE:
+      store(Kind::NARROW, operands[0]);
+      break;
+    case JVM_LSTORE:
+    case JVM_DSTORE:
+      store(Kind::WIDE, operands[0]);
+      break;
+    case JVM_ASTORE:
+      store(Kind::OBJECT, operands[0]);
+      break;
+    case JVM_IASTORE:
+    case JVM_FASTORE:
+      array_store(OPCODE_APUT, Kind::NARROW);
+      break;
+    case JVM_LASTORE:
+    case JVM_DASTORE:
+      array_store(OPCODE_APUT_WIDE, Kind::WIDE);
+      break;
+    case JVM_AASTORE:
+      array_store(OPCODE_APUT_OBJECT, Kind::OBJECT);
+      break;
+    case JVM_BASTORE:
+      array_store(OPCODE_APUT_BYTE, Kind::NARROW);
+      break;
+    case JVM_CASTORE:
+      array_store(OPCODE_APUT_CHAR, Kind::NARROW);
+      break;
+    case JVM_SASTORE:
+      array_store(OPCODE_APUT_SHORT, Kind::NARROW);
+      break;
+    case JVM_POP:
+    case JVM_POP2:
+    case JVM_DUP:
+    case JVM_DUP_X1:
+    case JVM_DUP_X2:
+    case JVM_DUP2:
+    case JVM_DUP2_X1:
+    case JVM_DUP2_X2:
+    case JVM_SWAP:
+      stack_op(op);
+      break;
+    case JVM_IADD:
+      binop(OPCODE_ADD_INT, Kind::NARROW);
+      break;
+    case JVM_LADD:
+      binop(OPCODE_ADD_LONG, Kind::WIDE);
+      break;
+    case JVM_FADD:
+      binop(OPCODE_ADD_FLOAT, Kind::NARROW);
+      break;
+    case JVM_DADD:
+      binop(OPCODE_ADD_DOUBLE, Kind::WIDE);
+      break;
+    case JVM_ISUB:
+      binop(OPCODE_SUB_INT, Kind::NARROW);
+      break;
+    case JVM_LSUB:
+      binop(OPCODE_SUB_LONG, Kind::WIDE);
+      break;
+    case JVM_FSUB:
+      binop(OPCODE_SUB_FLOAT, Kind::NARROW);
+      break;
+    case JVM_DSUB:
+      binop(OPCODE_SUB_DOUBLE, Kind::WIDE);
+      break;
+    case JVM_IMUL:
+      binop(OPCODE_MUL_INT, Kind::NARROW);
+      break;
+    case JVM_LMUL:
+      binop(OPCODE_MUL_LONG, Kind::WIDE);
+      break;
+    case JVM_FMUL:
+      binop(OPCODE_MUL_FLOAT, Kind::NARROW);
+      break;
+    case JVM_DMUL:
+      binop(OPCODE_MUL_DOUBLE, Kind::WIDE);
+      break;
+    case JVM_IDIV:
+      binop(OPCODE_DIV_INT, Kind::NARROW);
+      break;
+    case JVM_LDIV:
+      binop(OPCODE_DIV_LONG, Kind::WIDE);
+      break;
+    case JVM_FDIV:
+      binop(OPCODE_DIV_FLOAT, Kind::NARROW);
+      break;
+    case JVM_DDIV:
+      binop(OPCODE_DIV_DOUBLE, Kind::WIDE);
+      break;
+    case JVM_IREM:
+      binop(OPCODE_REM_INT, Kind::NARROW);
+      break;
+    case JVM_LREM:
+      binop(OPCODE_REM_LONG, Kind::WIDE);
+      break;
+    case JVM_FREM:
+      binop(OPCODE_REM_FLOAT, Kind::NARROW);
+      break;
+    case JVM_DREM:
+      binop(OPCODE_REM_DOUBLE, Kind::WIDE);
+      break;
+    case JVM_INEG:
+      unop(OPCODE_NEG_INT, Kind::NARROW, Kind::NARROW);
+      break;
+    case JVM_LNEG:
+      unop(OPCODE_NEG_LONG, Kind::WIDE, Kind::WIDE);
+      break;
+    case JVM_FNEG:
+      unop(OPCODE_NEG_FLOAT, Kind::NARROW, Kind::NARROW);
+      break;
+    case JVM_DNEG:
+      unop(OPCODE_NEG_DOUBLE, Kind::WIDE, Kind::WIDE);
+      break;
+    case JVM_ISHL:
+      binop(OPCODE_SHL_INT, Kind::NARROW);
+      break;
+    case JVM_LSHL:
+      binop(OPCODE_SHL_LONG, Kind::WIDE, Kind::NARROW, Kind::WIDE);
+      break;
+    case JVM_ISHR:
+      binop(OPCODE_SHR_INT, Kind::NARROW);
+      break;
+    case JVM_LSHR:
+      binop(OPCODE_SHR_LONG, Kind::WIDE, Kind::NARROW, Kind::WIDE);
+      break;
+    case JVM_IUSHR:
+      binop(OPCODE_USHR_INT, Kind::NARROW);
+      break;
+    case JVM_LUSHR:
+      binop(OPCODE_USHR_LONG, Kind::WIDE, Kind::NARROW, Kind::WIDE);
+      break;
+    case JVM_IAND:
+      binop(OPCODE_AND_INT, Kind::NARROW);
+      break;
+    case JVM_LAND:
+      binop(OPCODE_AND_LONG, Kind::WIDE);
+      break;
+    case JVM_IOR:
+      binop(OPCODE_OR_INT, Kind::NARROW);
+      break;
+    case JVM_LOR:
+      binop(OPCODE_OR_LONG, Kind::WIDE);
+      break;
+    case JVM_IXOR:
+      binop(OPCODE_XOR_INT, Kind::NARROW);
+      break;
+    case JVM_LXOR:
+      binop(OPCODE_XOR_LONG, Kind::WIDE);
+      break;
+    case JVM_IINC: {
+      reg_t reg = local(operands[0], Kind::NARROW);
+      emit(OPCODE_ADD_INT_LIT16)
+          ->set_literal(int8_t(operands[1]))
+          ->set_src(0, reg)
+          ->set_dest(reg);
+      break;
+    }
+    case JVM_I2L:
+      unop(OPCODE_INT_TO_LONG, Kind::NARROW, Kind::WIDE);
+      break;
+    case JVM_I2F:
+      unop(OPCODE_INT_TO_FLOAT, Kind::NARROW, Kind::NARROW);
+      break;
+    case JVM_I2D:
+      unop(OPCODE_INT_TO_DOUBLE, Kind::NARROW, Kind::WIDE);
+      break;
+    case JVM_L2I:
+      unop(OPCODE_LONG_TO_INT, Kind::WIDE, Kind::NARROW);
+      break;
+    case JVM_L2F:
+      unop(OPCODE_LONG_TO_FLOAT, Kind::WIDE, Kind::NARROW);
+      break;
+    case JVM_L2D:
+      unop(OPCODE_LONG_TO_DOUBLE, Kind::WIDE, Kind::WIDE);
+      break;
+    case JVM_F2I:
+      unop(OPCODE_FLOAT_TO_INT, Kind::NARROW, Kind::NARROW);
+      break;
+    case JVM_F2L:
+      unop(OPCODE_FLOAT_TO_LONG, Kind::NARROW, Kind::WIDE);
+      break;
+    case JVM_F2D:
+      unop(OPCODE_FLOAT_TO_DOUBLE, Kind::NARROW, Kind::WIDE);
+      break;
+    case JVM_D2I:
+      unop(OPCODE_DOUBLE_TO_INT, Kind::WIDE, Kind::NARROW);
+      break;
+    case JVM_D2L:
+      unop(OPCODE_DOUBLE_TO_LONG, Kind::WIDE, Kind::WIDE);
+      break;
+    case JVM_D2F:
+      unop(OPCODE_DOUBLE_TO_FLOAT, Kind::WIDE, Kind::NARROW);
+      break;
+    case JVM_I2B:
+      unop(OPCODE_INT_TO_BYTE, Kind::NARROW, Kind::NARROW);
+      break;
+    case JVM_I2C:
+      unop(OPCODE_INT_TO_CHAR, Kind::NARROW, Kind::NARROW);
+      break;
+    case JVM_I2S:
+      unop(OPCODE_INT_TO_SHORT, Kind::NARROW, Kind::NARROW);
+      break;
+    case JVM_LCMP:
+      binop(OPCODE_CMP_LONG, Kind::WIDE, Kind::WIDE, Kind::NARROW);
+      break;
+    case JVM_FCMPL:
+      binop(OPCODE_CMPL_FLOAT, Kind::NARROW);
+      break;
+    case JVM_FCMPG:
+      binop(OPCODE_CMPG_FLOAT, Kind::NARROW);
+      break;
+    case JVM_DCMPL:
+      binop(OPCODE_CMPL_DOUBLE, Kind::WIDE, Kind::WIDE, Kind::NARROW);
+      break;
+    case JVM_DCMPG:
+      binop(OPCODE_CMPG_DOUBLE, Kind::WIDE, Kind::WIDE, Kind::NARROW);
+      break;
+    case JVM_IFEQ:
+      if_zero(OPCODE_IF_EQZ, Kind::NARROW, offset);
+      break;
+    case JVM_IFNE:
+      if_zero(OPCODE_IF_NEZ, Kind::NARROW, offset);
+      break;
+    case JVM_IFLT:
+      if_zero(OPCODE_IF_LTZ, Kind::NARROW, offset);
+      break;
+    case JVM_IFGE:
+      if_zero(OPCODE_IF_GEZ, Kind::NARROW, offset);
+      break;
+    case JVM_IFGT:
+      if_zero(OPCODE_IF_GTZ, Kind::NARROW, offset);
+      break;
+    case JVM_IFLE:
+      if_zero(OPCODE_IF_LEZ, Kind::NARROW, offset);
+      break;
+    case JVM_IF_ICMPEQ:
+      if_compare(OPCODE_IF_EQ, Kind::NARROW, offset);
+      break;
+    case JVM_IF_ICMPNE:
+      if_compare(OPCODE_IF_NE, Kind::NARROW, offset);
+      break;
+    case JVM_IF_ICMPLT:
+      if_compare(OPCODE_IF_LT, Kind::NARROW, offset);
+      break;
+    case JVM_IF_ICMPGE:
+      if_compare(OPCODE_IF_GE, Kind::NARROW, offset);
+      break;
+    case JVM_IF_ICMPGT:
+      if_compare(OPCODE_IF_GT, Kind::NARROW, offset);
+      break;
+    case JVM_IF_ICMPLE:
+      if_compare(OPCODE_IF_LE, Kind::NARROW, offset);
+      break;
+    case JVM_IF_ACMPEQ:
+      if_compare(OPCODE_IF_EQ, Kind::OBJECT, offset);
+      break;
+    case JVM_IF_ACMPNE:
+      if_compare(OPCODE_IF_NE, Kind::OBJECT, offset);
+      break;
+    case JVM_IFNULL:
+      if_zero(OPCODE_IF_EQZ, Kind::OBJECT, offset);
+      break;
+    case JVM_IFNONNULL:
+      if_zero(OPCODE_IF_NEZ, Kind::OBJECT, offset);
+      break;
+    case JVM_GOTO:
+      branch(emit(OPCODE_GOTO), offset + int16_t(read_u2(operands)));
+      falls_through = false;
+      break;
+    case JVM_GOTO_W:
+      branch(emit(OPCODE_GOTO), offset + int32_t(read_u4(operands)));
+      falls_through = false;
+      break;
+    case JVM_JSR:
+    case JVM_JSR_W:
+    case JVM_RET:
+      return fail("subroutines are not supported");
+    case JVM_TABLESWITCH:
+    case JVM_LOOKUPSWITCH:
+      switch_op(op, offset);
+      falls_through = false;
+      break;
+    case JVM_IRETURN:
+    case JVM_FRETURN:
+      return_value(OPCODE_RETURN, Kind::NARROW);
+      falls_through = false;
+      break;
+    case JVM_LRETURN:
+    case JVM_DRETURN:
+      return_value(OPCODE_RETURN_WIDE, Kind::WIDE);
+      falls_through = false;
+      break;
+    case JVM_ARETURN:
+      return_value(OPCODE_RETURN_OBJECT, Kind::OBJECT);
+      falls_through = false;
+      break;
+    case JVM_RETURN:
+      emit(OPCODE_RETURN_VOID);
+      falls_through = false;
+      break;
+    case JVM_GETSTATIC:
+    case JVM_PUTSTATIC:
+    case JVM_GETFIELD:
+    case JVM_PUTFIELD:
+      field_op(op, read_u2(operands));
+      break;
+    case JVM_INVOKEVIRTUAL:
+    case JVM_INVOKESPECIAL:
+    case JVM_INVOKESTATIC:
+    case JVM_INVOKEINTERFACE:
+      invoke(op, read_u2(operands));
+      break;
+    case JVM_INVOKEDYNAMIC:
+      invoke_dynamic(read_u2(operands));
+      break;
+    case JVM_NEW:
+    case JVM_ANEWARRAY:
+    case JVM_CHECKCAST:
+    case JVM_INSTANCEOF:
+      type_op(op, read_u2(operands));
+      break;
+    case JVM_NEWARRAY: {
+      static const std::array<DexType* (*)(), 8> kElementTypes = {
+          type::_boolean, type::_char, type::_float, type::_double,
+          type::_byte,    type::_short, type::_int,  type::_long};
+      uint8_t atype = operands[0];
+      if (atype < 4 || atype > 11) {
+        return fail("invalid newarray type " + std::to_string(atype));
+      }
+      new_array(type::make_array_type(kElementTypes[atype - 4]()));
+      break;
+    }
+    case JVM_ARRAYLENGTH: {
+      reg_t array = pop(Kind::OBJECT);
+      push_result(emit(OPCODE_ARRAY_LENGTH)->set_src(0, array), Kind::NARROW);
+      break;
+    }
+    case JVM_ATHROW:
+      emit(OPCODE_THROW)->set_src(0, pop(Kind::OBJECT));
+      falls_through = false;
+      break;
+    case JVM_MONITORENTER:
+      emit(OPCODE_MONITOR_ENTER)->set_src(0, pop(Kind::OBJECT));
+      break;
+    case JVM_MONITOREXIT:
+      emit(OPCODE_MONITOR_EXIT)->set_src(0, pop(Kind::OBJECT));
+      break;
+    case JVM_MULTIANEWARRAY:
+      multi_new_array(read_u2(operands), operands[2]);
+      break;
+    case JVM_WIDE: {
+      uint8_t wide_op = operands[0];
+      uint16_t index = read_u2(operands + 1);
+      switch (wide_op) {
+      case JVM_ILOAD:
+      case JVM_FLOAD:
+        load(Kind::NARROW, index);
+        break;
+      case JVM_LLOAD:
+      case JVM_DLOAD:
+        load(Kind::WIDE, index);
+        break;
+      case JVM_ALOAD:
+        load(Kind::OBJECT, index);
+        break;
+      case JVM_ISTORE:
+      case JVM_FSTORE:
+        store(Kind::NARROW, index);
+        break;
+      case JVM_LSTORE:
+      case JVM_DSTORE:
+        store(Kind::WIDE, index);
+        break;
+      case JVM_ASTORE:
+        store(Kind::OBJECT, index);
+        break;
+      case JVM_IINC: {
+        reg_t reg = local(index, Kind::NARROW);
+        emit(OPCODE_ADD_INT_LIT16)
+            ->set_literal(int16_t(read_u2(operands + 3)))
+            ->set_src(0, reg)
+            ->set_dest(reg);
+        break;
+      }
+      case JVM_RET:
+        return fail("subroutines are not supported");
+      default:
+        return fail("invalid wide opcode " + std::to_string(wide_op));
+      }
+      break;
+    }
+    default:
+      if (op >= JVM_ICONST_M1 && op <= JVM_ICONST_5) {
+        constant(int32_t(op) - JVM_ICONST_M1 - 1);
+      } else if (op >= JVM_ILOAD_0 && op <= JVM_ALOAD_3) {
+        // iload_<n>, lload_<n>, fload_<n>, dload_<n> and aload_<n>.
+        static const std::array<Kind, 5> kKinds = {
+            Kind::NARROW, Kind::WIDE, Kind::NARROW, Kind::WIDE, Kind::OBJECT};
+        load(kKinds[(op - JVM_ILOAD_0) / 4], (op - JVM_ILOAD_0) % 4);
+      } else if (op >= JVM_ISTORE_0 && op <= JVM_ASTORE_3) {
+        static const std::array<Kind, 5> kKinds = {
+            Kind::NARROW, Kind::WIDE, Kind::NARROW, Kind::WIDE, Kind::OBJECT};
+        store(kKinds[(op - JVM_ISTORE_0) / 4], (op - JVM_ISTORE_0) % 4);
+      } else {
+        return fail("invalid opcode " + std::to_string(op));
+      }
+      break;
+    }
+    if (!m_error.empty()) {
+      return false;
+    }
+
+    if (falls_through) {
+      enqueue(offset + translation.length, m_stack);
+    }
+    for (const auto& handler : m_handlers) {
+      if (handler.start_pc <= offset && offset < handler.end_pc) {
+        enqueue(handler.handler_pc, {Kind::OBJECT});
+      }
+    }
+    return m_error.empty();
+  }
+
+  CatchChain catch_chain(uint32_t offset) const {
+    CatchChain chain;
+    std::unordered_set<DexType*> caught;
+    for (const auto& handler : m_handlers) {
+      if (handler.start_pc > offset || offset >= handler.end_pc ||
+          !caught.insert(handler.catch_type).second) {
+        continue;
+      }
+      chain.emplace_back(handler.catch_type, handler.handler_pc);
+      if (handler.catch_type == nullptr) {
+        // Nothing is caught after a finally handler.
+        break;
+      }
+    }
+    return chain;
+  }
+
+  std::unique_ptr<IRCode> layout(DexString* source_file) {
+    auto code = std::make_unique<IRCode>(m_method, /* temp_regs */ 0);
+    code->set_registers_size(m_scratch + kScratchRegisters);
+
+    std::unordered_set<uint32_t> targets;
+    for (const auto& branch : m_branches) {
+      targets.insert(branch.target);
+    }
+    for (const auto& handler : m_handlers) {
+      targets.insert(handler.handler_pc);
+    }
+
+    // The first catch entry of every chain, in the order they are used.
+    std::vector<std::pair<CatchChain, MethodItemEntry*>> catches;
+    auto catch_entry = [&](const CatchChain& chain) -> MethodItemEntry* {
+      if (chain.empty()) {
+        return nullptr;
+      }
+      for (const auto& entry : catches) {
+        if (entry.first == chain) {
+          return entry.second;
+        }
+      }
+      MethodItemEntry* next = nullptr;
+      for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        auto* entry = new MethodItemEntry(it->first);
+        entry->centry->next = next;
+        next = entry;
+      }
+      catches.emplace_back(chain, next);
+      return next;
+    };
+
+    auto* method_name = DexString::make_string(show(m_method));
+    std::unordered_map<uint32_t, MethodItemEntry*> labels;
+    std::unordered_map<const IRInstruction*, MethodItemEntry*> branch_sources;
+    MethodItemEntry* active_catch = nullptr;
+    boost::optional<uint32_t> line;
+    for (auto& entry : m_translations) {
+      uint32_t offset = entry.first;
+      auto& translation = entry.second;
+      if (targets.count(offset)) {
+        // Replaced by the branch targets once all the branches are laid out.
+        auto* label = new MethodItemEntry();
+        code->push_back(*label);
+        labels.emplace(offset, label);
+      }
+      auto line_it = m_lines.find(offset);
+      if (line_it != m_lines.end()) {
+        line = line_it->second;
+      }
+      if (translation.insns.empty()) {
+        continue;
+      }
+      auto* catch_start = catch_entry(catch_chain(offset));
+      if (catch_start != active_catch) {
+        if (active_catch != nullptr) {
+          code->push_back(TRY_END, active_catch);
+        }
+        if (catch_start != nullptr) {
+          code->push_back(TRY_START, catch_start);
+        }
+        active_catch = catch_start;
+      }
+      if (line) {
+        auto position = std::make_unique<DexPosition>(*line);
+        position->bind(method_name, source_file);
+        code->push_back(std::move(position));
+        line = boost::none;
+      }
+      for (auto& insn : translation.insns) {
+        auto* mie = new MethodItemEntry(insn.release());
+        code->push_back(*mie);
+        if (opcode::is_branch(mie->insn->opcode())) {
+          branch_sources.emplace(mie->insn, mie);
+        }
+      }
+    }
+    if (active_catch != nullptr) {
+      code->push_back(TRY_END, active_catch);
+    }
+
+    // The catch blocks move the exception to the stack of the handler.
+    for (const auto& entry : catches) {
+      auto* catch_mie = entry.second;
+      for (const auto& link : entry.first) {
+        code->push_back(*catch_mie);
+        auto* move = new IRInstruction(OPCODE_MOVE_EXCEPTION);
+        move->set_dest(m_max_locals);
+        code->push_back(move);
+        auto* mie = new MethodItemEntry(new IRInstruction(OPCODE_GOTO));
+        code->push_back(*mie);
+        branch_sources.emplace(mie->insn, mie);
+        m_branches.push_back(Branch{mie->insn, link.second, boost::none});
+        catch_mie = catch_mie->centry->next;
+      }
+    }
+
+    for (const auto& branch : m_branches) {
+      auto* src = branch_sources.at(branch.insn);
+      auto* target = branch.case_key
+                         ? new BranchTarget(src, *branch.case_key)
+                         : new BranchTarget(src);
+      code->insert_before(code->iterator_to(*labels.at(branch.target)),
+                          *new MethodItemEntry(target));
+    }
+    return code;
+  }
+
+  DexMethod* m_method;
+  const ConstantPool& m_cpool;
+
+  uint16_t m_max_stack{0};
+  uint16_t m_max_locals{0};
+  const uint8_t* m_code{nullptr};
+  uint32_t m_code_length{0};
+  std::vector<Handler> m_handlers;
+  // The lines of the LineNumberTable, by start offset.
+  std::map<uint32_t, uint32_t> m_lines;
+  reg_t m_scratch{0};
+
+  // The reachable instructions, by offset.
+  std::map<uint32_t, Translation> m_translations;
+  std::vector<uint32_t> m_worklist;
+  std::vector<Branch> m_branches;
+
+  // The state of the instruction being visited.
+  boost::optional<uint32_t> m_offset;
+  Stack m_stack;
+  uint32_t m_slots{0};
+  std::vector<std::unique_ptr<IRInstruction>>* m_insns{nullptr};
+
+  std::string m_error;
+};
+
+} // namespace
+
+std::unique_ptr<IRCode> translate(DexMethod* method,
+                                  const uint8_t* code_attribute,
+                                  uint32_t length,
+                                  const ConstantPool& cpool,
+                                  DexString* source_file,
+                                  std::string* error) {
+  Translator translator(method, cpool);
+  auto code = translator.run(code_attribute, length, source_file);
+  if (code == nullptr && error != nullptr) {
+    *error = translator.error();
+  }
+  return code;
+}
+
+} // namespace jvm_bytecode
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class DexCallSite;
+class DexFieldRef;
+class DexMethod;
+class DexMethodRef;
+class DexString;
+class DexType;
+class IRCode;
+
+/*
+ * Translates the bytecode of the Code attribute of a JVM method to IR, so that
+ * the classes of a jar can be analyzed without dexing them first.
+ *
+ * The operand stack is mapped to registers: local i is register i, as in the
+ * load-param instructions, and the stack slot at depth d is register
+ * max_locals + d, followed by a few scratch registers. Each handler of the
+ * exception table is entered through a catch block that moves the exception to
+ * the bottom of the stack and jumps to the handler.
+ *
+ * The bytecode is expected to pass the JVM verifier. The translation fails on
+ * the subroutines of old class files (jsr and ret), on the constants that have
+ * no IR counterpart (method handles and types, dynamic constants) and on
+ * inconsistent stacks.
+ */
+namespace jvm_bytecode {
+
+// A loadable constant of the constant pool.
+struct Constant {
+  enum class Kind { INT, FLOAT, LONG, DOUBLE, STRING, CLASS };
+
+  Kind kind;
+  // The bits of the numeric constants.
+  int64_t bits{0};
+  DexString* string{nullptr};
+  DexType* type{nullptr};
+};
+
+// The constant pool of the class that defines the translated method. The
+// getters return false or null, having printed why, if the entry at `index` is
+// not of the expected kind.
+class ConstantPool {
+ public:
+  virtual ~ConstantPool() = default;
+
+  virtual bool get_utf8(uint16_t index, std::string* utf8) const = 0;
+
+  virtual bool get_constant(uint16_t index, Constant* constant) const = 0;
+
+  // The type of a CONSTANT_Class, which names an array type by its descriptor.
+  virtual DexType* get_type(uint16_t index) const = 0;
+
+  virtual DexFieldRef* get_field(uint16_t index) const = 0;
+
+  // A CONSTANT_Methodref or a CONSTANT_InterfaceMethodref.
+  virtual DexMethodRef* get_method(uint16_t index) const = 0;
+
+  // The call site of a CONSTANT_InvokeDynamic.
+  virtual DexCallSite* get_call_site(uint16_t index) const = 0;
+};
+
+/*
+ * Translates the Code attribute of `method`, whose access flags must be set,
+ * given its content, i.e., without the attribute name and length. Returns null
+ * with the reason in `error` if the code cannot be translated.
+ */
+std::unique_ptr<IRCode> translate(DexMethod* method,
+                                  const uint8_t* code_attribute,
+                                  uint32_t length,
+                                  const ConstantPool& cpool,
+                                  DexString* source_file,
+                                  std::string* error);
+
+} // namespace jvm_bytecode
@@ -56,6 +56,15 @@ class Pass : public Configurable {
                         ConfigFiles& conf,
                         PassManager& mgr) = 0;
 
+  /**
+   * Called by a redex-all server (--serve) once the pass is configured, and
+   * again after each request, in the process the runs of the requests are
+   * forked from. The pass may load state there that the runs then share
+   * instead of loading it every time, e.g. the files named by its
+   * configuration.
+   */
+  virtual void preload() {}
+
   virtual void set_analysis_usage(AnalysisUsage& analysis_usage) const;
 
   Configurable::Reflection reflect() override;
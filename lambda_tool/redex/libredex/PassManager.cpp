@@ -27,6 +27,7 @@
 #include "AnalysisUsage.h"
 #include "ApiLevelChecker.h"
 #include "AssetManager.h"
+#include "CFGCache.h"
 #include "CommandProfiling.h"
 #include "ConfigFiles.h"
 #include "Debug.h"
@@ -1079,6 +1080,7 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
 
     pre_pass_verifiers(pass, i);
 
+    auto cfg_cache_before = cfg::CFGCache::instance().stats();
     {
       auto scoped_command_prof = profiler_info_pass == pass
                                      ? ScopedCommandProfiling::maybe_from_info(
@@ -1091,6 +1093,19 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
       pass->run_pass(stores, conf, *this);
     }
 
+    auto cfg_cache_after = cfg::CFGCache::instance().stats();
+    if (cfg_cache_after.hits + cfg_cache_after.misses !=
+        cfg_cache_before.hits + cfg_cache_before.misses) {
+      set_metric("cfg_cache_hits",
+                 cfg_cache_after.hits - cfg_cache_before.hits);
+      set_metric("cfg_cache_misses",
+                 cfg_cache_after.misses - cfg_cache_before.misses);
+    }
+    if (!pass->is_analysis_pass()) {
+      // The pass may have changed code without rebuilding its CFG.
+      cfg::CFGCache::instance().invalidate();
+    }
+
     vm_hwm.trace_log(this, pass);
 
     sanitizers::lsan_do_recoverable_leak_check();
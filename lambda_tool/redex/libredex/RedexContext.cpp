@@ -72,6 +72,7 @@ RedexContext::~RedexContext() {
   for (auto const& it : m_type_to_class) {
     delete it.second;
   }
+  m_lazy_class_source.reset();
 
   for (const auto& p : s_keep_reasons) {
     delete p.second;
@@ -478,6 +479,10 @@ bool RedexContext::class_already_loaded(DexClass* cls) {
 }
 
 void RedexContext::publish_class(DexClass* cls) {
+  if (m_lazy_class_source != nullptr &&
+      m_lazy_class_source->publish_class(cls)) {
+    return;
+  }
   std::lock_guard<std::mutex> l(m_type_system_mutex);
   const DexType* type = cls->get_type();
   const auto& pair = m_type_to_class.emplace(type, cls);
@@ -490,7 +495,23 @@ void RedexContext::publish_class(DexClass* cls) {
 
 DexClass* RedexContext::type_class(const DexType* t) {
   auto it = m_type_to_class.find(t);
-  return it != m_type_to_class.end() ? it->second : nullptr;
+  if (it != m_type_to_class.end()) {
+    return it->second;
+  }
+  return m_lazy_class_source != nullptr ? m_lazy_class_source->type_class(t)
+                                        : nullptr;
+}
+
+DexClass* RedexContext::published_type_class(const DexType* t) {
+  {
+    std::lock_guard<std::mutex> l(m_type_system_mutex);
+    auto it = m_type_to_class.find(t);
+    if (it != m_type_to_class.end()) {
+      return it->second;
+    }
+  }
+  return m_lazy_class_source != nullptr ? m_lazy_class_source->type_class(t)
+                                        : nullptr;
 }
 
 void run_rethrow_first_aggregate(const std::function<void()>& f) {
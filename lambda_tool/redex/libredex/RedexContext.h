@@ -15,6 +15,7 @@
 #include <limits>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <unordered_map>
@@ -48,6 +49,28 @@ struct AssumeReturnValue;
 
 extern RedexContext* g_redex;
 
+/*
+ * A source of external classes that are only created when they are first
+ * looked up with type_class(), e.g. the classes of the jars loaded with
+ * load_jar_file_lazily(). Passes look classes up concurrently, so the classes
+ * it creates are kept by the source rather than added to the tables of the
+ * context: they are neither in external_classes() nor walked by
+ * walk_type_class().
+ */
+class LazyClassSource {
+ public:
+  virtual ~LazyClassSource() = default;
+
+  // Returns the class of `type`, creating it on the first call, or nullptr if
+  // the source does not define it. Thread-safe.
+  virtual DexClass* type_class(const DexType* type) = 0;
+
+  // Called by RedexContext::publish_class(). Returns true if the class is
+  // being created by the source on the calling thread, in which case the
+  // source owns it.
+  virtual bool publish_class(DexClass* cls) = 0;
+};
+
 #if defined(__SSE4_2__) && defined(__linux__) && defined(__STRCMP_LESS__)
 extern "C" bool strcmp_less(const char* str1, const char* str2);
 #endif
@@ -138,6 +161,18 @@ struct RedexContext {
   void publish_class(DexClass* cls);
 
   DexClass* type_class(const DexType* t);
+
+  // Like type_class(), but takes the lock of publish_class(), so that it can
+  // be called while other threads publish classes.
+  DexClass* published_type_class(const DexType* t);
+
+  // The source of the classes of the types that have none in the context, if
+  // any. Not thread-safe.
+  LazyClassSource* lazy_class_source() { return m_lazy_class_source.get(); }
+  void set_lazy_class_source(std::unique_ptr<LazyClassSource> source) {
+    m_lazy_class_source = std::move(source);
+  }
+
   template <class TypeClassWalkerFn = void(const DexType*, const DexClass*)>
   void walk_type_class(TypeClassWalkerFn walker) {
     for (const auto& type_cls : m_type_to_class) {
@@ -333,6 +368,7 @@ struct RedexContext {
   std::mutex m_type_system_mutex;
   std::unordered_map<const DexType*, DexClass*> m_type_to_class;
   std::vector<DexClass*> m_external_classes;
+  std::unique_ptr<LazyClassSource> m_lazy_class_source;
 
   const std::vector<const DexType*> m_empty_types;
 
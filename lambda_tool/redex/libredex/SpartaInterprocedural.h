@@ -7,20 +7,43 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
 #include "Analyzer.h"
 #include "CallGraph.h"
 #include "DexClass.h"
 #include "MethodOverrideGraph.h"
 #include "MonotonicFixpointIterator.h"
+#include "Trace.h"
 // this file just provides commonly used typenames to the interprocedural analyzer. 
 // It's also possible to override
 // type aliases in the children class, for instance struct
 // MaxDepthAnalysisAdaptor : public BottomUpAnalysisAdaptorBase.
 namespace sparta_interprocedural {
 
+/*
+ * The program analyzed by the adaptors below: a scope, and optionally the
+ * methods its call graph is rooted at. Converts implicitly from a Scope, in
+ * which case the call graph has all the methods of the scope.
+ */
+struct RootedScope {
+  RootedScope(Scope scope) : scope(std::move(scope)) {}
+
+  RootedScope(Scope scope, std::vector<const DexMethod*> roots)
+      : scope(std::move(scope)), roots(std::move(roots)) {}
+
+  Scope scope;
+  // If not empty, only the methods reachable from these are in the call graph,
+  // and thus analyzed.
+  std::vector<const DexMethod*> roots;
+};
+
 struct AnalysisAdaptorBase {
   using Function = const DexMethod*;
-  using Program = Scope;
+  using Program = RootedScope;
   // using Scope = std::vector<DexClass*>;                             
   using CallGraphInterface = call_graph::GraphInterface;
 
@@ -35,20 +58,26 @@ struct AnalysisAdaptorBase {
   // analyses will require this argument, in which case this function
   // should be *overriden* in the derived class.
   template <typename Registry>
-  static call_graph::Graph call_graph_of(const Scope& scope,
+  static call_graph::Graph call_graph_of(const RootedScope& program,
                                          Registry* /*reg*/) {
     constexpr uint32_t big_override_threshold = 5;
-    printf("call_graph::Graph call_graph_of\n");
-    call_graph::Graph resulting_call_graph = call_graph::multiple_callee_graph(
-        *method_override_graph::build_graph(scope),
-        scope,
-        big_override_threshold);
-    resulting_call_graph.debug_methods_in_graph();
-    auto cg_stats = call_graph::get_num_nodes_edges(resulting_call_graph);
-    printf("num of nodes: %d \t num of edges %d \t num of callsites %d \n", cg_stats.num_nodes, cg_stats.num_edges, cg_stats.num_callsites);
-    // printf("entry: %s\n", resulting_call_graph.entry()->method()->get_name()->c_str());
-    // printf("exit: %s\n", resulting_call_graph.exit()->method()->get_name()->c_str());
-
+    auto override_graph = method_override_graph::build_graph(program.scope);
+    call_graph::Graph resulting_call_graph =
+        program.roots.empty()
+            ? call_graph::multiple_callee_graph(
+                  *override_graph, program.scope, big_override_threshold)
+            : call_graph::multiple_callee_graph(*override_graph,
+                                                program.scope,
+                                                big_override_threshold,
+                                                program.roots);
+    if (traceEnabled(CALLGRAPH, 5)) {
+      resulting_call_graph.debug_methods_in_graph();
+    }
+    if (traceEnabled(CALLGRAPH, 1)) {
+      auto cg_stats = call_graph::get_num_nodes_edges(resulting_call_graph);
+      TRACE(CALLGRAPH, 1, "nodes: %u, edges: %u, callsites: %u",
+            cg_stats.num_nodes, cg_stats.num_edges, cg_stats.num_callsites);
+    }
     return resulting_call_graph;
   }
 
@@ -66,14 +95,46 @@ struct BottomUpAnalysisAdaptorBase : public AnalysisAdaptorBase {
 template <typename Summary>
 class MethodSummaryRegistry : public sparta::AbstractRegistry {
  private:
+  using Reads = std::vector<std::pair<const DexMethod*, uint64_t>>;
+
+  // Summaries read on the current thread between begin_reads() and
+  // end_reads().
+  struct ReadLog {
+    const MethodSummaryRegistry* registry = nullptr;
+    Reads reads;
+  };
+
   ConcurrentMap<const DexMethod*, Summary> m_map;
-  bool m_has_update = false;
+  // Number of times the summary of a method changed, and the summaries (with
+  // the versions) read by each method during its last analysis. Only used by
+  // sparta::IncrementalInterproceduralAnalyzer.
+  ConcurrentMap<const DexMethod*, uint64_t> m_versions;
+  ConcurrentMap<const DexMethod*, Reads> m_reads;
+  std::atomic<bool> m_has_update{false};
+
+  static ReadLog& read_log() {
+    thread_local ReadLog log;
+    return log;
+  }
+
+  void bump_version(const DexMethod* method) {
+    m_versions.update(method,
+                      [](const DexMethod*, uint64_t& version,
+                         bool /* exists */) { ++version; });
+  }
 
  public:
   bool has_update() const override { return m_has_update; }
   void materialize_update() override { m_has_update = false; }
 
   Summary get(const DexMethod* method, Summary default_value) const {
+    auto& log = read_log();
+    if (log.registry == this) {
+      // Read the version before the summary: updates bump it after writing
+      // the summary, so a racing update can only make the recorded version
+      // stale, never hide a change.
+      log.reads.emplace_back(method, m_versions.get(method, 0));
+    }
     return m_map.get(method, default_value);
   }
 
@@ -85,8 +146,9 @@ class MethodSummaryRegistry : public sparta::AbstractRegistry {
       entry_exists = exists;
       value = updater(value);
     });
-    m_has_update = true; // benign race conditions as long as materialize_update
-                         // is not called during update.
+    bump_version(method);
+    m_has_update = true; // materialize_update must not be called during
+                         // update.
     return entry_exists;
   }
 
@@ -100,9 +162,57 @@ class MethodSummaryRegistry : public sparta::AbstractRegistry {
                  });
 
     if (changed) {
-      m_has_update = true; // benign race conditions as long as
-                           // materialize_update is not called during update.
+      bump_version(method);
+      m_has_update = true; // materialize_update must not be called during
+                           // update.
+    }
+  }
+
+  // Records the summaries read by `reader` on the calling thread until
+  // end_reads(reader).
+  void begin_reads(const DexMethod* /* reader */) {
+    auto& log = read_log();
+    log.registry = this;
+    log.reads.clear();
+  }
+
+  void end_reads(const DexMethod* reader) {
+    auto& log = read_log();
+    std::sort(log.reads.begin(), log.reads.end());
+    log.reads.erase(std::unique(log.reads.begin(), log.reads.end()),
+                    log.reads.end());
+    m_reads.update(reader,
+                   [&](const DexMethod*, Reads& reads, bool /* exists */) {
+                     reads = std::move(log.reads);
+                   });
+    log.registry = nullptr;
+    log.reads.clear();
+  }
+
+  // Number of changes of the summary of `method`. Used by
+  // sparta::SccInterproceduralAnalyzer to detect that a component is stable.
+  uint64_t version(const DexMethod* method) const {
+    return m_versions.get(method, 0);
+  }
+
+  // Sets the summary of `method` to top. Used by
+  // sparta::SccInterproceduralAnalyzer when a component exhausts its budget.
+  void widen(const DexMethod* method) {
+    update(method, [](const Summary&) { return Summary::top(); });
+  }
+
+  // Returns true unless the reads of `reader` were recorded and none of the
+  // summaries it read changed since.
+  bool has_changed_reads(const DexMethod* reader) const {
+    if (!m_reads.count(reader)) {
+      return true;
+    }
+    for (const auto& read : m_reads.get(reader, Reads())) {
+      if (m_versions.get(read.first, 0) != read.second) {
+        return true;
+      }
     }
+    return false;
   }
 
   // Not thread-safe
@@ -145,6 +145,12 @@ class DexType;
   TM(TYPE)            \
   TM(TYPE_TRANSFORM)  \
   TM(UCM)             \
+  TM(UDF_CACHE)       \
+  TM(UDF_DET)         \
+  TM(UDF_FUSED)       \
+  TM(UDF_NULL)        \
+  TM(UDF_OUTPUT)      \
+  TM(UDF_PSAFE)       \
   TM(UNREF_INTF)      \
   TM(USES_NAMES)      \
   TM(VERIFY)          \
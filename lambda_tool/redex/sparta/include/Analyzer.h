@@ -7,14 +7,24 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <boost/optional.hpp>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "AbstractDomain.h"
+#include "MonotonicFixpointIterator.h"
+#include "SpartaWorkQueue.h"
 
 namespace sparta {
 
@@ -58,8 +68,10 @@ typename enable_if<
 optionally_analyze_edge_if_exist(Callsite*,
                                  const Edge& edge,
                                  const Domain& domain) {
-  static Callsite c2;
-  printf("enter optionally_analyze_edge_if exist c2.analyze_edge(edge, domain)\n");
+  // Callsite::analyze_edge is not const, so we use a fresh instance for every
+  // edge. A shared instance would race when the call graph level fixpoint is
+  // computed by a ParallelMonotonicFixpointIterator.
+  Callsite c2;
   return c2.analyze_edge(edge, domain);
 }
 
@@ -123,6 +135,72 @@ class AbstractRegistry {
   virtual ~AbstractRegistry() {}
 };
 
+// What a FunctionAnalyzer reports about its last analysis to the
+// AnalysisTelemetry, if it provides:
+//
+//   FunctionAnalysisStats analysis_stats() const;
+struct FunctionAnalysisStats {
+  // The size of the graph analyzed by the intraprocedural fixpoint, e.g., the
+  // number of basic blocks of the CFG.
+  uint32_t num_nodes = 0;
+  // See MonotonicFixpointIteratorBase::get_num_iterations().
+  uint32_t num_iterations = 0;
+};
+
+// Receives a record of every analysis of a function by an
+// InterproceduralAnalyzer, see InterproceduralAnalyzer::set_telemetry().
+// record() is called concurrently by the parallel analyzers.
+template <typename Function>
+class AnalysisTelemetry {
+ public:
+  struct Record {
+    Function function;
+    // The global iteration, or the iteration of the strongly connected
+    // component for a SccInterproceduralAnalyzer, starting at 0.
+    uint32_t iteration;
+    // The wall time of the analysis and the summarization of the function.
+    uint64_t microseconds;
+    FunctionAnalysisStats stats;
+    // Whether the summary of the function changed. Always false if the
+    // Registry does not count the changes of the summaries, see
+    // SccInterproceduralAnalyzer.
+    bool summary_changed;
+  };
+
+  virtual void record(const Record& record) = 0;
+
+  virtual ~AnalysisTelemetry() {}
+};
+
+template <typename FunctionAnalyzer, typename = void>
+struct has_analysis_stats : std::false_type {};
+
+template <typename FunctionAnalyzer>
+struct has_analysis_stats<
+    FunctionAnalyzer,
+    std::void_t<decltype(std::declval<const FunctionAnalyzer&>()
+                             .analysis_stats())>> : std::true_type {};
+
+template <typename Registry, typename Function, typename = void>
+struct has_summary_version : std::false_type {};
+
+template <typename Registry, typename Function>
+struct has_summary_version<
+    Registry,
+    Function,
+    std::void_t<decltype(std::declval<const Registry&>().version(
+        std::declval<const Function&>()))>> : std::true_type {};
+
+template <typename Registry, typename Function, typename = void>
+struct has_summary_widening : std::false_type {};
+
+template <typename Registry, typename Function>
+struct has_summary_widening<
+    Registry,
+    Function,
+    std::void_t<decltype(std::declval<Registry&>().widen(
+        std::declval<const Function&>()))>> : std::true_type {};
+
 // Typical Usage:
 
 // struct IRAdaptor /* defined for the IR */ {
@@ -176,19 +254,25 @@ class InterproceduralAnalyzer {
    public:
     static CallerContext initial_domain() { return CallerContext(); }
 
+    // Any trailing arguments are forwarded to the constructor of
+    // Analysis::FixpointIteratorBase, e.g. the number of threads of a
+    // ParallelMonotonicFixpointIterator.
+    template <typename... FixpointArgs>
     explicit CallGraphFixpointIterator(const CallGraph& graph,
                                        Registry* registry,
-                                       const IntraFn& intraprocedural)
+                                       const IntraFn& intraprocedural,
+                                       FixpointArgs&&... fixpoint_args)
         : Analysis::template FixpointIteratorBase<CallGraphInterface,
-                                                  CallerContext>(graph),
+                                                  CallerContext>(
+              graph, std::forward<FixpointArgs>(fixpoint_args)...),
           m_intraprocedural(intraprocedural),
           m_registry(registry) {}
 
+    // The intraprocedural function analyzes and summarizes the function.
     virtual void analyze_node(const typename CallGraphInterface::NodeId& node,
                               CallerContext* current_state) const override {
       m_intraprocedural(Analysis::function_by_node_id(node), this->m_registry,
-                        current_state)
-          ->summarize();
+                        current_state);
     }
 
     CallerContext analyze_edge(
@@ -228,9 +312,9 @@ class InterproceduralAnalyzer {
 
     std::shared_ptr<CallGraphFixpointIterator> fp = nullptr;
     boost::optional<CallGraph> callgraph = boost::none;
-    printf("start iteration globally\n");
+    m_reached_fixpoint = false;
     for (int iteration = 0; iteration < m_max_iteration; iteration++) {
-      printf("start iteration %d\n", iteration);
+      m_iteration = iteration;
       if (m_logger) {
         (*m_logger)(std::string("Iteration ") + std::to_string(iteration + 1));
       }
@@ -242,30 +326,27 @@ class InterproceduralAnalyzer {
         // If the callgraph requires to be rebuilt, we need to rebuild the
         // iterator as well as weak partial ordering should be updated.
         // define a fp and tells it how to analyze on a function
-        fp = std::make_shared<CallGraphFixpointIterator>(
+        fp = make_fixpoint_iterator(
             *callgraph,
-            &this->registry,
             [this, callgraph](
                 const Function& func, Registry* reg,
                 CallerContext* context) -> std::shared_ptr<FunctionAnalyzer> {
               // intraprocedural part
-              return this->run_on_function(func, reg, context, &*callgraph);
+              return this->analyze_function(func, reg, context, &*callgraph,
+                                            m_iteration);
             });
       }
-      printf("In Analyzer.h fp->run(CallGraphFixpointIterator::initial_domain())\n");
 
       fp->run(CallGraphFixpointIterator::initial_domain());
-      printf("In Analyzer.h fp->finish run(CallGraphFixpointIterator::initial_domain())\n");
 
       if (this->registry.has_update()) {
-        printf("registry has update\n");
         this->registry.materialize_update();
       } else {
-        printf("registry does not have update, global fixpoint rached after %d iteration\n", iteration + 1);
         if (m_logger) {
           (*m_logger)(std::string("Global fixpoint reached after ") +
                       std::to_string(iteration + 1) + " iterations.");
         }
+        m_reached_fixpoint = true;
         break;
       }
     }
@@ -292,12 +373,549 @@ class InterproceduralAnalyzer {
     m_logger = logger;
   }
 
+  // Records every analysis of a function into `telemetry`, which must outlive
+  // the runs. Disabled if null, the default.
+  void set_telemetry(AnalysisTelemetry<Function>* telemetry) {
+    m_telemetry = telemetry;
+  }
+
+  // Whether the last run() reached a global fixpoint within max_iteration
+  // iterations.
+  bool reached_fixpoint() const { return m_reached_fixpoint; }
+
+  // The functions whose summaries the last run() widened to top because they
+  // did not stabilize within their iteration budget, in no particular order.
+  // Only SccInterproceduralAnalyzer has budgets.
+  const std::vector<Function>& budget_exhausted_functions() const {
+    return m_budget_exhausted;
+  }
+
+ protected:
+  virtual std::shared_ptr<CallGraphFixpointIterator> make_fixpoint_iterator(
+      const CallGraph& graph, const IntraFn& intraprocedural) {
+    return std::make_shared<CallGraphFixpointIterator>(graph, &this->registry,
+                                                       intraprocedural);
+  }
+
+  // Analyzes and summarizes `function`, and records it if the telemetry is
+  // enabled.
+  std::shared_ptr<FunctionAnalyzer> analyze_function(const Function& function,
+                                                     Registry* reg,
+                                                     CallerContext* context,
+                                                     const CallGraph* graph,
+                                                     uint32_t iteration) {
+    if (m_telemetry == nullptr) {
+      auto analyzer = run_on_function(function, reg, context, graph);
+      analyzer->summarize();
+      return analyzer;
+    }
+
+    typename AnalysisTelemetry<Function>::Record record{
+        function, iteration, 0, FunctionAnalysisStats(), false};
+    uint64_t version = 0;
+    if constexpr (has_summary_version<Registry, Function>::value) {
+      version = reg->version(function);
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto analyzer = run_on_function(function, reg, context, graph);
+    analyzer->summarize();
+    record.microseconds = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+    if constexpr (has_analysis_stats<FunctionAnalyzer>::value) {
+      record.stats = analyzer->analysis_stats();
+    }
+    if constexpr (has_summary_version<Registry, Function>::value) {
+      record.summary_changed = reg->version(function) != version;
+    }
+    m_telemetry->record(record);
+    return analyzer;
+  }
+
+  const Program& program() const { return m_program; }
+
+  int max_iteration() const { return m_max_iteration; }
+
+  void set_reached_fixpoint(bool reached_fixpoint) {
+    m_reached_fixpoint = reached_fixpoint;
+  }
+
+  // Thread-safe.
+  void add_budget_exhausted_function(const Function& function) {
+    std::lock_guard<std::mutex> lock(m_budget_exhausted_lock);
+    m_budget_exhausted.push_back(function);
+  }
+
+  void clear_budget_exhausted_functions() { m_budget_exhausted.clear(); }
+
+  void log(const std::string& message) const {
+    if (m_logger) {
+      (*m_logger)(message);
+    }
+  }
+
  private:
   Program m_program;
   int m_max_iteration;
   AnalysisParameters* m_parameters;
+  bool m_reached_fixpoint = false;
+  std::mutex m_budget_exhausted_lock;
+  std::vector<Function> m_budget_exhausted;
+  // The current global iteration of run().
+  uint32_t m_iteration = 0;
   boost::optional<std::function<void(const std::string&)>> m_logger =
       boost::none;
+  AnalysisTelemetry<Function>* m_telemetry = nullptr;
+};
+
+// Runs the call graph level fixpoint of `Analysis` on a
+// ParallelMonotonicFixpointIterator instead of the iterator chosen by the
+// adaptor. The Registry and the FunctionAnalyzer must tolerate concurrent
+// calls for distinct functions.
+//
+// The summaries are the same as with a MonotonicFixpointIterator on the same
+// call graph, recursive components included, provided that a function only
+// reads the summaries of its neighbors in the call graph. Both iterators
+// follow the same weak partial ordering: every edge orders the analyses of its
+// source and target in each iteration of the component that contains them, so
+// each summary is read after the same analyses of its function whatever the
+// schedule. The successors of a node must be enumerated in the same order by
+// both runs, since they determine the weak partial ordering.
+template <typename Analysis>
+struct ParallelAnalysisAdaptor : public Analysis {
+  template <typename GraphInterface, typename Domain>
+  using FixpointIteratorBase =
+      ParallelMonotonicFixpointIterator<GraphInterface, Domain>;
+};
+
+template <typename Analysis, typename AnalysisParameters = void>
+class ParallelInterproceduralAnalyzer
+    : public InterproceduralAnalyzer<ParallelAnalysisAdaptor<Analysis>,
+                                     AnalysisParameters> {
+ public:
+  using Base = InterproceduralAnalyzer<ParallelAnalysisAdaptor<Analysis>,
+                                       AnalysisParameters>;
+  using Program = typename Base::Program;
+  using CallGraph = typename Base::CallGraph;
+  using CallGraphFixpointIterator = typename Base::CallGraphFixpointIterator;
+  using IntraFn = typename Base::IntraFn;
+
+  ParallelInterproceduralAnalyzer(
+      Program program,
+      int max_iteration,
+      AnalysisParameters* parameters = nullptr,
+      size_t num_threads = parallel::default_num_threads())
+      : Base(std::move(program), max_iteration, parameters),
+        m_num_threads(num_threads) {}
+
+ protected:
+  std::shared_ptr<CallGraphFixpointIterator> make_fixpoint_iterator(
+      const CallGraph& graph, const IntraFn& intraprocedural) override {
+    return std::make_shared<CallGraphFixpointIterator>(
+        graph, &this->registry, intraprocedural, m_num_threads);
+  }
+
+ private:
+  size_t m_num_threads;
+};
+
+// Analyzes the strongly connected components of the call graph one at a time,
+// in the order of Analysis::CallGraphInterface: a component is analyzed once
+// all the components with edges into it are done. With an interface that
+// visits the callees first, like a backwards call graph, a function that is
+// not part of a cycle is thus analyzed once, with the final summaries of its
+// callees, instead of once per global iteration. The functions of a cyclic
+// component are analyzed in turn until neither their summaries nor their exit
+// states change, at most `max_iteration` times. Components that do not depend
+// on each other are analyzed concurrently on a SpartaWorkQueue, so the
+// Registry and the FunctionAnalyzer must tolerate concurrent calls for
+// distinct functions when more than one thread is used.
+//
+// The entry state of a function is computed like in a MonotonicFixpointIterator
+// on the same graph. The Registry must count the changes of each summary:
+//
+//   size_t version(const Function& function) const;
+//
+// run() returns no fixpoint iterator, reached_fixpoint() is false if a cyclic
+// component did not stabilize within `max_iteration` iterations.
+//
+// A deep mutual recursion can take all of `max_iteration` iterations, on each
+// of its functions, before giving up with unsound summaries. A budget bounds
+// the iterations of every cyclic component instead, see
+// set_component_budget(). The Registry must then be able to set a summary to
+// top:
+//
+//   void widen(const Function& function);
+//
+// The summaries of the functions of a component do not change once it is
+// analyzed, see set_component_callback().
+template <typename Analysis, typename AnalysisParameters = void>
+class SccInterproceduralAnalyzer
+    : public InterproceduralAnalyzer<Analysis, AnalysisParameters> {
+ public:
+  using Base = InterproceduralAnalyzer<Analysis, AnalysisParameters>;
+  using Function = typename Base::Function;
+  using Program = typename Base::Program;
+  using CallGraphInterface = typename Base::CallGraphInterface;
+  using CallGraph = typename Base::CallGraph;
+  using Callsite = typename Base::Callsite;
+  using CallerContext = typename Base::CallerContext;
+  using CallGraphFixpointIterator = typename Base::CallGraphFixpointIterator;
+  using NodeId = typename CallGraphInterface::NodeId;
+  using EdgeId = typename CallGraphInterface::EdgeId;
+  using ComponentCallback =
+      std::function<void(const std::vector<Function>& functions, bool widened)>;
+
+  SccInterproceduralAnalyzer(
+      Program program,
+      int max_iteration,
+      AnalysisParameters* parameters = nullptr,
+      size_t num_threads = parallel::default_num_threads())
+      : Base(std::move(program), max_iteration, parameters),
+        m_num_threads(num_threads) {}
+
+  // Limits the iterations of each cyclic component to `budget`, at most
+  // `max_iteration`. If a component did not stabilize when its budget runs
+  // out, the summaries of its functions are widened to top, the states they
+  // pass to the components that depend on them are set to top, and the
+  // functions are reported by budget_exhausted_functions(). The summaries are
+  // then sound but reached_fixpoint() is false. 0, the default, disables the
+  // budget.
+  void set_component_budget(int budget) {
+    static_assert(has_summary_widening<typename Base::Registry,
+                                       Function>::value,
+                  "The Registry must provide widen(function)");
+    m_component_budget = budget;
+  }
+
+  // Calls `callback` with the functions of each component once their
+  // summaries are final, and whether they were widened to top because the
+  // component exhausted its budget. The callback is called concurrently by
+  // the worker threads, before the components that depend on the component
+  // are analyzed. Disabled if empty, the default.
+  void set_component_callback(ComponentCallback callback) {
+    m_component_callback = std::move(callback);
+  }
+
+  std::shared_ptr<CallGraphFixpointIterator> run(
+      bool /* rebuild_callgraph_on_each_iteration */ = false) override {
+    this->clear_budget_exhausted_functions();
+    CallGraph graph = Analysis::call_graph_of(this->program(), &this->registry);
+    auto components = strongly_connected_components(graph);
+    this->log(std::to_string(components.size()) + " components, " +
+              std::to_string(std::count_if(
+                  components.begin(), components.end(),
+                  [](const Component& c) { return c.is_cyclic; })) +
+              " cyclic");
+
+    // All the states are created up front, so that the tasks only access
+    // existing entries.
+    States states;
+    for (const auto& component : components) {
+      for (const auto& node : component.nodes) {
+        states.emplace(node, std::make_pair(CallerContext::bottom(),
+                                            CallerContext::bottom()));
+      }
+    }
+
+    std::unique_ptr<std::atomic<uint32_t>[]> num_done_preds(
+        new std::atomic<uint32_t>[components.size()]);
+    std::fill_n(num_done_preds.get(), components.size(), 0);
+    std::atomic<bool> all_stable{true};
+    auto wq = sparta::work_queue<uint32_t>(
+        [&](SpartaWorkerState<uint32_t>* worker_state, uint32_t index) {
+          const auto& component = components[index];
+          bool stable = analyze_component(graph, component, &states);
+          if (!stable) {
+            all_stable = false;
+          }
+          if (m_component_callback) {
+            std::vector<Function> functions;
+            functions.reserve(component.nodes.size());
+            for (const auto& node : component.nodes) {
+              functions.push_back(Analysis::function_by_node_id(node));
+            }
+            m_component_callback(functions,
+                                 !stable && m_component_budget > 0);
+          }
+          for (auto succ : component.successors) {
+            if (++num_done_preds[succ] == components[succ].num_preds) {
+              worker_state->push_task(succ);
+            }
+          }
+        },
+        m_num_threads,
+        /* push_tasks_while_running */ true);
+    for (uint32_t index = 0; index < components.size(); ++index) {
+      if (components[index].num_preds == 0) {
+        wq.add_item(index);
+      }
+    }
+    wq.run_all();
+
+    this->set_reached_fixpoint(all_stable);
+    if (!this->budget_exhausted_functions().empty()) {
+      this->log(std::to_string(this->budget_exhausted_functions().size()) +
+                " functions of cyclic components exhausted the budget of " +
+                std::to_string(component_budget()) +
+                " iterations and were widened.");
+    } else if (!all_stable) {
+      this->log("Some cyclic components did not stabilize after " +
+                std::to_string(this->max_iteration()) + " iterations.");
+    }
+    return nullptr;
+  }
+
+ private:
+  struct Component {
+    std::vector<NodeId> nodes;
+    // Has more than one node, or a node that calls itself.
+    bool is_cyclic = false;
+    // The components with an edge from this one.
+    std::vector<uint32_t> successors;
+    uint32_t num_preds = 0;
+  };
+
+  // The entry and exit states of each node.
+  using States =
+      std::unordered_map<NodeId, std::pair<CallerContext, CallerContext>>;
+
+  // Tarjan's algorithm on the nodes reachable from the entry, without
+  // recursion since call chains can be deep.
+  static std::vector<Component> strongly_connected_components(
+      const CallGraph& graph) {
+    struct Frame {
+      NodeId node;
+      std::vector<EdgeId> succs;
+      size_t next_succ;
+    };
+    std::unordered_map<NodeId, uint32_t> index;
+    std::unordered_map<NodeId, uint32_t> lowlink;
+    std::unordered_set<NodeId> on_stack;
+    std::vector<NodeId> stack;
+    std::vector<Frame> frames;
+    std::vector<Component> components;
+    std::unordered_map<NodeId, uint32_t> component_of;
+
+    auto push = [&](const NodeId& node) {
+      uint32_t i = index.size();
+      index.emplace(node, i);
+      lowlink.emplace(node, i);
+      stack.push_back(node);
+      on_stack.insert(node);
+      frames.push_back(
+          Frame{node, CallGraphInterface::successors(graph, node), 0});
+    };
+    push(CallGraphInterface::entry(graph));
+    while (!frames.empty()) {
+      auto& frame = frames.back();
+      if (frame.next_succ < frame.succs.size()) {
+        auto succ = CallGraphInterface::target(
+            graph, frame.succs[frame.next_succ++]);
+        if (!index.count(succ)) {
+          push(succ);
+        } else if (on_stack.count(succ)) {
+          auto& low = lowlink.at(frame.node);
+          low = std::min(low, index.at(succ));
+        }
+        continue;
+      }
+      NodeId node = frame.node;
+      frames.pop_back();
+      if (!frames.empty()) {
+        auto& low = lowlink.at(frames.back().node);
+        low = std::min(low, lowlink.at(node));
+      }
+      if (lowlink.at(node) != index.at(node)) {
+        continue;
+      }
+      Component component;
+      NodeId member;
+      do {
+        member = stack.back();
+        stack.pop_back();
+        on_stack.erase(member);
+        component_of.emplace(member, components.size());
+        component.nodes.push_back(member);
+      } while (!(member == node));
+      // Analyze the nodes of a cyclic component in the order they were
+      // reached.
+      std::reverse(component.nodes.begin(), component.nodes.end());
+      components.push_back(std::move(component));
+    }
+
+    for (uint32_t i = 0; i < components.size(); ++i) {
+      auto& component = components[i];
+      component.is_cyclic = component.nodes.size() > 1;
+      std::unordered_set<uint32_t> successors;
+      for (const auto& node : component.nodes) {
+        for (const auto& edge : CallGraphInterface::successors(graph, node)) {
+          auto succ = component_of.at(CallGraphInterface::target(graph, edge));
+          if (succ == i) {
+            component.is_cyclic = true;
+          } else if (successors.insert(succ).second) {
+            component.successors.push_back(succ);
+            ++components[succ].num_preds;
+          }
+        }
+      }
+    }
+    return components;
+  }
+
+  // Joins the states flowing into `node` into its entry state.
+  void compute_entry_state(const CallGraph& graph,
+                           const NodeId& node,
+                           const States& states,
+                           CallerContext* entry_state) const {
+    if (node == CallGraphInterface::entry(graph)) {
+      entry_state->join_with(CallGraphFixpointIterator::initial_domain());
+    }
+    // Nodes that are not reachable from the entry have a bottom exit state.
+    const CallerContext bottom = CallerContext::bottom();
+    for (const auto& edge : CallGraphInterface::predecessors(graph, node)) {
+      auto it = states.find(CallGraphInterface::source(graph, edge));
+      const CallerContext& exit_state =
+          it == states.end() ? bottom : it->second.second;
+      entry_state->join_with(
+          optionally_analyze_edge_if_exist<Callsite, EdgeId, CallerContext>(
+              nullptr, edge, exit_state));
+    }
+  }
+
+  // The iterations of a cyclic component.
+  int component_budget() const {
+    return m_component_budget > 0
+               ? std::min(m_component_budget, this->max_iteration())
+               : this->max_iteration();
+  }
+
+  // Returns false if the component did not stabilize.
+  bool analyze_component(const CallGraph& graph,
+                         const Component& component,
+                         States* states) {
+    int max_iteration = component.is_cyclic ? component_budget() : 1;
+    for (int iteration = 0; iteration < max_iteration; ++iteration) {
+      bool changed = false;
+      for (const auto& node : component.nodes) {
+        auto& state = states->at(node);
+        compute_entry_state(graph, node, *states, &state.first);
+        auto function = Analysis::function_by_node_id(node);
+        auto version = this->registry.version(function);
+        CallerContext exit_state = state.first;
+        this->analyze_function(function, &this->registry, &exit_state, &graph,
+                               iteration);
+        if (version != this->registry.version(function) ||
+            !exit_state.equals(state.second)) {
+          changed = true;
+        }
+        state.second = std::move(exit_state);
+      }
+      if (!component.is_cyclic || !changed) {
+        return true;
+      }
+    }
+    if constexpr (has_summary_widening<typename Base::Registry,
+                                       Function>::value) {
+      if (m_component_budget > 0) {
+        for (const auto& node : component.nodes) {
+          auto function = Analysis::function_by_node_id(node);
+          this->registry.widen(function);
+          states->at(node).second.set_to_top();
+          this->add_budget_exhausted_function(function);
+        }
+      }
+    }
+    return false;
+  }
+
+  size_t m_num_threads;
+  int m_component_budget = 0;
+  ComponentCallback m_component_callback;
+};
+
+// Re-analyzes a function only if its calling context or one of the summaries
+// it read changed since its previous analysis. Otherwise, the exit state and
+// the FunctionAnalyzer of the previous analysis are reused, so the global
+// iterations after the first one only pay for the functions affected by
+// summary updates. `BaseAnalyzer` is an InterproceduralAnalyzer or a
+// ParallelInterproceduralAnalyzer.
+//
+// The Registry records the summaries read by a function:
+//
+//   void begin_reads(const Function& reader);
+//   void end_reads(const Function& reader);
+//   bool has_changed_reads(const Function& reader) const;
+//
+// where has_changed_reads() returns true unless the reads of `reader` have
+// been recorded and none of the summaries it read has been updated since.
+// The FunctionAnalyzer must only depend on its calling context and on the
+// summaries it reads, and its summarize() is called again when it is reused,
+// so it must be idempotent.
+template <typename BaseAnalyzer>
+class IncrementalInterproceduralAnalyzer : public BaseAnalyzer {
+ public:
+  using Function = typename BaseAnalyzer::Function;
+  using Registry = typename BaseAnalyzer::Registry;
+  using CallGraph = typename BaseAnalyzer::CallGraph;
+  using CallerContext = typename BaseAnalyzer::CallerContext;
+  using FunctionAnalyzer = typename BaseAnalyzer::FunctionAnalyzer;
+
+  using BaseAnalyzer::BaseAnalyzer;
+
+  std::shared_ptr<FunctionAnalyzer> run_on_function(
+      const Function& function,
+      Registry* reg,
+      CallerContext* context,
+      const CallGraph* graph) override {
+    boost::optional<PreviousAnalysis> previous;
+    {
+      std::lock_guard<std::mutex> lock(m_previous_mutex);
+      auto it = m_previous.find(function);
+      if (it != m_previous.end()) {
+        previous = it->second;
+      }
+    }
+    if (previous && previous->entry_state.equals(*context) &&
+        !reg->has_changed_reads(function)) {
+      *context = previous->exit_state;
+      previous->analyzer->set_summaries(reg);
+      previous->analyzer->set_caller_context(context);
+      previous->analyzer->set_call_graph(graph);
+      ++m_num_reused;
+      return previous->analyzer;
+    }
+
+    CallerContext entry_state = *context;
+    reg->begin_reads(function);
+    auto analyzer =
+        BaseAnalyzer::run_on_function(function, reg, context, graph);
+    reg->end_reads(function);
+    ++m_num_analyzed;
+
+    std::lock_guard<std::mutex> lock(m_previous_mutex);
+    m_previous[function] =
+        PreviousAnalysis{std::move(entry_state), *context, analyzer};
+    return analyzer;
+  }
+
+  // Number of FunctionAnalyzer runs since the analyzer was created.
+  size_t num_analyzed() const { return m_num_analyzed; }
+
+  // Number of times the previous analysis of a function was reused.
+  size_t num_reused() const { return m_num_reused; }
+
+ private:
+  struct PreviousAnalysis {
+    CallerContext entry_state;
+    CallerContext exit_state;
+    std::shared_ptr<FunctionAnalyzer> analyzer;
+  };
+
+  std::mutex m_previous_mutex;
+  std::unordered_map<Function, PreviousAnalysis> m_previous;
+  std::atomic<size_t> m_num_analyzed{0};
+  std::atomic<size_t> m_num_reused{0};
 };
 
 } // namespace sparta
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace sparta {
+
+/*
+ * A bump allocator: memory is carved out of chunks obtained from the heap,
+ * deallocation is a no-op, and all the chunks are freed at once when the arena
+ * is destroyed. This suits the transient state of an analysis, e.g., the
+ * hashtables of a fixpoint iterator, which lives and dies with the analysis of
+ * a single function.
+ *
+ * Not thread-safe. The objects allocated in the arena must be destroyed
+ * before the arena, i.e., the arena must be declared before the containers
+ * that use it.
+ */
+class Arena final {
+ public:
+  explicit Arena(size_t chunk_size = kDefaultChunkSize)
+      : m_next_chunk_size(chunk_size) {}
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  ~Arena() {
+    while (m_chunks != nullptr) {
+      Chunk* next = m_chunks->next;
+      ::operator delete(m_chunks);
+      m_chunks = next;
+    }
+  }
+
+  void* allocate(size_t size, size_t alignment) {
+    auto current = reinterpret_cast<uintptr_t>(m_current);
+    uintptr_t aligned = (current + alignment - 1) & ~(alignment - 1);
+    if (m_current == nullptr || aligned + size > m_end) {
+      new_chunk(size + alignment);
+      current = reinterpret_cast<uintptr_t>(m_current);
+      aligned = (current + alignment - 1) & ~(alignment - 1);
+    }
+    m_current = reinterpret_cast<char*>(aligned + size);
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  // The total size of the chunks, in bytes.
+  size_t capacity() const { return m_capacity; }
+
+ private:
+  static constexpr size_t kDefaultChunkSize = 4096;
+  static constexpr size_t kMaxChunkSize = 1 << 20;
+
+  struct alignas(std::max_align_t) Chunk {
+    Chunk* next;
+  };
+
+  // Chunks double in size, so that the number of chunks is logarithmic in the
+  // size of the arena.
+  void new_chunk(size_t min_size) {
+    size_t size = std::max(m_next_chunk_size, min_size);
+    m_next_chunk_size = std::min(m_next_chunk_size * 2, kMaxChunkSize);
+    auto* chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk) + size));
+    chunk->next = m_chunks;
+    m_chunks = chunk;
+    m_current = reinterpret_cast<char*>(chunk + 1);
+    m_end = reinterpret_cast<uintptr_t>(m_current) + size;
+    m_capacity += size;
+  }
+
+  size_t m_next_chunk_size;
+  Chunk* m_chunks = nullptr;
+  char* m_current = nullptr;
+  uintptr_t m_end = 0;
+  size_t m_capacity = 0;
+};
+
+/*
+ * A standard allocator that allocates from an Arena, or from the heap if the
+ * arena is null, so that the containers using it behave as usual unless an
+ * arena is provided.
+ */
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  ArenaAllocator() = default;
+
+  explicit ArenaAllocator(Arena* arena) : m_arena(arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.arena()) {}
+
+  T* allocate(size_t n) {
+    if (m_arena == nullptr) {
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* p, size_t /* n */) {
+    if (m_arena == nullptr) {
+      ::operator delete(p);
+    }
+  }
+
+  Arena* arena() const { return m_arena; }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const {
+    return m_arena == other.arena();
+  }
+
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const {
+    return m_arena != other.arena();
+  }
+
+ private:
+  Arena* m_arena = nullptr;
+};
+
+} // namespace sparta
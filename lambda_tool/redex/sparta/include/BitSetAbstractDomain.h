@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <initializer_list>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+#include "PatriciaTreeSet.h"
+#include "PowersetAbstractDomain.h"
+
+namespace sparta {
+
+namespace bsad_impl {
+
+/*
+ * A set of unsigned integers, e.g. registers, stored as an inline bitset for
+ * the elements below InlineBits. The larger elements go to a Patricia tree,
+ * which stays empty (and allocates nothing) as long as all the elements are
+ * small. Copying, joining and comparing sets of small elements is therefore
+ * just a few word operations.
+ */
+template <typename IntegerType, size_t InlineBits>
+class BitSetValue final
+    : public PowersetImplementation<IntegerType,
+                                    std::vector<IntegerType>,
+                                    BitSetValue<IntegerType, InlineBits>> {
+ public:
+  BitSetValue() = default;
+
+  BitSetValue(std::initializer_list<IntegerType> l) {
+    for (IntegerType e : l) {
+      add(e);
+    }
+  }
+
+  // Returns the elements in increasing order.
+  std::vector<IntegerType> elements() const override {
+    std::vector<IntegerType> elements;
+    elements.reserve(size());
+    for (size_t i = 0; i < InlineBits; ++i) {
+      if (m_inline.test(i)) {
+        elements.push_back(static_cast<IntegerType>(i));
+      }
+    }
+    auto overflow_begin = elements.size();
+    elements.insert(elements.end(), m_overflow.begin(), m_overflow.end());
+    std::sort(elements.begin() + overflow_begin, elements.end());
+    return elements;
+  }
+
+  size_t size() const override {
+    return m_inline.count() + m_overflow.size();
+  }
+
+  bool contains(const IntegerType& e) const override {
+    return e < InlineBits ? m_inline.test(e) : m_overflow.contains(e);
+  }
+
+  void add(const IntegerType& e) override {
+    if (e < InlineBits) {
+      m_inline.set(e);
+    } else {
+      m_overflow.insert(e);
+    }
+  }
+
+  void remove(const IntegerType& e) override {
+    if (e < InlineBits) {
+      m_inline.reset(e);
+    } else {
+      m_overflow.remove(e);
+    }
+  }
+
+  void clear() override {
+    m_inline.reset();
+    m_overflow.clear();
+  }
+
+  AbstractValueKind kind() const override { return AbstractValueKind::Value; }
+
+  bool leq(const BitSetValue& other) const override {
+    return (m_inline & ~other.m_inline).none() &&
+           m_overflow.is_subset_of(other.m_overflow);
+  }
+
+  bool equals(const BitSetValue& other) const override {
+    return m_inline == other.m_inline && m_overflow.equals(other.m_overflow);
+  }
+
+  AbstractValueKind join_with(const BitSetValue& other) override {
+    m_inline |= other.m_inline;
+    m_overflow.union_with(other.m_overflow);
+    return AbstractValueKind::Value;
+  }
+
+  AbstractValueKind meet_with(const BitSetValue& other) override {
+    m_inline &= other.m_inline;
+    m_overflow.intersection_with(other.m_overflow);
+    return AbstractValueKind::Value;
+  }
+
+  AbstractValueKind difference_with(const BitSetValue& other) override {
+    m_inline &= ~other.m_inline;
+    m_overflow.difference_with(other.m_overflow);
+    return AbstractValueKind::Value;
+  }
+
+  friend std::ostream& operator<<(std::ostream& o, const BitSetValue& value) {
+    o << "{";
+    const auto& elements = value.elements();
+    for (auto it = elements.begin(); it != elements.end();) {
+      o << *it++;
+      if (it != elements.end()) {
+        o << ", ";
+      }
+    }
+    o << "}";
+    return o;
+  }
+
+ private:
+  std::bitset<InlineBits> m_inline;
+  PatriciaTreeSet<IntegerType> m_overflow;
+};
+
+} // namespace bsad_impl
+
+/*
+ * A powerset abstract domain over unsigned integers that is efficient when the
+ * elements are small, such as the registers of a method. Elements below
+ * InlineBits are kept in a bitset, the others in a Patricia tree.
+ */
+template <typename IntegerType, size_t InlineBits = 64>
+class BitSetAbstractDomain final
+    : public PowersetAbstractDomain<
+          IntegerType,
+          bsad_impl::BitSetValue<IntegerType, InlineBits>,
+          std::vector<IntegerType>,
+          BitSetAbstractDomain<IntegerType, InlineBits>> {
+ public:
+  using Value = bsad_impl::BitSetValue<IntegerType, InlineBits>;
+
+  ~BitSetAbstractDomain() {
+    // The destructor is the only method that is guaranteed to be created when
+    // a class template is instantiated. This is a good place to perform all
+    // the sanity checks on the template parameters.
+    static_assert(std::is_unsigned<IntegerType>::value,
+                  "IntegerType is not an unsigned arithmetic type");
+    static_assert(InlineBits > 0, "InlineBits must be positive");
+  }
+
+  // Returns the empty set.
+  BitSetAbstractDomain()
+      : PowersetAbstractDomain<IntegerType,
+                               Value,
+                               std::vector<IntegerType>,
+                               BitSetAbstractDomain>() {}
+
+  explicit BitSetAbstractDomain(AbstractValueKind kind)
+      : PowersetAbstractDomain<IntegerType,
+                               Value,
+                               std::vector<IntegerType>,
+                               BitSetAbstractDomain>(kind) {}
+
+  explicit BitSetAbstractDomain(std::initializer_list<IntegerType> l) {
+    this->set_to_value(Value(l));
+  }
+
+  static BitSetAbstractDomain bottom() {
+    return BitSetAbstractDomain(AbstractValueKind::Bottom);
+  }
+
+  static BitSetAbstractDomain top() {
+    return BitSetAbstractDomain(AbstractValueKind::Top);
+  }
+};
+
+} // namespace sparta
@@ -9,6 +9,7 @@
 
 #include <bitset>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <initializer_list>
 #include <ostream>
@@ -502,4 +503,262 @@ class BitVectorLattice final
       m_opposite_semi_lattice;
 };
 
+/*
+ * A finite lattice whose encoding is computed at compile time. The elements are
+ * encoded by their index in the list given to the constructor, and the Join,
+ * the Meet and the partial order are precomputed tables indexed by the
+ * encodings. Unlike BitVectorLattice, the lattice operations are table lookups
+ * on small integers, decoding is an array access and there is no virtual
+ * dispatch. Example usage, for the lattice shown above FiniteAbstractDomain:
+ *
+ *   enum Elements {BOTTOM, A, B, TOP};
+ *
+ *   using Lattice = ConstexprLattice<Elements, 4>;
+ *
+ *   inline constexpr Lattice lattice({BOTTOM, A, B, TOP},
+ *                                    {{BOTTOM, A}, {BOTTOM, B},
+ *                                     {A, TOP}, {B, TOP}});
+ *
+ *   using Domain = ConstexprFiniteAbstractDomain<Elements, Lattice, &lattice>;
+ *
+ * The tables are built by the constexpr constructor from the reflexive and
+ * transitive closure of the Hasse diagram, so a diagram that doesn't describe a
+ * lattice is a compilation error.
+ */
+template <typename Element, size_t cardinality>
+class ConstexprLattice final {
+  // The closure of the order relation is computed on 64-bit rows.
+  static_assert(cardinality > 0 && cardinality <= 64,
+                "ConstexprLattice supports up to 64 elements");
+
+ public:
+  using Encoding = uint8_t;
+
+  template <size_t num_edges>
+  constexpr ConstexprLattice(
+      const Element (&elements)[cardinality],
+      const std::pair<Element, Element> (&hasse_diagram)[num_edges])
+      : m_elements(),
+        m_leq(),
+        m_join(),
+        m_meet(),
+        m_bottom(0),
+        m_top(0) {
+    for (size_t i = 0; i < cardinality; ++i) {
+      m_elements[i] = elements[i];
+    }
+
+    // Bit j of below[i] is set if element j is less than or equal to element i.
+    uint64_t below[cardinality] = {};
+    for (size_t i = 0; i < cardinality; ++i) {
+      below[i] = uint64_t(1) << i;
+    }
+    for (const auto& pair : hasse_diagram) {
+      below[index_of(pair.second)] |= uint64_t(1) << index_of(pair.first);
+    }
+    // Warshall's algorithm.
+    for (size_t k = 0; k < cardinality; ++k) {
+      for (size_t i = 0; i < cardinality; ++i) {
+        if ((below[i] >> k) & 1) {
+          below[i] |= below[k];
+        }
+      }
+    }
+
+    bool has_bottom = false;
+    bool has_top = false;
+    for (size_t i = 0; i < cardinality; ++i) {
+      for (size_t j = 0; j < cardinality; ++j) {
+        m_leq[i][j] = (below[j] >> i) & 1;
+        m_join[i][j] = least_upper_bound(below, i, j);
+        m_meet[i][j] = greatest_lower_bound(below, i, j);
+      }
+      if (below[i] == uint64_t(1) << i) {
+        RUNTIME_CHECK(!has_bottom, internal_error());
+        has_bottom = true;
+        m_bottom = static_cast<Encoding>(i);
+      }
+      if (below[i] == all_elements()) {
+        has_top = true;
+        m_top = static_cast<Encoding>(i);
+      }
+    }
+    RUNTIME_CHECK(has_bottom && has_top, internal_error());
+  }
+
+  constexpr Encoding encode(const Element& element) const {
+    return static_cast<Encoding>(index_of(element));
+  }
+
+  constexpr Element decode(Encoding encoding) const {
+    return m_elements[encoding];
+  }
+
+  constexpr bool is_bottom(Encoding x) const { return x == m_bottom; }
+
+  constexpr bool is_top(Encoding x) const { return x == m_top; }
+
+  constexpr bool leq(Encoding x, Encoding y) const { return m_leq[x][y]; }
+
+  constexpr Encoding join(Encoding x, Encoding y) const {
+    return m_join[x][y];
+  }
+
+  constexpr Encoding meet(Encoding x, Encoding y) const {
+    return m_meet[x][y];
+  }
+
+  constexpr Encoding bottom() const { return m_bottom; }
+
+  constexpr Encoding top() const { return m_top; }
+
+ private:
+  static constexpr uint64_t all_elements() {
+    return cardinality == 64 ? ~uint64_t(0)
+                             : (uint64_t(1) << (cardinality % 64)) - 1;
+  }
+
+  constexpr size_t index_of(const Element& element) const {
+    for (size_t i = 0; i < cardinality; ++i) {
+      if (m_elements[i] == element) {
+        return i;
+      }
+    }
+    BOOST_THROW_EXCEPTION(undefined_operation()
+                          << error_msg("Element not in the lattice"));
+  }
+
+  // The upper bound of x and y that is less than or equal to all the others.
+  static constexpr Encoding least_upper_bound(
+      const uint64_t (&below)[cardinality], size_t x, size_t y) {
+    uint64_t bounds = 0;
+    for (size_t u = 0; u < cardinality; ++u) {
+      if (((below[u] >> x) & 1) && ((below[u] >> y) & 1)) {
+        bounds |= uint64_t(1) << u;
+      }
+    }
+    for (size_t u = 0; u < cardinality; ++u) {
+      if (((bounds >> u) & 1) && all_above(below, u, bounds)) {
+        return static_cast<Encoding>(u);
+      }
+    }
+    BOOST_THROW_EXCEPTION(internal_error()
+                          << error_msg("No least upper bound"));
+  }
+
+  // The lower bound of x and y that is greater than or equal to all the others.
+  static constexpr Encoding greatest_lower_bound(
+      const uint64_t (&below)[cardinality], size_t x, size_t y) {
+    uint64_t bounds = below[x] & below[y];
+    for (size_t l = 0; l < cardinality; ++l) {
+      if (((bounds >> l) & 1) && (below[l] & bounds) == bounds) {
+        return static_cast<Encoding>(l);
+      }
+    }
+    BOOST_THROW_EXCEPTION(internal_error()
+                          << error_msg("No greatest lower bound"));
+  }
+
+  // Whether all the elements of `elements` are greater than or equal to u.
+  static constexpr bool all_above(const uint64_t (&below)[cardinality],
+                                  size_t u,
+                                  uint64_t elements) {
+    for (size_t v = 0; v < cardinality; ++v) {
+      if (((elements >> v) & 1) && !((below[v] >> u) & 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  Element m_elements[cardinality];
+  bool m_leq[cardinality][cardinality];
+  Encoding m_join[cardinality][cardinality];
+  Encoding m_meet[cardinality][cardinality];
+  Encoding m_bottom;
+  Encoding m_top;
+};
+
+/*
+ * The abstract domain of a ConstexprLattice, with the same interface as
+ * FiniteAbstractDomain. The lattice must be a constexpr variable with static
+ * storage duration.
+ */
+template <typename Element, typename Lattice, const Lattice* lattice>
+class ConstexprFiniteAbstractDomain final
+    : public AbstractDomain<
+          ConstexprFiniteAbstractDomain<Element, Lattice, lattice>> {
+ public:
+  using Encoding = typename Lattice::Encoding;
+
+  /*
+   * A default constructor is required in the AbstractDomain specification.
+   */
+  ConstexprFiniteAbstractDomain() : m_encoding(lattice->top()) {}
+
+  explicit ConstexprFiniteAbstractDomain(const Element& element)
+      : m_encoding(lattice->encode(element)) {}
+
+  Element element() const { return lattice->decode(m_encoding); }
+
+  bool is_bottom() const override { return lattice->is_bottom(m_encoding); }
+
+  bool is_top() const override { return lattice->is_top(m_encoding); }
+
+  bool leq(const ConstexprFiniteAbstractDomain& other) const override {
+    return lattice->leq(m_encoding, other.m_encoding);
+  }
+
+  bool equals(const ConstexprFiniteAbstractDomain& other) const override {
+    return m_encoding == other.m_encoding;
+  }
+
+  void set_to_bottom() override { m_encoding = lattice->bottom(); }
+
+  void set_to_top() override { m_encoding = lattice->top(); }
+
+  void join_with(const ConstexprFiniteAbstractDomain& other) override {
+    m_encoding = lattice->join(m_encoding, other.m_encoding);
+  }
+
+  void widen_with(const ConstexprFiniteAbstractDomain& other) override {
+    join_with(other);
+  }
+
+  void meet_with(const ConstexprFiniteAbstractDomain& other) override {
+    m_encoding = lattice->meet(m_encoding, other.m_encoding);
+  }
+
+  void narrow_with(const ConstexprFiniteAbstractDomain& other) override {
+    meet_with(other);
+  }
+
+  static ConstexprFiniteAbstractDomain bottom() {
+    return ConstexprFiniteAbstractDomain(lattice->bottom(), Encoded());
+  }
+
+  static ConstexprFiniteAbstractDomain top() {
+    return ConstexprFiniteAbstractDomain(lattice->top(), Encoded());
+  }
+
+ private:
+  // Tags the constructor from an encoding, since an unscoped Element may
+  // implicitly convert to Encoding.
+  struct Encoded {};
+
+  ConstexprFiniteAbstractDomain(Encoding encoding, Encoded)
+      : m_encoding(encoding) {}
+
+  Encoding m_encoding;
+};
+
 } // namespace sparta
+
+template <typename Element, typename Lattice, const Lattice* lattice>
+inline std::ostream& operator<<(
+    std::ostream& o,
+    const typename sparta::
+        ConstexprFiniteAbstractDomain<Element, Lattice, lattice>& x) {
+  o << x.element();
+  return o;
+}
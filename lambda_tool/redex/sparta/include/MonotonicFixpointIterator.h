@@ -15,6 +15,7 @@
 #include <vector>
 // #include <iostream>
 #include "AbstractDomain.h"
+#include "ArenaAllocator.h"
 #include "FixpointIterator.h"
 #include "SpartaWorkQueue.h"
 #include "WeakPartialOrdering.h"
@@ -114,11 +115,22 @@ class MonotonicFixpointIteratorBase
    * When the number of nodes in the CFG is known, it's better to provide it to
    * the constructor, so as to prevent unnecessary resizing of the underlying
    * hashtables during the iteration.
+   *
+   * If an arena is provided, the hashtables of the states are allocated from
+   * it instead of the heap. The arena must outlive the fixpoint iterator.
    */
-  MonotonicFixpointIteratorBase(const Graph& graph, size_t cfg_size_hint = 4)
+  MonotonicFixpointIteratorBase(const Graph& graph,
+                                size_t cfg_size_hint = 4,
+                                Arena* arena = nullptr)
       : m_graph(graph),
-        m_entry_states(cfg_size_hint),
-        m_exit_states(cfg_size_hint) {}
+        m_entry_states(cfg_size_hint,
+                       NodeHash(),
+                       std::equal_to<NodeId>(),
+                       StateAllocator(arena)),
+        m_exit_states(cfg_size_hint,
+                      NodeHash(),
+                      std::equal_to<NodeId>(),
+                      StateAllocator(arena)) {}
 
   /*
    * This method is invoked on the head of an SCC at each iteration, whenever
@@ -172,6 +184,13 @@ class MonotonicFixpointIteratorBase
     return (it == m_exit_states.end()) ? Domain::bottom() : it->second;
   }
 
+  /*
+   * Returns the number of times the components of the graph were iterated
+   * again because they did not stabilize, during the last run. This is 0 for
+   * an acyclic graph.
+   */
+  uint32_t get_num_iterations() const { return m_num_iterations; }
+
   void clear() {
     m_entry_states.clear();
     m_exit_states.clear();
@@ -189,12 +208,9 @@ class MonotonicFixpointIteratorBase
                            const NodeId& node,
                            Domain* entry_state) {
     if (node == GraphInterface::entry(m_graph)) {
-      printf("node is entry, get initial value of calling context and join with entry_state\n");
       entry_state->join_with(context->get_initial_value());
-      printf("is entry state bottom %d\n", entry_state->is_bottom());
     }
     for (EdgeId edge : GraphInterface::predecessors(m_graph, node)) {
-      printf("node is not entry, now iterate all predecessors\n");
       entry_state->join_with(this->analyze_edge(
           edge, get_exit_state_at(GraphInterface::source(m_graph, edge))));
     }
@@ -212,17 +228,23 @@ class MonotonicFixpointIteratorBase
     // iteration is not a viable option, since the control-flow graph may
     // contain unreachable nodes pointing to reachable ones (see the
     // documentation of `get_exit_state_at`).
-    printf("analyze_vertex() compute_entry_state\n");
     compute_entry_state(context, node, &entry_state);
     Domain& exit_state = m_exit_states[node];
     exit_state = entry_state;
-    printf("analyze_vertex() begin analyze the node\n");
     this->analyze_node(node, &exit_state);
   }
 
+  using StateAllocator = ArenaAllocator<std::pair<const NodeId, Domain>>;
+  using StateMap = std::unordered_map<NodeId,
+                                      Domain,
+                                      NodeHash,
+                                      std::equal_to<NodeId>,
+                                      StateAllocator>;
+
   const Graph& m_graph;
-  std::unordered_map<NodeId, Domain, NodeHash> m_entry_states;
-  std::unordered_map<NodeId, Domain, NodeHash> m_exit_states;
+  StateMap m_entry_states;
+  StateMap m_exit_states;
+  uint32_t m_num_iterations = 0;
 };
 
 } // namespace fp_impl
@@ -250,10 +272,13 @@ class WTOMonotonicFixpointIterator
   using Context =
       fp_impl::MonotonicFixpointIteratorContext<NodeId, Domain, NodeHash>;
 
-  WTOMonotonicFixpointIterator(const Graph& graph, size_t cfg_size_hint = 4)
+  WTOMonotonicFixpointIterator(const Graph& graph,
+                               size_t cfg_size_hint = 4,
+                               Arena* arena = nullptr)
       : fp_impl::MonotonicFixpointIteratorBase<GraphInterface,
                                                Domain,
-                                               NodeHash>(graph, cfg_size_hint),
+                                               NodeHash>(
+            graph, cfg_size_hint, arena),
         m_wto(GraphInterface::entry(graph), [=, &graph](const NodeId& x) {
           const auto& succ_edges = GraphInterface::successors(graph, x);
           std::vector<NodeId> succ_nodes;
@@ -275,6 +300,7 @@ class WTOMonotonicFixpointIterator
   void run(const Domain& init) {
     this->clear();
     Context context(init);
+    this->m_num_iterations = 0;
     for (const WtoComponent<NodeId>& component : m_wto) {
       analyze_component(&context, component);
     }
@@ -319,6 +345,7 @@ class WTOMonotonicFixpointIterator
         iterate = false;
       } else {
         this->extrapolate(*context, head, current_state, new_state);
+        ++this->m_num_iterations;
       }
     }
   }
@@ -402,18 +429,18 @@ class ParallelMonotonicFixpointIterator
    * initial conditions.
    */
   void run(const Domain& init) {
-    printf("ParallelMonotonicFixpointIterator run\n");
     this->set_all_to_bottom(m_all_nodes);
     Context context(init, m_all_nodes);
     std::unique_ptr<std::atomic<uint32_t>[]> wpo_counter(
         new std::atomic<uint32_t>[m_wpo.size()]);
     std::fill_n(wpo_counter.get(), m_wpo.size(), 0);
+    std::atomic<uint32_t> num_iterations{0};
     auto entry_idx = m_wpo.get_entry();
     assert(m_wpo.get_num_preds(entry_idx) == 0);
     // Prepare work queue.
     auto wq = sparta::work_queue<uint32_t>(
-        [&context, &entry_idx, &wpo_counter, this](WPOWorkerState* worker_state,
-                                                   uint32_t wpo_idx) {
+        [&context, &entry_idx, &wpo_counter, &num_iterations, this](
+            WPOWorkerState* worker_state, uint32_t wpo_idx) {
           std::atomic<uint32_t>& current_counter = wpo_counter[wpo_idx];
           assert(current_counter == m_wpo.get_num_preds(wpo_idx));
           current_counter = 0;
@@ -453,6 +480,7 @@ class ParallelMonotonicFixpointIterator
             // Component didn't stabilize.
             this->extrapolate(context, head, current_state, new_state);
             context.increase_iteration_count_for(head);
+            ++num_iterations;
             // Set component nodes v's counter to their
             // NumOuterSchedPreds(v, wpo_idx)
             for (auto pred_pair : m_wpo.get_num_outer_preds(wpo_idx)) {
@@ -494,6 +522,7 @@ class ParallelMonotonicFixpointIterator
     for (uint32_t idx = 0; idx < m_wpo.size(); ++idx) {
       assert(wpo_counter[idx] == 0);
     }
+    this->m_num_iterations = num_iterations;
   }
 
  private:
@@ -520,10 +549,13 @@ class MonotonicFixpointIterator
   using Context =
       fp_impl::MonotonicFixpointIteratorContext<NodeId, Domain, NodeHash>;
 
-  MonotonicFixpointIterator(const Graph& graph, size_t cfg_size_hint = 4)
+  MonotonicFixpointIterator(const Graph& graph,
+                            size_t cfg_size_hint = 4,
+                            Arena* arena = nullptr)
       : fp_impl::MonotonicFixpointIteratorBase<GraphInterface,
                                                Domain,
-                                               NodeHash>(graph, cfg_size_hint),
+                                               NodeHash>(
+            graph, cfg_size_hint, arena),
         m_wpo(
             GraphInterface::entry(graph),
             [=, &graph](const NodeId& x) {
@@ -555,8 +587,8 @@ class MonotonicFixpointIterator
    * initial conditions.
    */
   void run(const Domain& init) {
-    printf("MonotonicFixpointIterator run\n");
     this->clear();
+    this->m_num_iterations = 0;
     Context context(init);
     std::unique_ptr<std::atomic<uint32_t>[]> wpo_counter(
         new std::atomic<uint32_t>[m_wpo.size()]);
@@ -571,7 +603,6 @@ class MonotonicFixpointIterator
       // NonExit node
       if (!m_wpo.is_exit(wpo_idx)) {
         this->analyze_vertex(&context, m_wpo.get_node(wpo_idx));
-        printf("------fixpointiterator finish analyzing this vertex--------\n");
         for (auto succ_idx : m_wpo.get_successors(wpo_idx)) {
           // Increase succ node's counter, push succ nodes in work queue if
           // their counter number matches their NumSchedPreds.
@@ -603,6 +634,7 @@ class MonotonicFixpointIterator
         // Component didn't stabilize.
         this->extrapolate(context, head, current_state, new_state);
         context.increase_iteration_count_for(head);
+        ++this->m_num_iterations;
         // Set component nodes v's counter to their
         // NumOuterSchedPreds(v, wpo_idx)
         for (auto pred_pair : m_wpo.get_num_outer_preds(wpo_idx)) {
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <type_traits>
+#include <unordered_set>
+
+#include <boost/intrusive_ptr.hpp>
+
+#include "SlabAllocator.h"
+
+namespace sparta {
+
+/*
+ * By default, every node of a Patricia tree is allocated on the heap, and
+ * structurally identical subtrees that are built independently (e.g., by two
+ * joins) are distinct objects. Specializing this template opts Patricia trees
+ * into hash-consed nodes:
+ *
+ *   - Nodes are unique: equal trees are the same pointer, hence equals() and
+ *     leq() short-circuit on pointer identity and equal subtrees are only
+ *     stored once.
+ *   - Nodes are allocated from thread-local slabs.
+ *
+ * For a PatriciaTreeMap (or PatriciaTreeMapAbstractEnvironment), T is the type
+ * of the values, and the specialization must provide a hash function
+ * consistent with the equality of values:
+ *
+ *   template <>
+ *   struct sparta::PatriciaTreeHashConsing<ConstantDomain> : std::true_type {
+ *     static size_t hash(const ConstantDomain& x) { ... }
+ *   };
+ *
+ * For a PatriciaTreeSet, the nodes only depend on the integer encoding of the
+ * elements, so T is the integer type of the keys (uintptr_t for pointers), and
+ * all the sets over that type are hash-consed.
+ *
+ * Creating a node then costs a lookup in a global table, which pays off when
+ * the same trees are built over and over again, as in the abstract
+ * environments of a fixpoint iteration.
+ */
+template <typename T>
+struct PatriciaTreeHashConsing : std::false_type {};
+
+namespace pt_util {
+
+/*
+ * Base class of the node classes of Patricia trees, which allocates the nodes
+ * from a SlabAllocator when they are hash-consed.
+ */
+template <typename Derived, bool hash_consed>
+class SlabAllocated {
+ public:
+  static void* operator new(size_t size) {
+    if constexpr (hash_consed) {
+      return SlabAllocator<sizeof(Derived), alignof(Derived)>::allocate();
+    } else {
+      return ::operator new(size);
+    }
+  }
+
+  static void operator delete(void* p) {
+    if constexpr (hash_consed) {
+      SlabAllocator<sizeof(Derived), alignof(Derived)>::deallocate(p);
+    } else {
+      ::operator delete(p);
+    }
+  }
+};
+
+/*
+ * The table of the live hash-consed nodes of type Node, the base class of the
+ * nodes of a kind of Patricia tree, which must provide:
+ *
+ *   // A hash code consistent with structurally_equals().
+ *   size_t structural_hash() const;
+ *
+ *   // Whether the nodes have the same kind and contents. Since the children of
+ *   // a hash-consed node are hash-consed, they are compared by pointer.
+ *   bool structurally_equals(const Node& other) const;
+ *
+ *   // Increments the reference count unless it is zero, i.e., unless the node
+ *   // is being destroyed.
+ *   bool try_add_ref() const;
+ *
+ * The table doesn't own the nodes: the release of the last reference to a node
+ * must call erase() before destroying it.
+ */
+template <typename Node>
+class HashConsingTable final {
+ public:
+  // Returns the node of the table that is equal to `node` and deletes `node`,
+  // or inserts `node` in the table if there is none.
+  template <typename Derived>
+  static boost::intrusive_ptr<Derived> intern(Derived* node) {
+    Entry entry{node->structural_hash(), node};
+    auto& shard = shard_of(entry.hash);
+    std::unique_lock<std::mutex> lock(shard.lock);
+    auto it = shard.nodes.find(entry);
+    if (it != shard.nodes.end()) {
+      Node* existing = it->node;
+      if (existing->try_add_ref()) {
+        lock.unlock();
+        delete node;
+        return boost::intrusive_ptr<Derived>(static_cast<Derived*>(existing),
+                                             /* add_ref */ false);
+      }
+      // The equal node is being destroyed by another thread. It's replaced
+      // here, and erase() will leave the new node alone.
+      shard.nodes.erase(it);
+    }
+    shard.nodes.insert(entry);
+    return boost::intrusive_ptr<Derived>(node);
+  }
+
+  static void erase(const Node* node) {
+    Entry entry{node->structural_hash(), const_cast<Node*>(node)};
+    auto& shard = shard_of(entry.hash);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto it = shard.nodes.find(entry);
+    if (it != shard.nodes.end() && it->node == node) {
+      shard.nodes.erase(it);
+    }
+  }
+
+  // The number of live nodes.
+  static size_t size() {
+    size_t size = 0;
+    for (size_t i = 0; i < kNumShards; ++i) {
+      std::lock_guard<std::mutex> lock(shards()[i].lock);
+      size += shards()[i].nodes.size();
+    }
+    return size;
+  }
+
+ private:
+  // Selected by the 6 high bits of the mixed hash code.
+  static constexpr size_t kNumShards = 64;
+
+  struct Entry {
+    size_t hash;
+    Node* node;
+  };
+
+  struct EntryHash {
+    size_t operator()(const Entry& entry) const { return entry.hash; }
+  };
+
+  struct EntryEqual {
+    bool operator()(const Entry& e1, const Entry& e2) const {
+      return e1.hash == e2.hash && e1.node->structurally_equals(*e2.node);
+    }
+  };
+
+  struct Shard {
+    std::mutex lock;
+    std::unordered_set<Entry, EntryHash, EntryEqual> nodes;
+  };
+
+  // Never destroyed, since nodes may be released during static destruction.
+  static Shard* shards() {
+    static Shard* all = new Shard[kNumShards];
+    return all;
+  }
+
+  static Shard& shard_of(size_t hash) {
+    // Integer keys are their own hash code, so the bits are mixed first.
+    return shards()[(hash * 0x9e3779b97f4a7c15ull) >> 58];
+  }
+};
+
+} // namespace pt_util
+
+} // namespace sparta
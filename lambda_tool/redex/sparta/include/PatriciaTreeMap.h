@@ -18,9 +18,11 @@
 #include <type_traits>
 #include <utility>
 
+#include <boost/functional/hash.hpp>
 #include <boost/intrusive_ptr.hpp>
 
 #include "AbstractDomain.h"
+#include "PatriciaTreeHashConsing.h"
 #include "PatriciaTreeUtil.h"
 
 // Forward declarations
@@ -444,6 +446,10 @@ using namespace pt_util;
 template <typename IntegerType, typename Value>
 class PatriciaTree {
  public:
+  // See PatriciaTreeHashConsing.h.
+  static constexpr bool hash_consed =
+      PatriciaTreeHashConsing<typename Value::type>::value;
+
   // A Patricia tree is an immutable structure.
   PatriciaTree& operator=(const PatriciaTree& other) = delete;
 
@@ -459,6 +465,23 @@ class PatriciaTree {
 
   bool is_branch() const { return !is_leaf(); }
 
+  // The hash-consing interface, see pt_util::HashConsingTable.
+  virtual size_t structural_hash() const = 0;
+
+  virtual bool structurally_equals(
+      const PatriciaTree<IntegerType, Value>& other) const = 0;
+
+  bool try_add_ref() const {
+    size_t count = m_reference_count.load(std::memory_order_relaxed);
+    while (count != 0) {
+      if (m_reference_count.compare_exchange_weak(
+              count, count + 1, std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   friend void intrusive_ptr_add_ref(const PatriciaTree<IntegerType, Value>* p) {
     p->m_reference_count.fetch_add(1, std::memory_order_relaxed);
   }
@@ -466,6 +489,9 @@ class PatriciaTree {
   friend void intrusive_ptr_release(const PatriciaTree<IntegerType, Value>* p) {
     if (p->m_reference_count.fetch_sub(1, std::memory_order_release) == 1) {
       std::atomic_thread_fence(std::memory_order_acquire);
+      if constexpr (hash_consed) {
+        HashConsingTable<PatriciaTree<IntegerType, Value>>::erase(p);
+      }
       delete p;
     }
   }
@@ -475,7 +501,10 @@ class PatriciaTree {
 };
 
 template <typename IntegerType, typename Value>
-class PatriciaTreeBranch final : public PatriciaTree<IntegerType, Value> {
+class PatriciaTreeBranch final
+    : public PatriciaTree<IntegerType, Value>,
+      public SlabAllocated<PatriciaTreeBranch<IntegerType, Value>,
+                           PatriciaTree<IntegerType, Value>::hash_consed> {
  public:
   PatriciaTreeBranch(
       IntegerType prefix,
@@ -489,6 +518,28 @@ class PatriciaTreeBranch final : public PatriciaTree<IntegerType, Value> {
 
   bool is_leaf() const override { return false; }
 
+  size_t structural_hash() const override {
+    size_t seed = 0;
+    boost::hash_combine(seed, m_prefix);
+    boost::hash_combine(seed, m_stacking_bit);
+    boost::hash_combine(seed, m_left_tree.get());
+    boost::hash_combine(seed, m_right_tree.get());
+    return seed;
+  }
+
+  bool structurally_equals(
+      const PatriciaTree<IntegerType, Value>& other) const override {
+    if (other.is_leaf()) {
+      return false;
+    }
+    const auto& branch =
+        static_cast<const PatriciaTreeBranch<IntegerType, Value>&>(other);
+    return m_prefix == branch.m_prefix &&
+           m_stacking_bit == branch.m_stacking_bit &&
+           m_left_tree == branch.m_left_tree &&
+           m_right_tree == branch.m_right_tree;
+  }
+
   IntegerType prefix() const { return m_prefix; }
 
   IntegerType branching_bit() const { return m_stacking_bit; }
@@ -508,8 +559,12 @@ class PatriciaTreeBranch final : public PatriciaTree<IntegerType, Value> {
       IntegerType branching_bit,
       boost::intrusive_ptr<PatriciaTree<IntegerType, Value>> left_tree,
       boost::intrusive_ptr<PatriciaTree<IntegerType, Value>> right_tree) {
-    return new PatriciaTreeBranch<IntegerType, Value>(
+    auto* branch = new PatriciaTreeBranch<IntegerType, Value>(
         prefix, branching_bit, std::move(left_tree), std::move(right_tree));
+    if constexpr (PatriciaTree<IntegerType, Value>::hash_consed) {
+      return HashConsingTable<PatriciaTree<IntegerType, Value>>::intern(branch);
+    }
+    return branch;
   }
 
  private:
@@ -520,7 +575,10 @@ class PatriciaTreeBranch final : public PatriciaTree<IntegerType, Value> {
 };
 
 template <typename IntegerType, typename Value>
-class PatriciaTreeLeaf final : public PatriciaTree<IntegerType, Value> {
+class PatriciaTreeLeaf final
+    : public PatriciaTree<IntegerType, Value>,
+      public SlabAllocated<PatriciaTreeLeaf<IntegerType, Value>,
+                           PatriciaTree<IntegerType, Value>::hash_consed> {
  public:
   using mapped_type = typename Value::type;
 
@@ -529,13 +587,37 @@ class PatriciaTreeLeaf final : public PatriciaTree<IntegerType, Value> {
 
   bool is_leaf() const override { return true; }
 
+  size_t structural_hash() const override {
+    size_t seed = 0;
+    boost::hash_combine(seed, m_pair.first);
+    if constexpr (PatriciaTree<IntegerType, Value>::hash_consed) {
+      boost::hash_combine(
+          seed, PatriciaTreeHashConsing<mapped_type>::hash(m_pair.second));
+    }
+    return seed;
+  }
+
+  bool structurally_equals(
+      const PatriciaTree<IntegerType, Value>& other) const override {
+    if (other.is_branch()) {
+      return false;
+    }
+    const auto& leaf =
+        static_cast<const PatriciaTreeLeaf<IntegerType, Value>&>(other);
+    return key() == leaf.key() && Value::equals(value(), leaf.value());
+  }
+
   const IntegerType& key() const { return m_pair.first; }
 
   const mapped_type& value() const { return m_pair.second; }
 
   static boost::intrusive_ptr<PatriciaTreeLeaf<IntegerType, Value>> make(
       IntegerType key, const mapped_type& value) {
-    return new PatriciaTreeLeaf<IntegerType, Value>(key, value);
+    auto* leaf = new PatriciaTreeLeaf<IntegerType, Value>(key, value);
+    if constexpr (PatriciaTree<IntegerType, Value>::hash_consed) {
+      return HashConsingTable<PatriciaTree<IntegerType, Value>>::intern(leaf);
+    }
+    return leaf;
   }
 
  private:
@@ -717,6 +799,10 @@ inline bool equals(
     // comparing Patricia trees that share some structure.
     return true;
   }
+  if (PatriciaTree<IntegerType, Value>::hash_consed) {
+    // Equal hash-consed trees are the same node.
+    return false;
+  }
   if (tree1 == nullptr) {
     return tree2 == nullptr;
   }
@@ -23,6 +23,7 @@
 #include <boost/intrusive_ptr.hpp>
 
 #include "Exceptions.h"
+#include "PatriciaTreeHashConsing.h"
 #include "PatriciaTreeUtil.h"
 
 namespace sparta {
@@ -320,6 +321,10 @@ using namespace pt_util;
 template <typename IntegerType>
 class PatriciaTree {
  public:
+  // See PatriciaTreeHashConsing.h.
+  static constexpr bool hash_consed =
+      PatriciaTreeHashConsing<IntegerType>::value;
+
   // A Patricia tree is an immutable structure.
   PatriciaTree& operator=(const PatriciaTree& other) = delete;
 
@@ -339,6 +344,23 @@ class PatriciaTree {
 
   void set_hash(size_t h) { m_hash = h; }
 
+  // The hash-consing interface, see pt_util::HashConsingTable.
+  size_t structural_hash() const { return m_hash; }
+
+  virtual bool structurally_equals(
+      const PatriciaTree<IntegerType>& other) const = 0;
+
+  bool try_add_ref() const {
+    size_t count = m_reference_count.load(std::memory_order_relaxed);
+    while (count != 0) {
+      if (m_reference_count.compare_exchange_weak(
+              count, count + 1, std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   friend void intrusive_ptr_add_ref(const PatriciaTree<IntegerType>* p) {
     p->m_reference_count.fetch_add(1, std::memory_order_relaxed);
   }
@@ -346,6 +368,9 @@ class PatriciaTree {
   friend void intrusive_ptr_release(const PatriciaTree<IntegerType>* p) {
     if (p->m_reference_count.fetch_sub(1, std::memory_order_release) == 1) {
       std::atomic_thread_fence(std::memory_order_acquire);
+      if constexpr (hash_consed) {
+        HashConsingTable<PatriciaTree<IntegerType>>::erase(p);
+      }
       delete p;
     }
   }
@@ -364,7 +389,10 @@ class PatriciaTree {
 // originating from a given node share the same bit prefix (in the little endian
 // ordering), which is stored in m_prefix.
 template <typename IntegerType>
-class PatriciaTreeBranch final : public PatriciaTree<IntegerType> {
+class PatriciaTreeBranch final
+    : public PatriciaTree<IntegerType>,
+      public SlabAllocated<PatriciaTreeBranch<IntegerType>,
+                           PatriciaTree<IntegerType>::hash_consed> {
  public:
   PatriciaTreeBranch(IntegerType prefix,
                      IntegerType branching_bit,
@@ -384,6 +412,19 @@ class PatriciaTreeBranch final : public PatriciaTree<IntegerType> {
 
   bool is_leaf() const override { return false; }
 
+  bool structurally_equals(
+      const PatriciaTree<IntegerType>& other) const override {
+    if (other.is_leaf()) {
+      return false;
+    }
+    const auto& branch =
+        static_cast<const PatriciaTreeBranch<IntegerType>&>(other);
+    return m_prefix == branch.m_prefix &&
+           m_branching_bit == branch.m_branching_bit &&
+           m_left_tree == branch.m_left_tree &&
+           m_right_tree == branch.m_right_tree;
+  }
+
   IntegerType prefix() const { return m_prefix; }
 
   IntegerType branching_bit() const { return m_branching_bit; }
@@ -401,8 +442,12 @@ class PatriciaTreeBranch final : public PatriciaTree<IntegerType> {
       IntegerType branching_bit,
       boost::intrusive_ptr<PatriciaTree<IntegerType>> left_tree,
       boost::intrusive_ptr<PatriciaTree<IntegerType>> right_tree) {
-    return new PatriciaTreeBranch<IntegerType>(
+    auto* branch = new PatriciaTreeBranch<IntegerType>(
         prefix, branching_bit, std::move(left_tree), std::move(right_tree));
+    if constexpr (PatriciaTree<IntegerType>::hash_consed) {
+      return HashConsingTable<PatriciaTree<IntegerType>>::intern(branch);
+    }
+    return branch;
   }
 
  private:
@@ -413,7 +458,10 @@ class PatriciaTreeBranch final : public PatriciaTree<IntegerType> {
 };
 
 template <typename IntegerType>
-class PatriciaTreeLeaf final : public PatriciaTree<IntegerType> {
+class PatriciaTreeLeaf final
+    : public PatriciaTree<IntegerType>,
+      public SlabAllocated<PatriciaTreeLeaf<IntegerType>,
+                           PatriciaTree<IntegerType>::hash_consed> {
  public:
   explicit PatriciaTreeLeaf(IntegerType key) : m_key(key) {
     boost::hash<IntegerType> hasher;
@@ -422,11 +470,22 @@ class PatriciaTreeLeaf final : public PatriciaTree<IntegerType> {
 
   bool is_leaf() const override { return true; }
 
+  bool structurally_equals(
+      const PatriciaTree<IntegerType>& other) const override {
+    return other.is_leaf() &&
+           m_key == static_cast<const PatriciaTreeLeaf<IntegerType>&>(other)
+                        .m_key;
+  }
+
   const IntegerType& key() const { return m_key; }
 
   static boost::intrusive_ptr<PatriciaTreeLeaf<IntegerType>> make(
       IntegerType key) {
-    return new PatriciaTreeLeaf<IntegerType>(key);
+    auto* leaf = new PatriciaTreeLeaf<IntegerType>(key);
+    if constexpr (PatriciaTree<IntegerType>::hash_consed) {
+      return HashConsingTable<PatriciaTree<IntegerType>>::intern(leaf);
+    }
+    return leaf;
   }
 
  private:
@@ -545,6 +604,10 @@ inline bool equals(
     // when comparing Patricia trees that share some structure.
     return true;
   }
+  if (PatriciaTree<IntegerType>::hash_consed) {
+    // Equal hash-consed trees are the same node.
+    return false;
+  }
   if (tree1 == nullptr) {
     return tree2 == nullptr;
   }
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace sparta {
+
+/*
+ * Allocates blocks of `size` bytes from slabs. Every thread allocates from and
+ * frees to its own free list, without synchronization. A thread keeps at most
+ * two slabs worth of free blocks: beyond that, it hands a batch of them over
+ * to the global free list, from which the threads that allocate more than they
+ * free take them back. The global lock is thus taken once per batch. Slabs are
+ * never returned to the system, so the memory of the blocks of a given size
+ * stays at their peak.
+ *
+ * The slabs are opt-in: unless SPARTA_SLAB_ALLOCATOR is defined, e.g. by
+ * `configure --enable-slab-allocator`, every block comes from the heap.
+ */
+template <size_t size, size_t alignment>
+class SlabAllocator final {
+ public:
+  static void* allocate() {
+#ifndef SPARTA_SLAB_ALLOCATOR
+    return new Block;
+#else
+    if (exited()) {
+      // The free list of this thread has already been destroyed.
+      return allocate_from_global();
+    }
+    auto& free_list = local_free_list();
+    if (free_list.head == nullptr) {
+      std::tie(free_list.head, free_list.length) = take_global_batch();
+      if (free_list.head == nullptr) {
+        free_list.head = new_slab();
+        free_list.length = kBlocksPerSlab;
+      }
+    }
+    Block* block = free_list.head;
+    free_list.head = block->next;
+    --free_list.length;
+    return block;
+#endif
+  }
+
+  static void deallocate(void* p) {
+    Block* block = static_cast<Block*>(p);
+#ifndef SPARTA_SLAB_ALLOCATOR
+    delete block;
+#else
+    if (exited()) {
+      std::lock_guard<std::mutex> lock(global().lock);
+      block->next = nullptr;
+      global().batches.emplace_back(block, 1);
+      return;
+    }
+    auto& free_list = local_free_list();
+    block->next = free_list.head;
+    free_list.head = block;
+    if (++free_list.length == 2 * kBlocksPerSlab) {
+      // Blocks freed by a thread that does not allocate them, e.g. the
+      // consumer of a queue, would otherwise pile up here.
+      Block* last = free_list.head;
+      for (size_t i = 1; i < kBlocksPerSlab; ++i) {
+        last = last->next;
+      }
+      Block* batch = free_list.head;
+      free_list.head = last->next;
+      free_list.length -= kBlocksPerSlab;
+      last->next = nullptr;
+      std::lock_guard<std::mutex> lock(global().lock);
+      global().batches.emplace_back(batch, kBlocksPerSlab);
+    }
+#endif
+  }
+
+ private:
+  static constexpr size_t kBlocksPerSlab = 512;
+
+  union Block {
+    Block* next;
+    alignas(alignment) unsigned char storage[size];
+  };
+
+  struct FreeList {
+    Block* head = nullptr;
+    size_t length = 0;
+
+    // Hands the free blocks over to the other threads.
+    ~FreeList() {
+      exited() = true;
+      if (head == nullptr) {
+        return;
+      }
+      std::lock_guard<std::mutex> lock(global().lock);
+      global().batches.emplace_back(head, length);
+    }
+  };
+
+  // The lists of free blocks handed over by the threads, and their lengths.
+  struct Global {
+    std::mutex lock;
+    std::vector<std::pair<Block*, size_t>> batches;
+  };
+
+  // Never destroyed, since nodes may be freed during static destruction.
+  static Global& global() {
+    static Global* state = new Global();
+    return *state;
+  }
+
+  static FreeList& local_free_list() {
+    thread_local FreeList free_list;
+    return free_list;
+  }
+
+  // Trivially destructible, hence still usable once the free list of the
+  // thread has been destroyed.
+  static bool& exited() {
+    thread_local bool has_exited = false;
+    return has_exited;
+  }
+
+  static std::pair<Block*, size_t> take_global_batch() {
+    std::lock_guard<std::mutex> lock(global().lock);
+    auto& batches = global().batches;
+    if (batches.empty()) {
+      return {nullptr, 0};
+    }
+    auto batch = batches.back();
+    batches.pop_back();
+    return batch;
+  }
+
+  static Block* new_slab() {
+    Block* slab = new Block[kBlocksPerSlab];
+    for (size_t i = 0; i + 1 < kBlocksPerSlab; ++i) {
+      slab[i].next = &slab[i + 1];
+    }
+    slab[kBlocksPerSlab - 1].next = nullptr;
+    return slab;
+  }
+
+  static void* allocate_from_global() {
+    {
+      std::lock_guard<std::mutex> lock(global().lock);
+      auto& batches = global().batches;
+      if (!batches.empty()) {
+        auto& batch = batches.back();
+        Block* block = batch.first;
+        batch.first = block->next;
+        if (--batch.second == 0) {
+          batches.pop_back();
+        }
+        return block;
+      }
+    }
+    return new Block;
+  }
+};
+
+} // namespace sparta
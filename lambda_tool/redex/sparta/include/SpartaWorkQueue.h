@@ -15,10 +15,12 @@
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <memory>
 #include <numeric>
-#include <queue>
 #include <random>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "Arity.h"
 
@@ -57,56 +59,231 @@ inline std::vector<unsigned int> create_permutation(unsigned int num,
   return attempts;
 }
 
-class Semaphore {
+/*
+ * A Chase-Lev work-stealing deque, as described in:
+ *
+ *   N. M. Lê, A. Pop, A. Cohen, F. Zappa Nardelli. Correct and Efficient
+ *   Work-Stealing for Weak Memory Models. In PPoPP 2013.
+ *
+ * The owner thread pushes and pops tasks at the bottom (LIFO) without locks,
+ * while other threads steal tasks from the top (FIFO) with a single CAS.
+ * Scalar tasks are stored in the deque, other tasks are boxed so that a thief
+ * never reads a task it hasn't won.
+ */
+template <typename Input>
+class WorkStealingDeque final {
  public:
-  explicit Semaphore(size_t initial = 0u) : m_count(initial) {}
+  WorkStealingDeque() { m_array.store(grow(nullptr, 0, 0)); }
 
-  inline void give(size_t n = 1u) {
-    std::unique_lock<std::mutex> lock(m_mtx);
-    m_count += n;
-    if (n == 1) {
-      m_cv.notify_one();
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+
+  ~WorkStealingDeque() {
+    if constexpr (!kInline) {
+      Array* array = m_array.load(std::memory_order_relaxed);
+      int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+      for (int64_t i = m_top.load(std::memory_order_relaxed); i < bottom; ++i) {
+        delete array->get(i);
+      }
+    }
+  }
+
+  // Owner only.
+  void push(Input task) {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+    Array* array = m_array.load(std::memory_order_relaxed);
+    if (bottom - top >= static_cast<int64_t>(array->capacity)) {
+      array = grow(array, top, bottom);
+    }
+    array->put(bottom, box(std::move(task)));
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only. Takes the most recently pushed task.
+  boost::optional<Input> pop() {
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    Array* array = m_array.load(std::memory_order_relaxed);
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      // Empty.
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+      return boost::none;
+    }
+    Slot slot = array->get(bottom);
+    if (top == bottom) {
+      // Last task, which thieves may be stealing as well.
+      bool won = m_top.compare_exchange_strong(top, top + 1,
+                                               std::memory_order_seq_cst,
+                                               std::memory_order_relaxed);
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+      if (!won) {
+        return boost::none;
+      }
+    }
+    return unbox(slot);
+  }
+
+  // Any thread. Takes the least recently pushed task. Returns none only if
+  // the deque is empty.
+  boost::optional<Input> steal() {
+    while (true) {
+      int64_t top = m_top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t bottom = m_bottom.load(std::memory_order_acquire);
+      if (top >= bottom) {
+        return boost::none;
+      }
+      Slot slot = m_array.load(std::memory_order_acquire)->get(top);
+      if (m_top.compare_exchange_strong(top, top + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        return unbox(slot);
+      }
+      // Lost the race against the owner or another thief.
+    }
+  }
+
+  bool empty() const {
+    int64_t top = m_top.load(std::memory_order_acquire);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    return top >= bottom;
+  }
+
+ private:
+  static constexpr bool kInline =
+      std::is_scalar<Input>::value && sizeof(Input) <= sizeof(uint64_t);
+  using Slot = std::conditional_t<kInline, Input, Input*>;
+
+  struct Array {
+    explicit Array(size_t capacity)
+        : capacity(capacity), slots(new std::atomic<Slot>[capacity]) {}
+
+    Slot get(int64_t i) const {
+      return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+
+    void put(int64_t i, Slot slot) {
+      slots[i & (capacity - 1)].store(slot, std::memory_order_relaxed);
+    }
+
+    const size_t capacity;
+    std::unique_ptr<std::atomic<Slot>[]> slots;
+  };
+
+  static Slot box(Input task) {
+    if constexpr (kInline) {
+      return task;
     } else {
-      m_cv.notify_all(); // A bit suboptimal, but easier than precise counting.
+      return new Input(std::move(task));
     }
   }
 
-  inline void take() {
-    std::unique_lock<std::mutex> lock(m_mtx);
-    while (m_count == 0) {
-      m_cv.wait(lock);
+  static Input unbox(Slot slot) {
+    if constexpr (kInline) {
+      return slot;
+    } else {
+      std::unique_ptr<Input> task(slot);
+      return std::move(*task);
     }
-    --m_count;
   }
 
-  inline void take_all() {
+  // Replaces the array by one twice as large. Thieves may still be reading the
+  // old arrays, which are only freed with the deque.
+  Array* grow(Array* array, int64_t top, int64_t bottom) {
+    auto* larger = new Array(array == nullptr ? 64 : 2 * array->capacity);
+    for (int64_t i = top; i < bottom; ++i) {
+      larger->put(i, array->get(i));
+    }
+    m_arrays.emplace_back(larger);
+    m_array.store(larger, std::memory_order_release);
+    return larger;
+  }
+
+  std::atomic<int64_t> m_top{0};
+  std::atomic<int64_t> m_bottom{0};
+  std::atomic<Array*> m_array{nullptr};
+  std::vector<std::unique_ptr<Array>> m_arrays;
+};
+
+/*
+ * Parks idle workers. This is an event count: notifying costs a fence and a
+ * load unless some thread is parked, and a worker parks in three steps, so
+ * that a notification sent after it last found no work is never lost:
+ *
+ *   auto key = parker.prepare_park();
+ *   if (<work is available>) {
+ *     parker.cancel_park();
+ *   } else {
+ *     parker.park(key);
+ *   }
+ */
+class Parker {
+ public:
+  uint64_t prepare_park() {
+    m_num_parked.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return m_epoch.load(std::memory_order_seq_cst);
+  }
+
+  void cancel_park() { m_num_parked.fetch_sub(1, std::memory_order_seq_cst); }
+
+  void park(uint64_t key) {
     std::unique_lock<std::mutex> lock(m_mtx);
-    m_count = 0;
+    m_cv.wait(lock, [&] {
+      return m_epoch.load(std::memory_order_relaxed) != key;
+    });
+    m_num_parked.fetch_sub(1, std::memory_order_seq_cst);
+  }
+
+  void unpark_one() {
+    if (notify()) {
+      m_cv.notify_one();
+    }
+  }
+
+  void unpark_all() {
+    if (notify()) {
+      m_cv.notify_all();
+    }
   }
 
  private:
+  // Returns whether a thread may be parked.
+  bool notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_num_parked.load(std::memory_order_seq_cst) == 0) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_epoch.fetch_add(1, std::memory_order_seq_cst);
+    return true;
+  }
+
+  std::atomic<uint64_t> m_epoch{0};
+  std::atomic<size_t> m_num_parked{0};
   std::mutex m_mtx;
   std::condition_variable m_cv;
-  size_t m_count;
 };
 
 struct StateCounters {
-  std::atomic_uint num_non_empty;
+  // The workers that are not idle.
   std::atomic_uint num_running;
+  // Set once all the workers are idle and there are no tasks left.
+  std::atomic_bool done;
   const unsigned int num_all;
   // Mutexes aren't move-able.
-  std::unique_ptr<Semaphore> waiter;
+  std::unique_ptr<Parker> parker;
 
   explicit StateCounters(unsigned int num)
-      : num_non_empty(0),
-        num_running(0),
-        num_all(num),
-        waiter(new Semaphore(0)) {}
+      : num_running(0), done(false), num_all(num), parker(new Parker()) {}
   StateCounters(StateCounters&& other)
-      : num_non_empty(other.num_non_empty.load()),
-        num_running(other.num_running.load()),
+      : num_running(other.num_running.load()),
+        done(other.done.load()),
         num_all(other.num_all),
-        waiter(std::move(other.waiter)) {}
+        parker(std::move(other.parker)) {}
 };
 
 } // namespace workqueue_impl
@@ -127,48 +304,16 @@ class SpartaWorkerState final {
    */
   void push_task(Input task) {
     assert(m_can_push_task);
-    std::lock_guard<std::mutex> guard(m_queue_mtx);
-    if (m_queue.empty()) {
-      ++m_state_counters->num_non_empty;
-    }
-    if (m_state_counters->num_running < m_state_counters->num_all) {
-      m_state_counters->waiter->give(1u); // May consider waking all.
-    }
-    m_queue.push(task);
+    m_queue.push(std::move(task));
+    m_state_counters->parker->unpark_one();
   }
 
   size_t worker_id() const { return m_id; }
 
-  void set_running(bool running) {
-    if (m_running && !running) {
-      assert(m_state_counters->num_running > 0);
-      --m_state_counters->num_running;
-    } else if (!m_running && running) {
-      ++m_state_counters->num_running;
-    }
-    m_running = running;
-  };
-
  private:
-  boost::optional<Input> pop_task(SpartaWorkerState<Input>* other) {
-    std::lock_guard<std::mutex> guard(m_queue_mtx);
-    if (!m_queue.empty()) {
-      other->set_running(true);
-      if (m_queue.size() == 1) {
-        assert(m_state_counters->num_non_empty > 0);
-        --m_state_counters->num_non_empty;
-      }
-      auto task = std::move(m_queue.front());
-      m_queue.pop();
-      return task;
-    }
-    return boost::none;
-  }
-
   size_t m_id;
-  bool m_running{false};
-  std::queue<Input> m_queue;
-  std::mutex m_queue_mtx;
+  // Only the worker pushes and pops, other workers steal.
+  workqueue_impl::WorkStealingDeque<Input> m_queue;
   workqueue_impl::StateCounters* m_state_counters;
   const bool m_can_push_task{false};
 
@@ -252,58 +397,62 @@ void SpartaWorkQueue<Input, Executor>::add_item(Input task, size_t worker_id) {
 }
 
 /*
- * Each worker thread pulls from its own queue first, and then once finished
- * looks randomly at other queues to try and steal work.
+ * Each worker thread pops from its own deque first, most recent task first, and
+ * then once it is empty, steals the oldest tasks of the other deques in a
+ * random order.
  */
 template <class Input, typename Executor>
 void SpartaWorkQueue<Input, Executor>::run_all() {
-  m_state_counters.num_non_empty = 0;
-  m_state_counters.num_running = 0;
-  m_state_counters.waiter->take_all();
+  m_state_counters.num_running = m_num_threads;
+  m_state_counters.done = false;
+  auto all_empty = [&]() {
+    return std::all_of(m_states.begin(), m_states.end(), [](const auto& state) {
+      return state->m_queue.empty();
+    });
+  };
   auto worker = [&](SpartaWorkerState<Input>* state, size_t state_idx) {
     auto attempts =
         workqueue_impl::create_permutation(m_num_threads, state_idx);
+    auto& parker = *m_state_counters.parker;
     while (true) {
-      auto have_task = false;
-      for (auto idx : attempts) {
-        auto other_state = m_states[idx].get();
-        auto task = other_state->pop_task(state);
-        if (task) {
-          have_task = true;
-          consume(state, *task);
-          break;
-        }
+      auto task = state->m_queue.pop();
+      for (size_t i = 1; !task && i < attempts.size(); ++i) {
+        task = m_states[attempts[i]]->m_queue.steal();
       }
-      if (have_task) {
+      if (task) {
+        consume(state, std::move(*task));
         continue;
       }
 
-      state->set_running(false);
       if (!m_can_push_task) {
         // New tasks can't be added. We don't need to wait for the currently
         // running jobs to finish.
         return;
       }
 
-      // Let the thread quit if all the threads are not running and there
-      // is no task in any queue.
-      if (m_state_counters.num_running == 0 &&
-          m_state_counters.num_non_empty == 0) {
-        // Wake up everyone who might be waiting, so they can quit.
-        m_state_counters.waiter->give(m_state_counters.num_all);
+      // Only running workers push tasks, so once they are all idle with empty
+      // deques, we are done. Wake up everyone who might be parked, so they can
+      // quit.
+      if (--m_state_counters.num_running == 0 && all_empty()) {
+        m_state_counters.done = true;
+        parker.unpark_all();
         return;
       }
-
-      m_state_counters.waiter->take(); // Wait for work.
+      while (true) {
+        auto key = parker.prepare_park();
+        if (m_state_counters.done || !all_empty()) {
+          parker.cancel_park();
+          break;
+        }
+        parker.park(key); // Wait for work.
+      }
+      if (m_state_counters.done) {
+        return;
+      }
+      ++m_state_counters.num_running;
     }
   };
 
-  for (size_t i = 0; i < m_num_threads; ++i) {
-    if (!m_states[i]->m_queue.empty()) {
-      ++m_state_counters.num_non_empty;
-    }
-  }
-
   std::vector<boost::thread> all_threads;
   all_threads.reserve(m_num_threads);
   for (size_t i = 0; i < m_num_threads; ++i) {
@@ -317,9 +466,7 @@ void SpartaWorkQueue<Input, Executor>::run_all() {
     thread.join();
   }
 
-  for (size_t i = 0; i < m_num_threads; ++i) {
-    assert(m_states[i]->m_queue.empty());
-  }
+  assert(all_empty());
 }
 
 namespace workqueue_impl {
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ArenaAllocator.h"
+
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace sparta;
+
+TEST(ArenaAllocatorTest, alignedAllocations) {
+  Arena arena;
+  EXPECT_EQ(0, arena.capacity());
+  std::vector<char*> blocks;
+  for (size_t i = 1; i <= 100; ++i) {
+    size_t alignment = size_t(1) << (i % 5);
+    auto* block = static_cast<char*>(arena.allocate(i, alignment));
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(block) % alignment);
+    // Blocks don't overlap.
+    std::fill(block, block + i, static_cast<char>(i));
+    blocks.push_back(block);
+  }
+  for (size_t i = 1; i <= 100; ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      EXPECT_EQ(static_cast<char>(i), blocks[i - 1][j]);
+    }
+  }
+  EXPECT_GT(arena.capacity(), 0);
+}
+
+TEST(ArenaAllocatorTest, largeAllocation) {
+  Arena arena(/* chunk_size */ 64);
+  auto* small = static_cast<char*>(arena.allocate(16, 8));
+  auto* large = static_cast<char*>(arena.allocate(10000, 16));
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(large) % 16);
+  std::fill(large, large + 10000, 'x');
+  std::fill(small, small + 16, 'y');
+  EXPECT_EQ('x', large[9999]);
+  EXPECT_GE(arena.capacity(), 10000);
+}
+
+TEST(ArenaAllocatorTest, containers) {
+  Arena arena;
+  {
+    using Allocator = ArenaAllocator<std::pair<const int, std::string>>;
+    std::unordered_map<int, std::string, std::hash<int>, std::equal_to<int>,
+                       Allocator>
+        map(/* bucket_count */ 4, std::hash<int>(), std::equal_to<int>(),
+            Allocator(&arena));
+    for (int i = 0; i < 1000; ++i) {
+      map.emplace(i, std::to_string(i));
+    }
+    map.erase(500);
+    EXPECT_EQ(999, map.size());
+    EXPECT_EQ("999", map.at(999));
+    EXPECT_EQ(0, map.count(500));
+    EXPECT_EQ(&arena, map.get_allocator().arena());
+
+    auto copy = map;
+    EXPECT_EQ(&arena, copy.get_allocator().arena());
+    EXPECT_EQ(map, copy);
+  }
+  EXPECT_GT(arena.capacity(), 0);
+
+  // Without an arena, the allocator falls back to the heap.
+  std::vector<int, ArenaAllocator<int>> vector;
+  for (int i = 0; i < 100; ++i) {
+    vector.push_back(i);
+  }
+  EXPECT_EQ(nullptr, vector.get_allocator().arena());
+  EXPECT_EQ(99, vector.back());
+  EXPECT_TRUE(ArenaAllocator<int>(&arena) == ArenaAllocator<char>(&arena));
+  EXPECT_TRUE(ArenaAllocator<int>(&arena) != ArenaAllocator<int>());
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "BitSetAbstractDomain.h"
+
+#include <cstdint>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "AbstractDomainPropertyTest.h"
+
+using namespace sparta;
+
+// Elements from 8 upwards exercise the sparse representation.
+using Domain = BitSetAbstractDomain<uint32_t, 8>;
+
+INSTANTIATE_TYPED_TEST_CASE_P(BitSetAbstractDomain,
+                              AbstractDomainPropertyTest,
+                              Domain);
+
+template <>
+std::vector<Domain>
+AbstractDomainPropertyTest<Domain>::non_extremal_values() {
+  return {Domain(), Domain{1, 2}, Domain{2, 100}, Domain{1, 2, 100, 1000}};
+}
+
+TEST(BitSetAbstractDomainTest, latticeOperations) {
+  Domain e1{1};
+  Domain e2{1, 2, 300};
+  Domain e3{2, 4, 300, 400};
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1));
+  EXPECT_THAT(e2.elements(), ::testing::ElementsAre(1, 2, 300));
+  EXPECT_THAT(e3.elements(), ::testing::ElementsAre(2, 4, 300, 400));
+  EXPECT_EQ(e3.size(), 4);
+
+  std::ostringstream out;
+  out << e2;
+  EXPECT_EQ("{1, 2, 300}", out.str());
+
+  EXPECT_TRUE(Domain::bottom().leq(Domain::top()));
+  EXPECT_FALSE(Domain::top().leq(Domain::bottom()));
+  EXPECT_FALSE(e2.is_top());
+  EXPECT_FALSE(e2.is_bottom());
+
+  EXPECT_TRUE(e1.leq(e2));
+  EXPECT_FALSE(e1.leq(e3));
+  EXPECT_FALSE(Domain{300}.leq(Domain{1}));
+  EXPECT_TRUE(e2.equals(Domain{300, 2, 1}));
+  EXPECT_FALSE(e2.equals(e3));
+
+  EXPECT_THAT(e2.join(e3).elements(),
+              ::testing::ElementsAre(1, 2, 4, 300, 400));
+  EXPECT_TRUE(e1.join(e2).equals(e2));
+  EXPECT_TRUE(e2.join(Domain::bottom()).equals(e2));
+  EXPECT_TRUE(e2.join(Domain::top()).is_top());
+  EXPECT_TRUE(e1.widening(e2).equals(e2));
+
+  EXPECT_THAT(e2.meet(e3).elements(), ::testing::ElementsAre(2, 300));
+  EXPECT_TRUE(e1.meet(e2).equals(e1));
+  EXPECT_TRUE(e2.meet(Domain::bottom()).is_bottom());
+  EXPECT_TRUE(e2.meet(Domain::top()).equals(e2));
+  EXPECT_FALSE(e1.meet(e3).is_bottom());
+  EXPECT_TRUE(e1.meet(e3).elements().empty());
+  EXPECT_TRUE(e1.narrowing(e2).equals(e1));
+
+  EXPECT_TRUE(e2.contains(300));
+  EXPECT_FALSE(e2.contains(400));
+  EXPECT_FALSE(e3.contains(1));
+
+  // Making sure no side effect happened.
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1));
+  EXPECT_THAT(e2.elements(), ::testing::ElementsAre(1, 2, 300));
+  EXPECT_THAT(e3.elements(), ::testing::ElementsAre(2, 4, 300, 400));
+}
+
+TEST(BitSetAbstractDomainTest, destructiveOperations) {
+  Domain e1;
+  e1.add(1);
+  e1.add(7);
+  e1.add(8);
+  e1.add(1000);
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1, 7, 8, 1000));
+  e1.remove(7);
+  e1.remove(1000);
+  e1.remove(5);
+  e1.remove(2000);
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1, 8));
+
+  e1.join_with(Domain{2, 9});
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1, 2, 8, 9));
+  e1.meet_with(Domain{2, 3, 9, 10});
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(2, 9));
+  e1.difference_with(Domain{9});
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(2));
+  e1.difference_with(Domain::top());
+  EXPECT_TRUE(e1.is_bottom());
+
+  // Adding to bottom or top has no effect.
+  e1.add(1);
+  EXPECT_TRUE(e1.is_bottom());
+  e1.set_to_top();
+  e1.remove(1);
+  EXPECT_TRUE(e1.is_top());
+  EXPECT_TRUE(e1.contains(12345));
+}
@@ -163,3 +163,82 @@ TEST(FiniteAbstractDomainTest, malformedLattice) {
                                        {{bottom, a}, {bottom, b}});
   });
 }
+
+using ConstexprLatticeType = ConstexprLattice<Elements, 7>;
+
+constexpr ConstexprLatticeType constexpr_lattice(
+    {BOTTOM, A, B, C, D, E, TOP},
+    {{BOTTOM, A}, {A, B}, {A, C}, {B, D}, {C, D}, {C, E}, {D, TOP}, {E, TOP}});
+
+using ConstexprDomain = ConstexprFiniteAbstractDomain<Elements,
+                                                      ConstexprLatticeType,
+                                                      &constexpr_lattice>;
+
+// The tables are computed at compile time.
+static_assert(constexpr_lattice.decode(constexpr_lattice.join(
+                  constexpr_lattice.encode(B), constexpr_lattice.encode(C))) ==
+                  D,
+              "B join C is D");
+static_assert(constexpr_lattice.decode(constexpr_lattice.bottom()) == BOTTOM,
+              "BOTTOM is the bottom element");
+
+TEST(FiniteAbstractDomainTest, constexprLatticeMatchesBitVectorLattice) {
+  const Elements elements[] = {BOTTOM, A, B, C, D, E, TOP};
+  for (auto x : elements) {
+    for (auto y : elements) {
+      EXPECT_EQ(Domain(x).join(Domain(y)).element(),
+                ConstexprDomain(x).join(ConstexprDomain(y)).element());
+      EXPECT_EQ(Domain(x).meet(Domain(y)).element(),
+                ConstexprDomain(x).meet(ConstexprDomain(y)).element());
+      EXPECT_EQ(Domain(x).leq(Domain(y)),
+                ConstexprDomain(x).leq(ConstexprDomain(y)));
+      EXPECT_EQ(Domain(x).equals(Domain(y)),
+                ConstexprDomain(x).equals(ConstexprDomain(y)));
+    }
+    EXPECT_EQ(Domain(x).is_bottom(), ConstexprDomain(x).is_bottom());
+    EXPECT_EQ(Domain(x).is_top(), ConstexprDomain(x).is_top());
+  }
+  EXPECT_EQ(BOTTOM, ConstexprDomain::bottom().element());
+  EXPECT_EQ(TOP, ConstexprDomain::top().element());
+  EXPECT_TRUE(ConstexprDomain().is_top());
+
+  ConstexprDomain x(B);
+  x.join_with(ConstexprDomain(C));
+  EXPECT_EQ(D, x.element());
+  x.narrow_with(ConstexprDomain(E));
+  EXPECT_EQ(C, x.element());
+  x.set_to_bottom();
+  EXPECT_TRUE(x.is_bottom());
+
+  std::ostringstream o1, o2;
+  o1 << A;
+  o2 << ConstexprDomain(A);
+  EXPECT_EQ(o1.str(), o2.str());
+}
+
+TEST(FiniteAbstractDomainTest, malformedConstexprLattice) {
+  enum MalformedLatticeElements { bottom, a, b, c, d, top };
+  using MalformedLattice = ConstexprLattice<MalformedLatticeElements, 6>;
+  using SmallMalformedLattice = ConstexprLattice<MalformedLatticeElements, 3>;
+  // The same malformed diagrams as above. Constructed at runtime, they throw;
+  // as constexpr variables, they would not compile.
+  EXPECT_ANY_THROW({
+    MalformedLattice malformed_lattice({bottom, a, b, c, d, top},
+                                       {{bottom, a},
+                                        {bottom, b},
+                                        {a, c},
+                                        {a, d},
+                                        {b, c},
+                                        {b, d},
+                                        {c, top},
+                                        {d, top}});
+  });
+  EXPECT_ANY_THROW({
+    SmallMalformedLattice malformed_lattice({a, b, top},
+                                            {{a, top}, {b, top}});
+  });
+  EXPECT_ANY_THROW({
+    SmallMalformedLattice malformed_lattice({bottom, a, b},
+                                            {{bottom, a}, {bottom, b}});
+  });
+}
@@ -12,11 +12,17 @@
 #include "MonotonicFixpointIterator.h"
 #include "PatriciaTreeMapAbstractEnvironment.h"
 
+#include <algorithm>
+#include <atomic>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace language {
 
@@ -469,6 +475,12 @@ class SimpleFunctionAnalyzer : public Base {
     this->get_summaries()->update(m_fun,
                                   [&](const Summary&) { return conclusion; });
   }
+
+  sparta::FunctionAnalysisStats analysis_stats() const {
+    sparta::FunctionAnalysisStats stats;
+    stats.num_nodes = m_cfg.statements().size();
+    return stats;
+  }
 };
 
 template <typename Base>
@@ -601,8 +613,331 @@ struct PurityAnalysisAdaptor : public language::AnalysisAdaptorBase {
 
 using Analysis = sparta::InterproceduralAnalyzer<PurityAnalysisAdaptor>;
 
+// Records the summaries read by each function for
+// sparta::IncrementalInterproceduralAnalyzer.
+class IncrementalAnalysisRegistry : public AnalysisRegistry {
+ private:
+  std::unordered_map<language::Function*, size_t> m_versions;
+  std::unordered_map<language::Function*,
+                     std::unordered_map<language::Function*, size_t>>
+      m_reads;
+  language::Function* m_reader = nullptr;
+
+  size_t version(language::Function* func) const {
+    auto it = m_versions.find(func);
+    return it == m_versions.end() ? 0 : it->second;
+  }
+
+ public:
+  void update(language::Function* func,
+              std::function<Summary(const Summary&)> update) {
+    auto old = AnalysisRegistry::get(func);
+    AnalysisRegistry::update(func, update);
+    if (!AnalysisRegistry::get(func).equals(old)) {
+      ++m_versions[func];
+    }
+  }
+
+  Summary get(language::Function* func) {
+    if (m_reader) {
+      m_reads[m_reader].emplace(func, version(func));
+    }
+    return AnalysisRegistry::get(func);
+  }
+
+  void begin_reads(language::Function* reader) {
+    m_reader = reader;
+    m_reads[reader].clear();
+  }
+
+  void end_reads(language::Function*) { m_reader = nullptr; }
+
+  bool has_changed_reads(language::Function* reader) const {
+    auto it = m_reads.find(reader);
+    if (it == m_reads.end()) {
+      return true;
+    }
+    for (const auto& read : it->second) {
+      if (version(read.first) != read.second) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+struct IncrementalPurityAnalysisAdaptor : public PurityAnalysisAdaptor {
+  using Registry = IncrementalAnalysisRegistry;
+};
+
+using IncrementalAnalysis = sparta::IncrementalInterproceduralAnalyzer<
+    sparta::InterproceduralAnalyzer<IncrementalPurityAnalysisAdaptor>>;
+
+// Counts the updates of each summary, and its changes for
+// sparta::SccInterproceduralAnalyzer.
+class SccAnalysisRegistry : public AnalysisRegistry {
+ private:
+  std::unordered_map<language::Function*, size_t> m_versions;
+  std::unordered_map<language::Function*, size_t> m_num_updates;
+
+ public:
+  void update(language::Function* func,
+              std::function<Summary(const Summary&)> update) {
+    auto old = AnalysisRegistry::get(func);
+    AnalysisRegistry::update(func, update);
+    ++m_num_updates[func];
+    if (!AnalysisRegistry::get(func).equals(old)) {
+      ++m_versions[func];
+    }
+  }
+
+  size_t version(language::Function* func) const {
+    auto it = m_versions.find(func);
+    return it == m_versions.end() ? 0 : it->second;
+  }
+
+  size_t num_updates(language::Function* func) const {
+    auto it = m_num_updates.find(func);
+    return it == m_num_updates.end() ? 0 : it->second;
+  }
+
+  void widen(language::Function* func) {
+    update(func, [](const Summary&) { return Summary::top(); });
+  }
+};
+
+// Iterates over the call graph from the callees to the callers. The functions
+// without callees call a ghost exit function, the entry of the iteration.
+struct BottomUpPurityAnalysisAdaptor : public PurityAnalysisAdaptor {
+  using Registry = SccAnalysisRegistry;
+  using CallGraphInterface =
+      sparta::BackwardsFixpointIterationAdaptor<language::CallGraphInterface>;
+
+  static language::Function* ghost_exit() {
+    static language::Function exit = [] {
+      language::Function f;
+      f.name = "exit";
+      f.cfg = std::make_shared<language::ControlFlowGraph>("1");
+      f.cfg->add("1", language::Statement(language::Opcode::CONST));
+      return f;
+    }();
+    return &exit;
+  }
+
+  template <typename FunctionSummaries>
+  static language::CallGraph call_graph_of(language::Program* program,
+                                           FunctionSummaries*) {
+    language::CallGraph graph(program->entry);
+    graph.set_exit(ghost_exit());
+    for (const auto& func : program->functions) {
+      bool has_callees = false;
+      for (const auto& entry : func->cfg->statements()) {
+        if (entry.second.op == language::Opcode::CALL) {
+          graph.add_edge(func, entry.second.callee);
+          has_callees = true;
+        }
+      }
+      if (!has_callees) {
+        graph.add_edge(func, ghost_exit());
+      }
+    }
+    return graph;
+  }
+};
+
+using BottomUpAnalysis =
+    sparta::InterproceduralAnalyzer<BottomUpPurityAnalysisAdaptor>;
+
+class RecordingTelemetry final
+    : public sparta::AnalysisTelemetry<language::Function*> {
+ public:
+  void record(const Record& record) override {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    records.push_back(record);
+  }
+
+  std::vector<Record> records_of(language::Function* function) const {
+    std::vector<Record> result;
+    for (const auto& record : records) {
+      if (record.function == function) {
+        result.push_back(record);
+      }
+    }
+    return result;
+  }
+
+  std::vector<Record> records;
+
+ private:
+  std::mutex m_mutex;
+};
+using SccAnalysis =
+    sparta::SccInterproceduralAnalyzer<BottomUpPurityAnalysisAdaptor>;
+
 } // namespace purity_interprocedural
 
+namespace depth_interprocedural {
+
+// The summary of a function is the length of the longest chain of calls from
+// it seen so far, which grows on every analysis of a recursive function. A run
+// stopped by its iteration limit thus depends on how many times, and in which
+// order, the functions of a recursive component read each other's summaries.
+class DepthRegistry : public sparta::AbstractRegistry {
+ public:
+  bool has_update() const override { return m_has_update; }
+
+  void materialize_update() override { m_has_update = false; }
+
+  void update(language::Function* func, uint32_t depth) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto& old = m_depths[func];
+    if (old != depth) {
+      old = depth;
+      m_has_update = true;
+    }
+  }
+
+  uint32_t get(language::Function* func) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_depths.find(func);
+    return it == m_depths.end() ? 0 : it->second;
+  }
+
+  std::unordered_map<language::Function*, uint32_t> depths() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_depths;
+  }
+
+ private:
+  mutable std::mutex m_mutex;
+  std::unordered_map<language::Function*, uint32_t> m_depths;
+  std::atomic<bool> m_has_update{false};
+};
+
+template <typename Base>
+class DepthFunctionAnalyzer : public Base {
+ public:
+  explicit DepthFunctionAnalyzer(language::Function* fun) : m_fun(fun) {}
+
+  void analyze() override {
+    for (const auto& entry : m_fun->cfg->statements()) {
+      if (entry.second.op == language::Opcode::CALL) {
+        m_depth = std::max(m_depth,
+                           this->get_summaries()->get(entry.second.callee) + 1);
+      }
+    }
+  }
+
+  void summarize() override { this->get_summaries()->update(m_fun, m_depth); }
+
+ private:
+  language::Function* m_fun;
+  uint32_t m_depth = 0;
+};
+
+struct DepthAnalysisAdaptor : public language::AnalysisAdaptorBase {
+  using Registry = DepthRegistry;
+
+  template <typename IntraproceduralBase>
+  using FunctionAnalyzer = DepthFunctionAnalyzer<IntraproceduralBase>;
+  using Callsite = purity_interprocedural::CallsiteEdgeTarget;
+
+  // The successors of a node are ordered by the addresses of their edges, so
+  // the analyses of a program must share its call graph to iterate over it in
+  // the same order, see RandomProgram.
+  template <typename FunctionSummaries>
+  static const language::CallGraph& call_graph_of(language::Program* program,
+                                                  FunctionSummaries*) {
+    return *call_graphs().at(program);
+  }
+
+  static std::unordered_map<language::Program*, const language::CallGraph*>&
+  call_graphs() {
+    static std::unordered_map<language::Program*, const language::CallGraph*>
+        graphs;
+    return graphs;
+  }
+};
+
+using DepthAnalysis = sparta::InterproceduralAnalyzer<DepthAnalysisAdaptor>;
+using ParallelDepthAnalysis =
+    sparta::ParallelInterproceduralAnalyzer<DepthAnalysisAdaptor>;
+
+// A program whose entry calls a few functions, and whose functions call up to
+// three functions picked at random: its call graph has many recursive
+// components, some of them nested or entered through several functions.
+class RandomProgram {
+ public:
+  RandomProgram(uint32_t seed, size_t size) {
+    std::mt19937 random(seed);
+    for (size_t i = 0; i < size; ++i) {
+      m_functions.push_back(std::make_unique<language::Function>());
+      m_functions.back()->name = "fun" + std::to_string(i);
+    }
+    std::uniform_int_distribution<size_t> callee(0, size - 1);
+    std::uniform_int_distribution<size_t> num_calls(0, 3);
+    for (auto& func : m_functions) {
+      func->cfg = std::make_shared<language::ControlFlowGraph>("0");
+      add_calls(func.get(), num_calls(random), [&] {
+        return m_functions[callee(random)].get();
+      });
+    }
+    m_entry.name = "mainfun";
+    m_entry.cfg = std::make_shared<language::ControlFlowGraph>("0");
+    size_t next = 0;
+    add_calls(&m_entry, std::min<size_t>(size, 4),
+              [&] { return m_functions[next++].get(); });
+
+    std::vector<language::Function*> functions{&m_entry};
+    for (auto& func : m_functions) {
+      functions.push_back(func.get());
+    }
+    m_program = std::make_unique<language::Program>(functions, &m_entry);
+
+    m_call_graph = std::make_unique<language::CallGraph>(&m_entry);
+    for (auto* func : functions) {
+      for (const auto& entry : func->cfg->statements()) {
+        if (entry.second.op == language::Opcode::CALL) {
+          m_call_graph->add_edge(func, entry.second.callee);
+        }
+      }
+    }
+    DepthAnalysisAdaptor::call_graphs()[m_program.get()] = m_call_graph.get();
+  }
+
+  ~RandomProgram() {
+    DepthAnalysisAdaptor::call_graphs().erase(m_program.get());
+  }
+
+  language::Program* program() { return m_program.get(); }
+
+ private:
+  template <typename CalleeFn>
+  static void add_calls(language::Function* func,
+                        size_t num_calls,
+                        const CalleeFn& callee) {
+    if (num_calls == 0) {
+      func->cfg->add("0", language::Statement(language::Opcode::CONST));
+      return;
+    }
+    for (size_t i = 0; i < num_calls; ++i) {
+      func->cfg->add(std::to_string(i),
+                     language::Statement(language::Opcode::CALL, callee()));
+      if (i > 0) {
+        func->cfg->add_edge(std::to_string(i - 1), std::to_string(i));
+      }
+    }
+    func->cfg->set_exit(std::to_string(num_calls - 1));
+  }
+
+  std::vector<std::unique_ptr<language::Function>> m_functions;
+  language::Function m_entry;
+  std::unique_ptr<language::Program> m_program;
+  std::unique_ptr<language::CallGraph> m_call_graph;
+};
+
+} // namespace depth_interprocedural
+
 void test1() {
   using namespace language;
 
@@ -683,3 +1018,332 @@ void test1() {
 }
 
 TEST(AnalyzerTest, test1) { test1(); }
+
+void test_incremental() {
+  using namespace language;
+
+  Function fun1, fun2, fun3, fun4, mainfun;
+  fun1.name = "fun1";
+  fun1.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun1.cfg->add("1", Statement(Opcode::CONST));
+  fun1.cfg->set_exit("1");
+
+  fun2.name = "fun2";
+  fun2.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun2.cfg->add("1", Statement(Opcode::THROW));
+  fun2.cfg->add("2", Statement(Opcode::CALL, &fun1));
+  fun2.cfg->add_edge("1", "2");
+  fun2.cfg->set_exit("2");
+
+  fun3.name = "fun3";
+  fun3.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun3.cfg->add("1", Statement(Opcode::CALL, &fun1));
+  fun3.cfg->set_exit("1");
+
+  fun4.name = "fun4";
+  fun4.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun4.cfg->add("1", Statement(Opcode::CALL, &fun2));
+  fun4.cfg->set_exit("1");
+
+  mainfun.name = "mainfun";
+  mainfun.cfg = std::make_shared<ControlFlowGraph>("1");
+  mainfun.cfg->add("1", Statement(Opcode::CALL, &fun3));
+  mainfun.cfg->add("2", Statement(Opcode::CALL, &fun4));
+  mainfun.cfg->add_edge("1", "2");
+  mainfun.cfg->set_exit("2");
+
+  std::vector<Function*> functions{&fun1, &fun2, &fun3, &fun4, &mainfun};
+  Program prog(functions, &mainfun);
+  purity_interprocedural::Analysis full(&prog, 5 /* max iteration */);
+  full.run();
+  purity_interprocedural::IncrementalAnalysis incremental(
+      &prog, 5 /* max iteration */);
+  incremental.run();
+
+  for (auto* f : functions) {
+    EXPECT_TRUE(incremental.registry.get(f).equals(full.registry.get(f)))
+        << f->name;
+  }
+  ASSERT_TRUE(incremental.registry.get(&mainfun).is_value());
+  EXPECT_FALSE(incremental.registry.get(&mainfun).pure());
+
+  // The registry reports an update after every iteration, so all 5 iterations
+  // run, but once the summaries are stable every function reuses its previous
+  // analysis.
+  EXPECT_LE(incremental.num_analyzed(), 2 * functions.size());
+  EXPECT_EQ(incremental.num_analyzed() + incremental.num_reused(),
+            5 * functions.size());
+}
+
+TEST(AnalyzerTest, incremental) { test_incremental(); }
+
+void test_scc() {
+  using namespace language;
+
+  Function fun1, fun2, fun3, fun4, fun5, fun6, mainfun;
+  fun1.name = "fun1";
+  fun1.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun1.cfg->add("1", Statement(Opcode::CONST));
+  fun1.cfg->set_exit("1");
+
+  fun2.name = "fun2";
+  fun2.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun2.cfg->add("1", Statement(Opcode::THROW));
+  fun2.cfg->add("2", Statement(Opcode::CALL, &fun1));
+  fun2.cfg->add_edge("1", "2");
+  fun2.cfg->set_exit("2");
+
+  fun3.name = "fun3";
+  fun3.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun3.cfg->add("1", Statement(Opcode::CALL, &fun1));
+  fun3.cfg->set_exit("1");
+
+  fun4.name = "fun4";
+  fun4.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun4.cfg->add("1", Statement(Opcode::CALL, &fun2));
+  fun4.cfg->set_exit("1");
+
+  // fun5 and fun6 are mutually recursive.
+  fun5.name = "fun5";
+  fun5.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun5.cfg->add("1", Statement(Opcode::CALL, &fun6));
+  fun5.cfg->set_exit("1");
+
+  fun6.name = "fun6";
+  fun6.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun6.cfg->add("1", Statement(Opcode::CALL, &fun5));
+  fun6.cfg->add("2", Statement(Opcode::CALL, &fun3));
+  fun6.cfg->add_edge("1", "2");
+  fun6.cfg->set_exit("2");
+
+  mainfun.name = "mainfun";
+  mainfun.cfg = std::make_shared<ControlFlowGraph>("1");
+  mainfun.cfg->add("1", Statement(Opcode::CALL, &fun5));
+  mainfun.cfg->add("2", Statement(Opcode::CALL, &fun3));
+  mainfun.cfg->add("3", Statement(Opcode::CALL, &fun4));
+  mainfun.cfg->add_edge("1", "2");
+  mainfun.cfg->add_edge("2", "3");
+  mainfun.cfg->set_exit("3");
+
+  std::vector<Function*> functions{&fun1, &fun2, &fun3, &fun4,
+                                   &fun5, &fun6, &mainfun};
+  Program prog(functions, &mainfun);
+  purity_interprocedural::BottomUpAnalysis global(&prog, 10 /* max iteration */);
+  global.run();
+  purity_interprocedural::SccAnalysis scc(
+      &prog, 10 /* max iteration */, nullptr, 1 /* num threads */);
+  std::vector<std::vector<Function*>> completed;
+  scc.set_component_callback(
+      [&](const std::vector<Function*>& component, bool widened) {
+        EXPECT_FALSE(widened);
+        completed.push_back(component);
+      });
+  scc.run();
+
+  EXPECT_TRUE(scc.reached_fixpoint());
+  // Every function is reported once, with its component, after its callees.
+  std::unordered_map<Function*, size_t> completed_at;
+  for (size_t i = 0; i < completed.size(); ++i) {
+    for (auto* f : completed[i]) {
+      EXPECT_TRUE(completed_at.emplace(f, i).second) << f->name;
+    }
+  }
+  for (auto* f : functions) {
+    ASSERT_EQ(completed_at.count(f), 1) << f->name;
+  }
+  EXPECT_EQ(completed_at.at(&fun5), completed_at.at(&fun6));
+  EXPECT_LT(completed_at.at(&fun1), completed_at.at(&fun2));
+  EXPECT_LT(completed_at.at(&fun2), completed_at.at(&fun4));
+  EXPECT_LT(completed_at.at(&fun3), completed_at.at(&fun6));
+  EXPECT_LT(completed_at.at(&fun6), completed_at.at(&mainfun));
+  for (auto* f : functions) {
+    EXPECT_TRUE(scc.registry.get(f).equals(global.registry.get(f))) << f->name;
+  }
+  ASSERT_TRUE(scc.registry.get(&fun3).is_value());
+  EXPECT_TRUE(scc.registry.get(&fun3).pure());
+  ASSERT_TRUE(scc.registry.get(&mainfun).is_value());
+  EXPECT_FALSE(scc.registry.get(&mainfun).pure());
+
+  // The functions that are not part of a cycle are analyzed once, the cycle
+  // until its summaries are stable.
+  for (auto* f : {&fun1, &fun2, &fun3, &fun4, &mainfun}) {
+    EXPECT_EQ(scc.registry.num_updates(f), 1) << f->name;
+  }
+  EXPECT_EQ(scc.registry.num_updates(&fun5), 2);
+  EXPECT_EQ(scc.registry.num_updates(&fun6), 2);
+  EXPECT_GT(global.registry.num_updates(&fun1), 1);
+}
+
+TEST(AnalyzerTest, scc) { test_scc(); }
+
+void test_scc_budget() {
+  using namespace language;
+
+  Function fun1, fun2, fun3, mainfun;
+  fun1.name = "fun1";
+  fun1.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun1.cfg->add("1", Statement(Opcode::CONST));
+  fun1.cfg->set_exit("1");
+
+  // fun2 and fun3 are mutually recursive, and need two iterations.
+  fun2.name = "fun2";
+  fun2.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun2.cfg->add("1", Statement(Opcode::CALL, &fun3));
+  fun2.cfg->set_exit("1");
+
+  fun3.name = "fun3";
+  fun3.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun3.cfg->add("1", Statement(Opcode::THROW));
+  fun3.cfg->add("2", Statement(Opcode::CALL, &fun2));
+  fun3.cfg->add("3", Statement(Opcode::CALL, &fun1));
+  fun3.cfg->add_edge("1", "2");
+  fun3.cfg->add_edge("2", "3");
+  fun3.cfg->set_exit("3");
+
+  mainfun.name = "mainfun";
+  mainfun.cfg = std::make_shared<ControlFlowGraph>("1");
+  mainfun.cfg->add("1", Statement(Opcode::CALL, &fun2));
+  mainfun.cfg->add("2", Statement(Opcode::CALL, &fun1));
+  mainfun.cfg->add_edge("1", "2");
+  mainfun.cfg->set_exit("2");
+
+  std::vector<Function*> functions{&fun1, &fun2, &fun3, &mainfun};
+  Program prog(functions, &mainfun);
+
+  // A budget that suffices changes nothing.
+  purity_interprocedural::SccAnalysis enough(
+      &prog, 10 /* max iteration */, nullptr, 1 /* num threads */);
+  enough.set_component_budget(2);
+  enough.run();
+  EXPECT_TRUE(enough.reached_fixpoint());
+  EXPECT_TRUE(enough.budget_exhausted_functions().empty());
+  ASSERT_TRUE(enough.registry.get(&fun2).is_value());
+  EXPECT_FALSE(enough.registry.get(&fun2).pure());
+
+  purity_interprocedural::SccAnalysis scc(
+      &prog, 10 /* max iteration */, nullptr, 1 /* num threads */);
+  scc.set_component_budget(1);
+  std::vector<Function*> widened_functions;
+  scc.set_component_callback(
+      [&](const std::vector<Function*>& component, bool widened) {
+        if (widened) {
+          widened_functions.insert(widened_functions.end(), component.begin(),
+                                   component.end());
+        }
+      });
+  scc.run();
+
+  EXPECT_FALSE(scc.reached_fixpoint());
+  std::vector<Function*> exhausted(scc.budget_exhausted_functions().begin(),
+                                   scc.budget_exhausted_functions().end());
+  std::sort(exhausted.begin(), exhausted.end(),
+            [](Function* f, Function* g) { return f->name < g->name; });
+  EXPECT_EQ(exhausted, (std::vector<Function*>{&fun2, &fun3}));
+  std::sort(widened_functions.begin(), widened_functions.end(),
+            [](Function* f, Function* g) { return f->name < g->name; });
+  EXPECT_EQ(widened_functions, exhausted);
+  EXPECT_TRUE(scc.registry.get(&fun2).is_top());
+  EXPECT_TRUE(scc.registry.get(&fun3).is_top());
+  EXPECT_EQ(scc.registry.num_updates(&fun2), 2);
+  // The other components are analyzed once, the caller of the widened cycle
+  // with its top summaries.
+  EXPECT_TRUE(scc.registry.get(&fun1).equals(enough.registry.get(&fun1)));
+  EXPECT_EQ(scc.registry.num_updates(&mainfun), 1);
+  EXPECT_TRUE(scc.registry.get(&mainfun).is_top());
+}
+
+TEST(AnalyzerTest, sccBudget) { test_scc_budget(); }
+
+void test_telemetry() {
+  using namespace language;
+
+  Function fun1, fun2, fun3, mainfun;
+  fun1.name = "fun1";
+  fun1.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun1.cfg->add("1", Statement(Opcode::CONST));
+  fun1.cfg->set_exit("1");
+
+  // fun2 and fun3 are mutually recursive.
+  fun2.name = "fun2";
+  fun2.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun2.cfg->add("1", Statement(Opcode::CALL, &fun3));
+  fun2.cfg->set_exit("1");
+
+  fun3.name = "fun3";
+  fun3.cfg = std::make_shared<ControlFlowGraph>("1");
+  fun3.cfg->add("1", Statement(Opcode::CALL, &fun2));
+  fun3.cfg->add("2", Statement(Opcode::CALL, &fun1));
+  fun3.cfg->add_edge("1", "2");
+  fun3.cfg->set_exit("2");
+
+  mainfun.name = "mainfun";
+  mainfun.cfg = std::make_shared<ControlFlowGraph>("1");
+  mainfun.cfg->add("1", Statement(Opcode::CALL, &fun2));
+  mainfun.cfg->set_exit("1");
+
+  std::vector<Function*> functions{&fun1, &fun2, &fun3, &mainfun};
+  Program prog(functions, &mainfun);
+  purity_interprocedural::RecordingTelemetry telemetry;
+  purity_interprocedural::SccAnalysis scc(
+      &prog, 10 /* max iteration */, nullptr, 1 /* num threads */);
+  scc.set_telemetry(&telemetry);
+  scc.run();
+
+  // One record per analysis of a function.
+  for (auto* f : functions) {
+    EXPECT_EQ(telemetry.records_of(f).size(), scc.registry.num_updates(f))
+        << f->name;
+  }
+  auto fun1_records = telemetry.records_of(&fun1);
+  ASSERT_EQ(fun1_records.size(), 1);
+  EXPECT_EQ(fun1_records[0].iteration, 0);
+  EXPECT_EQ(fun1_records[0].stats.num_nodes, 1);
+  EXPECT_TRUE(fun1_records[0].summary_changed);
+
+  // The cycle is iterated until its summaries do not change.
+  auto fun3_records = telemetry.records_of(&fun3);
+  ASSERT_EQ(fun3_records.size(), 2);
+  EXPECT_EQ(fun3_records[0].iteration, 0);
+  EXPECT_EQ(fun3_records[0].stats.num_nodes, 2);
+  EXPECT_EQ(fun3_records[1].iteration, 1);
+  EXPECT_FALSE(fun3_records[1].summary_changed);
+
+  // Global iterations.
+  purity_interprocedural::RecordingTelemetry global_telemetry;
+  purity_interprocedural::BottomUpAnalysis global(&prog,
+                                                  3 /* max iteration */);
+  global.set_telemetry(&global_telemetry);
+  global.run();
+  auto global_fun1_records = global_telemetry.records_of(&fun1);
+  ASSERT_EQ(global_fun1_records.size(), 3);
+  for (uint32_t i = 0; i < 3; ++i) {
+    EXPECT_EQ(global_fun1_records[i].iteration, i);
+  }
+}
+
+TEST(AnalyzerTest, telemetry) { test_telemetry(); }
+
+void test_parallel() {
+  using namespace depth_interprocedural;
+
+  for (uint32_t seed = 0; seed < 5; ++seed) {
+    RandomProgram random(seed, 200);
+    DepthAnalysis serial(random.program(), 4 /* max iteration */);
+    serial.run();
+    // The recursive functions are still growing their summaries.
+    EXPECT_FALSE(serial.reached_fixpoint()) << seed;
+    auto expected = serial.registry.depths();
+
+    // A function is analyzed once all its predecessors in the weak partial
+    // ordering are, and it only reads the summaries of its callees, so the
+    // summaries are the same as in a serial run whatever the schedule.
+    for (int run = 0; run < 10; ++run) {
+      ParallelDepthAnalysis parallel(random.program(), 4 /* max iteration */,
+                                     nullptr, 8 /* num threads */);
+      parallel.run();
+      EXPECT_EQ(parallel.registry.depths(), expected) << seed;
+    }
+  }
+}
+
+TEST(AnalyzerTest, parallel) { test_parallel(); }
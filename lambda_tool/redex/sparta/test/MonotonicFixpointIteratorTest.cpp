@@ -142,6 +142,9 @@ class FixpointEngine final
   explicit FixpointEngine(const Program& program)
       : Base(program), m_program(program) {}
 
+  FixpointEngine(const Program& program, Arena* arena)
+      : Base(program, /* cfg_size_hint */ 4, arena), m_program(program) {}
+
   void analyze_node(const uint32_t& node,
                     LivenessDomain* current_state) const override {
     const Statement& stmt = m_program.statement_at(node);
@@ -350,6 +353,38 @@ TYPED_TEST(MonotonicFixpointIteratorLivenessTest, program1) {
   EXPECT_TRUE(fp.get_live_out_vars_at(6).elements().empty());
 }
 
+using MonotonicFixpointIteratorArenaTest = MonotonicFixpointIteratorLivenessTest<
+    liveness::FixpointEngine<sparta::WTOMonotonicFixpointIterator>>;
+
+// The states allocated from an arena are the same as the ones allocated from
+// the heap.
+TEST_F(MonotonicFixpointIteratorArenaTest, sameStatesAsHeap) {
+  using namespace liveness;
+  for (const Program* program : {&m_program1, &m_program2, &m_program3}) {
+    FixpointEngine<sparta::WTOMonotonicFixpointIterator> heap_fp(*program);
+    heap_fp.run(LivenessDomain());
+    sparta::Arena arena;
+    {
+      FixpointEngine<sparta::WTOMonotonicFixpointIterator> wto_fp(*program,
+                                                                 &arena);
+      wto_fp.run(LivenessDomain());
+      FixpointEngine<sparta::MonotonicFixpointIterator> fp(*program, &arena);
+      fp.run(LivenessDomain());
+      for (uint32_t node = 1; node <= 8; ++node) {
+        EXPECT_TRUE(wto_fp.get_live_in_vars_at(node).equals(
+            heap_fp.get_live_in_vars_at(node)));
+        EXPECT_TRUE(wto_fp.get_live_out_vars_at(node).equals(
+            heap_fp.get_live_out_vars_at(node)));
+        EXPECT_TRUE(fp.get_live_in_vars_at(node).equals(
+            heap_fp.get_live_in_vars_at(node)));
+        EXPECT_TRUE(fp.get_live_out_vars_at(node).equals(
+            heap_fp.get_live_out_vars_at(node)));
+      }
+    }
+    EXPECT_GT(arena.capacity(), 0);
+  }
+}
+
 TYPED_TEST(MonotonicFixpointIteratorLivenessTest, program2) {
   using namespace std::placeholders;
   using namespace liveness;
@@ -816,6 +851,9 @@ TYPED_TEST(MonotonicFixpointIteratorNumericalTest, program1) {
   EXPECT_EQ(fp.get_entry_state_at(bb4).get(&y),
             (IntegerSetAbstractDomain{2, 3}));
   EXPECT_EQ(fp.get_exit_state_at(bb4), fp.get_entry_state_at(bb4));
+
+  // There is no loop.
+  EXPECT_EQ(fp.get_num_iterations(), 0);
 }
 
 TYPED_TEST(MonotonicFixpointIteratorNumericalTest, program2) {
@@ -859,4 +897,7 @@ TYPED_TEST(MonotonicFixpointIteratorNumericalTest, program2) {
   EXPECT_EQ(fp.get_entry_state_at(bb3).get(&x),
             IntegerSetAbstractDomain::top());
   EXPECT_EQ(fp.get_exit_state_at(bb3).get(&x), IntegerSetAbstractDomain::top());
+
+  // The loop is joined once, then widened to top.
+  EXPECT_EQ(fp.get_num_iterations(), 2);
 }
@@ -12,7 +12,9 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <initializer_list>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 using namespace sparta;
 
@@ -209,3 +211,79 @@ TEST(PatriciaTreeMapTest, difference) {
                                      create_pt_map({{2, 1}, {4, 1}, {6, 1}})),
             create_pt_map({{1, 3}, {3, 3}, {5, 3}}));
 }
+
+namespace {
+
+struct Color {
+  uint32_t value = 0;
+
+  bool operator==(const Color& other) const { return value == other.value; }
+};
+
+} // namespace
+
+template <>
+struct sparta::PatriciaTreeHashConsing<Color> : std::true_type {
+  static size_t hash(const Color& color) { return color.value; }
+};
+
+using hash_consed_map = PatriciaTreeMap<uint32_t, Color>;
+using HashConsedNodes = pt_util::HashConsingTable<
+    ptmap_impl::PatriciaTree<uint32_t, ptmap_impl::SimpleValue<Color>>>;
+
+TEST(PatriciaTreeMapTest, hashConsing) {
+  {
+    hash_consed_map m1;
+    hash_consed_map m2;
+    for (uint32_t i = 0; i < 100; ++i) {
+      m1.insert_or_assign(i, Color{i % 3 + 1});
+      m2.insert_or_assign(99 - i, Color{(99 - i) % 3 + 1});
+    }
+    // Equal maps built independently are the same tree.
+    EXPECT_TRUE(m1.reference_equals(m2));
+    EXPECT_TRUE(m1.equals(m2));
+    // 100 leaves and 99 branches.
+    EXPECT_EQ(199, HashConsedNodes::size());
+
+    m2.insert_or_assign(50, Color{7});
+    EXPECT_FALSE(m1.equals(m2));
+    EXPECT_FALSE(m1.reference_equals(m2));
+
+    auto m3 = m2.get_union_with(
+        [](const Color& x, const Color& y) {
+          return x.value < y.value ? x : y;
+        },
+        m1);
+    EXPECT_TRUE(m3.reference_equals(m1));
+    m2.insert_or_assign(50, Color{50 % 3 + 1});
+    EXPECT_TRUE(m2.reference_equals(m1));
+  }
+  EXPECT_EQ(0, HashConsedNodes::size());
+}
+
+TEST(PatriciaTreeMapTest, concurrentHashConsing) {
+  constexpr size_t num_threads = 4;
+  std::vector<hash_consed_map> maps(num_threads);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&maps, t] {
+      for (size_t round = 0; round < 100; ++round) {
+        hash_consed_map map;
+        for (uint32_t i = 0; i < 64; ++i) {
+          uint32_t key = (i * 7 + t) % 64;
+          map.insert_or_assign(key, Color{key + 1});
+        }
+        maps[t] = map;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (size_t t = 1; t < num_threads; ++t) {
+    EXPECT_TRUE(maps[t].reference_equals(maps[0]));
+  }
+  EXPECT_EQ(127, HashConsedNodes::size());
+  maps.clear();
+  EXPECT_EQ(0, HashConsedNodes::size());
+}
@@ -273,3 +273,30 @@ TYPED_TEST(UInt64SetTest, setOfUnsignedInt64) {
     EXPECT_EQ(1, values.count(x));
   }
 }
+
+template <>
+struct sparta::PatriciaTreeHashConsing<uint16_t> : std::true_type {};
+
+TEST(PatriciaTreeSetTest, hashConsing) {
+  using HashConsedNodes =
+      pt_util::HashConsingTable<pt_impl::PatriciaTree<uint16_t>>;
+  {
+    PatriciaTreeSet<uint16_t> s1;
+    PatriciaTreeSet<uint16_t> s2;
+    for (uint16_t i = 0; i < 100; ++i) {
+      s1.insert(i);
+      s2.insert(99 - i);
+    }
+    // Equal sets built independently are the same tree.
+    EXPECT_TRUE(s1.reference_equals(s2));
+    // 100 leaves and 99 branches.
+    EXPECT_EQ(199, HashConsedNodes::size());
+
+    s2.remove(50);
+    EXPECT_FALSE(s1.equals(s2));
+    EXPECT_TRUE(s2.is_subset_of(s1));
+    s2.union_with(PatriciaTreeSet<uint16_t>({50}));
+    EXPECT_TRUE(s2.reference_equals(s1));
+  }
+  EXPECT_EQ(0, HashConsedNodes::size());
+}
@@ -11,6 +11,9 @@
 #include <chrono>
 #include <gtest/gtest.h>
 #include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 constexpr unsigned int NUM_INTS = 1000;
 
@@ -99,3 +102,77 @@ TEST(SpartaWorkQueueTest, preciseScheduling) {
     ASSERT_EQ(1, array[idx]);
   }
 }
+
+TEST(SpartaWorkQueueTest, workStealingDeque) {
+  constexpr size_t num_thieves = 3;
+  constexpr int num_tasks = 100000;
+  sparta::workqueue_impl::WorkStealingDeque<int> deque;
+  std::vector<std::atomic<int>> taken(num_tasks);
+  std::atomic<bool> owner_done{false};
+  std::vector<std::thread> thieves;
+  for (size_t i = 0; i < num_thieves; ++i) {
+    thieves.emplace_back([&] {
+      while (!owner_done || !deque.empty()) {
+        if (auto task = deque.steal()) {
+          ++taken[*task];
+        }
+      }
+    });
+  }
+  // The owner pushes all the tasks, popping one every other push. The deque
+  // starts with a capacity of 64, so it grows while being stolen from.
+  for (int i = 0; i < num_tasks; ++i) {
+    deque.push(i);
+    if (i % 2 == 0) {
+      if (auto task = deque.pop()) {
+        ++taken[*task];
+      }
+    }
+  }
+  while (auto task = deque.pop()) {
+    ++taken[*task];
+  }
+  owner_done = true;
+  for (auto& thief : thieves) {
+    thief.join();
+  }
+  for (int i = 0; i < num_tasks; ++i) {
+    ASSERT_EQ(1, taken[i]) << i;
+  }
+}
+
+TEST(SpartaWorkQueueTest, workStealingDequeOrder) {
+  // Tasks that are not scalars are boxed.
+  sparta::workqueue_impl::WorkStealingDeque<std::string> deque;
+  for (int i = 0; i < 100; ++i) {
+    deque.push(std::to_string(i));
+  }
+  EXPECT_EQ("99", *deque.pop());
+  EXPECT_EQ("0", *deque.steal());
+  EXPECT_EQ("1", *deque.steal());
+  EXPECT_EQ("98", *deque.pop());
+  // The remaining tasks are freed with the deque.
+  EXPECT_FALSE(deque.empty());
+}
+
+// Each task pushes two smaller tasks, so that the workers steal from each
+// other and park while the tree is being expanded.
+TEST(SpartaWorkQueueTest, fanOut) {
+  for (unsigned int num_threads : {1, 2, 8}) {
+    std::atomic<int> num_leaves{0};
+    auto wq = sparta::work_queue<int>(
+        [&](sparta::SpartaWorkerState<int>* worker_state, int depth) {
+          if (depth == 0) {
+            ++num_leaves;
+            return;
+          }
+          worker_state->push_task(depth - 1);
+          worker_state->push_task(depth - 1);
+        },
+        num_threads,
+        /*push_tasks_while_running=*/true);
+    wq.add_item(16);
+    wq.run_all();
+    EXPECT_EQ(1 << 16, num_leaves) << num_threads;
+  }
+}
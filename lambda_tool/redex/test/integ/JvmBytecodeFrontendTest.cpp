@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "DeterminismAnalysis.h"
+#include "DexClass.h"
+#include "DexLoader.h"
+#include "IRCode.h"
+#include "IRTypeChecker.h"
+#include "JarLoader.h"
+#include "RedexTest.h"
+#include "Show.h"
+#include "Walkers.h"
+
+using namespace determinism;
+
+namespace {
+
+// The determinism of the methods, by method name.
+using Results = std::map<std::string, std::string>;
+
+Results analyze(const Scope& scope) {
+  DeterminismAnalysisPass analysis;
+  DeterminismAnalysisPass::AnalysisParameters param;
+  analysis.run(scope, 10, param);
+  Results results;
+  for (const auto& entry : *analysis.get_result()) {
+    std::ostringstream domain;
+    domain << entry.second;
+    results.emplace(show(entry.first), domain.str());
+  }
+  return results;
+}
+
+std::vector<std::string> methods_with_code(const Scope& scope) {
+  std::vector<std::string> methods;
+  walk::code(scope, [&](DexMethod* method, IRCode&) {
+    methods.push_back(show(method));
+  });
+  std::sort(methods.begin(), methods.end());
+  return methods;
+}
+
+} // namespace
+
+/*
+ * The jar the dex file of the test is built from is loaded with the bytecode
+ * frontend, and compared to the dex file, each in its own context.
+ */
+class JvmBytecodeFrontendTest : public RedexTest {
+ protected:
+  void SetUp() override {
+    const char* dexfile = std::getenv("dexfile");
+    ASSERT_NE(nullptr, dexfile);
+    m_dexfile = dexfile;
+    ASSERT_TRUE(boost::algorithm::ends_with(m_dexfile, ".dex"));
+    m_jarfile = m_dexfile.substr(0, m_dexfile.size() - 4) + ".jar";
+  }
+
+  Scope load_dex() { return load_classes_from_dex(m_dexfile.c_str()); }
+
+  Scope load_jar() {
+    delete g_redex;
+    g_redex = new RedexContext();
+    Scope classes;
+    always_assert(load_program_jar_file(m_jarfile.c_str(), &classes));
+    return classes;
+  }
+
+  std::string m_dexfile;
+  std::string m_jarfile;
+};
+
+TEST_F(JvmBytecodeFrontendTest, translatedCodeTypeChecks) {
+  auto classes = load_jar();
+  ASSERT_FALSE(classes.empty());
+  for (const auto* cls : classes) {
+    EXPECT_FALSE(cls->is_external()) << show(cls);
+  }
+  walk::code(classes, [](DexMethod* method, IRCode&) {
+    IRTypeChecker checker(method);
+    checker.run();
+    EXPECT_TRUE(checker.good()) << show(method) << ": " << checker.what();
+  });
+}
+
+TEST_F(JvmBytecodeFrontendTest, sameMethodsAsDexFrontend) {
+  auto dex_methods = methods_with_code(load_dex());
+  auto jar_methods = methods_with_code(load_jar());
+  EXPECT_FALSE(jar_methods.empty());
+  EXPECT_EQ(dex_methods, jar_methods);
+}
+
+TEST_F(JvmBytecodeFrontendTest, sameDeterminismAsDexFrontend) {
+  auto dex_results = analyze(load_dex());
+  auto jar_results = analyze(load_jar());
+  EXPECT_FALSE(jar_results.empty());
+  for (const auto& entry : dex_results) {
+    auto it = jar_results.find(entry.first);
+    ASSERT_NE(it, jar_results.end()) << entry.first;
+    EXPECT_EQ(entry.second, it->second) << entry.first;
+  }
+  EXPECT_EQ(dex_results.size(), jar_results.size());
+}
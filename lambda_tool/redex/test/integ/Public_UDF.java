@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+package com.facebook.redextest;
+
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.Random;
+
+/*
+ * The kind of scalar functions of the PL/Java UDF jars: the analyses have to
+ * get the same results on the classes of the jar as on the dexed ones.
+ */
+public class Public_UDF {
+  private static final String SEPARATOR = ",";
+  private static final long SEED = 0x5DEECE66DL;
+  private static final double SCALE = 0.5;
+  private static int sCounter;
+
+  private final Map<String, Integer> mCache = new HashMap<String, Integer>();
+  private long mTotal;
+
+  public static int add(int a, int b) {
+    return a + b;
+  }
+
+  public static long mix(long a, int shift, double scale) {
+    long mixed = (a << shift) ^ (a >>> (64 - shift));
+    return mixed + (long) (scale * SCALE) - (a % 7);
+  }
+
+  public static float average(float[] values) {
+    if (values == null || values.length == 0) {
+      return 0.0f;
+    }
+    float sum = 0;
+    for (int i = 0; i < values.length; i++) {
+      sum += values[i];
+    }
+    return sum / values.length;
+  }
+
+  public static String concat(String a, String b) {
+    return a + SEPARATOR + b;
+  }
+
+  public static String[] split(String value) {
+    List<String> parts = new ArrayList<String>();
+    int start = 0;
+    for (int i = value.indexOf(SEPARATOR);
+        i >= 0;
+        i = value.indexOf(SEPARATOR, start)) {
+      parts.add(value.substring(start, i));
+      start = i + 1;
+    }
+    parts.add(value.substring(start));
+    return parts.toArray(new String[parts.size()]);
+  }
+
+  public static int parseOrDefault(String value, int fallback) {
+    try {
+      return Integer.parseInt(value.trim());
+    } catch (NumberFormatException e) {
+      return fallback;
+    } catch (NullPointerException e) {
+      return -fallback;
+    } finally {
+      sCounter++;
+    }
+  }
+
+  public static String grade(int score) {
+    switch (score / 10) {
+    case 10:
+    case 9:
+      return "A";
+    case 8:
+      return "B";
+    case 7:
+      return "C";
+    default:
+      return "F";
+    }
+  }
+
+  public static int category(int code) {
+    switch (code) {
+    case -1000:
+      return 0;
+    case 7:
+      return 1;
+    case 123456:
+      return 2;
+    default:
+      return code > 0 ? 3 : 4;
+    }
+  }
+
+  public static int[][] identity(int size) {
+    int[][] matrix = new int[size][size];
+    for (int i = 0; i < size; i++) {
+      matrix[i][i] = 1;
+    }
+    return matrix;
+  }
+
+  public static String[][][] cube(int size) {
+    return new String[size][size][];
+  }
+
+  public static boolean isBlank(char[] chars) {
+    for (char c : chars) {
+      if (!Character.isWhitespace(c)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  public static byte checksum(byte[] bytes, boolean[] mask) {
+    byte sum = 0;
+    for (int i = 0; i < bytes.length; i++) {
+      if (mask[i]) {
+        sum ^= bytes[i];
+      }
+    }
+    return sum;
+  }
+
+  public static short narrow(double value) {
+    long rounded = Math.round(value);
+    return (short) (int) rounded;
+  }
+
+  public static int compare(double a, double b, float c, long d) {
+    if (a < b) {
+      return -1;
+    }
+    if (c > a || d >= 100L) {
+      return 1;
+    }
+    return a == b ? 0 : 2;
+  }
+
+  public static long sum(long[] values) {
+    long total = 0;
+    int i = values.length;
+    while (--i >= 0) {
+      total += values[i];
+    }
+    return total;
+  }
+
+  public static Object first(Object[] values) {
+    Object[] copy = values.clone();
+    return copy.length > 0 ? copy[0] : null;
+  }
+
+  public static int random(int bound) {
+    return new Random().nextInt(bound);
+  }
+
+  public static int seeded(int bound) {
+    return new Random(SEED).nextInt(bound);
+  }
+
+  public static long now() {
+    return System.currentTimeMillis();
+  }
+
+  public static int counter() {
+    return ++sCounter;
+  }
+
+  public static int lookup(Public_UDF udf, String key) {
+    Integer value = udf.mCache.get(key);
+    if (value == null) {
+      value = key.length();
+      udf.mCache.put(key, value);
+    }
+    return value;
+  }
+
+  public long accumulate(long value) {
+    mTotal += value;
+    return mTotal;
+  }
+
+  public long locked(long value) {
+    synchronized (mCache) {
+      mTotal = mTotal * 31 + value;
+      return mTotal;
+    }
+  }
+
+  public static double wide(double a, long b, int c, double d) {
+    double[] values = new double[] {a, b, c, d};
+    double result = 1.0;
+    for (double value : values) {
+      result = result * value + 1.5;
+    }
+    return result;
+  }
+
+  public static long dup(long[] values, int i) {
+    // The values of the array stores are kept with dup2_x2 and dup_x2.
+    long copy = values[i] = values[i] + 1;
+    int[] ints = new int[1];
+    int n = ints[0] = i * 2;
+    return copy + n;
+  }
+
+  public static String describe(Object value) {
+    if (value instanceof String) {
+      return (String) value;
+    }
+    if (value instanceof Number) {
+      return "number:" + ((Number) value).intValue();
+    }
+    return String.valueOf(value) + Public_UDF.class.getName();
+  }
+
+  public static int wideLocals(int a) {
+    int v0 = a, v1 = a + 1, v2 = a + 2, v3 = a + 3, v4 = a + 4;
+    long l0 = v0, l1 = v1, l2 = v2, l3 = v3, l4 = v4;
+    double d0 = l0, d1 = l1, d2 = l2, d3 = l3, d4 = l4;
+    int total = v0 + v1 + v2 + v3 + v4;
+    total += (int) (l0 + l1 + l2 + l3 + l4);
+    total += (int) (d0 * d1 * d2 * d3 * d4);
+    for (int i = 0; i < 1000; i += 300) {
+      total += i;
+    }
+    return total;
+  }
+
+  public static void fail(String message) {
+    throw new IllegalStateException(message);
+  }
+}
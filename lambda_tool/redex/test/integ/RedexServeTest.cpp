@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <json/json.h>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#include "RedexTestUtils.h"
+
+/*
+ * Starts `redex-all --serve` on the dex file of the test, and checks that it
+ * answers the requests of its clients, with the summary cache of the analysis
+ * pass shared by the requests, and that a client that does not send its
+ * request does not hold up the others.
+ */
+
+namespace {
+
+const char* METHOD = "Lcom/facebook/redextest/RedexServeTest;.add:(I)I";
+
+// Connects to the server, waiting for it to listen. Returns -1 if it does not
+// listen in time.
+int connect_to(const std::string& socket_path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+  for (int attempt = 0; attempt < 600; ++attempt) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ==
+        0) {
+      return fd;
+    }
+    close(fd);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  return -1;
+}
+
+// Reads the response of the server, a line of JSON.
+Json::Value read_response(int fd) {
+  std::string text;
+  char buffer[4096];
+  ssize_t n;
+  while (text.find('\n') == std::string::npos &&
+         (n = read(fd, buffer, sizeof(buffer))) > 0) {
+    text.append(buffer, n);
+  }
+  Json::Value response;
+  Json::CharReaderBuilder builder;
+  std::istringstream in(text);
+  std::string errors;
+  EXPECT_TRUE(Json::parseFromStream(builder, in, &response, &errors))
+      << text << errors;
+  return response;
+}
+
+Json::Value send_request(const std::string& socket_path,
+                         const Json::Value& request) {
+  int fd = connect_to(socket_path);
+  EXPECT_GE(fd, 0);
+  Json::StreamWriterBuilder builder;
+  builder["indentation"] = "";
+  auto line = Json::writeString(builder, request) + "\n";
+  EXPECT_EQ(write(fd, line.data(), line.size()),
+            static_cast<ssize_t>(line.size()));
+  auto response = read_response(fd);
+  close(fd);
+  return response;
+}
+
+// Kills the server if the test fails before it shuts down.
+struct ServerGuard {
+  pid_t pid;
+  ~ServerGuard() {
+    if (pid > 0) {
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+    }
+  }
+};
+
+} // namespace
+
+TEST(RedexServeTest, answersRequests) {
+  auto tmp_dir = redex::make_tmp_dir("RedexServeTest%%%%%%%%");
+  auto socket_path = tmp_dir.path + "/redex.sock";
+  auto config_path = tmp_dir.path + "/config.json";
+  auto summary_cache = tmp_dir.path + "/summaries";
+  {
+    Json::Value config;
+    config["redex"]["passes"].append("DeterminismAnalysisPass");
+    config["DeterminismAnalysisPass"]["summary_cache"] = summary_cache;
+    std::ofstream out(config_path);
+    out << config;
+  }
+  const char* dexfile = std::getenv("dexfile");
+  ASSERT_NE(dexfile, nullptr);
+  auto dex_path = boost::filesystem::absolute(dexfile).string();
+
+  pid_t server = fork();
+  ASSERT_GE(server, 0);
+  if (server == 0) {
+    execl(REDEX_ALL, REDEX_ALL, "--serve", socket_path.c_str(),
+          "--serve-timeout", "1000", "--config", config_path.c_str(),
+          "--outdir", tmp_dir.path.c_str(), nullptr);
+    _exit(127);
+  }
+  ServerGuard guard{server};
+
+  // A client that never sends its request is answered once it times out.
+  int stalled = connect_to(socket_path);
+  ASSERT_GE(stalled, 0);
+
+  Json::Value request;
+  request["dex_files"].append(dex_path);
+  request["methods"].append(METHOD);
+  auto cold = send_request(socket_path, request);
+  ASSERT_EQ(cold["status"], "ok") << cold;
+  ASSERT_EQ(cold["results"]["det"].size(), 1) << cold;
+  EXPECT_EQ(cold["results"]["det"][0]["name"], METHOD);
+  EXPECT_TRUE(cold["time_ms"].isIntegral());
+
+  auto timed_out = read_response(stalled);
+  close(stalled);
+  EXPECT_EQ(timed_out["status"], "error");
+
+  // The first request saved the summary cache, which the server then kept in
+  // memory for the next ones.
+  EXPECT_TRUE(boost::filesystem::exists(summary_cache));
+  auto warm = send_request(socket_path, request);
+  ASSERT_EQ(warm["status"], "ok") << warm;
+  EXPECT_EQ(warm["results"], cold["results"]);
+
+  Json::Value shutdown;
+  shutdown["command"] = "shutdown";
+  EXPECT_EQ(send_request(socket_path, shutdown)["status"], "ok");
+  int stat;
+  ASSERT_EQ(waitpid(server, &stat, 0), server);
+  guard.pid = 0;
+  EXPECT_TRUE(WIFEXITED(stat));
+  EXPECT_EQ(WEXITSTATUS(stat), 0);
+}
@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+package com.facebook.redextest;
+
+public class RedexServeTest {
+  public static int constant() {
+    return 1;
+  }
+
+  public static int add(int x) {
+    return constant() + x;
+  }
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CalleeLabels.h"
+#include "DexClass.h"
+#include "IRCode.h"
+#include "JarLoader.h"
+#include "RedexContext.h"
+#include "Walkers.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//==========
+// Test for performance
+//==========
+
+// Looks up the labels of the callees of every invoke of a large jar, e.g. the
+// rt.jar of a JDK 8 loaded as program classes, as the determinism and
+// parallel-safety analyses do:
+//  - by name, building the "<class><name>" and "<class>*" strings of every
+//    callee and probing the labels with them, as the analyses did before
+//    CalleeLabels;
+//  - with CalleeLabels, resolved once, and then probed with the method
+//    reference of every callee.
+//
+//   callee_labels_perf_test [<jar>]
+//
+// The jar defaults to $JAVA_HOME/jre/lib/rt.jar. The labels are made up: every
+// fourth method name invoked, and every class of java/util.
+
+using Clock = std::chrono::high_resolution_clock;
+
+long long microseconds(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+      .count();
+}
+
+int main(int argc, char* argv[]) {
+  std::string jar;
+  if (argc > 1) {
+    jar = argv[1];
+  } else if (const char* java_home = getenv("JAVA_HOME")) {
+    jar = std::string(java_home) + "/jre/lib/rt.jar";
+  } else {
+    fprintf(stderr, "usage: %s <jar>, or set JAVA_HOME\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  printf("Begin!\n");
+  g_redex = new RedexContext();
+  Scope scope;
+  if (!load_program_jar_file(jar.c_str(), &scope)) {
+    fprintf(stderr, "Cannot load %s\n", jar.c_str());
+    return EXIT_FAILURE;
+  }
+
+  std::vector<const DexMethodRef*> callees;
+  walk::opcodes(scope, [&](const DexMethod*, IRInstruction* insn) {
+    if (insn->has_method()) {
+      callees.push_back(insn->get_method());
+    }
+  });
+  std::unordered_map<std::string, int> labels;
+  for (size_t i = 0; i < callees.size(); i += 4) {
+    labels.emplace(callees[i]->get_class()->str() + callees[i]->str(), 1);
+  }
+  for (const auto* cls : scope) {
+    if (cls->get_name()->str().rfind("Ljava/util/", 0) == 0) {
+      labels.emplace(cls->get_name()->str() + "*", 2);
+    }
+  }
+
+  auto by_name_start = Clock::now();
+  size_t by_name_hits = 0;
+  for (const auto* callee : callees) {
+    std::string method_name(callee->get_class()->c_str());
+    method_name.append(callee->c_str());
+    std::string class_name(callee->get_class()->c_str());
+    class_name.append("*");
+    if (labels.count(method_name) || labels.count(class_name)) {
+      ++by_name_hits;
+    }
+  }
+  auto by_name_end = Clock::now();
+
+  CalleeLabels<int> callee_labels;
+  auto resolve_start = Clock::now();
+  callee_labels.resolve(scope, labels);
+  auto resolve_end = Clock::now();
+  size_t resolved_hits = 0;
+  for (const auto* callee : callees) {
+    if (callee_labels.get(callee)) {
+      ++resolved_hits;
+    }
+  }
+  auto lookup_end = Clock::now();
+
+  printf("%zu classes, %zu invokes, %zu labels\n", scope.size(),
+         callees.size(), labels.size());
+  printf("by name: %lld us\n", microseconds(by_name_start, by_name_end));
+  printf("resolved: %lld us to resolve, %lld us to look up\n",
+         microseconds(resolve_start, resolve_end),
+         microseconds(resolve_end, lookup_end));
+  delete g_redex;
+  if (by_name_hits != resolved_hits) {
+    fprintf(stderr, "%zu callees are labeled by name but %zu resolved\n",
+            by_name_hits, resolved_hits);
+    return EXIT_FAILURE;
+  }
+  printf("Done!\n");
+  return 0;
+}
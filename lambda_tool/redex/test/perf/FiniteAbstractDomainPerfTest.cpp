@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "FiniteAbstractDomain.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+//==========
+// Test for performance
+//==========
+
+// The shape of the exception lattice of the UDF analyses (exp_lattice).
+enum Elements { BOTTOM, UNVISIT, FROM_EX, NO_EX, TOP };
+
+using BitVectorLatticeType = sparta::BitVectorLattice<Elements, 5, std::hash<int>>;
+BitVectorLatticeType bit_vector_lattice({BOTTOM, UNVISIT, FROM_EX, NO_EX, TOP},
+                                        {{BOTTOM, UNVISIT},
+                                         {UNVISIT, FROM_EX},
+                                         {UNVISIT, NO_EX},
+                                         {NO_EX, TOP},
+                                         {FROM_EX, TOP}});
+using BitVectorDomain =
+    sparta::FiniteAbstractDomain<Elements,
+                                 BitVectorLatticeType,
+                                 BitVectorLatticeType::Encoding,
+                                 &bit_vector_lattice>;
+
+using ConstexprLatticeType = sparta::ConstexprLattice<Elements, 5>;
+constexpr ConstexprLatticeType constexpr_lattice(
+    {BOTTOM, UNVISIT, FROM_EX, NO_EX, TOP},
+    {{BOTTOM, UNVISIT},
+     {UNVISIT, FROM_EX},
+     {UNVISIT, NO_EX},
+     {NO_EX, TOP},
+     {FROM_EX, TOP}});
+using ConstexprDomain = sparta::ConstexprFiniteAbstractDomain<Elements,
+                                                              ConstexprLatticeType,
+                                                              &constexpr_lattice>;
+
+constexpr size_t kNumOperands = 1 << 12;
+constexpr size_t kNumRounds = 200;
+
+// Runs join, meet, leq and element() on all the consecutive pairs of
+// `elements` and returns the duration in microseconds.
+template <typename Domain>
+double time_operations(const std::vector<Elements>& elements, size_t* checksum) {
+  std::vector<Domain> operands;
+  operands.reserve(elements.size());
+  for (auto element : elements) {
+    operands.emplace_back(element);
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t round = 0; round < kNumRounds; ++round) {
+    for (size_t i = 0; i + 1 < operands.size(); ++i) {
+      const auto& x = operands[i];
+      const auto& y = operands[i + 1];
+      *checksum += x.join(y).element();
+      *checksum += x.meet(y).element();
+      *checksum += x.leq(y);
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+      .count();
+}
+
+void compareLatticeOperations() {
+  std::mt19937 generator(0);
+  std::uniform_int_distribution<int> distribution(BOTTOM, TOP);
+  std::vector<Elements> elements;
+  elements.reserve(kNumOperands);
+  for (size_t i = 0; i < kNumOperands; ++i) {
+    elements.push_back(static_cast<Elements>(distribution(generator)));
+  }
+
+  size_t bit_vector_checksum = 0;
+  size_t constexpr_checksum = 0;
+  double bit_vector_time =
+      time_operations<BitVectorDomain>(elements, &bit_vector_checksum);
+  double constexpr_time =
+      time_operations<ConstexprDomain>(elements, &constexpr_checksum);
+  printf("BitVectorLattice: %.0f us\n", bit_vector_time);
+  printf("ConstexprLattice: %.0f us\n", constexpr_time);
+  printf("speedup: %f\n", bit_vector_time / constexpr_time);
+  if (bit_vector_checksum != constexpr_checksum) {
+    printf("ERROR: the lattices disagree (%zu != %zu)\n", bit_vector_checksum,
+           constexpr_checksum);
+  }
+}
+
+int main() {
+  printf("Begin!\n");
+  compareLatticeOperations();
+  printf("Done!\n");
+  return 0;
+}
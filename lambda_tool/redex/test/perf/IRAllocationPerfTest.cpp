@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DexClass.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "RedexContext.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <sys/resource.h>
+#include <vector>
+
+//==========
+// Test for performance
+//==========
+
+// Builds method bodies and clones them over and over, as balloon, inlining and
+// outlining do, and reports the calls to the global allocator and the peak
+// RSS. In a build with SPARTA_SLAB_ALLOCATOR, IRInstructions, their
+// out-of-line sources and MethodItemEntries come from slabs, so only the slabs
+// and the other objects (e.g. the IRLists) reach the global allocator.
+
+namespace {
+
+std::atomic<size_t> num_global_allocations{0};
+
+} // namespace
+
+void* operator new(size_t size) {
+  num_global_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+constexpr size_t kNumMethods = 20000;
+constexpr size_t kNumInstructions = 60;
+constexpr size_t kNumRounds = 5;
+
+std::unique_ptr<IRCode> make_code(DexMethodRef* callee) {
+  auto code = std::make_unique<IRCode>();
+  code->set_registers_size(8);
+  for (size_t i = 0; i < kNumInstructions / 3; ++i) {
+    code->push_back((new IRInstruction(OPCODE_CONST))
+                        ->set_dest(i % 8)
+                        ->set_literal(i));
+    code->push_back((new IRInstruction(OPCODE_ADD_INT))
+                        ->set_dest(0)
+                        ->set_src(0, i % 8)
+                        ->set_src(1, 1));
+    // Four sources, hence out of line.
+    code->push_back((new IRInstruction(OPCODE_INVOKE_STATIC))
+                        ->set_method(callee)
+                        ->set_srcs_size(4)
+                        ->set_src(0, 0)
+                        ->set_src(1, 1)
+                        ->set_src(2, 2)
+                        ->set_src(3, i % 8));
+  }
+  code->push_back(new IRInstruction(OPCODE_RETURN_VOID));
+  return code;
+}
+
+long peak_rss_kb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+int main() {
+  g_redex = new RedexContext();
+  auto* callee = DexMethod::make_method("LFoo;.bar:(IIII)V");
+
+  printf("Begin!\n");
+  size_t allocations_before = num_global_allocations.load();
+  auto start = std::chrono::high_resolution_clock::now();
+  std::vector<std::unique_ptr<IRCode>> codes;
+  codes.reserve(kNumMethods);
+  for (size_t i = 0; i < kNumMethods; ++i) {
+    codes.push_back(make_code(callee));
+  }
+  for (size_t round = 0; round < kNumRounds; ++round) {
+    for (auto& code : codes) {
+      code = std::make_unique<IRCode>(*code);
+    }
+  }
+  codes.clear();
+  auto end = std::chrono::high_resolution_clock::now();
+  size_t allocations = num_global_allocations.load() - allocations_before;
+
+  printf("%zu methods, %zu rounds: %lld ms, %zu global allocations, "
+         "%ld KB peak RSS\n",
+         kNumMethods, kNumRounds,
+         static_cast<long long>(
+             std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+                 .count()),
+         allocations, peak_rss_kb());
+
+  delete g_redex;
+  printf("Done!\n");
+  return 0;
+}
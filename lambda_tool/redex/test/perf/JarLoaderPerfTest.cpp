@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DexClass.h"
+#include "JarLoader.h"
+#include "RedexContext.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+//==========
+// Test for performance
+//==========
+
+// Loads a large jar, e.g. the rt.jar of a JDK 8, with the entries parsed on
+// the calling thread and in parallel. An attribute hook, even a no-op, makes
+// the loader parse the entries in order on the calling thread.
+//
+//   jar_loader_perf_test [<jar>]
+//
+// The jar defaults to $JAVA_HOME/jre/lib/rt.jar.
+
+struct Run {
+  long long milliseconds;
+  std::vector<std::string> classes;
+};
+
+Run load(const std::string& jar, bool sequential) {
+  g_redex = new RedexContext();
+  attribute_hook_t hook = nullptr;
+  if (sequential) {
+    hook = [](boost::variant<DexField*, DexMethod*>, const char*, uint8_t*) {};
+  }
+  Scope classes;
+  auto start = std::chrono::high_resolution_clock::now();
+  bool loaded = load_jar_file(jar.c_str(), &classes, hook);
+  auto end = std::chrono::high_resolution_clock::now();
+  if (!loaded) {
+    fprintf(stderr, "Cannot load %s\n", jar.c_str());
+    exit(EXIT_FAILURE);
+  }
+  Run run;
+  run.milliseconds =
+      std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+          .count();
+  for (const auto* cls : classes) {
+    run.classes.push_back(cls->get_name()->str());
+  }
+  delete g_redex;
+  g_redex = nullptr;
+  return run;
+}
+
+int main(int argc, char* argv[]) {
+  std::string jar;
+  if (argc > 1) {
+    jar = argv[1];
+  } else if (const char* java_home = getenv("JAVA_HOME")) {
+    jar = std::string(java_home) + "/jre/lib/rt.jar";
+  } else {
+    fprintf(stderr, "usage: %s <jar>, or set JAVA_HOME\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  printf("Begin!\n");
+  auto sequential = load(jar, /* sequential */ true);
+  auto parallel = load(jar, /* sequential */ false);
+  printf("%zu classes: %lld ms sequential, %lld ms parallel\n",
+         sequential.classes.size(), sequential.milliseconds,
+         parallel.milliseconds);
+  if (sequential.classes != parallel.classes) {
+    fprintf(stderr, "The classes are not loaded in the same order\n");
+    return EXIT_FAILURE;
+  }
+  printf("Done!\n");
+  return 0;
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Analyzer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "FiniteAbstractDomain.h"
+#include "HashedSetAbstractDomain.h"
+#include "MonotonicFixpointIterator.h"
+#include "WorkQueue.h"
+
+/*
+ * Measures the speedup of ParallelInterproceduralAnalyzer over the serial
+ * InterproceduralAnalyzer on a synthetic layered call graph, analyzed bottom-up
+ * like the determinism, null-input and parallel-safety analyses. It also checks
+ * that both modes compute identical summaries.
+ */
+
+namespace {
+
+struct Function {
+  uint32_t id;
+  bool impure;
+  std::vector<Function*> callees;
+};
+
+struct CallGraph {
+  using NodeId = Function*;
+  using Edge = std::pair<NodeId, NodeId>;
+  using EdgeId = std::shared_ptr<Edge>;
+
+  NodeId entry;
+  NodeId exit;
+  std::unordered_map<NodeId, std::vector<EdgeId>> successors;
+  std::unordered_map<NodeId, std::vector<EdgeId>> predecessors;
+
+  void add_edge(NodeId src, NodeId dst) {
+    auto edge = std::make_shared<Edge>(src, dst);
+    successors[src].push_back(edge);
+    predecessors[dst].push_back(edge);
+  }
+};
+
+struct CallGraphInterface {
+  using Graph = CallGraph;
+  using NodeId = Graph::NodeId;
+  using EdgeId = Graph::EdgeId;
+
+  static NodeId entry(const Graph& graph) { return graph.entry; }
+  static NodeId exit(const Graph& graph) { return graph.exit; }
+  static std::vector<EdgeId> predecessors(const Graph& graph,
+                                          const NodeId& node) {
+    auto it = graph.predecessors.find(node);
+    return it == graph.predecessors.end() ? std::vector<EdgeId>()
+                                          : it->second;
+  }
+  static std::vector<EdgeId> successors(const Graph& graph,
+                                        const NodeId& node) {
+    auto it = graph.successors.find(node);
+    return it == graph.successors.end() ? std::vector<EdgeId>() : it->second;
+  }
+  static NodeId source(const Graph&, const EdgeId& e) { return e->first; }
+  static NodeId target(const Graph&, const EdgeId& e) { return e->second; }
+};
+
+/*
+ *  entry -> layer 0 -> layer 1 -> ... -> layer N-1 -> exit
+ *
+ * Every function of a layer calls a few functions of the next layer. The
+ * entry and exit nodes are ghost functions, as in call_graph::Graph.
+ */
+struct Program {
+  std::vector<std::unique_ptr<Function>> functions;
+  Function entry{0, false, {}};
+  Function exit{1, false, {}};
+  CallGraph graph;
+
+  Program(uint32_t num_layers, uint32_t width, uint32_t fanout) {
+    std::vector<std::vector<Function*>> layers(num_layers);
+    uint32_t id = 2;
+    for (uint32_t l = 0; l < num_layers; ++l) {
+      for (uint32_t i = 0; i < width; ++i) {
+        functions.emplace_back(new Function{id, id % 97 == 0, {}});
+        layers[l].push_back(functions.back().get());
+        ++id;
+      }
+    }
+    graph.entry = &entry;
+    graph.exit = &exit;
+    for (auto* f : layers[0]) {
+      graph.add_edge(&entry, f);
+    }
+    for (uint32_t l = 0; l + 1 < num_layers; ++l) {
+      for (uint32_t i = 0; i < width; ++i) {
+        auto* caller = layers[l][i];
+        for (uint32_t k = 0; k < fanout; ++k) {
+          auto* callee = layers[l + 1][(i * 7 + k * 13) % width];
+          caller->callees.push_back(callee);
+          graph.add_edge(caller, callee);
+        }
+      }
+    }
+    for (auto* f : layers[num_layers - 1]) {
+      graph.add_edge(f, &exit);
+    }
+  }
+};
+
+enum Elements { BOTTOM, PURE, IMPURE, TOP };
+using Lattice = sparta::BitVectorLattice<Elements, 4, std::hash<int>>;
+Lattice lattice({BOTTOM, PURE, IMPURE, TOP},
+                {{BOTTOM, PURE}, {BOTTOM, IMPURE}, {PURE, TOP}, {IMPURE, TOP}});
+using PurityDomain = sparta::
+    FiniteAbstractDomain<Elements, Lattice, Lattice::Encoding, &lattice>;
+
+class Registry : public sparta::AbstractRegistry {
+ public:
+  bool has_update() const override { return m_has_update; }
+  void materialize_update() override { m_has_update = false; }
+
+  PurityDomain get(const Function* f) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_map.find(f);
+    return it == m_map.end() ? PurityDomain::top() : it->second;
+  }
+
+  void maybe_update(const Function* f, const PurityDomain& summary) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_map.find(f);
+    if (it == m_map.end() || it->second != summary) {
+      m_map[f] = summary;
+      m_has_update = true;
+    }
+  }
+
+  std::unordered_map<const Function*, PurityDomain> map() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_map;
+  }
+
+ private:
+  mutable std::mutex m_mutex;
+  std::unordered_map<const Function*, PurityDomain> m_map;
+  std::atomic<bool> m_has_update{false};
+};
+
+struct Callsite {
+  using Domain = sparta::HashedSetAbstractDomain<const Function*>;
+
+  Domain analyze_edge(const CallGraph::EdgeId&, const Domain& domain) {
+    return domain;
+  }
+};
+
+template <typename Base>
+class FunctionAnalyzer : public Base {
+ public:
+  explicit FunctionAnalyzer(Function* f) : m_function(f) {}
+
+  void analyze() override {
+    if (m_function->id < 2) {
+      return;
+    }
+    // Stand-in for the intraprocedural fixpoint of a real method.
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    m_domain = PurityDomain(m_function->impure ? IMPURE : PURE);
+    for (auto* callee : m_function->callees) {
+      m_domain.join_with(this->get_summaries()->get(callee));
+    }
+  }
+
+  void summarize() override {
+    if (m_function->id < 2) {
+      return;
+    }
+    this->get_summaries()->maybe_update(m_function, m_domain);
+  }
+
+ private:
+  Function* m_function;
+  PurityDomain m_domain;
+};
+
+struct PurityAnalysisAdaptor {
+  using Function = ::Function*;
+  using Program = ::Program*;
+  using CallGraphInterface =
+      sparta::BackwardsFixpointIterationAdaptor<::CallGraphInterface>;
+  using Registry = ::Registry;
+  using Callsite = ::Callsite;
+
+  template <typename GraphInterface, typename Domain>
+  using FixpointIteratorBase =
+      sparta::MonotonicFixpointIterator<GraphInterface, Domain>;
+
+  template <typename IntraproceduralBase>
+  using FunctionAnalyzer = ::FunctionAnalyzer<IntraproceduralBase>;
+
+  static const CallGraph& call_graph_of(::Program* program, Registry*) {
+    return program->graph;
+  }
+
+  static ::Function* function_by_node_id(const CallGraph::NodeId& node) {
+    return node;
+  }
+};
+
+using SerialAnalysis = sparta::InterproceduralAnalyzer<PurityAnalysisAdaptor>;
+using ParallelAnalysis =
+    sparta::ParallelInterproceduralAnalyzer<PurityAnalysisAdaptor>;
+
+template <typename Analysis, typename... Args>
+double run_analysis(Program* program,
+                    std::unordered_map<const Function*, PurityDomain>* result,
+                    Args... args) {
+  Analysis analysis(program, 10, nullptr, args...);
+  auto start = std::chrono::high_resolution_clock::now();
+  analysis.run();
+  auto end = std::chrono::high_resolution_clock::now();
+  *result = analysis.registry.map();
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+      .count();
+}
+
+} // namespace
+
+int main() {
+  Program program(/* num_layers */ 50, /* width */ 40, /* fanout */ 3);
+  printf("functions: %zu\n", program.functions.size());
+
+  std::unordered_map<const Function*, PurityDomain> serial_result;
+  double serial = run_analysis<SerialAnalysis>(&program, &serial_result);
+  printf("serial %lf us\n", serial);
+
+  printf("threads speedup identical\n");
+  for (uint32_t i = 1; i <= redex_parallel::default_num_threads(); ++i) {
+    std::unordered_map<const Function*, PurityDomain> parallel_result;
+    double parallel =
+        run_analysis<ParallelAnalysis>(&program, &parallel_result, i);
+    printf("%u %lf %s\n", i, serial / parallel,
+           parallel_result == serial_result ? "yes" : "NO");
+  }
+}
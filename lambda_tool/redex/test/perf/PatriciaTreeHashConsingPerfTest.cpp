@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "PatriciaTreeMap.h"
+
+#include <chrono>
+#include <cstdio>
+#include <malloc.h>
+#include <random>
+#include <vector>
+
+//==========
+// Test for performance
+//==========
+
+// Register environments of a fixpoint iteration, with and without hash-consed
+// nodes: every block state is its predecessor's state with a few registers
+// updated, joined with the state of another block.
+
+template <int tag>
+struct Constant {
+  uint32_t value = 0;
+
+  bool operator==(const Constant& other) const { return value == other.value; }
+};
+
+using PlainConstant = Constant<0>;
+using HashConsedConstant = Constant<1>;
+
+template <>
+struct sparta::PatriciaTreeHashConsing<HashConsedConstant> : std::true_type {
+  static size_t hash(const HashConsedConstant& x) { return x.value; }
+};
+
+constexpr size_t kNumMethods = 2000;
+constexpr size_t kNumBlocks = 50;
+constexpr uint32_t kNumRegisters = 32;
+
+size_t allocated_bytes() { return mallinfo2().uordblks; }
+
+template <typename Value>
+void run(const char* name) {
+  using Environment = sparta::PatriciaTreeMap<uint32_t, Value>;
+  auto join = [](const Value& x, const Value& y) {
+    return x.value == y.value ? x : Value{0};
+  };
+  std::mt19937 generator(0);
+  std::uniform_int_distribution<uint32_t> registers(0, kNumRegisters - 1);
+  // Few distinct constants, as in real code.
+  std::uniform_int_distribution<uint32_t> constants(1, 4);
+
+  size_t memory_before = allocated_bytes();
+  auto start = std::chrono::high_resolution_clock::now();
+  std::vector<Environment> states;
+  states.reserve(kNumMethods * kNumBlocks);
+  size_t num_equal = 0;
+  for (size_t method = 0; method < kNumMethods; ++method) {
+    Environment entry;
+    for (uint32_t reg = 0; reg < kNumRegisters; ++reg) {
+      entry.insert_or_assign(reg, Value{reg % 4 + 1});
+    }
+    states.push_back(entry);
+    for (size_t block = 1; block < kNumBlocks; ++block) {
+      Environment state = states.back();
+      for (size_t i = 0; i < 3; ++i) {
+        state.insert_or_assign(registers(generator),
+                               Value{constants(generator)});
+      }
+      state.union_with(join, states[states.size() - 1 - block / 2]);
+      num_equal += state.equals(states.back());
+      states.push_back(state);
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  size_t memory_after = allocated_bytes();
+
+  printf("%s: %lld ms, %zu KB, %zu unchanged states\n", name,
+         static_cast<long long>(
+             std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+                 .count()),
+         (memory_after - memory_before) / 1024, num_equal);
+}
+
+int main() {
+  printf("Begin!\n");
+  run<PlainConstant>("plain nodes");
+  run<HashConsedConstant>("hash-consed nodes");
+  printf("Done!\n");
+  return 0;
+}
@@ -7,9 +7,12 @@
 
 #include "WorkQueue.h"
 
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <random>
 #include <thread>
+#include <vector>
 
 //==========
 // Test for performance
@@ -73,9 +76,54 @@ void smallLengthTasks() {
   printf("speedup small length tasks: %f\n", speedup);
 }
 
+// Each task spins briefly and pushes two smaller tasks, as the parallel
+// fixpoint iterator pushes one task per node, so that scheduling dominates.
+// Prints the throughput for 1 to 64 threads.
+void fineGrainedTasksScaling() {
+  constexpr int depth = 20;
+  printf("fine-grained tasks: threads, tasks/ms, speedup\n");
+  double single_throughput = 0;
+  for (unsigned int num_threads = 1; num_threads <= 64; num_threads *= 2) {
+    // One counter per cache line.
+    std::vector<std::array<size_t, 8>> num_tasks(num_threads);
+    auto wq = workqueue_foreach<int>(
+        [&](sparta::SpartaWorkerState<int>* state, int d) {
+          ++num_tasks[state->worker_id()][0];
+          for (volatile int i = 0; i < 64; ++i) {
+          }
+          if (d > 0) {
+            state->push_task(d - 1);
+            state->push_task(d - 1);
+          }
+        },
+        num_threads,
+        /*push_tasks_while_running=*/true);
+    wq.add_item(depth);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    wq.run_all();
+    auto end = std::chrono::high_resolution_clock::now();
+
+    size_t total = 0;
+    for (const auto& n : num_tasks) {
+      total += n[0];
+    }
+    double duration =
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+            .count();
+    double throughput = total / (duration / 1000);
+    if (num_threads == 1) {
+      single_throughput = throughput;
+    }
+    printf("%u %.0f %f\n", num_threads, throughput,
+           throughput / single_throughput);
+  }
+}
+
 int main() {
   printf("Begin!\n");
   profileBusyLoop();
   variableLengthTasks();
   smallLengthTasks();
+  fineGrainedTasksScaling();
 }
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AnalysisOutput.h"
+
+#include <fstream>
+#include <gtest/gtest.h>
+#include <json/reader.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Creators.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+#include "Show.h"
+
+using namespace analysis_output;
+
+struct AnalysisOutputTest : public RedexTest {
+ protected:
+  void SetUp() override {
+    m_tmp_dir = std::make_unique<redex::TempDir>(
+        redex::make_tmp_dir("AnalysisOutputTest%%%%%%%%"));
+    setenv("ANALYSIS_OUTPUT", m_tmp_dir->path.c_str(), 1);
+    unsetenv("current_date_time");
+    m_foo = assembler::method_from_string(R"(
+      (method (public static) "Lcom/A;.foo:()V"
+       ((return-void))
+      )
+    )");
+    m_bar = assembler::method_from_string(R"(
+      (method (public static) "Lcom/B;.bar:()V"
+       ((return-void))
+      )
+    )");
+  }
+
+  void TearDown() override { unsetenv("ANALYSIS_OUTPUT"); }
+
+  void write(Format format) {
+    auto writer = ResultWriter::open("AnalysisOutputTest", "test", format);
+    ASSERT_NE(writer, nullptr);
+    for (auto* method : {m_foo, m_bar}) {
+      Json::Value record;
+      record["name"] = show(method);
+      writer->add(method, std::move(record));
+    }
+    EXPECT_TRUE(writer->finish());
+  }
+
+  static Json::Value parse(const std::string& text) {
+    Json::Value value;
+    Json::CharReaderBuilder builder;
+    std::istringstream in(text);
+    std::string errors;
+    EXPECT_TRUE(Json::parseFromStream(builder, in, &value, &errors)) << errors;
+    return value;
+  }
+
+  std::unique_ptr<redex::TempDir> m_tmp_dir;
+  DexMethod* m_foo;
+  DexMethod* m_bar;
+};
+
+TEST_F(AnalysisOutputTest, jsonLinesWritesOneRecordPerLine) {
+  write(Format::JSON_LINES);
+
+  std::ifstream in(m_tmp_dir->path + "/test.jsonl");
+  ASSERT_TRUE(in);
+  std::vector<Json::Value> records;
+  std::string line;
+  while (std::getline(in, line)) {
+    records.push_back(parse(line));
+  }
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_EQ(records[0]["name"].asString(), show(m_foo));
+  EXPECT_EQ(records[0]["class"].asString(), "A");
+  EXPECT_EQ(records[1]["name"].asString(), show(m_bar));
+  EXPECT_EQ(records[1]["class"].asString(), "B");
+}
+
+TEST_F(AnalysisOutputTest, perClassJsonWritesOneFilePerClass) {
+  write(Format::PER_CLASS_JSON);
+
+  for (const auto& class_name : {"A", "B"}) {
+    std::ifstream in(m_tmp_dir->path + "/" + class_name + "_test.json");
+    ASSERT_TRUE(in) << class_name;
+    std::string text((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    auto records = parse(text);
+    ASSERT_TRUE(records.isArray());
+    EXPECT_EQ(records.size(), 1);
+  }
+}
+
+TEST_F(AnalysisOutputTest, recordsAreSortedByName) {
+  auto* baz = assembler::method_from_string(R"(
+    (method (public static) "Lcom/A;.baz:()V"
+     ((return-void))
+    )
+  )");
+  for (auto format : {Format::JSON_LINES, Format::PER_CLASS_JSON}) {
+    auto writer = ResultWriter::open("AnalysisOutputTest", "test", format);
+    ASSERT_NE(writer, nullptr);
+    // Added concurrently and out of order.
+    std::vector<std::thread> threads;
+    for (auto* method : {m_bar, m_foo, baz}) {
+      threads.emplace_back([&writer, method] {
+        Json::Value record;
+        record["name"] = show(method);
+        writer->add(method, std::move(record));
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    EXPECT_TRUE(writer->finish());
+  }
+
+  std::ifstream lines(m_tmp_dir->path + "/test.jsonl");
+  std::vector<std::string> names;
+  std::string line;
+  while (std::getline(lines, line)) {
+    names.push_back(parse(line)["name"].asString());
+  }
+  EXPECT_EQ(names,
+            (std::vector<std::string>{show(baz), show(m_foo), show(m_bar)}));
+
+  std::ifstream in(m_tmp_dir->path + "/A_test.json");
+  std::string text((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  auto records = parse(text);
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_EQ(records[0]["name"].asString(), show(baz));
+  EXPECT_EQ(records[1]["name"].asString(), show(m_foo));
+}
+
+// The lines are copied through a buffer of 64 KB when they are sorted.
+TEST_F(AnalysisOutputTest, longLinesAreSorted) {
+  std::string padding(200 * 1024, 'x');
+  {
+    auto writer =
+        ResultWriter::open("AnalysisOutputTest", "test", Format::JSON_LINES);
+    ASSERT_NE(writer, nullptr);
+    for (auto* method : {m_bar, m_foo}) {
+      Json::Value record;
+      record["name"] = show(method);
+      record["padding"] = padding;
+      writer->add(method, std::move(record));
+    }
+    EXPECT_TRUE(writer->finish());
+  }
+
+  std::ifstream in(m_tmp_dir->path + "/test.jsonl");
+  std::vector<Json::Value> records;
+  std::string line;
+  while (std::getline(in, line)) {
+    records.push_back(parse(line));
+  }
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_EQ(records[0]["name"].asString(), show(m_foo));
+  EXPECT_EQ(records[1]["name"].asString(), show(m_bar));
+  EXPECT_EQ(records[1]["padding"].asString(), padding);
+}
+
+TEST_F(AnalysisOutputTest, dateTimeSubdirectory) {
+  setenv("current_date_time", "today", 1);
+  auto directory = result_directory();
+  ASSERT_TRUE(directory);
+  EXPECT_EQ(*directory, m_tmp_dir->path + "/today");
+
+  setenv("current_date_time", "", 1);
+  EXPECT_EQ(*result_directory(), m_tmp_dir->path);
+  unsetenv("current_date_time");
+}
+
+TEST_F(AnalysisOutputTest, noOutputDirectory) {
+  unsetenv("ANALYSIS_OUTPUT");
+  EXPECT_FALSE(result_directory());
+  EXPECT_EQ(ResultWriter::open("AnalysisOutputTest", "test", Format::JSON_LINES),
+            nullptr);
+}
+
+TEST_F(AnalysisOutputTest, readResultsOfRequestedMethods) {
+  write(Format::JSON_LINES);
+  auto all = read_results(m_tmp_dir->path, {});
+  ASSERT_TRUE(all["test"].isArray());
+  EXPECT_EQ(all["test"].size(), 2);
+
+  auto results = read_results(m_tmp_dir->path, {show(m_bar), "Lcom/C;.c:()V"});
+  ASSERT_EQ(results["test"].size(), 1);
+  EXPECT_EQ(results["test"][0]["name"].asString(), show(m_bar));
+
+  auto none = read_results(m_tmp_dir->path, {"Lcom/C;.c:()V"});
+  ASSERT_TRUE(none["test"].isArray());
+  EXPECT_EQ(none["test"].size(), 0);
+}
+
+TEST_F(AnalysisOutputTest, readResultsPerClassJson) {
+  write(Format::PER_CLASS_JSON);
+  auto results = read_results(m_tmp_dir->path, {show(m_foo)});
+  EXPECT_EQ(results.getMemberNames(), std::vector<std::string>{"test"});
+  ASSERT_EQ(results["test"].size(), 1);
+  EXPECT_EQ(results["test"][0]["name"].asString(), show(m_foo));
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AnalysisTelemetry.h"
+
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "Creators.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+
+using namespace analysis_telemetry;
+
+struct AnalysisTelemetryTest : public RedexTest {
+ protected:
+  void SetUp() override {
+    ClassCreator creator(DexType::make_type("LA;"));
+    creator.set_super(type::java_lang_Object());
+    m_foo = assembler::method_from_string(R"(
+      (method (public static) "LA;.foo:()V"
+       ((return-void))
+      )
+    )");
+    m_bar = assembler::method_from_string(R"(
+      (method (public static) "LA;.bar:()V"
+       ((return-void))
+      )
+    )");
+    creator.add_method(m_foo);
+    creator.add_method(m_bar);
+    creator.create();
+  }
+
+  static MethodTelemetry::Record make_record(const DexMethod* method,
+                                             uint32_t iteration,
+                                             uint64_t microseconds,
+                                             uint32_t num_blocks,
+                                             bool summary_changed) {
+    return MethodTelemetry::Record{method,
+                                   iteration,
+                                   microseconds,
+                                   {num_blocks, /* num_iterations */ 1},
+                                   summary_changed};
+  }
+
+  DexMethod* m_foo;
+  DexMethod* m_bar;
+};
+
+TEST_F(AnalysisTelemetryTest, topMethods) {
+  MethodTelemetry telemetry;
+  telemetry.record(make_record(m_foo, 0, 10, 3, true));
+  telemetry.record(make_record(m_bar, 0, 25, 1, true));
+  telemetry.record(make_record(m_foo, 1, 20, 3, false));
+  EXPECT_EQ(telemetry.size(), 3);
+
+  auto top = telemetry.top_methods(10);
+  ASSERT_EQ(top.size(), 2);
+  EXPECT_EQ(top[0].method, m_foo);
+  EXPECT_EQ(top[0].num_analyses, 2);
+  EXPECT_EQ(top[0].microseconds, 30);
+  EXPECT_EQ(top[0].num_blocks, 3);
+  EXPECT_EQ(top[0].num_iterations, 2);
+  EXPECT_EQ(top[0].num_summary_changes, 1);
+  EXPECT_EQ(top[1].method, m_bar);
+
+  top = telemetry.top_methods(1);
+  ASSERT_EQ(top.size(), 1);
+  EXPECT_EQ(top[0].method, m_foo);
+}
+
+TEST_F(AnalysisTelemetryTest, writeCsv) {
+  auto tmp_dir = redex::make_tmp_dir("AnalysisTelemetryTest%%%%%%%%");
+  auto path = tmp_dir.path + "/telemetry.csv";
+  MethodTelemetry telemetry;
+  telemetry.record(make_record(m_foo, 0, 10, 3, true));
+  telemetry.record(make_record(m_bar, 1, 25, 1, false));
+  ASSERT_TRUE(telemetry.write_csv(path));
+
+  std::ifstream in(path);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  EXPECT_EQ(contents.str(),
+            "method,iteration,microseconds,blocks,fixpoint_iterations,"
+            "summary_changed\n"
+            "\"LA;.foo:()V\",0,10,3,1,1\n"
+            "\"LA;.bar:()V\",1,25,1,1,0\n");
+
+  EXPECT_FALSE(telemetry.write_csv(tmp_dir.path + "/missing/telemetry.csv"));
+}
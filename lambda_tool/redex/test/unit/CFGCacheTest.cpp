@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CFGCache.h"
+
+#include <gtest/gtest.h>
+
+#include "ControlFlow.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+class CFGCacheTest : public RedexTest {
+ protected:
+  std::unique_ptr<IRCode> make_code() {
+    return assembler::ircode_from_string(R"(
+      (
+        (load-param v0)
+        (if-eqz v0 :done)
+        (const v0 1)
+        (:done)
+        (return v0)
+      )
+    )");
+  }
+};
+
+TEST_F(CFGCacheTest, borrowedTwice) {
+  auto& cache = cfg::CFGCache::instance();
+  auto code = make_code();
+  auto before = cache.stats();
+  const auto& cfg = cache.borrow(code.get());
+  EXPECT_FALSE(cfg.editable());
+  EXPECT_NE(cfg.exit_block(), nullptr);
+  EXPECT_EQ(&cache.borrow(code.get()), &cfg);
+
+  auto after = cache.stats();
+  EXPECT_EQ(after.misses - before.misses, 1);
+  EXPECT_EQ(after.hits - before.hits, 1);
+}
+
+TEST_F(CFGCacheTest, rebuiltAfterChange) {
+  auto& cache = cfg::CFGCache::instance();
+  auto code = make_code();
+  cache.borrow(code.get());
+
+  code->build_cfg(/* editable */ true);
+  code->clear_cfg();
+  auto before = cache.stats();
+  const auto& cfg = cache.borrow(code.get());
+  EXPECT_FALSE(cfg.editable());
+  EXPECT_EQ(cache.stats().misses - before.misses, 1);
+
+  cache.invalidate();
+  before = cache.stats();
+  cache.borrow(code.get());
+  EXPECT_EQ(cache.stats().misses - before.misses, 1);
+  EXPECT_EQ(cache.stats().hits, before.hits);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CalleeLabels.h"
+
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "DeterminismAnalysisIntra.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+using namespace determinism;
+
+struct CalleeLabelsTest : public RedexTest {
+ protected:
+  // LA;.foo calls the two overloads of LB;.random and LC;.now.
+  Scope make_scope() {
+    ClassCreator creator(DexType::make_type("LA;"));
+    creator.set_super(type::java_lang_Object());
+    creator.add_method(assembler::method_from_string(R"(
+      (method (public static) "LA;.foo:()V"
+       (
+        (invoke-static () "LB;.random:()I")
+        (const v0 1)
+        (invoke-static (v0) "LB;.random:(I)I")
+        (invoke-static () "LC;.now:()J")
+        (return-void)
+       )
+      )
+    )"));
+    return Scope{creator.create()};
+  }
+};
+
+TEST_F(CalleeLabelsTest, methodLabelCoversOverloads) {
+  auto scope = make_scope();
+  CalleeLabels<DeterminismDomain> labels;
+  labels.resolve(scope,
+                 {{"LB;random", DeterminismDomain(DeterminismType::NOT_DET)},
+                  {"LD;random", DeterminismDomain(DeterminismType::IS_DET)}});
+
+  EXPECT_EQ(labels.num_methods(), 2);
+  for (const auto* name : {"LB;.random:()I", "LB;.random:(I)I"}) {
+    auto label = labels.get(DexMethod::get_method(name));
+    ASSERT_TRUE(label) << name;
+    EXPECT_EQ(label->element(), DeterminismType::NOT_DET);
+  }
+  EXPECT_FALSE(labels.get(DexMethod::get_method("LC;.now:()J")));
+}
+
+TEST_F(CalleeLabelsTest, methodLabelOverridesClassLabel) {
+  auto scope = make_scope();
+  CalleeLabels<DeterminismDomain> labels;
+  labels.resolve(scope,
+                 {{"LB;*", DeterminismDomain(DeterminismType::IS_DET)},
+                  {"LC;*", DeterminismDomain(DeterminismType::NOT_DET)},
+                  {"LB;random", DeterminismDomain(DeterminismType::NOT_DET)},
+                  {"LD;*", DeterminismDomain(DeterminismType::IS_DET)}});
+
+  EXPECT_EQ(labels.num_classes(), 2);
+  auto random = labels.get(DexMethod::get_method("LB;.random:()I"));
+  ASSERT_TRUE(random);
+  EXPECT_EQ(random->element(), DeterminismType::NOT_DET);
+  auto now = labels.get(DexMethod::get_method("LC;.now:()J"));
+  ASSERT_TRUE(now);
+  EXPECT_EQ(now->element(), DeterminismType::NOT_DET);
+}
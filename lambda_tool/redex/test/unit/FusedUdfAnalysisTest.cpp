@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "FusedUdfAnalysis.h"
+
+#include <gtest/gtest.h>
+#include <json/value.h>
+#include <stdlib.h>
+
+#include "Creators.h"
+#include "IRAssembler.h"
+#include "JsonWrapper.h"
+#include "NullInputAnalysis.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+
+using namespace fused_udf;
+
+struct FusedUdfAnalysisTest : public RedexTest {
+ protected:
+  void SetUp() override {
+    m_tmp_dir = std::make_unique<redex::TempDir>(
+        redex::make_tmp_dir("FusedUdfAnalysisTest%%%%%%%%"));
+    setenv("ANALYSIS_OUTPUT", m_tmp_dir->path.c_str(), 1);
+    setenv("current_date_time", "", 1);
+  }
+
+  // LA;.foo calls LA;.bar, which calls itself.
+  Scope make_scope() {
+    ClassCreator creator(DexType::make_type("LA;"));
+    creator.set_super(type::java_lang_Object());
+    m_foo = assembler::method_from_string(R"(
+      (method (public static) "LA;.foo:(I)I"
+       (
+        (load-param v0)
+        (invoke-static (v0) "LA;.bar:(I)I")
+        (move-result v1)
+        (return v1)
+       )
+      )
+    )");
+    m_bar = assembler::method_from_string(R"(
+      (method (public static) "LA;.bar:(I)I"
+       (
+        (load-param v0)
+        (if-eqz v0 :done)
+        (invoke-static (v0) "LA;.bar:(I)I")
+        (move-result v0)
+        (:done)
+        (return v0)
+       )
+      )
+    )");
+    creator.add_method(m_foo);
+    creator.add_method(m_bar);
+    return Scope{creator.create()};
+  }
+
+  std::unique_ptr<redex::TempDir> m_tmp_dir;
+  DexMethod* m_foo;
+  DexMethod* m_bar;
+};
+
+TEST_F(FusedUdfAnalysisTest, oneSummaryPerMethod) {
+  auto scope = make_scope();
+  FusedUdfAnalysisPass pass;
+  pass.run(scope, 10, FusedUdfAnalysisPass::AnalysisParameters());
+
+  auto result = pass.get_result();
+  ASSERT_NE(result, nullptr);
+  EXPECT_EQ(result->size(), 2);
+  EXPECT_EQ(result->count(m_foo), 1);
+  EXPECT_EQ(result->count(m_bar), 1);
+}
+
+TEST_F(FusedUdfAnalysisTest, parallelFixpointIsIdentical) {
+  auto scope = make_scope();
+  FusedUdfAnalysisPass serial_pass;
+  serial_pass.run(scope, 10, FusedUdfAnalysisPass::AnalysisParameters());
+
+  FusedUdfAnalysisPass::AnalysisParameters param;
+  param.parallel_fixpoint = true;
+  param.num_threads = 2;
+  FusedUdfAnalysisPass parallel_pass;
+  parallel_pass.run(scope, 10, param);
+
+  auto serial = serial_pass.get_result();
+  auto parallel = parallel_pass.get_result();
+  ASSERT_EQ(serial->size(), parallel->size());
+  for (const auto& entry : *serial) {
+    ASSERT_EQ(parallel->count(entry.first), 1);
+    EXPECT_TRUE(parallel->at(entry.first).equals(entry.second))
+        << show(entry.first);
+  }
+}
+
+TEST_F(FusedUdfAnalysisTest, matchesSeparatePasses) {
+  auto scope = make_scope();
+  FusedUdfAnalysisPass pass;
+  pass.run(scope, 10, FusedUdfAnalysisPass::AnalysisParameters());
+
+  DeterminismAnalysisPass det_pass;
+  det_pass.run(scope, 10, DeterminismAnalysisPass::AnalysisParameters());
+  NullInputAnalysisPass null_pass;
+  null_pass.run(scope, 10, NullInputAnalysisPass::AnalysisParameters());
+  ParallelSafetyAnalysisPass psafe_pass;
+  psafe_pass.run(scope, 10, ParallelSafetyAnalysisPass::AnalysisParameters());
+
+  // The components of the fused summaries are computed in one fixpoint over
+  // each CFG, and are the same as the summaries of the separate passes.
+  auto fused = pass.get_result();
+  ASSERT_NE(fused, nullptr);
+  for (const auto& entry : *fused) {
+    const auto& summary = entry.second;
+    ASSERT_EQ(det_pass.get_result()->count(entry.first), 1);
+    EXPECT_TRUE(summary.determinism().equals(
+        det_pass.get_result()->at(entry.first)))
+        << show(entry.first);
+    ASSERT_EQ(null_pass.get_result()->count(entry.first), 1);
+    EXPECT_TRUE(summary.null_input().equals(
+        null_pass.get_result()->at(entry.first)))
+        << show(entry.first);
+    ASSERT_EQ(psafe_pass.get_result()->count(entry.first), 1);
+    EXPECT_TRUE(summary.parallel_safety().equals(
+        psafe_pass.get_result()->at(entry.first)))
+        << show(entry.first);
+  }
+}
+
+TEST_F(FusedUdfAnalysisTest, warmRunMatchesColdRun) {
+  auto scope = make_scope();
+  auto run = [&](bool warm) {
+    Json::Value config;
+    if (warm) {
+      config["summary_cache"] = m_tmp_dir->path + "/summaries";
+    }
+    FusedUdfAnalysisPass pass;
+    pass.parse_config(JsonWrapper(config));
+    pass.run(scope, 10, FusedUdfAnalysisPass::AnalysisParameters());
+    return pass.get_result();
+  };
+
+  // The second warm run reuses the analyses of the three components, and the
+  // calling contexts of the determinism and parallel-safety analyses.
+  run(/* warm */ true);
+  auto warm = run(/* warm */ true);
+  auto cold = run(/* warm */ false);
+
+  ASSERT_EQ(warm->size(), cold->size());
+  for (const auto& entry : *cold) {
+    ASSERT_EQ(warm->count(entry.first), 1) << show(entry.first);
+    EXPECT_TRUE(warm->at(entry.first).equals(entry.second))
+        << show(entry.first);
+  }
+}
+
+TEST_F(FusedUdfAnalysisTest, targetFunctionsOnly) {
+  auto scope = make_scope();
+  ClassCreator creator(DexType::make_type("LB;"));
+  creator.set_super(type::java_lang_Object());
+  auto* baz = assembler::method_from_string(R"(
+    (method (public static) "LB;.baz:()V"
+     ((return-void))
+    )
+  )");
+  creator.add_method(baz);
+  scope.push_back(creator.create());
+
+  FusedUdfAnalysisPass::AnalysisParameters param;
+  param.function_names = {"LA;.foo:(I)I"};
+  param.target_functions_only = true;
+  FusedUdfAnalysisPass pass;
+  pass.run(scope, 10, param);
+
+  // LA;.bar is reachable from LA;.foo, LB;.baz is neither analyzed nor has its
+  // CFG built.
+  auto result = pass.get_result();
+  ASSERT_NE(result, nullptr);
+  EXPECT_EQ(result->size(), 2);
+  EXPECT_EQ(result->count(m_foo), 1);
+  EXPECT_EQ(result->count(m_bar), 1);
+  EXPECT_EQ(result->count(baz), 0);
+  EXPECT_FALSE(baz->get_code()->cfg_built());
+}
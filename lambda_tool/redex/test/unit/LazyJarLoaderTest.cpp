@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "JarLoader.h"
+
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "DexClass.h"
+#include "RedexTest.h"
+#include "WorkQueue.h"
+
+class LazyJarLoaderTest : public RedexTest {
+ protected:
+  void SetUp() override {
+    const char* android_sdk = std::getenv("sdk_path");
+    const char* android_target = std::getenv("android_target");
+    if (android_sdk == nullptr || android_target == nullptr) {
+      GTEST_SKIP() << "sdk_path and android_target are not set";
+    }
+    m_sdk_jar = std::string(android_sdk) + "/platforms/" + android_target +
+                "/android.jar";
+    ASSERT_TRUE(load_jar_file_lazily(m_sdk_jar.c_str()));
+  }
+
+  std::string m_sdk_jar;
+};
+
+TEST_F(LazyJarLoaderTest, classesAreCreatedOnLookup) {
+  auto* string_type = DexType::make_type("Ljava/lang/String;");
+  auto* string_cls = type_class(string_type);
+  ASSERT_NE(string_cls, nullptr);
+  EXPECT_TRUE(string_cls->is_external());
+  EXPECT_EQ(string_cls->get_location(), m_sdk_jar);
+  EXPECT_EQ(type_class(string_type), string_cls);
+
+  auto* object_cls = type_class(string_cls->get_super_class());
+  ASSERT_NE(object_cls, nullptr);
+  EXPECT_EQ(object_cls->get_type(), DexType::make_type("Ljava/lang/Object;"));
+
+  // The lazily created classes are kept by the jar index.
+  EXPECT_TRUE(g_redex->external_classes().empty());
+
+  EXPECT_EQ(type_class(DexType::make_type("Lcom/facebook/Missing;")), nullptr);
+  EXPECT_EQ(type_class(DexType::make_type("[Ljava/lang/String;")), nullptr);
+}
+
+TEST_F(LazyJarLoaderTest, concurrentLookups) {
+  std::vector<DexType*> types;
+  for (const auto* name :
+       {"Ljava/lang/Integer;", "Ljava/lang/Long;", "Ljava/util/ArrayList;",
+        "Ljava/util/HashMap;", "Ljava/lang/Math;"}) {
+    types.push_back(DexType::make_type(name));
+  }
+  std::vector<std::vector<DexClass*>> found(64);
+  std::vector<size_t> indices;
+  for (size_t i = 0; i < found.size(); ++i) {
+    indices.push_back(i);
+  }
+  workqueue_run<size_t>(
+      [&](size_t i) {
+        for (auto* type : types) {
+          found[i].push_back(type_class(type));
+        }
+      },
+      indices);
+  for (size_t t = 0; t < types.size(); ++t) {
+    ASSERT_NE(found[0][t], nullptr);
+    EXPECT_EQ(found[0][t]->get_type(), types[t]);
+    for (const auto& classes : found) {
+      EXPECT_EQ(classes[t], found[0][t]);
+    }
+  }
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SummaryCache.h"
+
+#include <fstream>
+#include <gtest/gtest.h>
+#include <json/value.h>
+#include <stdlib.h>
+
+#include "Creators.h"
+#include "DeterminismAnalysis.h"
+#include "IRAssembler.h"
+#include "JsonWrapper.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+
+using namespace summary_cache;
+
+struct SummaryCacheTest : public RedexTest {
+ protected:
+  // LA;.foo calls LB;.bar.
+  Scope make_scope() {
+    ClassCreator b_creator(DexType::make_type("LB;"));
+    b_creator.set_super(type::java_lang_Object());
+    auto bar = assembler::method_from_string(R"(
+      (method (public static) "LB;.bar:()I"
+       (
+        (const v0 1)
+        (return v0)
+       )
+      )
+    )");
+    b_creator.add_method(bar);
+
+    ClassCreator a_creator(DexType::make_type("LA;"));
+    a_creator.set_super(type::java_lang_Object());
+    m_foo = assembler::method_from_string(R"(
+      (method (public static) "LA;.foo:()I"
+       (
+        (invoke-static () "LB;.bar:()I")
+        (move-result v0)
+        (return v0)
+       )
+      )
+    )");
+    a_creator.add_method(m_foo);
+    m_bar = bar;
+    return Scope{a_creator.create(), b_creator.create()};
+  }
+
+  DexMethod* m_foo;
+  DexMethod* m_bar;
+};
+
+TEST_F(SummaryCacheTest, roundTrip) {
+  auto tmp_dir = redex::make_tmp_dir("SummaryCacheTest%%%%%%%%");
+  auto path = tmp_dir.path + "/summaries";
+  auto scope = make_scope();
+  uint64_t fingerprint = Fingerprint("Test").add("label").get();
+
+  SummaryCache cache(scope, fingerprint);
+  EXPECT_EQ(cache.load(path), 0);
+  EXPECT_FALSE(cache.get(m_foo, {1}));
+  cache.stage(m_foo, {1}, {2, 0});
+  cache.stage(m_bar, {1}, {1, 0});
+  // Only the latest analysis of a method is kept.
+  cache.stage(m_bar, {2}, {3, 1, 0, 0});
+  EXPECT_FALSE(cache.get(m_foo, {1}));
+  cache.commit();
+  EXPECT_TRUE(cache.save(path));
+
+  SummaryCache reloaded(scope, fingerprint);
+  EXPECT_EQ(reloaded.load(path), 2);
+  ASSERT_TRUE(reloaded.get(m_foo, {1}));
+  EXPECT_EQ(*reloaded.get(m_foo, {1}), SummaryCache::Value({2, 0}));
+  EXPECT_FALSE(reloaded.get(m_bar, {1}));
+  ASSERT_TRUE(reloaded.get(m_bar, {2}));
+  EXPECT_EQ(*reloaded.get(m_bar, {2}), SummaryCache::Value({3, 1, 0, 0}));
+
+  SummaryCache other_configuration(scope, Fingerprint("Test").get());
+  EXPECT_EQ(other_configuration.load(path), 0);
+  EXPECT_FALSE(other_configuration.get(m_foo, {1}));
+}
+
+TEST_F(SummaryCacheTest, concurrentSavesAreMerged) {
+  auto tmp_dir = redex::make_tmp_dir("SummaryCacheTest%%%%%%%%");
+  auto path = tmp_dir.path + "/summaries";
+  auto scope = make_scope();
+  uint64_t fingerprint = Fingerprint("Test").get();
+
+  // Two runs load the cache before either saves it.
+  SummaryCache first(scope, fingerprint);
+  SummaryCache second(scope, fingerprint);
+  EXPECT_EQ(first.load(path), 0);
+  EXPECT_EQ(second.load(path), 0);
+  first.stage(m_foo, {1}, {2, 0});
+  first.commit();
+  second.stage(m_bar, {1}, {1, 0});
+  second.commit();
+  first.save(path);
+  second.save(path);
+
+  SummaryCache reloaded(scope, fingerprint);
+  EXPECT_EQ(reloaded.load(path), 2);
+  EXPECT_TRUE(reloaded.get(m_foo, {1}));
+  EXPECT_TRUE(reloaded.get(m_bar, {1}));
+}
+
+TEST_F(SummaryCacheTest, unwritablePathIsNotFatal) {
+  auto tmp_dir = redex::make_tmp_dir("SummaryCacheTest%%%%%%%%");
+  auto path = tmp_dir.path + "/missing/summaries";
+  auto scope = make_scope();
+
+  SummaryCache cache(scope, Fingerprint("Test").get());
+  cache.stage(m_foo, {1}, {2, 0});
+  cache.commit();
+  EXPECT_FALSE(cache.save(path));
+  EXPECT_TRUE(cache.get(m_foo, {1}));
+}
+
+// The inputs are compared on a hit, so an analysis whose inputs only share
+// their hash with the inputs of the lookup is not reused.
+TEST_F(SummaryCacheTest, inputsAreCompared) {
+  auto tmp_dir = redex::make_tmp_dir("SummaryCacheTest%%%%%%%%");
+  auto path = tmp_dir.path + "/summaries";
+  auto scope = make_scope();
+  uint64_t fingerprint = Fingerprint("Test").get();
+  {
+    SummaryCache cache(scope, fingerprint);
+    cache.stage(m_foo, {7}, {2, 0});
+    cache.commit();
+    EXPECT_TRUE(cache.save(path));
+  }
+
+  // Change the stored inputs but not their hash. The only input word follows
+  // the header, of 4 words of 64 bits, and the entry, of 5.
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp((4 + 5) * sizeof(uint64_t));
+    uint32_t input = 8;
+    file.write(reinterpret_cast<const char*>(&input), sizeof(input));
+  }
+  SummaryCache cache(scope, fingerprint);
+  EXPECT_EQ(cache.load(path), 1);
+  EXPECT_FALSE(cache.get(m_foo, {7}));
+  EXPECT_FALSE(cache.get(m_foo, {8}));
+}
+
+TEST_F(SummaryCacheTest, classChangeInvalidatesMethod) {
+  auto tmp_dir = redex::make_tmp_dir("SummaryCacheTest%%%%%%%%");
+  auto path = tmp_dir.path + "/summaries";
+  uint64_t fingerprint = Fingerprint("Test").get();
+  auto scope = make_scope();
+  {
+    SummaryCache cache(scope, fingerprint);
+    cache.stage(m_foo, {1}, {2, 0});
+    cache.stage(m_bar, {1}, {1, 0});
+    cache.commit();
+    cache.save(path);
+  }
+
+  for (auto& mie : InstructionIterable(m_bar->get_code())) {
+    if (mie.insn->opcode() == OPCODE_CONST) {
+      mie.insn->set_literal(2);
+    }
+  }
+  SummaryCache cache(scope, fingerprint);
+  EXPECT_EQ(cache.load(path), 2);
+  EXPECT_FALSE(cache.get(m_bar, {1}));
+  // The summaries of the callees of LA;.foo are part of its inputs, so its
+  // class alone decides here.
+  EXPECT_TRUE(cache.get(m_foo, {1}));
+}
+
+// LA;.foo invokes LBase;.get, which LSub; overrides in another class. Editing
+// the override must not let a warm run reuse the stale analysis of LA;.foo.
+TEST_F(SummaryCacheTest, warmRunMatchesColdRunAfterOverrideChange) {
+  auto tmp_dir = redex::make_tmp_dir("SummaryCacheTest%%%%%%%%");
+  setenv("ANALYSIS_OUTPUT", tmp_dir.path.c_str(), 1);
+  setenv("current_date_time", "", 1);
+  auto labels_path = tmp_dir.path + "/labels.csv";
+  {
+    std::ofstream labels(labels_path);
+    labels << "LLabels;det,DET\nLLabels;nondet,NOTDET\n";
+  }
+  auto* nondet = DexMethod::make_method("LLabels;.nondet:(I)I");
+
+  ClassCreator base_creator(DexType::make_type("LBase;"));
+  base_creator.set_super(type::java_lang_Object());
+  base_creator.add_method(assembler::method_from_string(R"(
+    (method (public) "LBase;.get:()I"
+     (
+      (load-param-object v1)
+      (const v0 1)
+      (return v0)
+     )
+    )
+  )"));
+  ClassCreator sub_creator(DexType::make_type("LSub;"));
+  sub_creator.set_super(DexType::make_type("LBase;"));
+  auto* sub_get = assembler::method_from_string(R"(
+    (method (public) "LSub;.get:()I"
+     (
+      (load-param-object v1)
+      (const v0 1)
+      (invoke-static (v0) "LLabels;.det:(I)I")
+      (move-result v0)
+      (return v0)
+     )
+    )
+  )");
+  sub_creator.add_method(sub_get);
+  ClassCreator a_creator(DexType::make_type("LA;"));
+  a_creator.set_super(type::java_lang_Object());
+  auto* foo = assembler::method_from_string(R"(
+    (method (public static) "LA;.foo:(LBase;)I"
+     (
+      (load-param-object v0)
+      (invoke-virtual (v0) "LBase;.get:()I")
+      (move-result v1)
+      (return v1)
+     )
+    )
+  )");
+  a_creator.add_method(foo);
+  Scope scope{base_creator.create(), sub_creator.create(), a_creator.create()};
+
+  auto run = [&](bool warm) {
+    Json::Value config;
+    config["m_func_lables"] = labels_path;
+    if (warm) {
+      config["summary_cache"] = tmp_dir.path + "/summaries";
+    }
+    DeterminismAnalysisPass pass;
+    pass.parse_config(JsonWrapper(config));
+    pass.run(scope, 10, DeterminismAnalysisPass::AnalysisParameters());
+    return pass.get_result();
+  };
+
+  auto before = run(/* warm */ true);
+  for (auto& mie : InstructionIterable(sub_get->get_code())) {
+    if (opcode::is_an_invoke(mie.insn->opcode())) {
+      mie.insn->set_method(nondet);
+    }
+  }
+  auto warm = run(/* warm */ true);
+  auto cold = run(/* warm */ false);
+
+  ASSERT_EQ(before->count(foo), 1);
+  ASSERT_EQ(cold->count(foo), 1);
+  EXPECT_FALSE(before->at(foo).equals(cold->at(foo)));
+  ASSERT_EQ(warm->size(), cold->size());
+  for (const auto& entry : *cold) {
+    ASSERT_EQ(warm->count(entry.first), 1) << show(entry.first);
+    EXPECT_TRUE(warm->at(entry.first).equals(entry.second))
+        << show(entry.first);
+  }
+}
@@ -7,6 +7,7 @@
 
 #include "ToolsCommon.h"
 
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem.hpp>
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -108,6 +109,10 @@ void write_intermediate_dex(const RedexOptions& redex_options,
     dex_files.append(Json::nullValue);
     Json::Value& store_files = dex_files[dex_files.size() - 1];
     store_files["name"] = store.get_name();
+    store_files["dependencies"] = Json::arrayValue;
+    for (const auto& dependency : store.get_dependencies()) {
+      store_files["dependencies"].append(dependency);
+    }
     store_files["list"] = Json::arrayValue;
 
     for (size_t i = 0; i < store.get_dexen().size(); i++) {
@@ -145,8 +150,12 @@ void load_intermediate_dex(const std::string& input_ir_dir,
   Timer t("Load intermediate dex");
   dex_stats_t dex_stats;
   for (const Json::Value& store_files : dex_files) {
-    DexStore store(store_files["name"].asString());
-    stores.emplace_back(std::move(store));
+    DexMetadata metadata;
+    metadata.set_id(store_files["name"].asString());
+    for (const Json::Value& dependency : store_files["dependencies"]) {
+      metadata.get_dependencies().push_back(dependency.asString());
+    }
+    stores.emplace_back(metadata);
     for (const Json::Value& file_name : store_files["list"]) {
       auto location = boost::filesystem::path(input_ir_dir);
       location /= file_name.asString();
@@ -258,9 +267,83 @@ void load_all_intermediate(const std::string& input_ir_dir,
   }
 }
 
+/**
+ * Dumping the dex files and the IR meta data of the program and of the library
+ * classes, then the entry file. The entry file is removed first and written
+ * last, so that an interrupted snapshot is never loaded.
+ */
+void write_snapshot(ConfigFiles& conf,
+                    const std::string& snapshot_dir,
+                    const RedexOptions& redex_options,
+                    DexStoresVector& stores,
+                    const Scope& external_classes,
+                    Json::Value& entry_data) {
+  Timer t("Writing snapshot");
+  boost::filesystem::create_directories(snapshot_dir);
+  boost::filesystem::remove(snapshot_dir + ENTRY_FILE);
+  redex_options.serialize(entry_data);
+  entry_data["dex_magic"] = stores[0].get_dex_magic();
+  entry_data["dex_list"] = Json::arrayValue;
+  {
+    Timer t2("Dumping IR meta");
+    // The keep rules also apply to the library classes, e.g.
+    // -assumenosideeffects.
+    Scope classes = build_class_scope(stores);
+    classes.insert(classes.end(), external_classes.begin(),
+                   external_classes.end());
+    ir_meta_io::dump(classes, snapshot_dir);
+  }
+  write_intermediate_dex(redex_options, conf, snapshot_dir, stores,
+                         entry_data["dex_list"]);
+  write_entry_file(snapshot_dir, entry_data);
+}
+
+/**
+ * Loading the entry file, then, if it matches the inputs, the dex files, the
+ * library jars and the IR meta data, in the order of the frontend
+ */
+bool load_snapshot(const std::string& snapshot_dir,
+                   const Json::Value& inputs,
+                   DexStoresVector& stores,
+                   Json::Value* entry_data,
+                   const std::function<void()>& load_library_jars) {
+  std::ifstream istrm(snapshot_dir + ENTRY_FILE);
+  if (!istrm) {
+    return false;
+  }
+  try {
+    istrm >> *entry_data;
+  } catch (const std::exception& e) {
+    std::cerr << "warning: ignoring invalid snapshot " << snapshot_dir << ": "
+              << e.what() << std::endl;
+    return false;
+  }
+  if ((*entry_data)["inputs"] != inputs) {
+    TRACE(MAIN, 1, "The inputs of snapshot %s changed", snapshot_dir.c_str());
+    return false;
+  }
+
+  Timer t("Loading snapshot");
+  load_intermediate_dex(snapshot_dir, (*entry_data)["dex_list"], stores);
+  stores[0].set_dex_magic((*entry_data)["dex_magic"].asString());
+  load_library_jars();
+  init_ir_meta(stores);
+  // The classes are loaded by now, there is no going back to the frontend.
+  always_assert_log(load_ir_meta(snapshot_dir),
+                    "Cannot load the IR meta data of snapshot %s",
+                    snapshot_dir.c_str());
+  return true;
+}
+
+bool is_class_file_input(const std::string& filename) {
+  return boost::algorithm::ends_with(filename, ".jar") ||
+         boost::algorithm::ends_with(filename, ".class");
+}
+
 /**
  * Helper to load classes from a list of input dex files into a DexStoresVector.
- * Processes dex (.dex) files as well as DexMetadata files (.json)
+ * Processes dex (.dex) files as well as DexMetadata files (.json), and jars
+ * (.jar) and class files (.class) as program classes of the root store.
  */
 void load_classes_from_dexes_and_metadata(
     const std::vector<std::string>& dex_files,
@@ -279,6 +362,14 @@ void load_classes_from_dexes_and_metadata(
       input_totals += dex_stats;
       input_dexes_stats.push_back(dex_stats);
       stores[0].add_classes(std::move(classes));
+    } else if (is_class_file_input(filename)) {
+      Scope classes;
+      bool loaded = boost::algorithm::ends_with(filename, ".jar")
+                        ? load_program_jar_file(filename.c_str(), &classes)
+                        : load_program_class_file(filename, &classes);
+      always_assert_log(loaded, "Cannot load the classes of %s",
+                        filename.c_str());
+      stores[0].add_classes(std::move(classes));
     } else if (is_zip(filename)) {
       std::cerr << "error: Input files are expected to be DEX (with filename "
                    "ending in "
@@ -5,6 +5,8 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <functional>
+
 #include "ConfigFiles.h"
 #include "DexStats.h"
 #include "DexStore.h"
@@ -26,6 +28,40 @@ void load_all_intermediate(const std::string& input_ir_dir,
                            DexStoresVector& stores,
                            Json::Value* entry_data);
 
+/**
+ * A snapshot is the program as loaded by the frontend, i.e., once the keep
+ * rules are applied, as intermediate dex files and IR meta data. Its entry file
+ * records the `inputs` it was taken from, which `load_snapshot` compares to
+ * the current ones.
+ *
+ * Writing a snapshot lowers the code of the classes, so it has to happen on a
+ * copy of the program, e.g., in a forked process.
+ */
+void write_snapshot(ConfigFiles& conf,
+                    const std::string& snapshot_dir,
+                    const RedexOptions& redex_options,
+                    DexStoresVector& stores,
+                    const Scope& external_classes,
+                    Json::Value& entry_data);
+
+/**
+ * Returns false, having loaded nothing, if there is no snapshot or if it was
+ * taken from other inputs. `load_library_jars` is called once the program
+ * classes are loaded, as in the frontend.
+ */
+bool load_snapshot(const std::string& snapshot_dir,
+                   const Json::Value& inputs,
+                   DexStoresVector& stores,
+                   Json::Value* entry_data,
+                   const std::function<void()>& load_library_jars);
+
+/**
+ * Whether an input is a jar or a class file, whose classes are loaded with the
+ * code of their methods translated from JVM bytecode, instead of a dex file or
+ * a DexMetadata file.
+ */
+bool is_class_file_input(const std::string& filename);
+
 void load_classes_from_dexes_and_metadata(
     const std::vector<std::string>& dex_files,
     DexStoresVector& stores,
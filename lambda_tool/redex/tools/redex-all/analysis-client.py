@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+# Copyright (c) Facebook, Inc. and its affiliates.
+#
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+
+import argparse
+import json
+import os
+import socket
+import sys
+
+
+def arg_parser():
+    description = """
+Sends a request to a server started with `redex-all --serve <socket>` and
+prints its response, e.g.
+
+  analysis-client.py /tmp/redex.sock udf.dex -m 'Lcom/Foo;.evaluate:(I)I'
+  analysis-client.py /tmp/redex.sock --shutdown
+"""
+    parser = argparse.ArgumentParser(
+        formatter_class=argparse.RawDescriptionHelpFormatter, description=description
+    )
+    parser.add_argument("socket", help="Unix domain socket of the server")
+    parser.add_argument("dex_files", nargs="*", help="Dex files to analyze")
+    parser.add_argument(
+        "-m",
+        "--method",
+        action="append",
+        default=[],
+        help="Method to get the results of, all of them if none is given",
+    )
+    parser.add_argument(
+        "--shutdown", action="store_true", help="Stop the server instead"
+    )
+    return parser
+
+
+def send_request(socket_path, request):
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as client:
+        client.connect(socket_path)
+        client.sendall((json.dumps(request) + "\n").encode("utf-8"))
+        response = b""
+        while not response.endswith(b"\n"):
+            chunk = client.recv(65536)
+            if not chunk:
+                break
+            response += chunk
+    if not response:
+        return {
+            "status": "error",
+            "error": "the server closed the connection, see its log",
+        }
+    return json.loads(response.decode("utf-8"))
+
+
+def main():
+    args = arg_parser().parse_args()
+    if args.shutdown:
+        request = {"command": "shutdown"}
+    else:
+        if not args.dex_files:
+            sys.exit("error: no dex files to analyze")
+        request = {
+            "dex_files": [os.path.abspath(dex) for dex in args.dex_files],
+            "methods": args.method,
+        }
+    response = send_request(args.socket, request)
+    print(json.dumps(response, indent=2))
+    sys.exit(0 if response.get("status") == "ok" else 1)
+
+
+if __name__ == "__main__":
+    main()
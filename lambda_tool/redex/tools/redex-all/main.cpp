@@ -6,6 +6,7 @@
  */
 
 #include <boost/thread/thread.hpp>
+#include <chrono>
 #include <cinttypes>
 #include <cstring>
 #include <ctime>
@@ -18,23 +19,32 @@
 #include <string>
 #include <vector>
 
+#include <fcntl.h>
 #include <signal.h>
 #include <sstream>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unordered_set>
 
 #ifdef _MSC_VER
 #include <io.h>
 #else
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #endif
 
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/program_options.hpp>
 #include <json/json.h>
 
 #include "ABExperimentContext.h"
+#include "AnalysisOutput.h"
 #include "CommandProfiling.h"
 #include "CommentFilter.h"
 #include "ControlFlow.h" // To set DEBUG.
@@ -61,6 +71,7 @@
 #include "ProguardPrintConfiguration.h" // New ProGuard configuration
 #include "Purity.h" // For defaults from config.
 #include "ReachableClasses.h"
+#include "ReadMaybeMapped.h"
 #include "RedexContext.h"
 #include "RedexResources.h"
 #include "SanitizersConfig.h"
@@ -98,6 +109,15 @@ struct Arguments {
   Json::Value entry_data;
   boost::optional<int> stop_pass_idx;
   RedexOptions redex_options;
+  // The file listing the runs of a batch, see read_batch_file(), if any.
+  std::string batch_file;
+  unsigned batch_jobs{1};
+  // The Unix domain socket the server listens on, see redex_serve(), if any.
+  std::string serve_socket;
+  // How long the server waits for the request of a connection.
+  unsigned serve_timeout_ms{10000};
+  // The snapshot of the frontend, see redex_frontend(), if any.
+  std::string snapshot_dir;
 };
 
 UNUSED void dump_args(const Arguments& args) {
@@ -322,9 +342,42 @@ Arguments parse_args(int argc, char* argv[]) {
       "    \te.g. -JMyPass.config=[1, 2, 3]\n"
       "Note: Be careful to properly escape JSON parameters, e.g., strings must "
       "be quoted.");
+  od.add_options()(
+      "batch",
+      po::value<std::string>(&args.batch_file),
+      "file listing the runs of a batch, one per line: a name, then the dex "
+      "files of the run\n"
+      "  \tThe library jars are loaded once, then every run analyzes its dex "
+      "files in its own process, writing to <outdir>/<name> and "
+      "$ANALYSIS_OUTPUT/<name>. The input dex files must not be given on the "
+      "command line.");
+  od.add_options()("batch-jobs",
+                   po::value<unsigned>(&args.batch_jobs)->default_value(1),
+                   "number of concurrent runs of a batch, or of concurrent "
+                   "requests of the server");
+  od.add_options()(
+      "serve",
+      po::value<std::string>(&args.serve_socket),
+      "Unix domain socket to serve analysis requests on\n"
+      "  \tThe library jars are loaded once, then every request, a line of "
+      "JSON {\"dex_files\": [...], \"methods\": [...]}, is answered with "
+      "the results of the analysis passes for the given methods. The input "
+      "dex files must not be given on the command line.");
+  od.add_options()(
+      "serve-timeout",
+      po::value<unsigned>(&args.serve_timeout_ms)->default_value(10000),
+      "milliseconds the server waits for the request of a connection before "
+      "answering it with an error");
+  od.add_options()(
+      "snapshot",
+      po::value<std::string>(&args.snapshot_dir),
+      "directory of a snapshot of the program loaded by the frontend\n"
+      "  \tThe snapshot replaces the frontend if it was taken from the same "
+      "config, dex files, ProGuard configuration and map, and redex-all "
+      "binary. Otherwise the frontend runs and the snapshot is written.");
   od.add_options()("show-passes", "show registered passes");
   od.add_options()("dex-files", po::value<std::vector<std::string>>(),
-                   "dex files");
+                   "dex files, or jars and class files to translate");
 
   // Development usage only, and Python script will generate the following
   // arguments.
@@ -381,7 +434,17 @@ Arguments parse_args(int argc, char* argv[]) {
     exit(EXIT_SUCCESS);
   }
 
-  if (vm.count("dex-files")) {
+  if (!args.batch_file.empty() || !args.serve_socket.empty()) {
+    if (vm.count("dex-files") ||
+        (!args.batch_file.empty() && !args.serve_socket.empty())) {
+      std::cerr << "error: the input dex files of a batch or of the server "
+                   "are given by the batch file or by the requests"
+                << std::endl
+                << std::endl;
+      print_usage();
+      exit(EXIT_FAILURE);
+    }
+  } else if (vm.count("dex-files")) {
     args.dex_files = vm["dex-files"].as<std::vector<std::string>>();
   } else {
     std::cerr << "error: no input dex files" << std::endl << std::endl;
@@ -803,11 +866,16 @@ void write_debug_line_mapping(
   ofs << line_out.str();
 }
 
-std::string get_dex_magic(std::vector<std::string>& dex_files) {
+std::string get_dex_magic(const std::vector<std::string>& dex_files) {
   always_assert_log(!dex_files.empty(), "APK contains no dex file\n");
   // Get dex magic from the first dex file since all dex magic
-  // should be consistent within one APK.
-  return load_dex_magic_from_dex(dex_files[0].c_str());
+  // should be consistent within one APK. Jars and class files have none.
+  for (const auto& dex_file : dex_files) {
+    if (!redex::is_class_file_input(dex_file)) {
+      return load_dex_magic_from_dex(dex_file.c_str());
+    }
+  }
+  return DEX_HEADER_DEXMAGIC_V35;
 }
 
 void dump_keep_reasons(const ConfigFiles& conf,
@@ -864,17 +932,11 @@ void dump_keep_reasons(const ConfigFiles& conf,
 }
 
 /**
- * Pre processing steps: load dex and configurations
+ * Parses the ProGuard configuration, whose library jars are added to the jars
+ * of the arguments
  */
-void redex_frontend(ConfigFiles& conf, /* input */
-                    Arguments& args, /* inout */
-                    keep_rules::ProguardConfiguration& pg_config,
-                    DexStoresVector& stores,
-                    Json::Value& stats) {
-  Timer redex_frontend_timer("Redex_frontend");
-
-  g_redex->load_pointers_cache();
-
+void parse_proguard_configs(Arguments& args, /* inout */
+                            keep_rules::ProguardConfiguration& pg_config) {
   for (const auto& pg_config_path : args.proguard_config_paths) {
     Timer time_pg_parsing("Parsed ProGuard config file");
     keep_rules::proguard_parser::parse_file(pg_config_path, &pg_config);
@@ -883,7 +945,12 @@ void redex_frontend(ConfigFiles& conf, /* input */
 
   const auto& pg_libs = pg_config.libraryjars;
   args.jar_paths.insert(pg_libs.begin(), pg_libs.end());
+}
 
+/**
+ * The library jars of the arguments, whose jar paths are lists of jars
+ */
+std::set<std::string> get_library_jars(const Arguments& args) {
   std::set<std::string> library_jars;
   for (const auto& jar_path : args.jar_paths) {
     std::istringstream jar_stream(jar_path);
@@ -902,36 +969,32 @@ void redex_frontend(ConfigFiles& conf, /* input */
       library_jars.emplace(dependent_jar_path);
     }
   }
+  return library_jars;
+}
 
-  DexStore root_store("classes");
-  // Only set dex magic to root DexStore since all dex magic
-  // should be consistent within one APK.
-  root_store.set_dex_magic(get_dex_magic(args.dex_files));
-  stores.emplace_back(std::move(root_store));
-
-  const JsonWrapper& json_config = conf.get_json_config();
-  dup_classes::read_dup_class_allowlist(json_config);
-
-  run_rethrow_first_aggregate([&]() {
-    Timer t("Load classes from dexes");
-    dex_stats_t input_totals;
-    std::vector<dex_stats_t> input_dexes_stats;
-    redex::load_classes_from_dexes_and_metadata(
-        args.dex_files, stores, input_totals, input_dexes_stats);
-    stats["input_stats"] = get_input_stats(input_totals, input_dexes_stats);
-  });
-
-  Scope external_classes;
+/**
+ * Loads the library jars of the arguments, once the ProGuard configuration is
+ * parsed
+ */
+void load_library_jars(Arguments& args, /* inout */
+                       const keep_rules::ProguardConfiguration& pg_config,
+                       Scope* external_classes) {
+  auto library_jars = get_library_jars(args);
   args.entry_data["jars"] = Json::arrayValue;
   if (!library_jars.empty()) {
     Timer t("Load library jars");
 
+    // The classes of lazily loaded jars are only created when they are looked
+    // up, and are not in external_classes.
+    bool lazy = args.config.get("lazy_library_jars", false).asBool();
     for (const auto& library_jar : library_jars) {
       TRACE(MAIN, 1, "LIBRARY JAR: %s", library_jar.c_str());
-      if (!load_jar_file(library_jar.c_str(), &external_classes)) {
+      if (lazy ? !load_jar_file_lazily(library_jar.c_str())
+               : !load_jar_file(library_jar.c_str(), external_classes)) {
         // Try again with the basedir
         std::string basedir_path = pg_config.basedirectory + "/" + library_jar;
-        if (!load_jar_file(basedir_path.c_str())) {
+        if (lazy ? !load_jar_file_lazily(basedir_path.c_str())
+                 : !load_jar_file(basedir_path.c_str())) {
           std::cerr << "error: library jar could not be loaded: " << library_jar
                     << std::endl;
           exit(EXIT_FAILURE);
@@ -943,7 +1006,43 @@ void redex_frontend(ConfigFiles& conf, /* input */
       }
     }
   }
+}
 
+/**
+ * Loads the classes of the input dexes
+ */
+void load_dexes(const ConfigFiles& conf,
+                const Arguments& args,
+                DexStoresVector& stores,
+                Json::Value& stats) {
+  DexStore root_store("classes");
+  // Only set dex magic to root DexStore since all dex magic
+  // should be consistent within one APK.
+  root_store.set_dex_magic(get_dex_magic(args.dex_files));
+  stores.emplace_back(std::move(root_store));
+
+  const JsonWrapper& json_config = conf.get_json_config();
+  dup_classes::read_dup_class_allowlist(json_config);
+
+  run_rethrow_first_aggregate([&]() {
+    Timer t("Load classes from dexes");
+    dex_stats_t input_totals;
+    std::vector<dex_stats_t> input_dexes_stats;
+    redex::load_classes_from_dexes_and_metadata(
+        args.dex_files, stores, input_totals, input_dexes_stats);
+    stats["input_stats"] = get_input_stats(input_totals, input_dexes_stats);
+  });
+}
+
+/**
+ * Applies the configurations to the loaded classes
+ */
+void process_program_classes(ConfigFiles& conf, /* input */
+                             const Arguments& args,
+                             keep_rules::ProguardConfiguration& pg_config,
+                             const Scope& external_classes,
+                             DexStoresVector& stores) {
+  const JsonWrapper& json_config = conf.get_json_config();
   {
     Timer t("Deobfuscating dex elements");
     for (auto& store : stores) {
@@ -1003,6 +1102,182 @@ void redex_frontend(ConfigFiles& conf, /* input */
   }
 }
 
+/**
+ * A hash of the contents of the file at `path`, read in words of 64 bits.
+ */
+uint64_t content_hash(const std::string& path) {
+  size_t seed = 0;
+  redex::read_file_with_contents(path, [&](const char* data, size_t size) {
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+      uint64_t word;
+      memcpy(&word, data + i, sizeof(uint64_t));
+      boost::hash_combine(seed, word);
+    }
+    for (; i < size; ++i) {
+      boost::hash_combine(seed, data[i]);
+    }
+  });
+  return seed;
+}
+
+/**
+ * What the program loaded by the frontend depends on, with the size and a hash
+ * of the contents of the files. Modification times are not used: they have a
+ * resolution of one second here, and a file rewritten within that second, or
+ * restored with its old time, would keep a stale snapshot. The library jars
+ * include those of the ProGuard configuration, which must be parsed. The
+ * contents of the APK directory and of the files included by the ProGuard
+ * configuration are not tracked.
+ */
+Json::Value get_snapshot_inputs(const ConfigFiles& conf,
+                                const Arguments& args,
+                                const keep_rules::ProguardConfiguration&
+                                    pg_config) {
+  auto file_stamp = [](const std::string& path) {
+    Json::Value stamp;
+    stamp["path"] = boost::filesystem::absolute(path).string();
+    boost::system::error_code ec;
+    auto size = boost::filesystem::file_size(path, ec);
+    if (!ec) {
+      stamp["size"] = (Json::UInt64)size;
+      stamp["hash"] = (Json::UInt64)content_hash(path);
+    }
+    return stamp;
+  };
+  Json::Value inputs;
+  inputs["binary"] = file_stamp("/proc/self/exe");
+  inputs["config"] = args.config;
+  inputs["dex_files"] = Json::arrayValue;
+  for (const auto& dex_file : args.dex_files) {
+    inputs["dex_files"].append(file_stamp(dex_file));
+    if (!boost::algorithm::ends_with(dex_file, ".dex") &&
+        !redex::is_class_file_input(dex_file)) {
+      DexMetadata store_metadata;
+      store_metadata.parse(dex_file);
+      for (const auto& store_file : store_metadata.get_files()) {
+        inputs["dex_files"].append(file_stamp(store_file));
+      }
+    }
+  }
+  inputs["proguard_configs"] = Json::arrayValue;
+  for (const auto& pg_config_path : args.proguard_config_paths) {
+    inputs["proguard_configs"].append(file_stamp(pg_config_path));
+  }
+  inputs["jars"] = Json::arrayValue;
+  for (const auto& library_jar : get_library_jars(args)) {
+    // Stamps the jar that load_library_jars() loads, which may be relative to
+    // the base directory of the ProGuard configuration.
+    std::string basedir_path = pg_config.basedirectory + "/" + library_jar;
+    if (!boost::filesystem::exists(library_jar) &&
+        boost::filesystem::exists(basedir_path)) {
+      inputs["jars"].append(file_stamp(basedir_path));
+    } else {
+      inputs["jars"].append(file_stamp(library_jar));
+    }
+  }
+  std::string proguard_map;
+  conf.get_json_config().get("proguard_map", "", proguard_map);
+  if (!proguard_map.empty()) {
+    inputs["proguard_map"] = file_stamp(proguard_map);
+  }
+  return inputs;
+}
+
+/**
+ * Writes a snapshot of the program loaded by the frontend, in a forked process
+ * since writing it lowers the code
+ */
+void write_frontend_snapshot(ConfigFiles& conf,
+                             const Arguments& args,
+                             DexStoresVector& stores,
+                             const Scope& external_classes,
+                             const Json::Value& inputs,
+                             const Json::Value& stats) {
+#ifdef __linux__
+  Timer t("Redex_frontend (snapshot)");
+  std::cout.flush();
+  std::cerr.flush();
+  pid_t pid = fork();
+  if (pid == 0) {
+    try {
+      Json::Value entry_data = args.entry_data;
+      entry_data["inputs"] = inputs;
+      entry_data["input_stats"] = stats["input_stats"];
+      redex::write_snapshot(conf, args.snapshot_dir, args.redex_options,
+                            stores, external_classes, entry_data);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      _exit(EXIT_FAILURE);
+    }
+    _exit(EXIT_SUCCESS);
+  }
+  int stat = 0;
+  if (pid > 0) {
+    while (waitpid(pid, &stat, 0) == -1 && errno == EINTR) {
+    }
+  }
+  if (pid < 0 || !WIFEXITED(stat) || WEXITSTATUS(stat) != 0) {
+    std::cerr << "warning: cannot write snapshot " << args.snapshot_dir
+              << std::endl;
+  }
+#else
+  (void)conf;
+  (void)stores;
+  (void)external_classes;
+  (void)inputs;
+  (void)stats;
+  std::cerr << "warning: snapshots are only written on Linux, ignoring "
+            << args.snapshot_dir << std::endl;
+#endif
+}
+
+/**
+ * Pre processing steps: load dex and configurations, or restore the snapshot
+ * of a previous run on the same inputs
+ */
+void redex_frontend(ConfigFiles& conf, /* input */
+                    Arguments& args, /* inout */
+                    keep_rules::ProguardConfiguration& pg_config,
+                    DexStoresVector& stores,
+                    Json::Value& stats) {
+  Timer redex_frontend_timer("Redex_frontend");
+
+  g_redex->load_pointers_cache();
+
+  parse_proguard_configs(args, pg_config);
+
+  Scope external_classes;
+  Json::Value snapshot_inputs;
+  if (!args.snapshot_dir.empty() && RedexContext::record_keep_reasons()) {
+    // The keep reasons are not part of the IR meta data.
+    std::cerr << "warning: ignoring the snapshot since keep reasons are "
+                 "recorded"
+              << std::endl;
+  } else if (!args.snapshot_dir.empty()) {
+    snapshot_inputs = get_snapshot_inputs(conf, args, pg_config);
+    dup_classes::read_dup_class_allowlist(conf.get_json_config());
+    Json::Value entry_data;
+    if (redex::load_snapshot(args.snapshot_dir, snapshot_inputs, stores,
+                             &entry_data, [&]() {
+                               load_library_jars(args, pg_config,
+                                                 &external_classes);
+                             })) {
+      stats["input_stats"] = entry_data["input_stats"];
+      return;
+    }
+  }
+
+  load_dexes(conf, args, stores, stats);
+  load_library_jars(args, pg_config, &external_classes);
+  process_program_classes(conf, args, pg_config, external_classes, stores);
+
+  if (!snapshot_inputs.isNull()) {
+    write_frontend_snapshot(conf, args, stores, external_classes,
+                            snapshot_inputs, stats);
+  }
+}
+
 /**
  * Post processing steps: write dex and collect stats
  */
@@ -1224,6 +1499,597 @@ void dump_class_method_info_map(const std::string& file_path,
   });
 }
 
+/**
+ * Runs the passes on the loaded classes, then writes the output dexes, or the
+ * intermediate IR when stopping before a pass, unless `write_output` is false
+ */
+void redex_run_passes(
+    ConfigFiles& conf,
+    Arguments& args,
+    std::unique_ptr<keep_rules::ProguardConfiguration> pg_config,
+    DexStoresVector& stores,
+    Json::Value& stats,
+    bool write_output = true) {
+  // Initialize purity defaults, if set.
+  purity::CacheConfig::parse_default(conf);
+
+  auto const& passes = PassRegistry::get().get_passes();
+  PassManager manager(passes, std::move(pg_config), args.config,
+                      args.redex_options);
+
+  std::unordered_map<std::string, std::string> exp_states;
+  conf.get_json_config().get("ab_experiments_states", {}, exp_states);
+  {
+    std::unordered_map<std::string, std::string> exp_states_override;
+    conf.get_json_config().get("ab_experiments_states_override", {},
+                               exp_states_override);
+    for (auto& p : exp_states_override) {
+      exp_states[p.first] = std::move(p.second);
+    }
+  }
+  auto exp_state_default = [&]() -> boost::optional<std::string> {
+    if (!conf.get_json_config().contains("ab_experiments_default")) {
+      return boost::none;
+    }
+    return conf.get_json_config().get("ab_experiments_default",
+                                      std::string(""));
+  }();
+  ab_test::ABExperimentContext::parse_experiments_states(
+      exp_states, exp_state_default, !manager.get_redex_options().redacted);
+
+  {
+    Timer t("Running optimization passes");
+    manager.run_passes(stores, conf);
+  }
+
+  if (!write_output) {
+    return;
+  }
+  if (args.stop_pass_idx == boost::none) {
+    // Call redex_backend by default
+    auto profile_backend =
+        ScopedCommandProfiling::maybe_from_env("BACKEND_", "backend");
+    redex_backend(conf, manager, stores, stats);
+    if (args.config.get("emit_class_method_info_map", false).asBool()) {
+      dump_class_method_info_map(conf.metafile(CLASS_METHOD_INFO_MAP),
+                                 stores);
+    }
+  } else {
+    redex::write_all_intermediate(conf, args.out_dir, args.redex_options,
+                                  stores, args.entry_data);
+  }
+}
+
+// An entry of a batch file.
+struct BatchEntry {
+  // The name of the output directories of the run.
+  std::string name;
+  std::vector<std::string> dex_files;
+};
+
+/**
+ * Reads the runs of a batch, one per line: a name, then the dex files of the
+ * run, separated by whitespace. Empty lines and lines starting with '#' are
+ * ignored.
+ */
+std::vector<BatchEntry> read_batch_file(const std::string& path) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "error: cannot read batch file: " << path << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  std::vector<BatchEntry> entries;
+  std::unordered_set<std::string> names;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    BatchEntry entry;
+    if (!(fields >> entry.name) || entry.name[0] == '#') {
+      continue;
+    }
+    std::string dex_file;
+    while (fields >> dex_file) {
+      entry.dex_files.push_back(dex_file);
+    }
+    if (entry.dex_files.empty() || entry.name.find('/') != std::string::npos ||
+        !names.insert(entry.name).second) {
+      std::cerr << "error: invalid batch entry: " << line << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+#ifdef __linux__
+/**
+ * Loads what the forked runs of a batch or of the server share
+ */
+Scope load_shared_classes(Arguments& args,
+                          keep_rules::ProguardConfiguration& pg_config) {
+  Timer t("Redex_frontend (shared)");
+  g_redex->load_pointers_cache();
+  Scope external_classes;
+  parse_proguard_configs(args, pg_config);
+  load_library_jars(args, pg_config, &external_classes);
+  return external_classes;
+}
+
+/**
+ * Runs the passes on an entry of a batch, in a process forked once the library
+ * jars are loaded, hence with its own copy of the classes. The outputs of the
+ * run go to <outdir>/<name>, and the results of the analysis passes to
+ * $ANALYSIS_OUTPUT/<name>.
+ */
+int run_batch_entry(
+    const BatchEntry& entry,
+    ConfigFiles& conf,
+    Arguments& args,
+    std::unique_ptr<keep_rules::ProguardConfiguration> pg_config,
+    const Scope& external_classes) {
+  args.out_dir += "/" + entry.name;
+  args.dex_files = entry.dex_files;
+  boost::filesystem::create_directories(args.out_dir);
+  conf.set_outdir(args.out_dir);
+
+  // The runs are concurrent, so each one logs to its own file.
+  auto log_path = args.out_dir + "/redex.log";
+  int log_fd = open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (log_fd >= 0) {
+    dup2(log_fd, STDOUT_FILENO);
+    dup2(log_fd, STDERR_FILENO);
+    close(log_fd);
+  }
+
+  const char* analysis_output = getenv("ANALYSIS_OUTPUT");
+  if (analysis_output != nullptr) {
+    setenv("ANALYSIS_OUTPUT",
+           (std::string(analysis_output) + "/" + entry.name).c_str(),
+           /* overwrite */ 1);
+    boost::filesystem::create_directories(
+        *analysis_output::result_directory());
+  }
+
+  Json::Value stats;
+  DexStoresVector stores;
+  load_dexes(conf, args, stores, stats);
+  process_program_classes(conf, args, *pg_config, external_classes, stores);
+  conf.parse_global_config();
+  redex_run_passes(conf, args, std::move(pg_config), stores, stats);
+
+  std::ofstream out(conf.metafile(
+      args.config.get("stats_output", "redex-stats.txt").asString()));
+  out << stats;
+  return out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+/**
+ * Loads the library jars once, then runs the passes on every entry of the
+ * batch file in a forked process, at most --batch-jobs at a time. Returns
+ * whether all the runs succeeded.
+ */
+bool redex_batch(ConfigFiles& conf,
+                 Arguments& args,
+                 std::unique_ptr<keep_rules::ProguardConfiguration> pg_config) {
+#ifdef __linux__
+  auto entries = read_batch_file(args.batch_file);
+  Scope external_classes = load_shared_classes(args, *pg_config);
+
+  Timer t("Running the batch");
+  std::unordered_map<pid_t, const BatchEntry*> running;
+  size_t num_failed = 0;
+  auto wait_for_run = [&]() {
+    int stat;
+    pid_t pid;
+    do {
+      pid = waitpid(-1, &stat, 0);
+    } while (pid == -1 && errno == EINTR);
+    always_assert_log(pid > 0, "waitpid failed: %s", strerror(errno));
+    const BatchEntry* entry = running.at(pid);
+    running.erase(pid);
+    if (WIFEXITED(stat) && WEXITSTATUS(stat) == 0) {
+      TRACE(MAIN, 1, "Batch run %s done", entry->name.c_str());
+      return;
+    }
+    ++num_failed;
+    std::cerr << "error: batch run " << entry->name << " failed (status "
+              << std::hex << stat << std::dec << "), see " << args.out_dir
+              << "/" << entry->name << "/redex.log" << std::endl;
+  };
+
+  for (const auto& entry : entries) {
+    while (running.size() >= std::max(args.batch_jobs, 1u)) {
+      wait_for_run();
+    }
+    // Otherwise the buffered output would be written by the child too.
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+    pid_t pid = fork();
+    if (pid < 0) {
+      std::cerr << "error: fork failed for batch run " << entry.name << ": "
+                << strerror(errno) << std::endl;
+      ++num_failed;
+      continue;
+    }
+    if (pid == 0) {
+      // Child. The exit handlers belong to the parent.
+      int status = run_batch_entry(entry, conf, args, std::move(pg_config),
+                                   external_classes);
+      std::cout.flush();
+      std::cerr.flush();
+      fflush(nullptr);
+      _exit(status);
+    }
+    running.emplace(pid, &entry);
+  }
+  while (!running.empty()) {
+    wait_for_run();
+  }
+  std::cerr << entries.size() - num_failed << " of " << entries.size()
+            << " batch runs succeeded" << std::endl;
+  return num_failed == 0;
+#else
+  (void)conf;
+  (void)args;
+  (void)pg_config;
+  std::cerr << "error: --batch is only supported on Linux" << std::endl;
+  return false;
+#endif
+}
+
+#ifdef __linux__
+// Reads a line, without its '\n', from a socket, within `timeout_ms`. Returns
+// an error message if the line is empty, or if the peer did not send it in
+// time, so that a stalled client does not hold up the next connections.
+std::string read_line(int fd, unsigned timeout_ms, std::string* line) {
+  using Clock = std::chrono::steady_clock;
+  auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+  char buffer[4096];
+  size_t end;
+  while ((end = line->find('\n')) == std::string::npos) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - Clock::now());
+    pollfd poll_fd{fd, POLLIN, 0};
+    int ready =
+        remaining.count() > 0 ? poll(&poll_fd, 1, remaining.count()) : 0;
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready == 0) {
+      return "timed out waiting for the request";
+    }
+    ssize_t n = ready < 0 ? -1 : read(fd, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    line->append(buffer, n);
+  }
+  if (end != std::string::npos) {
+    line->resize(end);
+  }
+  return line->empty() ? "empty request" : "";
+}
+
+// Writes a response as one line of compact JSON. Does not raise SIGPIPE if the
+// client is gone.
+void send_response(int fd, const Json::Value& response) {
+  Json::StreamWriterBuilder builder;
+  builder["indentation"] = "";
+  auto text = Json::writeString(builder, response) + "\n";
+  const char* data = text.data();
+  size_t size = text.size();
+  while (size > 0) {
+    ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return;
+    }
+    data += n;
+    size -= n;
+  }
+}
+
+Json::Value error_response(const std::string& error) {
+  Json::Value response;
+  response["status"] = "error";
+  response["error"] = error;
+  return response;
+}
+
+/**
+ * Parses a request of the server, a JSON object on one line, either
+ *
+ *   {"dex_files": ["<dex>", ...], "methods": ["<method>", ...]}
+ *
+ * to analyze the dex files and get the results of the given methods (or of all
+ * the methods if there are none), named as in the results, e.g.
+ * "Lcom/Foo;.evaluate:(I)I", or
+ *
+ *   {"command": "shutdown"}
+ *
+ * Returns an error message if the request is invalid.
+ */
+std::string parse_request(const std::string& line, Json::Value* request) {
+  Json::CharReaderBuilder builder;
+  std::istringstream in(line);
+  std::string errors;
+  if (!Json::parseFromStream(builder, in, request, &errors)) {
+    return "invalid JSON: " + errors;
+  }
+  if (!request->isObject()) {
+    return "the request is not an object";
+  }
+  auto command = request->get("command", "analyze");
+  if (command == "shutdown") {
+    return "";
+  }
+  if (command != "analyze") {
+    return "unknown command: " + command.asString();
+  }
+  const auto& dex_files = (*request)["dex_files"];
+  if (!dex_files.isArray() || dex_files.empty()) {
+    return "dex_files must be a non-empty array";
+  }
+  const auto& methods = (*request)["methods"];
+  if (!methods.isNull() && !methods.isArray()) {
+    return "methods must be an array";
+  }
+  for (const auto* strings : {&dex_files, &methods}) {
+    for (const auto& value : *strings) {
+      if (!value.isString()) {
+        return "dex_files and methods must be strings";
+      }
+    }
+  }
+  return "";
+}
+
+/**
+ * Answers an analysis request of the server, in a process forked from it, and
+ * writes the response to `connection`. The outputs of the run go to
+ * `work_dir`. Returns whether the analysis succeeded.
+ */
+bool serve_request(const Json::Value& request,
+                   int connection,
+                   const std::string& work_dir,
+                   ConfigFiles& conf,
+                   Arguments& args,
+                   std::unique_ptr<keep_rules::ProguardConfiguration> pg_config,
+                   const Scope& external_classes) {
+  auto start = std::chrono::steady_clock::now();
+  args.out_dir = work_dir;
+  conf.set_outdir(work_dir);
+  auto log_path = work_dir + "/redex.log";
+  int log_fd = open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (log_fd >= 0) {
+    dup2(log_fd, STDOUT_FILENO);
+    dup2(log_fd, STDERR_FILENO);
+    close(log_fd);
+  }
+  auto results_dir = work_dir + "/results";
+  boost::filesystem::create_directories(results_dir);
+  setenv("ANALYSIS_OUTPUT", results_dir.c_str(), /* overwrite */ 1);
+  unsetenv("current_date_time");
+
+  args.dex_files.clear();
+  for (const auto& dex_file : request["dex_files"]) {
+    args.dex_files.push_back(dex_file.asString());
+  }
+  std::unordered_set<std::string> methods;
+  for (const auto& method : request["methods"]) {
+    methods.insert(method.asString());
+  }
+
+  Json::Value response;
+  try {
+    Json::Value stats;
+    DexStoresVector stores;
+    load_dexes(conf, args, stores, stats);
+    process_program_classes(conf, args, *pg_config, external_classes, stores);
+    conf.parse_global_config();
+    redex_run_passes(conf, args, std::move(pg_config), stores, stats,
+                     /* write_output */ false);
+    response["status"] = "ok";
+    response["results"] = analysis_output::read_results(results_dir, methods);
+    response["time_ms"] = static_cast<Json::Int64>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+  } catch (const std::exception& e) {
+    std::cerr << "error: " << e.what() << std::endl;
+    send_response(connection, error_response(e.what()));
+    return false;
+  }
+  send_response(connection, response);
+  return true;
+}
+
+// Creates a fresh directory for the outputs of a request.
+boost::optional<std::string> make_work_dir() {
+  auto tmp_path = boost::filesystem::temp_directory_path();
+  tmp_path /= "redex.serve.XXXXXX";
+  std::string tmp_str = tmp_path.string();
+  if (mkdtemp(&tmp_str[0]) == nullptr) {
+    return boost::none;
+  }
+  return tmp_str;
+}
+#endif
+
+/**
+ * Loads the library jars once, then answers the analysis requests sent to the
+ * Unix domain socket --serve, see parse_request(), until it gets a shutdown
+ * request. Every request is analyzed in a forked process, with its own copy of
+ * the classes and of what the passes preloaded, see Pass::preload(), at most
+ * --batch-jobs at a time. A connection that does not send its request within
+ * --serve-timeout is answered with an error. The response is a JSON object on
+ * one line,
+ * {"status": "ok", "results": {"<suffix>": [<record>, ...]}, "time_ms": <ms>}
+ * with the records of the requested methods written by each analysis pass and
+ * the time the forked process took to answer, or
+ * {"status": "error", "error": "<message>"}. The connection is closed without
+ * a response if the analysis crashes, in which case its log is kept.
+ */
+bool redex_serve(ConfigFiles& conf,
+                 Arguments& args,
+                 std::unique_ptr<keep_rules::ProguardConfiguration> pg_config) {
+#ifdef __linux__
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (args.serve_socket.size() >= sizeof(address.sun_path)) {
+    std::cerr << "error: socket path is too long: " << args.serve_socket
+              << std::endl;
+    return false;
+  }
+  strncpy(address.sun_path, args.serve_socket.c_str(),
+          sizeof(address.sun_path) - 1);
+
+  Scope external_classes = load_shared_classes(args, *pg_config);
+  // The passes are configured here too, so that they load what the runs of
+  // the requests share once, e.g. their labels and summary caches, and again
+  // after each request if it changed.
+  PassManager configured_passes(PassRegistry::get().get_passes(), args.config,
+                                args.redex_options);
+  auto preload_passes = []() {
+    Timer t("Preloading the passes");
+    for (auto* pass : PassRegistry::get().get_passes()) {
+      pass->preload();
+    }
+  };
+  preload_passes();
+
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(args.serve_socket.c_str());
+  if (server < 0 ||
+      bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) !=
+          0 ||
+      listen(server, SOMAXCONN) != 0) {
+    std::cerr << "error: cannot listen on " << args.serve_socket << ": "
+              << strerror(errno) << std::endl;
+    return false;
+  }
+  std::cerr << "Serving on " << args.serve_socket << std::endl;
+
+  // The work directories of the running requests.
+  std::unordered_map<pid_t, std::string> running;
+  auto reap = [&](bool block) {
+    bool reaped = false;
+    for (;;) {
+      int stat;
+      pid_t pid = waitpid(-1, &stat, block ? 0 : WNOHANG);
+      if (pid == -1 && errno == EINTR) {
+        continue;
+      }
+      if (pid <= 0) {
+        break;
+      }
+      auto it = running.find(pid);
+      if (it == running.end()) {
+        continue;
+      }
+      if (WIFEXITED(stat) && WEXITSTATUS(stat) == 0) {
+        boost::filesystem::remove_all(it->second);
+      } else {
+        std::cerr << "error: request failed (status " << std::hex << stat
+                  << std::dec << "), see " << it->second << "/redex.log"
+                  << std::endl;
+      }
+      running.erase(it);
+      reaped = true;
+      // Collect the others without waiting.
+      block = false;
+    }
+    if (reaped) {
+      // The request may have added to the summary caches.
+      preload_passes();
+    }
+  };
+
+  for (;;) {
+    int connection = accept(server, nullptr, nullptr);
+    if (connection < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "error: accept failed: " << strerror(errno) << std::endl;
+      break;
+    }
+    reap(/* block */ false);
+
+    std::string line;
+    Json::Value request;
+    std::string error = read_line(connection, args.serve_timeout_ms, &line);
+    if (error.empty()) {
+      error = parse_request(line, &request);
+    }
+    if (!error.empty()) {
+      send_response(connection, error_response(error));
+      close(connection);
+      continue;
+    }
+    if (request.get("command", "analyze") == "shutdown") {
+      Json::Value response;
+      response["status"] = "ok";
+      send_response(connection, response);
+      close(connection);
+      break;
+    }
+
+    while (running.size() >= std::max(args.batch_jobs, 1u)) {
+      reap(/* block */ true);
+    }
+    auto work_dir = make_work_dir();
+    if (!work_dir) {
+      send_response(connection,
+                    error_response("cannot create a work directory"));
+      close(connection);
+      continue;
+    }
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+    pid_t pid = fork();
+    if (pid == 0) {
+      // Child.
+      close(server);
+      bool ok = serve_request(request, connection, *work_dir, conf, args,
+                              std::move(pg_config), external_classes);
+      close(connection);
+      std::cout.flush();
+      std::cerr.flush();
+      fflush(nullptr);
+      _exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    if (pid < 0) {
+      send_response(connection, error_response("fork failed"));
+    } else {
+      running.emplace(pid, *work_dir);
+    }
+    close(connection);
+  }
+
+  while (!running.empty()) {
+    reap(/* block */ true);
+  }
+  close(server);
+  unlink(args.serve_socket.c_str());
+  return true;
+#else
+  (void)conf;
+  (void)args;
+  (void)pg_config;
+  std::cerr << "error: --serve is only supported on Linux" << std::endl;
+  return false;
+#endif
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
@@ -1286,6 +2152,16 @@ int main(int argc, char* argv[]) {
       args.redex_options.min_sdk = *maybe_sdk;
     }
 
+    if (!args.serve_socket.empty()) {
+      return redex_serve(conf, args, std::move(pg_config)) ? EXIT_SUCCESS
+                                                           : EXIT_FAILURE;
+    }
+    if (!args.batch_file.empty()) {
+      // Every run of the batch writes its own stats.
+      return redex_batch(conf, args, std::move(pg_config)) ? EXIT_SUCCESS
+                                                           : EXIT_FAILURE;
+    }
+
     {
       auto profile_frontend =
           ScopedCommandProfiling::maybe_from_env("FRONTEND_", "frontend");
@@ -1293,51 +2169,7 @@ int main(int argc, char* argv[]) {
       conf.parse_global_config();
     }
 
-    // Initialize purity defaults, if set.
-    purity::CacheConfig::parse_default(conf);
-
-    auto const& passes = PassRegistry::get().get_passes();
-    PassManager manager(passes, std::move(pg_config), args.config,
-                        args.redex_options);
-
-    std::unordered_map<std::string, std::string> exp_states;
-    conf.get_json_config().get("ab_experiments_states", {}, exp_states);
-    {
-      std::unordered_map<std::string, std::string> exp_states_override;
-      conf.get_json_config().get("ab_experiments_states_override", {},
-                                 exp_states_override);
-      for (auto& p : exp_states_override) {
-        exp_states[p.first] = std::move(p.second);
-      }
-    }
-    auto exp_state_default = [&]() -> boost::optional<std::string> {
-      if (!conf.get_json_config().contains("ab_experiments_default")) {
-        return boost::none;
-      }
-      return conf.get_json_config().get("ab_experiments_default",
-                                        std::string(""));
-    }();
-    ab_test::ABExperimentContext::parse_experiments_states(
-        exp_states, exp_state_default, !manager.get_redex_options().redacted);
-
-    {
-      Timer t("Running optimization passes");
-      manager.run_passes(stores, conf);
-    }
-
-    if (args.stop_pass_idx == boost::none) {
-      // Call redex_backend by default
-      auto profile_backend =
-          ScopedCommandProfiling::maybe_from_env("BACKEND_", "backend");
-      redex_backend(conf, manager, stores, stats);
-      if (args.config.get("emit_class_method_info_map", false).asBool()) {
-        dump_class_method_info_map(conf.metafile(CLASS_METHOD_INFO_MAP),
-                                   stores);
-      }
-    } else {
-      redex::write_all_intermediate(conf, args.out_dir, args.redex_options,
-                                    stores, args.entry_data);
-    }
+    redex_run_passes(conf, args, std::move(pg_config), stores, stats);
 
     stats_output_path = conf.metafile(
         args.config.get("stats_output", "redex-stats.txt").asString());